@@ -2,26 +2,70 @@
 #include "tracker/Peer.h"
 #include "tracker/Transport.h" // Ensures we have TcpClient
 #include "parsing/Buffer.h"
+#include "download/EventHandler.h"
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <string>
 
 namespace BitTorrent {
 
     class Downloader; // Forward declaration still useful here
+    class Farm;       // Farm.h includes us
+    class Dialer;
 
-    class Connection {
+    // Requests are pipelined: each connection keeps 'queue_depth' of them outstanding, sized to
+    // the peer's bandwidth-delay product (measured rate x lowest request-to-block time, in
+    // blocks) times QUEUE_GAIN, so the pipe stays full while the estimate grows. Never more than
+    // the peer's BEP 10 'reqq', or MAX_QUEUE_DEPTH if it didn't say.
+    // The socket stays non-blocking for its whole life: what a slow peer doesn't take right away
+    // waits in 'send_buffer' and goes out on EPOLLOUT, so no peer can hold up the loop.
+    class Connection : public EventHandler {
     public:
+        using Clock = std::chrono::steady_clock;
         enum State { CONNECTING, HANDSHAKING, DOWNLOADING };
+        static constexpr int MAX_BAD_BLOCKS = 3; // v2: corrupt blocks tolerated before we hang up
+        static constexpr int CONNECT_TIMEOUT_MS = 5000; // Per attempt: a peer that doesn't answer the SYN by then is dead to us
+        static constexpr size_t INITIAL_QUEUE_DEPTH = 4; // Until there is a rate and an RTT to go by
+        static constexpr size_t MIN_QUEUE_DEPTH = 2;
+        static constexpr size_t MAX_QUEUE_DEPTH = 250;   // What common clients accept without a 'reqq'
+        static constexpr double QUEUE_GAIN = 2.0;
+        static constexpr double RATE_WINDOW_S = 0.1;     // Shortest span a rate sample is taken over
+        static constexpr int SNUB_S = 30;                // Outstanding requests, and no block for that long
+
+        // A REQUEST sent and not answered yet
+        struct Request {
+            uint32_t piece;
+            uint32_t begin;
+            uint32_t length;
+            Clock::time_point sent;
+        };
 
         Peer peer;
         Downloader& downloader;
         std::unique_ptr<TcpClient> socket;
+        std::unique_ptr<Dialer> dialer; // While the TCP connect is in flight
         State state = CONNECTING;
+        bool cancelled = false;         // We dropped it (enough peers already), not the peer's fault
+        bool timed_out = false;         // The connect never finished
         
         bool choked = true;          
+        bool snubbed = false;        // Sat on our requests (see Snubbed()) and hasn't sent a block since
         bool handshake_done = false;
+        int bad_blocks = 0;          // Blocks from this peer that failed their Merkle leaf
+        size_t bytes_received = 0;   // Block payload, good or bad
+
+        // Pipelining
+        std::deque<Request> outstanding;            // Oldest first
+        size_t queue_depth = INITIAL_QUEUE_DEPTH;   // How many 'outstanding' we aim for
+        int peer_reqq = 0;                          // BEP 10 'reqq', 0 if the peer didn't say
+        double rate = 0;                            // Bytes/s, smoothed
+        double min_rtt = 0;                         // Seconds from REQUEST to its block, lowest seen
 
         // Data Buffering
         Buffer recv_buffer; 
+        Buffer send_buffer; // Written, but not taken by the socket yet
 
         // Current Job
         int current_piece = -1;
@@ -29,10 +73,26 @@ namespace BitTorrent {
 
         std::vector<bool> peer_pieces; // True if peer has this piece
         Connection(Peer p, Downloader& d);
+        ~Connection() override;
         
-        void Connect();
+        // Non-blocking: the connect finishes on 'farm' (EPOLLOUT + SO_ERROR, via a Dialer) and
+        // tells the downloader, which may still turn the peer away. Gives up after 'timeout_ms'.
+        void Connect(Farm& farm, int timeout_ms = CONNECT_TIMEOUT_MS);
+        void Cancel(); // Stops a connect still in flight, or hangs up; marks it 'cancelled'
+        bool Dialing() const { return dialer != nullptr; }
         void OnReadyRead();  
         void OnReadyWrite(); 
+        void OnEvent(uint32_t events) override;
+        // Starts requesting again if the connection sits idle (e.g. pieces were re-queued)
+        void Kick();
+        // Sends CANCEL for everything outstanding and hands those blocks back for re-issue
+        void CancelRequests();
+        // Requests have been outstanding for the downloader's 'snub_ms' without a single block
+        bool Snubbed(Clock::time_point now = Clock::now()) const;
+
+        // Requests worth keeping outstanding for 'rate' bytes/s over 'rtt_s' seconds, capped by
+        // 'reqq' (0: MAX_QUEUE_DEPTH). INITIAL_QUEUE_DEPTH while either is still unknown.
+        static size_t QueueDepth(double rate, double rtt_s, int reqq);
         
         int GetSocketFd() { 
             return socket ? socket->GetSocket() : -1; 
@@ -42,7 +102,25 @@ namespace BitTorrent {
         return peer_pieces[index];
     }
     private:
+        Farm* farm = nullptr;
+        uint64_t connect_timer = 0; // Farm::TimerId
+        bool want_write = false;    // EPOLLOUT is in our epoll mask
+
+        bool extensions = false;          // Peer speaks BEP 10
+        Clock::time_point last_block;     // Or when the queue last went from empty to busy
+        Clock::time_point window_start;   // Current rate sample
+        size_t window_bytes = 0;
+
+        void OnDialed(int fd, const std::string& error);
+        void Drop(); // Closes the socket and takes it out of the epoll set
+        void Send(const Buffer& data); // Queues 'data' behind what is still unsent and writes what the socket takes
+        void Flush();  // Writes 'send_buffer' until the socket would block. Throws if the peer is gone.
         void ProcessBuffer();   
-        void RequestNextBlock(); 
+        void FillPipeline();      // Requests until 'queue_depth' are outstanding (or no work)
+        // Appends the next REQUEST (and a v2 hash request first, for a new piece) to 'out'.
+        // False if there was nothing (left) to ask this peer for.
+        bool RequestNextBlock(Buffer& out);
+        void OnBlock(uint32_t index, uint32_t begin, size_t size);
+        void ReleaseRequests();   // Forgets 'outstanding'; their pieces and ours go back to the Downloader
     };
 }
\ No newline at end of file
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+
+namespace BitTorrent {
+
+    // Anything registered in the Farm's epoll set. The Farm stores a pointer to it in
+    // epoll_event.data.ptr and hands back the ready events (EPOLLIN, EPOLLOUT, ...).
+    class EventHandler {
+    public:
+        virtual ~EventHandler() = default;
+        virtual void OnEvent(uint32_t events) = 0;
+    };
+}
@@ -1,21 +1,64 @@
 #pragma once
 #include "download/Connection.h"
 #include <vector>
+#include <map>
+#include <unordered_map>
 #include <memory>
 #include <functional>
+#include <chrono>
 #include <sys/epoll.h>
 
 namespace BitTorrent {
 
+    class Resolver;
+
     class Farm {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using TimerId = uint64_t;
+
+    private:
+        // Calls back when a plain fd (eventfd, timerfd, ...) becomes readable
+        struct FdWatcher : EventHandler {
+            std::function<void()> on_readable;
+            void OnEvent(uint32_t) override { on_readable(); }
+        };
+
         int epfd;
         std::vector<std::shared_ptr<Connection>> connections;
+        std::vector<std::unique_ptr<FdWatcher>> watchers;
+        std::unordered_map<int, EventHandler*> handlers; // Caller-owned, see Add()
         struct epoll_event events[64]; // Max events to process per loop
+        int ready = 0;                 // How many of 'events' the loop is working through
+
+        // One-shot timers, ordered by due time (the id breaks ties and makes Cancel() exact)
+        std::map<std::pair<Clock::time_point, TimerId>, std::function<void()>> timers;
+        std::unordered_map<TimerId, Clock::time_point> timer_due;
+        TimerId next_timer = 1;
+        std::unique_ptr<Resolver> resolver;
+
+        int NextTimeout() const;
+        void RunTimers();
 
     public:
         Farm();
         ~Farm();
-        void AddConnection(std::shared_ptr<Connection> conn);
+        // Keeps 'conn' alive for the Farm's lifetime and starts its (non-blocking) connect
+        void AddConnection(std::shared_ptr<Connection> conn, int connect_timeout_ms = Connection::CONNECT_TIMEOUT_MS);
+        // Wakes the loop whenever 'fd' is readable; the callback must drain it (level-triggered)
+        void Watch(int fd, std::function<void()> on_readable);
+
+        // Registers 'handler' for 'events' on 'fd'. The handler stays owned by the caller and must
+        // be Remove()d before it is destroyed; removing it from inside a callback is fine.
+        void Add(int fd, uint32_t events, EventHandler* handler);
+        void Modify(int fd, uint32_t events);
+        void Remove(int fd);
+
+        // Calls 'fn' on the loop thread once 'delay' has passed (0 = next loop iteration)
+        TimerId After(std::chrono::milliseconds delay, std::function<void()> fn);
+        void Cancel(TimerId id); // No-op for timers that already fired
+        // Host name lookups delivered on this loop (created on first use)
+        Resolver& GetResolver();
         void Run(); // The main loop
         void Run(std::function<bool()> checkComplete);
     };
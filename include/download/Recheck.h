@@ -0,0 +1,21 @@
+#pragma once
+#include "parsing/TorrentFile.h"
+#include "download/Worker.h"
+#include <string>
+#include <vector>
+
+namespace BitTorrent {
+
+    // Fast resume: finds out which pieces are already on disk and correct.
+    // Every file is memory-mapped and the pieces are hashed on a thread pool, eight equal-size
+    // pieces per call through Sha1::DigestMany (AVX2 lanes where that is faster).
+    // Missing files and short files are fine: pieces touching bytes that aren't there are
+    // reported missing without being hashed.
+    class Recheck {
+    public:
+        // Returns one flag per piece. 'progress' (optional) is advanced by every byte checked.
+        // threads == 0 means one per core.
+        static std::vector<bool> Run(const TorrentFile& tf, const std::string& root = ".",
+                                     Speed* progress = nullptr, size_t threads = 0);
+    };
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "parsing/TorrentFile.h"
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+
+namespace BitTorrent {
+
+    // Maps the torrent's single global byte stream onto the files on disk.
+    // A piece may straddle several files; Write() splits it using a sorted segment table
+    // (binary search, no per-byte work) and writes each part straight from the caller's buffer.
+    // File descriptors live in a small LRU cache so 10k-file torrents neither exhaust the fd limit
+    // nor reopen a file for every block.
+    class Storage {
+    public:
+        static constexpr size_t DEFAULT_MAX_OPEN_FILES = 64;
+
+        // All files of the torrent, created under 'root'
+        explicit Storage(const TorrentFile& tf, const std::string& root = ".",
+                         size_t max_open_files = DEFAULT_MAX_OPEN_FILES);
+        // A single file of unbounded size (plain offset -> file mapping)
+        explicit Storage(const std::string& filename);
+        ~Storage();
+
+        Storage(const Storage&) = delete;
+        Storage& operator=(const Storage&) = delete;
+
+        // Writes 'size' bytes at a global offset. Throws on I/O errors.
+        // Bytes that fall in padding (hybrid pad files, v2 alignment gaps) are dropped.
+        void Write(int64_t offset, const uint8_t* data, size_t size);
+        // Reads 'size' bytes at a global offset. Returns how many were available on disk
+        // (padding reads as zeros).
+        size_t Read(int64_t offset, uint8_t* data, size_t size);
+
+        size_t OpenFileCount() const { return open_files.size(); }
+        const std::string& FilePath(size_t index) const { return paths[index]; }
+
+    private:
+        // One contiguous range of the global stream that lives in one file (at file offset 0)
+        struct Segment {
+            int64_t offset;
+            int64_t length;
+            size_t file;
+        };
+        struct OpenFile {
+            int fd;
+            std::list<size_t>::iterator lru_pos;
+        };
+
+        std::vector<Segment> segments; // Sorted by offset, zero-length and pad files left out
+        int64_t stream_end;            // Total size of the global stream
+        std::vector<std::string> paths;
+
+        std::mutex mx; // Guards the fd cache (Writer thread vs. readers)
+        std::unordered_map<size_t, OpenFile> open_files;
+        std::list<size_t> lru; // Most recently used at the front
+        size_t max_open;
+
+        int GetFd(size_t file);
+        // The segment containing 'offset', or else the first one after it
+        std::vector<Segment>::const_iterator FindSegment(int64_t offset) const;
+    };
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "parsing/Buffer.h"
+#include "parsing/TorrentFile.h"
+#include "parsing/Sha1.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <vector>
+#include <chrono>
+#include <memory>
+
+namespace BitTorrent {
+
+    // A finished piece waiting to be hashed, and what came back
+    struct VerifyJob {
+        int piece;
+        int64_t offset;       // Global offset, handed on to the Writer
+        Buffer data;
+        PieceDigest expected;
+        // Optional running context that has already absorbed data[0, hashed);
+        // the hasher only needs to finish the tail. Null means hash everything.
+        std::unique_ptr<Sha1> sha;
+        size_t hashed = 0;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    struct VerifyResult {
+        int piece;
+        int64_t offset;
+        Buffer data;
+        bool ok;
+        PieceDigest actual;
+        PieceDigest expected;
+        double latency_ms;    // Submit() -> hash done
+    };
+
+    // Hashes completed pieces on a pool of threads so the epoll loop never stalls on SHA-1.
+    // Results are queued and signalled through an eventfd; the reactor watches GetEventFd()
+    // and calls Drain() when it becomes readable.
+    class Verifier {
+    public:
+        struct Stats {
+            size_t queue_depth = 0;     // Jobs submitted but not yet hashed
+            size_t max_queue_depth = 0;
+            size_t verified = 0;
+            size_t failed = 0;
+            double avg_latency_ms = 0;
+            double max_latency_ms = 0;
+        };
+
+        // threads == 0 means one per core
+        explicit Verifier(size_t threads = 0);
+        ~Verifier();
+        Verifier(const Verifier&) = delete;
+        Verifier& operator=(const Verifier&) = delete;
+
+        void Submit(VerifyJob job);
+        // Non-blocking: clears the eventfd and returns every result ready so far
+        std::vector<VerifyResult> Drain();
+
+        int GetEventFd() const { return event_fd; }
+        size_t ThreadCount() const { return pool.size(); }
+        Stats GetStats();
+
+    private:
+        int event_fd = -1;
+        std::vector<std::thread> pool;
+        std::mutex mx;
+        std::condition_variable cv;
+        std::queue<VerifyJob> jobs;
+        std::vector<VerifyResult> done;
+        bool stop_flag = false;
+
+        Stats stats;
+        double total_latency_ms = 0;
+
+        void Loop();
+    };
+}
@@ -3,10 +3,11 @@
 #include <mutex>
 #include <condition_variable>
 #include <queue>
-#include <fstream>
+#include <memory>
 #include <string>
 #include <atomic>
 #include "parsing/Buffer.h"
+#include "download/Storage.h"
 
 namespace BitTorrent {
 
@@ -21,10 +22,11 @@ namespace BitTorrent {
         std::mutex mx;
         std::condition_variable cv;
         std::queue<Job> q;
-        std::ofstream out;
+        std::unique_ptr<Storage> storage; // Splits each write across the torrent's files
         bool stop_flag = false;
     public:
         Writer(std::string filename);
+        Writer(const TorrentFile& tf, const std::string& root = ".");
         ~Writer(); 
         void start();
         void add(Buffer& b, int64_t offset); // Note: Non-const ref for move semantics
@@ -36,6 +38,7 @@ namespace BitTorrent {
         std::atomic<size_t> total_bytes{0};
         std::atomic<size_t> session_bytes{0};
         std::string filename;
+        std::atomic<const char*> label{"Downloading"}; // Shown in the status line
         bool stop_flag = false;
         
         std::string FormatBytes(double bytes);
@@ -44,5 +47,8 @@ namespace BitTorrent {
         ~Speed();
         void start();
         void add(size_t bytes);
+        void SetLabel(const char* text) { label = text; }
+        // Restart the progress bar at 'bytes' (e.g. after a recheck found that much on disk)
+        void Reset(size_t bytes) { bytes_downloaded = bytes; session_bytes = 0; }
     };
 }
\ No newline at end of file
@@ -1,43 +1,134 @@
 #pragma once
 #include "parsing/TorrentFile.h"
 #include "tracker/Peer.h"
+#include "tracker/PeerStore.h"
 #include "download/Worker.h"
+#include "download/Verifier.h"
 #include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <memory>
 #include <atomic>
 #include <string>
 
 namespace BitTorrent {
 
+    class Farm;
+    class Connection;
+    class Announcer;
+
+    // How this run's peer connects went
+    struct DialStats {
+        size_t started = 0;
+        size_t connected = 0;
+        size_t failed = 0;         // Refused, unreachable, ...
+        size_t timed_out = 0;      // No answer within the connect timeout
+        size_t peak_in_flight = 0; // Most connects pending at once
+    };
+
+    // A piece being assembled from blocks. Blocks are copied into 'data' as they arrive, and the
+    // in-order prefix is fed to 'sha' straight away (while the block is still in cache), so the
+    // digest is nearly done when the last block lands. Out-of-order blocks wait in 'held'.
+    // Pure v2 pieces skip the stream: each block gets its own SHA-256 leaf instead, and 'held'
+    // lists every stored block.
+    struct PieceState {
+        Buffer data;
+        size_t received = 0;             // Distinct bytes stored
+        size_t hashed = 0;               // data[0, hashed) has gone through 'sha'
+        std::map<size_t, size_t> held;   // offset -> length of blocks beyond the prefix
+        std::unique_ptr<Sha1> sha;
+        std::vector<Sha256Digest> leaves; // v2: digest of each stored block
+    };
+
     class Downloader {
     public:
+        static constexpr size_t BLOCK_SIZE = 16384; // Request granularity (16KB standard)
+        static constexpr size_t MAX_CONNECTIONS = 5;  // Limit peers to avoid file descriptor limits
+        static constexpr int MAINTAIN_MS = 1000;      // How often dead peers are replaced
+
+        // Peers are dialled without blocking, many at once: whichever answer first fill the
+        // MAX_CONNECTIONS slots and the rest are called off. Each connect gets 'connect_timeout_ms'.
+        int connect_timeout_ms;  // Connection::CONNECT_TIMEOUT_MS unless changed
+        size_t max_dials = 200; // Connects in flight at once
+        DialStats dial_stats;
+        // A peer with requests out and no block for 'snub_ms' has them cancelled and handed to others
+        int snub_ms;             // Connection::SNUB_S unless changed
+
         TorrentFile torrent;
         std::string my_id;
-        std::vector<Peer> peers;
+        PeerStore peers; // Every peer we've heard of; the only place dial candidates come from
         
         // These are from Step 2
         Writer file_writer;
         Speed s;
+        Verifier verifier; // Hashes finished pieces off the event loop thread
         void Start();
         std::atomic<int> next_req_index{0};
         std::atomic<long long> downloaded_bytes{0};
 
-        std::vector<uint8_t> piece_buffer; // Stores the current piece in RAM
-        int piece_bytes_received = 0;      // How many bytes of this piece we have
-        int current_piece_index = -1;      // Which piece we are building
+        std::unordered_map<int, PieceState> active_pieces; // Pieces with some blocks in RAM
+        std::vector<bool> completed_pieces;                // All blocks in (verifying or verified)
+        std::deque<int> retry_pieces;                      // Failed pieces, handed out again first
+
+        // v2 (BEP 52): block leaves a peer sent us in HASHES, already checked against the piece
+        // layer. With these every block is verified on arrival instead of once per piece.
+        std::unordered_map<int, std::vector<Sha256Digest>> piece_leaves;
+        size_t merkle_bad_blocks = 0; // Blocks rejected by their leaf hash
         // Constructor
         Downloader(const TorrentFile& tf, const std::string& id, const std::vector<Peer>& p_list);
 
         // Virtual methods allow us to Mock them in tests
-        virtual void OnBlockReceived(int piece_index, int offset, Buffer& data);
+        // Returns false only when the block fails its v2 leaf check, i.e. the sender sent bad data
+        // (duplicates and stray blocks are silently dropped)
+        virtual bool OnBlockReceived(int piece_index, int offset, Buffer& data);
+        // Called on the event loop thread when the Verifier's eventfd fires
+        void OnPiecesVerified();
+        // v2: the HASH_REQUEST to send before requesting blocks of 'piece' (empty if not needed)
+        Buffer HashRequestFor(int piece) const;
+        // v2: payload of a HASHES message
+        void OnHashesReceived(const Buffer& payload);
+        // First block offset >= 'from' of 'piece' that we don't hold yet
+        int64_t NextMissingBlock(int piece, int64_t from) const;
+        void RetryPiece(int piece) { retry_pieces.push_back(piece); }
+        // Stores peers we haven't seen before and dials while there are free connection slots.
+        // (Tracker replies go into 'peers' directly while Start() runs.)
+        void AddPeers(const std::vector<Peer>& list);
+        // A connect finished ('error' empty) or failed. False turns the peer away (we're full).
+        bool OnPeerDialed(Connection& c, const std::string& error);
         
         virtual int GetNextPieceToRequest() { 
+            while (!retry_pieces.empty()) {
+                int idx = retry_pieces.front();
+                retry_pieces.pop_front();
+                if (!completed_pieces[idx]) return idx;
+            }
             int idx = next_req_index++;
-            if(idx >= torrent.piece_hashes.size()) return -1;
+            while(idx < (int)torrent.PieceCount() && completed_pieces[idx]) idx = next_req_index++; // Already on disk
+            if(idx < 0 || (size_t)idx >= torrent.PieceCount()) return -1;
             return idx;
         }
 
         bool IsComplete() {
-            return downloaded_bytes >= torrent.length;
+            return downloaded_bytes >= total_bytes;
         }
+
+    private:
+        Farm* farm = nullptr;            // The running event loop (only during Start())
+        Announcer* announcer = nullptr;  // Its tracker schedule (only during Start())
+        std::vector<std::shared_ptr<Connection>> connections; // Dialled and not known dead
+        int last_family = 0;             // Of the peer dialled last
+        bool refill_queued = false;      // A DialCandidates() is due on the next loop pass
+        int64_t total_bytes;             // Sum of piece sizes (pure v2 leaves gaps between files)
+        int64_t start_bytes = 0;         // Already on disk when Start() began
+        bool merkle = false; // Verify per block against v2 trees (pure v2 torrents)
+
+        void DialCandidates();
+        size_t Established() const;      // Connected (or handshaking) peers
+        size_t Dialing() const;          // Connects still in flight
+        void Maintain();
+        bool OnMerkleBlock(int piece_index, PieceState& p, size_t off, const Buffer& data);
+        void FinishMerklePiece(int piece_index, PieceState& p);
     };
 }
\ No newline at end of file
@@ -19,6 +19,17 @@ namespace BitTorrent {
         static constexpr uint8_t REQUEST = 6;
         static constexpr uint8_t PIECE = 7;
         static constexpr uint8_t CANCEL = 8;
+        // BEP 10: extension protocol; sub-ID 0 of it is the extended handshake
+        static constexpr uint8_t EXTENDED = 20;
+        static constexpr uint8_t EXTENDED_HANDSHAKE = 0;
+        // BEP 52 (v2): Merkle hashes on demand
+        static constexpr uint8_t HASH_REQUEST = 21;
+        static constexpr uint8_t HASHES = 22;
+        static constexpr uint8_t HASH_REJECT = 23;
+        // Reserved-bit in handshake byte 7 announcing v2 support
+        static constexpr uint8_t RESERVED_V2 = 0x10;
+        // Reserved-bit in handshake byte 5 announcing the extension protocol (BEP 10)
+        static constexpr uint8_t RESERVED_EXTENSIONS = 0x10;
 
         // --- Builders (Outgoing) ---
         static Buffer BuildHandshake(const TorrentFile& t, const std::string& peer_id);
@@ -27,11 +38,29 @@ namespace BitTorrent {
         static Buffer BuildUnchoke();
         static Buffer BuildInterested();
         static Buffer BuildRequest(uint32_t index, uint32_t begin, uint32_t length);
+        static Buffer BuildCancel(uint32_t index, uint32_t begin, uint32_t length);
+        // BEP 10: we support no extension messages, this just asks the peer for its 'reqq'
+        static Buffer BuildExtendedHandshake();
+        static Buffer BuildPiece(uint32_t index, uint32_t begin, const uint8_t* data, size_t size);
+        static Buffer BuildBitfield(const std::vector<bool>& have);
+        // 'length' hashes of layer 'base_layer' (0 = 16 KiB leaves) of the file tree with
+        // 'pieces_root', starting at 'index', plus 'proof_layers' uncle hashes above them
+        static Buffer BuildHashRequest(const Sha256Digest& pieces_root, uint32_t base_layer, uint32_t index,
+                                       uint32_t length, uint32_t proof_layers);
+        static Buffer BuildHashes(const Sha256Digest& pieces_root, uint32_t base_layer, uint32_t index,
+                                  uint32_t length, uint32_t proof_layers, const std::vector<Sha256Digest>& hashes);
+        static Buffer BuildHashReject(const Sha256Digest& pieces_root, uint32_t base_layer, uint32_t index,
+                                      uint32_t length, uint32_t proof_layers);
         
         // --- Parsers (Incoming) ---
         // Reads the 4-byte length prefix from a buffer
         static uint32_t ReadMessageLength(const Buffer& b);
         // Reads the Message ID (e.g., 7 for PIECE)
         static uint8_t ReadMessageID(const Buffer& b);
+        // True if a peer's 68-byte handshake sets the BEP 10 bit
+        static bool SupportsExtensions(const Buffer& handshake);
+        // 'reqq' (how many requests the peer queues) from an EXTENDED payload holding its
+        // extended handshake; 0 if it doesn't say or the payload is anything else
+        static int ReadReqq(const Buffer& payload);
     };
 }
\ No newline at end of file
@@ -2,31 +2,67 @@
 
 #include "Buffer.h"
 #include <variant>
-#include <map>
 #include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <algorithm>
 
 namespace BitTorrent {
 
     // Forward declaration because a List contains Bnodes
     class Bnode;
+    class BDict;
 
-    // Define the possible types a Bnode can hold
-    using BList = std::vector<Bnode>;
-    using BDict = std::map<std::string, Bnode>;
+    // Define the possible types a Bnode can hold.
+    // Containers are std::pmr, so a whole decoded tree can be carved out of one arena
+    // (see Bnode::Decode). Built without a resource they behave like the plain std types.
+    using BList = std::pmr::vector<Bnode>;
     using BInt  = int64_t;
-    using BString = Buffer; // We treat byte strings as std::string for simplicity
+    using BString = std::pmr::vector<uint8_t>; // Raw bytes (not necessarily text)
+
+    // Dictionary stored as a flat array of (key, value) sorted by key.
+    // One contiguous block instead of a heap node per key like std::map; lookups are a
+    // binary search, and bencode keys already arrive sorted so decoding only appends.
+    class BDict {
+    public:
+        using Entry = std::pair<std::pmr::string, Bnode>;
+        using const_iterator = const Entry*; // Entries are contiguous
+
+        BDict() = default;
+        explicit BDict(std::pmr::memory_resource* mr) : entries(mr) {}
+
+        // std::map style access
+        Bnode& operator[](std::string_view key);
+        const Bnode& at(std::string_view key) const;
+        size_t count(std::string_view key) const { return find(key) != end() ? 1 : 0; }
+        const_iterator find(std::string_view key) const;
+
+        const_iterator begin() const;
+        const_iterator end() const;
+        size_t size() const;
+        bool empty() const { return size() == 0; }
+
+    private:
+        std::pmr::vector<Entry> entries;
+    };
 
     class Bnode {
     public:
         // The actual data is stored here
         std::variant<BInt, BString, BList, BDict> value;
 
+        // Where this node sits in the buffer it was decoded from: [raw_begin, raw_end).
+        // Lets callers hash or forward the original bytes (e.g. 'info') without re-encoding.
+        size_t raw_begin = 0;
+        size_t raw_end = 0;
+
         // Constructors
         Bnode() = default;
         Bnode(BInt v) : value(v) {}
-        Bnode(BString v) : value(v) {}
-        Bnode(BList v) : value(v) {}
-        Bnode(BDict v) : value(v) {}
+        Bnode(BString v) : value(std::move(v)) {}
+        Bnode(const Buffer& v) : value(BString(v.begin(), v.end())) {}
+        Bnode(BList v) : value(std::move(v)) {}
+        Bnode(BDict v) : value(std::move(v)) {}
 
         // Helper methods to check type
         bool IsInt() const { return std::holds_alternative<BInt>(value); }
@@ -40,13 +76,13 @@ namespace BitTorrent {
             return std::get<BInt>(value); 
         }
         
-        const Buffer& GetString() const { 
+        const BString& GetString() const { 
             if(!IsString()) throw std::runtime_error("Type mismatch: Expected String");
             return std::get<BString>(value); 
         }
         // Helper to convert to std::string (Good for 'announce' URL)
         std::string ToString() const {
-            const Buffer& b = GetString();
+            const BString& b = GetString();
             return std::string(b.begin(), b.end());
         }
         const BList& GetList() const { 
@@ -59,11 +95,96 @@ namespace BitTorrent {
             return std::get<BDict>(value); 
         }
 
-        // Static Decoding Function
-        static Bnode Decode(const Buffer& data);
+        // Static Decoding Function (fills raw_begin/raw_end on every node)
+        // Every container in the tree is allocated from 'mr'. Pass a
+        // std::pmr::monotonic_buffer_resource to get the whole tree in a few big blocks that are
+        // released together with the arena (no per-node free). The tree must not outlive 'mr';
+        // copies of nodes use the default resource and are safe to keep.
+        static Bnode Decode(const Buffer& data, std::pmr::memory_resource* mr = std::pmr::get_default_resource());
+
+        // Encoding: one sizing pass, one allocation, one writing pass. No per-node temporaries.
         static Buffer Encode(const Bnode& node);
+        static void Encode(const Bnode& node, Buffer& out); // Appends to 'out'
+        static size_t EncodedSize(const Bnode& node);
+
+        // Writes straight into any output iterator (raw pointer, back_inserter, ...)
+        template <typename OutputIt>
+        static OutputIt EncodeTo(const Bnode& node, OutputIt out) {
+            switch (node.value.index()) {
+            case 0: // BInt
+                *out++ = 'i';
+                out = WriteInt(std::get<BInt>(node.value), out);
+                *out++ = 'e';
+                break;
+            case 1: { // BString
+                const BString& s = std::get<BString>(node.value);
+                out = WriteInt((int64_t)s.size(), out);
+                *out++ = ':';
+                out = std::copy(s.begin(), s.end(), out);
+                break;
+            }
+            case 2: // BList
+                *out++ = 'l';
+                for (const auto& item : std::get<BList>(node.value)) out = EncodeTo(item, out);
+                *out++ = 'e';
+                break;
+            case 3: // BDict (std::map iterates keys in sorted order, as bencode requires)
+                *out++ = 'd';
+                for (const auto& pair : std::get<BDict>(node.value)) {
+                    out = WriteInt((int64_t)pair.first.size(), out);
+                    *out++ = ':';
+                    out = std::copy(pair.first.begin(), pair.first.end(), out);
+                    out = EncodeTo(pair.second, out);
+                }
+                *out++ = 'e';
+                break;
+            }
+            return out;
+        }
 
     private:
-        static Bnode DecodeElement(const Buffer& data, size_t& index);
+        static Bnode DecodeElement(const Buffer& data, size_t& index, std::pmr::memory_resource* mr);
+
+        // Decimal digits of an integer, written without a temporary std::string
+        template <typename OutputIt>
+        static OutputIt WriteInt(int64_t v, OutputIt out) {
+            char digits[20];
+            int n = 0;
+            uint64_t u = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+            do { digits[n++] = '0' + (u % 10); u /= 10; } while (u);
+            if (v < 0) *out++ = '-';
+            while (n) *out++ = digits[--n];
+            return out;
+        }
+        static size_t IntLength(int64_t v);
     };
+
+    // BDict members need the complete Bnode type
+    inline BDict::const_iterator BDict::begin() const { return entries.data(); }
+    inline BDict::const_iterator BDict::end() const { return entries.data() + entries.size(); }
+    inline size_t BDict::size() const { return entries.size(); }
+
+    inline Bnode& BDict::operator[](std::string_view key) {
+        // Fast path: sorted input (every valid bencode dict) appends at the end
+        if (entries.empty() || std::string_view(entries.back().first) < key) {
+            return entries.emplace_back(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple()).second;
+        }
+        auto it = std::lower_bound(entries.begin(), entries.end(), key,
+            [](const Entry& e, std::string_view k) { return std::string_view(e.first) < k; });
+        if (it != entries.end() && std::string_view(it->first) == key) return it->second;
+        return entries.emplace(it, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple())->second;
+    }
+
+    inline BDict::const_iterator BDict::find(std::string_view key) const {
+        auto it = std::lower_bound(begin(), end(), key,
+            [](const Entry& e, std::string_view k) { return std::string_view(e.first) < k; });
+        if (it != end() && std::string_view(it->first) == key) return it;
+        return end();
+    }
+
+    inline const Bnode& BDict::at(std::string_view key) const {
+        auto it = find(key);
+        if (it == end()) throw std::out_of_range("BDict::at: missing key " + std::string(key));
+        return it->second;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Bnode.h"
+#include <string_view>
+#include <vector>
+
+namespace BitTorrent {
+
+    // SAX-style events. Override only what you care about.
+    class BnodeHandler {
+    public:
+        virtual ~BnodeHandler() = default;
+        virtual void OnInt(int64_t) {}
+        virtual void OnString(std::string_view) {}
+        virtual void OnKey(std::string_view) {}         // A dict key (the next event is its value)
+        virtual void OnListBegin() {}
+        virtual void OnDictBegin() {}
+        virtual void OnEnd() {}                         // Closes the innermost list/dict
+    };
+
+    // Resumable, push-style bencode parser for data that arrives in pieces (sockets).
+    // Feed() it whatever recv() returned; events fire as soon as each value is complete.
+    // Bytes are looked at exactly once. A string that is split across two Feed() calls is
+    // the only thing ever copied; everything else is handed out as a view into the chunk.
+    class BnodeParser {
+    public:
+        explicit BnodeParser(BnodeHandler& handler) : handler(handler) {}
+
+        // Throws std::runtime_error on malformed input (same messages as Bnode::Decode)
+        void Feed(const uint8_t* data, size_t size);
+        void Feed(const Buffer& data) { Feed(data.data(), data.size()); }
+
+        // True once one complete top-level value has been parsed
+        bool Done() const { return done; }
+
+    private:
+        enum State { VALUE, INT, STR_LEN, STR_BODY };
+        struct Frame {
+            bool is_dict;
+            bool expecting_key; // Dicts alternate key -> value -> key ...
+        };
+
+        BnodeHandler& handler;
+        std::vector<Frame> stack;
+        State state = VALUE;
+        bool done = false;
+
+        // Partial token state
+        uint64_t number = 0;
+        bool negative = false;
+        int digits = 0;
+        size_t remaining = 0;  // String bytes still to come
+        Buffer pending;        // Only used when a string straddles two chunks
+
+        void EmitString(std::string_view s);
+        void ValueDone();
+    };
+
+    // Handler that assembles the events back into an owning Bnode tree.
+    // Containers come from 'mr' (e.g. a monotonic arena for short-lived tracker replies).
+    class BnodeBuilder : public BnodeHandler {
+    public:
+        explicit BnodeBuilder(std::pmr::memory_resource* mr = std::pmr::get_default_resource()) : mr(mr) {}
+
+        void OnInt(int64_t value) override { Attach(Bnode(value)); }
+        void OnString(std::string_view value) override;
+        void OnKey(std::string_view key) override { keys.emplace_back(key); }
+        void OnListBegin() override { open.push_back(Bnode(BList(mr))); }
+        void OnDictBegin() override { open.push_back(Bnode(BDict(mr))); }
+        void OnEnd() override;
+
+        // The finished tree (valid once the parser reports Done())
+        Bnode& Result() { return root; }
+
+    private:
+        std::pmr::memory_resource* mr;
+        Bnode root;
+        std::vector<Bnode> open;       // Containers still being filled
+        std::vector<std::string> keys; // Pending key for each open dict
+
+        void Attach(Bnode node);
+    };
+}
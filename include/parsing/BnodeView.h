@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Buffer.h"
+#include <string_view>
+#include <stdexcept>
+
+namespace BitTorrent {
+
+    // A read-only view over one bencoded element that lives in someone else's buffer.
+    // Unlike Bnode, nothing is copied: strings and dict keys are string_views into the
+    // input, and integers are parsed in place. The input MUST outlive every view into it.
+    class BnodeView {
+    public:
+        enum Type { INT, STRING, LIST, DICT };
+
+        BnodeView() = default;
+
+        // Validates the whole input once and returns a view of the root element
+        static BnodeView Decode(const Buffer& data);
+        static BnodeView Decode(const uint8_t* data, size_t size);
+
+        // An empty view is what Find() returns for a missing key
+        explicit operator bool() const { return ptr != nullptr; }
+
+        Type GetType() const;
+        bool IsInt() const { return ptr && *ptr == 'i'; }
+        bool IsString() const { return ptr && *ptr >= '0' && *ptr <= '9'; }
+        bool IsList() const { return ptr && *ptr == 'l'; }
+        bool IsDict() const { return ptr && *ptr == 'd'; }
+
+        // Getters (Safe Access, same errors as Bnode)
+        int64_t GetInt() const;
+        std::string_view GetString() const;
+        std::string ToString() const { return std::string(GetString()); }
+
+        // The raw encoded bytes of this element, e.g. for hashing the 'info' dict
+        const uint8_t* Data() const { return ptr; }
+        size_t Size() const { return len; }
+
+        // Lists: walks the elements (no allocation)
+        size_t Count() const;
+        BnodeView operator[](size_t index) const;
+
+        // Dicts: lazy lookup. Sibling values are skipped, never materialized.
+        BnodeView Find(std::string_view key) const;
+        BnodeView At(std::string_view key) const;
+        bool Has(std::string_view key) const { return (bool)Find(key); }
+
+        // Visit every element of a list: f(BnodeView)
+        template <typename F>
+        void ForEach(F f) const {
+            if (!IsList()) throw std::runtime_error("Type mismatch: Expected List");
+            const uint8_t* p = ptr + 1;
+            const uint8_t* end = ptr + len - 1; // points at the closing 'e'
+            while (p < end) {
+                const uint8_t* next = Skip(p, end, 0);
+                f(BnodeView(p, next - p));
+                p = next;
+            }
+        }
+
+        // Visit every pair of a dict: f(std::string_view key, BnodeView value)
+        template <typename F>
+        void ForEachPair(F f) const {
+            if (!IsDict()) throw std::runtime_error("Type mismatch: Expected Dict");
+            const uint8_t* p = ptr + 1;
+            const uint8_t* end = ptr + len - 1;
+            while (p < end) {
+                const uint8_t* valStart = Skip(p, end, 0);
+                std::string_view key = BnodeView(p, valStart - p).GetString();
+                const uint8_t* next = Skip(valStart, end, 0);
+                f(key, BnodeView(valStart, next - valStart));
+                p = next;
+            }
+        }
+
+    private:
+        const uint8_t* ptr = nullptr;
+        size_t len = 0;
+
+        BnodeView(const uint8_t* p, size_t n) : ptr(p), len(n) {}
+
+        // Returns the first byte after the element starting at p. Throws if malformed.
+        static const uint8_t* Skip(const uint8_t* p, const uint8_t* end, int depth);
+        static int64_t ParseInt(const uint8_t* p, const uint8_t* end);
+    };
+}
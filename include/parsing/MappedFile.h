@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace BitTorrent {
+
+    // A read-only, memory-mapped view of a whole file.
+    // The pages are faulted in by the kernel on demand, so "loading" a big file
+    // costs no copy and no heap memory. Unmapped automatically on destruction.
+    class MappedFile {
+        const uint8_t* ptr = nullptr;
+        size_t len = 0;
+
+    public:
+        MappedFile() = default;
+        explicit MappedFile(const std::string& path); // Throws if the file cannot be opened
+        ~MappedFile();
+
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const uint8_t* data() const { return ptr; }
+        size_t size() const { return len; }
+    };
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "parsing/TorrentFile.h"
+#include <vector>
+
+namespace BitTorrent {
+
+    // BitTorrent v2 (BEP 52) hash trees: SHA-256 over 16 KiB blocks, each file its own tree.
+    // Leaves past the end of the data are all-zero digests, so a tree is always a full binary
+    // tree over a power-of-two number of leaves.
+    class MerkleTree {
+    public:
+        static constexpr size_t BLOCK_SIZE = 16384;
+
+        static Sha256Digest HashBlock(const uint8_t* data, size_t size);
+        static Sha256Digest HashPair(const Sha256Digest& left, const Sha256Digest& right);
+        static size_t NextPow2(size_t n);
+
+        // Root of a subtree of 'width' leaves (power of two, >= leaves.size()); the missing
+        // leaves are zero digests
+        static Sha256Digest Root(std::vector<Sha256Digest> leaves, size_t width);
+        // Root of a subtree of 'width' leaves that are all padding
+        static Sha256Digest PadRoot(size_t width);
+
+        // Leaf digests of a run of bytes (the last block may be short)
+        static std::vector<Sha256Digest> BlockHashes(const uint8_t* data, size_t size);
+        // Tree of a whole file: its root ('pieces root') and, for files longer than one piece,
+        // the piece layer that goes into 'piece layers'
+        static Sha256Digest FileRoot(const uint8_t* data, size_t size, int64_t piece_length,
+                                     std::vector<Sha256Digest>* piece_layer = nullptr);
+
+        // --- Per piece, against a parsed torrent ---
+        // What the block leaves of 'piece' must hash up to: the piece layer entry, or for a file
+        // that fits in one piece the file's pieces root. 'width' receives the leaf count of that
+        // subtree. False for pieces with nothing to check (padding only).
+        static bool PieceTarget(const TorrentFile& tf, size_t piece, Sha256Digest& root, size_t& width);
+        // First file byte covered by 'piece' and how many bytes of the piece belong to that file
+        static bool PieceFileRange(const TorrentFile& tf, size_t piece, const FileEntry*& file, int64_t& begin, int64_t& size);
+        // Checks a whole piece (as laid out in the global stream) against the v2 tree.
+        // In a hybrid torrent any bytes of the piece that fall in padding must be zero.
+        static bool VerifyPiece(const TorrentFile& tf, size_t piece, const uint8_t* data, size_t size);
+    };
+}
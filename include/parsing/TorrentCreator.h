@@ -0,0 +1,39 @@
+#pragma once
+#include "parsing/TorrentFile.h"
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace BitTorrent {
+
+    struct CreateOptions {
+        std::string announce;
+        std::string comment;
+        std::string created_by = "CPP-CLIENT";
+        int64_t piece_length = 0; // 0 = pick from the payload size (see AutoPieceLength)
+        size_t threads = 0;       // Hashing threads, 0 = one per core
+        bool is_private = false;
+        // Called from the hashing threads (serialised) as pieces complete
+        std::function<void(int64_t hashed, int64_t total)> progress;
+    };
+
+    // Builds .torrent metainfo from a file or a directory tree.
+    // One reader thread streams the payload front to back with large sequential reads into a
+    // small pool of chunk buffers; hasher threads take whole chunks, hash their pieces
+    // (8 at a time via Sha1::DigestMany) and store each digest at its piece index, so the
+    // piece table comes out in order whichever thread finishes first.
+    class TorrentCreator {
+    public:
+        // Power of two between 16 KiB and 16 MiB giving roughly 1000-2000 pieces
+        static int64_t AutoPieceLength(int64_t total_size);
+
+        // Returns the bencoded .torrent. Files of a directory are sorted by path.
+        static Buffer Create(const std::string& path, const CreateOptions& options);
+        static void CreateFile(const std::string& path, const std::string& output, const CreateOptions& options);
+
+        // Just the hashing stage: the payload is the files in order, concatenated
+        static std::vector<PieceDigest> HashFiles(const std::vector<std::string>& paths, int64_t piece_length,
+                                                  size_t threads = 0,
+                                                  const std::function<void(int64_t, int64_t)>& progress = nullptr);
+    };
+}
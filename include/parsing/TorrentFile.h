@@ -3,19 +3,78 @@
 #include "Bnode.h"
 #include <string>
 #include <vector>
+#include <array>
 
 namespace BitTorrent {
 
+    class BnodeView;
+
+    // A raw 20-byte SHA-1 digest
+    using PieceDigest = std::array<uint8_t, 20>;
+    // A raw 32-byte SHA-256 digest (BitTorrent v2 Merkle nodes)
+    using Sha256Digest = std::array<uint8_t, 32>;
+
+    // One file of the payload, placed at 'offset' in the torrent's global byte stream
+    struct FileEntry {
+        std::string path;  // Relative path on disk, e.g. "Sintel/Sintel.mp4"
+        int64_t length;
+        int64_t offset;
+        bool pad = false;  // Hybrid torrents: zero filler aligning the next file to a piece, never on disk
+
+        // v2 only (BEP 52): root of the file's 16 KiB-leaf Merkle tree, and the tree's layer at
+        // piece granularity (from 'piece layers'; empty when the file fits in one piece)
+        Sha256Digest pieces_root{};
+        std::vector<Sha256Digest> piece_layer{};
+    };
+
     struct TorrentFile {
         std::string announce;
+        // BEP 12 tiers of tracker URLs, tried tier by tier. Empty when the torrent only has 'announce'.
+        std::vector<std::vector<std::string>> announce_list;
         std::string name;
-        int64_t length;
+        int64_t length;   // Total payload size (sum of all files)
+        std::vector<FileEntry> files; // Single-file torrents have exactly one entry
         int64_t piece_length;
-        std::vector<std::string> piece_hashes;
-        Buffer info_hash; // The Unique ID (20 bytes)
+        // One contiguous N x 20 byte table (a single allocation, however many pieces)
+        std::vector<PieceDigest> piece_hashes;
+        Buffer info_hash; // The Unique ID (20 bytes). Pure v2: the SHA-256 info hash truncated to 20.
 
-        // The only function you need: Load from disk
+        // BEP 52. 1 = v1 only; 2 = v2 or hybrid (a hybrid also has v1 'pieces')
+        int meta_version = 1;
+        Buffer info_hash_v2; // SHA-256 of the info dict (32 bytes), v2 and hybrid only
+
+        // Byte range of the bencoded 'info' value inside the .torrent file.
+        // info_hash is SHA-1 over exactly these bytes, whatever their key order or integer formatting.
+        size_t info_offset = 0;
+        size_t info_size = 0;
+
+        // Every tracker, as tiers: 'announce-list', or 'announce' alone as a single tier
+        std::vector<std::vector<std::string>> TrackerTiers() const;
+
+        bool HasV1() const { return !piece_hashes.empty() || meta_version == 1; }
+        bool HasV2() const { return meta_version >= 2; }
+
+        size_t PieceCount() const {
+            if (!piece_hashes.empty() || piece_length <= 0) return piece_hashes.size();
+            return HasV2() ? (size_t)((length + piece_length - 1) / piece_length) : 0;
+        }
+        // Raw expected digest of a piece (20 bytes, compare with memcmp). v1 and hybrid only.
+        const uint8_t* PieceHash(size_t index) const { return piece_hashes[index].data(); }
+        // Every piece is piece_length long except the last one, and (pure v2, where every file
+        // starts on a piece boundary) the last piece of each file
+        int64_t PieceSize(size_t index) const;
+
+        // The (non-pad) file holding global byte 'offset', or nullptr for padding / out of range
+        const FileEntry* FileAt(int64_t offset) const;
+
+        // The only function you need: Load from disk (memory-mapped, nothing is copied up front)
         static TorrentFile Load(const std::string& filepath);
+        // Parse metainfo that is already in memory
+        static TorrentFile Parse(const uint8_t* data, size_t size);
+
+    private:
+        static void ParseV1(BnodeView info, TorrentFile& t);
+        static void ParseV2(BnodeView root, BnodeView info, TorrentFile& t, bool has_v1);
     };
 
 }
\ No newline at end of file
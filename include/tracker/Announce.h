@@ -0,0 +1,201 @@
+#pragma once
+#include "parsing/Buffer.h"
+#include "tracker/Url.h"
+#include "tracker/Peer.h"
+#include "download/Farm.h"
+#include "download/EventHandler.h"
+#include "tracker/Resolver.h"
+#include "tracker/Dialer.h"
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace BitTorrent {
+
+    class PeerStore;
+
+    // Values are the BEP 15 codes; HTTP sends the names
+    enum class AnnounceEvent { NONE = 0, COMPLETED = 1, STARTED = 2, STOPPED = 3 };
+
+    // What we tell the tracker about ourselves and the torrent
+    struct AnnounceParams {
+        Buffer info_hash;     // 20 bytes
+        std::string peer_id;  // 20 bytes
+        int port = 6881;
+        int64_t uploaded = 0;
+        int64_t downloaded = 0;
+        int64_t left = 0;
+        AnnounceEvent event = AnnounceEvent::NONE;
+        int num_want = 200;     // Peers asked for; UDP receive buffers are sized to fit them
+        int timeout_ms = 0;     // Cap on the whole announce, connect included; 0: Announce::TimeoutMs()
+        int udp_retry_ms = 15000; // BEP 15: resend after 15 * 2^n seconds without a reply
+        std::vector<Buffer> scrape; // Set by Announce::Scrape(): these hashes are scraped instead
+        PeerStore* store = nullptr; // Set: compact peers are parsed straight into it, not into 'peers'
+    };
+
+    // A swarm as one tracker sees it; -1 where it didn't say
+    struct SwarmStats {
+        int seeders = -1;     // 'complete'
+        int leechers = -1;    // 'incomplete'
+        int downloaded = -1;  // Completed downloads so far (scrape only)
+
+        bool Known() const { return seeders >= 0 || leechers >= 0; }
+        int Peers() const { return std::max(seeders, 0) + std::max(leechers, 0); }
+    };
+
+    struct AnnounceResult {
+        bool ok = false;
+        std::string error;        // Socket error, timeout, or the tracker's 'failure reason'
+        std::vector<Peer> peers;
+        std::vector<uint32_t> fresh; // With AnnounceParams::store: indices of the peers this reply added
+        int interval = 0;         // Seconds until the tracker wants to hear from us again
+        int min_interval = 0;
+        SwarmStats swarm;         // Announce: the torrent's swarm, if the tracker told us
+        std::vector<SwarmStats> swarms; // Scrape: one per requested hash, same order
+        double latency_ms = 0;    // Start() to the parsed reply
+    };
+
+    // One announce in flight: a non-blocking state machine whose socket lives in the Farm's
+    // epoll set, so any number of them run alongside the peer connections on one thread.
+    // 'done' fires exactly once, on the loop thread; the owner may not destroy the Announce
+    // from inside it (check Done() and drop it afterwards).
+    class Announce : public EventHandler {
+    public:
+        using Callback = std::function<void(AnnounceResult&)>;
+
+        // Starts an announce to 'url' (http:// or udp://). Throws for other schemes.
+        // Failures that happen right away (DNS, socket) are reported through 'done' before this returns.
+        static std::unique_ptr<Announce> Create(Farm& farm, const std::string& url, const AnnounceParams& params, Callback done);
+        // Same, but asks for the swarm sizes of 'info_hashes' (HTTP /scrape, UDP action 2).
+        // One UDP datagram holds MAX_UDP_SCRAPE hashes; the request fails if there are more.
+        static std::unique_ptr<Announce> Scrape(Farm& farm, const std::string& url, const std::vector<Buffer>& info_hashes,
+                                                int timeout_ms, Callback done);
+        static constexpr size_t MAX_UDP_SCRAPE = 74;
+        // The scrape URL of an http:// announce URL ("/announce" -> "/scrape"), "" if it has none
+        static std::string ScrapeUrl(const std::string& announce_url);
+        // How long an announce to 'url' gets before it fails: 'timeout_ms' if set, else
+        // HttpAnnounce::TIMEOUT_MS, or for UDP the whole retry schedule (every retransmit goes out)
+        static int64_t TimeoutMs(const Url& url, const AnnounceParams& params);
+        virtual ~Announce();
+
+        bool Done() const { return finished; }
+        // Gives up without calling 'done' (e.g. another tracker already answered)
+        void Cancel();
+        const Url& GetUrl() const { return url; }
+
+    protected:
+        Announce(Farm& farm, const Url& url, const AnnounceParams& params, Callback done);
+
+        virtual void Begin() = 0;                   // Open the socket and send the first bytes
+        virtual void Closed() {}                    // Finished or cancelled: drop timers and shared state
+        // Resolves the host without blocking, then a non-blocking connect() of 'fd'. 'then' runs
+        // once the socket exists (maybe before this returns); failures go to Fail().
+        void OpenSocket(int type, std::function<void()> then);
+        void Finish(AnnounceResult result);
+        void Fail(const std::string& error);
+
+        Farm& farm;
+        Url url;
+        AnnounceParams params;
+        Callback done;
+        int fd = -1;
+        int family = AF_INET;    // Of 'fd', once it is open
+
+    private:
+        void Close();
+        Farm::TimerId timer = 0;
+        Resolver::RequestId resolving = 0;
+        std::unique_ptr<Dialer> dialer;
+        bool finished = false;
+        Farm::Clock::time_point started;
+    };
+
+    // GET /announce over HTTP/1.1. The reply body is parsed as it streams in. Connections are
+    // kept alive and pooled per host, so re-announces and other torrents on the same tracker
+    // skip the TCP handshake; redirects are followed.
+    class HttpAnnounce : public Announce {
+    public:
+        static constexpr int MAX_REDIRECTS = 5;
+        static constexpr size_t MAX_IDLE_PER_HOST = 4;
+        static constexpr int IDLE_TIMEOUT_S = 120;
+        static constexpr int TIMEOUT_MS = 10000;   // Unless AnnounceParams::timeout_ms says otherwise
+
+        HttpAnnounce(Farm& farm, const Url& url, const AnnounceParams& params, Callback done);
+        ~HttpAnnounce() override;
+        void OnEvent(uint32_t events) override;
+        static std::string UrlEncode(const Buffer& buffer);
+        // Closes every pooled connection (of this thread's loop)
+        static void ClearPool();
+
+    protected:
+        void Begin() override;
+
+    private:
+        enum State { CONNECTING, SENDING, RECEIVING } state = CONNECTING;
+        std::string request;
+        size_t sent = 0;
+        bool reused = false;       // The socket came from the pool
+        size_t received = 0;       // Reply bytes so far on this socket
+        int redirects = 0;
+        bool query_in_path = false; // A redirect gave us the complete announce URL
+        struct Reply;
+        std::unique_ptr<Reply> reply; // Parser state for the response
+
+        void OnReadable();
+        void Complete();
+        void Release(bool keep);   // Hands the socket back to the pool, or closes it
+        void Restart();            // Same request on another connection
+        void Reconnect();
+        void Redirect(const std::string& location);
+    };
+
+    // BEP 15: connect, then announce, two datagrams each way. Unanswered requests are sent
+    // again after udp_retry_ms * 2^n; after MAX_RETRANSMITS of those (about two hours at the
+    // default 15 s) the tracker is given up on. The connection ID is kept per tracker for a minute, so
+    // later announces (any torrent) skip the connect; announces that start while a connect to
+    // their tracker is in flight wait for it and then all go out together.
+    class UdpAnnounce : public Announce {
+    public:
+        static constexpr int CONNECTION_ID_TTL_S = 60;
+        static constexpr int MAX_RETRANSMITS = 8;
+
+        UdpAnnounce(Farm& farm, const Url& url, const AnnounceParams& params, Callback done)
+            : Announce(farm, url, params, std::move(done)) {}
+        ~UdpAnnounce() override;
+        void OnEvent(uint32_t events) override;
+
+        // Forgets every cached connection ID (of this thread's loop)
+        static void ClearConnectionCache();
+        // First send to giving up when nothing ever comes back: udp_retry_ms * (2^0 + ... + 2^MAX_RETRANSMITS)
+        static int64_t RetryScheduleMs(int udp_retry_ms) { return (int64_t)udp_retry_ms * ((2 << MAX_RETRANSMITS) - 1); }
+
+    protected:
+        void Begin() override;
+        void Closed() override;
+
+    private:
+        struct Endpoint;
+        enum State { WAITING, CONNECTING, ANNOUNCING } state = WAITING;
+        uint32_t transaction_id = 0;
+        Buffer request;                  // Last datagram sent, for retransmission
+        Buffer recv_buf;
+        int retransmits = 0;
+        Farm::TimerId retry = 0;
+        bool cached_id = false;          // Announcing with a connection ID from the cache
+        Farm::Clock::time_point id_expires; // Of the connection ID in 'request'
+        bool reconnected = false;
+
+        static std::unordered_map<std::string, Endpoint>& Endpoints();
+        Endpoint& GetEndpoint() const;
+        void OnDatagram(const Buffer& b);
+        void SendConnect();
+        void SendRequest(uint64_t connection_id); // Announce or scrape, whichever we are
+        void SendAnnounce(uint64_t connection_id);
+        void SendScrape(uint64_t connection_id);
+        void Transmit();
+        void Reconnect();
+    };
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include "tracker/Announce.h"
+#include "tracker/PeerStore.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace BitTorrent {
+
+    // How a tracker has done this session. Shared by every Announcer, so a tracker that was slow
+    // or dead for one torrent (or one round) is tried last the next time.
+    struct TrackerStats {
+        int attempts = 0;
+        int successes = 0;
+        double avg_latency_ms = 0; // Of successful announces
+
+        // Expected wait for an answer: latency over success rate. Unknown trackers are assumed
+        // to be average-ish (1 s, one in two), so they rank between good and bad ones.
+        double ExpectedMs() const {
+            double rate = (successes + 1.0) / (attempts + 2.0);
+            double latency = successes ? avg_latency_ms : 1000.0;
+            return latency / rate;
+        }
+        void Record(const AnnounceResult& r);
+    };
+
+    // Announces one torrent to all of its trackers (BEP 12 tiers) for as long as it runs.
+    // Tiers run side by side. Inside a tier the trackers are raced happy-eyeballs style: the
+    // best-ranked one starts, and each 'stagger_ms' without an answer (or right after a failure)
+    // the next one joins. The first reply settles the round and the stragglers are cancelled.
+    // Each tier then announces again when its tracker's 'interval' is up; a tier where every
+    // tracker failed retries with exponential backoff. A tracker known to see an empty swarm
+    // (from its last reply, or a scrape) goes behind the others of its tier.
+    class Announcer {
+    public:
+        // Called with the peers not seen before, as each reply arrives
+        using PeersCallback = std::function<void(const std::vector<Peer>& fresh)>;
+        // Same, for an Announcer filling the caller's PeerStore: how many it just added
+        using FreshCallback = std::function<void(size_t fresh)>;
+        // Fills in uploaded / downloaded / left right before each announce goes out
+        using ProgressFn = std::function<void(AnnounceParams&)>;
+        // Puts a tier's trackers in order at the start of each round (e.g. Scraper::RankTrackers)
+        using RankFn = std::function<std::vector<std::string>(std::vector<std::string> urls)>;
+
+        static constexpr int DEFAULT_INTERVAL_S = 1800;  // When the tracker doesn't say
+        static constexpr int DEFAULT_MIN_INTERVAL_S = 60; // Earliest early round without a 'min interval'
+        static constexpr int RETRY_BASE_S = 15;          // After a failed round: 15, 30, 60 s ... up to the interval
+        static constexpr int STOP_TIMEOUT_MS = 2000;     // 'completed' and 'stopped' are courtesies, don't hang on exit
+        // The first round is waited on (a download can't start without peers), so it doesn't get
+        // the full UDP retry schedule: a silent UDP tracker has its sends at 0, 15 and 45 s
+        static constexpr int START_TIMEOUT_MS = 60000;
+        int stagger_ms = 250;
+
+        Announcer(Farm& farm, std::vector<std::vector<std::string>> tiers, const AnnounceParams& params, PeersCallback on_peers);
+        // Tracker replies are parsed straight into 'store', which must outlive the Announcer
+        Announcer(Farm& farm, std::vector<std::vector<std::string>> tiers, const AnnounceParams& params, PeerStore& store,
+                  FreshCallback on_fresh);
+        ~Announcer();
+
+        void SetProgress(ProgressFn fn) { progress = std::move(fn); }
+        // Applied before the ranking by past results, which only reorders trackers it can tell apart
+        void SetRanking(RankFn fn) { ranking = std::move(fn); }
+
+        // First round ('started', capped at START_TIMEOUT_MS), then one per tier interval. Only
+        // those later rounds, which nothing waits on, give each tracker Announce::TimeoutMs().
+        void Start();
+        void Send(AnnounceEvent event); // A round for every tier right now ('completed' is capped like 'stopped')
+        void AnnounceSoon();            // Early round where 'min interval' allows (we're short of peers)
+        void Stop();                    // Ends the schedule; tells the trackers that answered we're leaving
+
+        bool Done() const;              // Nothing in flight and no race still to be joined
+        std::vector<Peer> Peers() const; // Everything in the store so far, de-duplicated
+
+        void SetSwarm(const std::string& url, const SwarmStats& swarm) { swarms[url] = swarm; } // e.g. from a Scraper
+        SwarmStats BestSwarm() const;   // The biggest swarm any of our trackers reported
+
+        static TrackerStats& Stats(const std::string& url);
+
+    private:
+        struct Attempt {
+            std::string url;
+            std::unique_ptr<Announce> announce;
+        };
+        struct Tier {
+            std::vector<std::string> urls;               // Best first
+            size_t next = 0;                             // First URL not started yet this round
+            std::vector<Attempt> running;
+            Farm::TimerId stagger = 0;
+            Farm::TimerId reannounce = 0;
+            bool settled = false;                        // This round is over (answered, or all failed)
+            AnnounceEvent event = AnnounceEvent::NONE;   // Sent with every attempt of this round
+            int timeout_ms = 0;                          // Cap on this round's attempts (0: none)
+            std::string working;                         // Tracker that answered last
+            int interval = DEFAULT_INTERVAL_S;
+            int min_interval = DEFAULT_MIN_INTERVAL_S;
+            int failed_rounds = 0;
+            Farm::Clock::time_point last_round;
+        };
+
+        Farm& farm;
+        std::vector<Tier> tiers;
+        AnnounceParams params;
+        PeersCallback on_peers;
+        FreshCallback on_fresh;
+        ProgressFn progress;
+        RankFn ranking;
+        PeerStore own_store;                             // Unless the caller brought one
+        PeerStore* store;
+        std::unordered_map<std::string, SwarmStats> swarms; // Tracker -> this torrent's swarm as it last said
+        bool stopped = false;
+
+        AnnounceParams CurrentParams(AnnounceEvent event) const;
+        void Round(Tier& tier, AnnounceEvent event, int timeout_ms = 0);
+        void Launch(Tier& tier);
+        void OnResult(Tier& tier, const std::string& url, AnnounceResult& r);
+        void CheckExhausted(Tier& tier);
+        void Abandon(Tier& tier);
+        void Schedule(Tier& tier, int seconds);
+    };
+}
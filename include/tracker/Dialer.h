@@ -0,0 +1,50 @@
+#pragma once
+#include "download/EventHandler.h"
+#include "download/Farm.h"
+#include <sys/socket.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace BitTorrent {
+
+    // Happy Eyeballs (RFC 8305) for one destination with several addresses: non-blocking TCP
+    // connects, IPv6 and IPv4 taking turns, the next attempt starting every STAGGER_MS (or as soon
+    // as one fails) while the earlier ones keep going. The first socket to connect wins and the
+    // others are closed. 'done' runs once, on the loop thread, with the connected fd (now the
+    // caller's) or -1 and the last error; the Dialer may be destroyed from inside it.
+    class Dialer {
+    public:
+        using Callback = std::function<void(int fd, const std::string& error)>;
+        static constexpr int STAGGER_MS = 250;
+
+        // 'addresses' include the port
+        Dialer(Farm& farm, std::vector<sockaddr_storage> addresses, Callback done);
+        ~Dialer(); // Abandons attempts still going
+        void Start();
+
+        // Reorders addresses so the families alternate, starting with the first one's
+        static std::vector<sockaddr_storage> Interleave(const std::vector<sockaddr_storage>& addresses);
+
+    private:
+        struct Attempt : EventHandler {
+            Dialer* owner;
+            int fd;
+            void OnEvent(uint32_t) override { owner->OnWritable(this); } // Done or failed, SO_ERROR says which
+        };
+
+        Farm& farm;
+        std::vector<sockaddr_storage> addresses;
+        size_t next = 0;
+        std::vector<std::unique_ptr<Attempt>> attempts;
+        Farm::TimerId stagger = 0;
+        std::string last_error;
+        Callback done;
+
+        void StartNext();
+        void OnWritable(Attempt* a);
+        void Drop(Attempt* a);
+        void Finish(int fd, const std::string& error);
+    };
+}
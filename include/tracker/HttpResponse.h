@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace BitTorrent {
+
+    // Incremental HTTP/1.1 response reader. Takes the bytes in whatever pieces the socket hands
+    // them over: status line and headers first, then the body framed by Content-Length, chunked
+    // transfer coding, or the end of the connection. Decoded body bytes go straight to 'on_body';
+    // only the header block is ever buffered. Malformed input throws std::runtime_error.
+    class HttpResponse {
+    public:
+        using BodyFn = std::function<void(const uint8_t* data, size_t size)>;
+        static constexpr size_t MAX_HEADER_BYTES = 64 * 1024;
+
+        explicit HttpResponse(BodyFn on_body);
+
+        // Consumes what belongs to this response and returns how many bytes that was
+        // (less than 'size' only once Done())
+        size_t Feed(const uint8_t* data, size_t size);
+        // The peer closed the connection. Ends a body that runs until then; anything else
+        // still unfinished stays !Done() (truncated).
+        void FeedEof();
+
+        bool HeadersDone() const { return state > HEADERS; }
+        bool Done() const { return state == DONE; }
+        int Status() const { return status; }
+        bool IsRedirect() const { return status == 301 || status == 302 || status == 303 || status == 307 || status == 308; }
+        // Value of the first header called 'name' (any case), "" if there is none
+        std::string Header(const std::string& name) const;
+        // The connection can carry another request after this response
+        bool KeepAlive() const;
+
+    private:
+        enum State { HEADERS, BODY_LENGTH, BODY_UNTIL_CLOSE, CHUNK_SIZE, CHUNK_DATA, CHUNK_END, TRAILERS, DONE };
+
+        BodyFn on_body;
+        State state = HEADERS;
+        std::string line;            // Header block, or the current chunk-size / trailer line
+        int status = 0;
+        bool http10 = false;
+        std::vector<std::pair<std::string, std::string>> headers; // Names lower-cased
+        uint64_t remaining = 0;      // Of the body (BODY_LENGTH) or the current chunk
+
+        void ParseHeaders();
+        bool TakeLine(const uint8_t*& p, const uint8_t* end); // Appends to 'line' up to CRLF
+    };
+}
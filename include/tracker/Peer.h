@@ -1,19 +1,28 @@
 #pragma once
 #include <string>
 #include <cstdint>
+#include <sys/socket.h>
 
 namespace BitTorrent {
 
+    // A peer's address in binary form (IPv4 or IPv6, port included), ready for connect()
     struct Peer {
-        std::string ip;
-        uint16_t port;
+        sockaddr_storage addr{};
         std::string id; // The peer's unique ID (optional, but good for debugging)
 
-        // Constructor
-        Peer(std::string i, uint16_t p, std::string pid = "") 
-            : ip(i), port(p), id(pid) {}
-            
+        // From text: "1.2.3.4" or "::1". Throws std::runtime_error for anything else.
+        Peer(const std::string& ip, uint16_t port, std::string pid = "");
+        // From compact tracker form: 4 or 16 address bytes, port in host order
+        static Peer FromV4(const uint8_t* ip, uint16_t port);
+        static Peer FromV6(const uint8_t* ip, uint16_t port);
+
         // Default Constructor
-        Peer() : port(0) {}
+        Peer() = default;
+
+        int Family() const { return addr.ss_family; }
+        uint16_t Port() const;
+        socklen_t Length() const;  // Of 'addr', for connect()
+        std::string Ip() const;    // "1.2.3.4" / "::1"
+        std::string ToString() const; // "1.2.3.4:6881" / "[::1]:6881"; unique per address
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "tracker/Peer.h"
+#include <chrono>
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+namespace BitTorrent {
+
+    // Where we first heard of a peer
+    enum class PeerSource : uint8_t { GIVEN, TRACKER };
+
+    // A peer address in 18 bytes: the IPv6 address (IPv4 ones mapped, ::ffff:a.b.c.d) and the port
+    struct PeerKey {
+        uint8_t ip[16] = {};
+        uint16_t port = 0; // Host order
+
+        static PeerKey FromV4(const uint8_t* ip, uint16_t port);
+        static PeerKey FromV6(const uint8_t* ip, uint16_t port);
+        static PeerKey From(const Peer& p);
+
+        bool IsV4() const;
+        int Family() const { return IsV4() ? AF_INET : AF_INET6; }
+        Peer ToPeer() const;
+        bool operator==(const PeerKey& o) const;
+    };
+
+    struct PeerInfo {
+        enum State : uint8_t { READY, DIALLED, WAITING, RETIRED };
+
+        PeerKey key;
+        PeerSource source = PeerSource::TRACKER;
+        State state = READY;
+        uint8_t failures = 0;          // In a row; reset by a useful connection
+        int32_t score = 0;             // Higher is dialled first
+        std::chrono::steady_clock::time_point last_failure;
+        std::chrono::steady_clock::time_point retry_at; // WAITING until then
+    };
+
+    // Every peer a torrent has heard of, without duplicates, and which one to dial next.
+    // Peers live in one flat array and are found through an open-addressing table of indices
+    // (linear probing, kept at most half full), so hundreds of thousands of them cost a few
+    // dozen bytes each and no strings. Compact tracker replies are parsed straight in.
+    // Dialling order: highest score first, newest first among equals, alternating IPv4 and IPv6
+    // on request. A peer that fails waits out an exponential backoff; after MAX_FAILURES in a row
+    // it is never dialled again (but still remembered, so trackers can't hand it back).
+    class PeerStore {
+    public:
+        using Clock = std::chrono::steady_clock;
+        static constexpr int BACKOFF_BASE_S = 30;   // 30 s, 60 s, 120 s ... after each failure
+        static constexpr int MAX_BACKOFF_S = 1800;
+        static constexpr int MAX_FAILURES = 5;
+        static constexpr int REDIAL_S = 60;         // After a connection that gave us data ends
+
+        PeerStore();
+
+        // Index of the peer, new or not; 'added' says which
+        uint32_t Add(const PeerKey& key, PeerSource source, bool* added = nullptr);
+        uint32_t Add(const Peer& p, PeerSource source, bool* added = nullptr) { return Add(PeerKey::From(p), source, added); }
+        // Compact tracker forms: 6 bytes per IPv4 peer, 18 per IPv6 one (a trailing partial entry
+        // is ignored). Returns how many were new, and appends their indices to 'fresh'.
+        size_t AddCompact(const uint8_t* data, size_t size, PeerSource source, std::vector<uint32_t>* fresh = nullptr);
+        size_t AddCompact6(const uint8_t* data, size_t size, PeerSource source, std::vector<uint32_t>* fresh = nullptr);
+
+        int64_t Find(const PeerKey& key) const; // -1 if unknown
+        size_t Size() const { return peers.size(); }
+        const PeerInfo& operator[](uint32_t index) const { return peers[index]; }
+
+        // The peer to dial now, preferring 'family' (0: any). It is DIALLED until Closed() or
+        // Failed(). False if nobody may be dialled right now.
+        bool Next(uint32_t& index, int family = 0, Clock::time_point now = Clock::now());
+        bool HasCandidates(Clock::time_point now = Clock::now());
+
+        // Outcome of a dial: 'useful' if the peer sent us data (it may be dialled again later
+        // and ranks higher), else it counts as a failure
+        void Closed(uint32_t index, bool useful, Clock::time_point now = Clock::now());
+        void Failed(uint32_t index, Clock::time_point now = Clock::now());
+        // A dial we called off ourselves (e.g. enough peers answered first): back in line as it was
+        void Requeue(uint32_t index);
+
+    private:
+        struct Candidate {
+            int32_t score;
+            uint32_t index;
+            bool operator<(const Candidate& o) const { return score != o.score ? score < o.score : index < o.index; }
+        };
+        using Due = std::pair<Clock::time_point, uint32_t>;
+
+        std::vector<PeerInfo> peers;
+        std::vector<uint32_t> slots;             // Index + 1 into 'peers', 0 = empty; power-of-two size
+        std::priority_queue<Candidate> ready[2]; // READY peers: [0] IPv4, [1] IPv6
+        std::priority_queue<Due, std::vector<Due>, std::greater<Due>> waiting; // WAITING peers by retry time
+
+        static uint64_t Hash(const PeerKey& key);
+        void Grow();
+        void MakeReady(uint32_t index);
+        void Promote(Clock::time_point now);     // WAITING peers whose time has come become READY
+    };
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "download/EventHandler.h"
+#include <sys/socket.h>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace BitTorrent {
+
+    class Farm;
+
+    struct ResolveResult {
+        bool ok = false;
+        std::string error;
+        std::vector<sockaddr_storage> addresses; // Port 0; see Resolver::WithPort()
+    };
+
+    // Host name lookups that never block the loop. getaddrinfo runs on a small thread pool shared
+    // by the whole process; answers come back to each Farm through an eventfd in its epoll set,
+    // so callbacks run on the loop thread. Results are cached process-wide (getaddrinfo doesn't
+    // report DNS TTLs, so entries live CACHE_TTL_S, failures NEGATIVE_TTL_S), and lookups of a
+    // host that is already being resolved wait for that one instead of starting another.
+    class Resolver : public EventHandler {
+    public:
+        using Callback = std::function<void(const ResolveResult&)>;
+        using LookupFn = std::function<ResolveResult(const std::string& host)>;
+        using RequestId = uint64_t;
+
+        static constexpr int CACHE_TTL_S = 300;
+        static constexpr int NEGATIVE_TTL_S = 30;
+        static constexpr size_t THREADS = 2;
+
+        explicit Resolver(Farm& farm);
+        ~Resolver() override;
+
+        // 'done' runs on the loop thread, exactly once unless cancelled. Literal addresses and
+        // cache hits are answered before Resolve() returns.
+        RequestId Resolve(const std::string& host, Callback done);
+        void Cancel(RequestId id);
+        void OnEvent(uint32_t events) override;
+
+        // Blocking lookup through the same cache, for code that isn't on a loop
+        static ResolveResult ResolveNow(const std::string& host);
+        // Copy of 'addr' with 'port' filled in; returns its length for connect()
+        static socklen_t WithPort(const sockaddr_storage& addr, int port, sockaddr_storage& out);
+
+        // Test hooks: what the pool threads run instead of getaddrinfo, and a cache reset
+        static void SetLookup(LookupFn fn);
+        static void ClearCache();
+        static size_t Lookups(); // Lookups that actually ran, for tests and stats
+
+    private:
+        struct Pending {
+            std::string host;
+            Callback done;
+        };
+
+        Farm& farm;
+        int efd;
+        bool watching = false;
+        RequestId next_id = 1;
+        std::unordered_map<RequestId, Pending> pending;
+        std::set<std::string> asked;          // Hosts we are registered with the pool for
+
+        // Filled by the pool threads, drained on the loop
+        std::mutex mutex;
+        std::deque<std::pair<std::string, ResolveResult>> answers;
+
+        friend struct ResolverPool;
+        void Post(const std::string& host, const ResolveResult& result); // Any thread
+        void Deliver(const std::string& host, const ResolveResult& result);
+    };
+}
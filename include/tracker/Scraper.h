@@ -0,0 +1,53 @@
+#pragma once
+#include "tracker/Announce.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace BitTorrent {
+
+    // Asks trackers how big the swarms of many torrents are without announcing any of them.
+    // The hashes of every torrent that shares a tracker go out together: up to MAX_UDP_SCRAPE
+    // per UDP datagram, MAX_HTTP_SCRAPE per HTTP GET. The answers then decide which of a
+    // torrent's trackers is tried first, and how many peers to ask for.
+    class Scraper {
+    public:
+        // Called on the loop thread for each swarm a tracker reports, as its reply arrives
+        using SwarmCallback = std::function<void(const std::string& url, const Buffer& info_hash, const SwarmStats& swarm)>;
+
+        static constexpr size_t MAX_HTTP_SCRAPE = 50; // Keeps the request line well under common URL limits
+        static constexpr int MIN_NUM_WANT = 10;
+        static constexpr int MAX_NUM_WANT = 200;      // AnnounceParams' default; the dial race can use them all
+
+        // 'timeout_ms' caps each request; 0 leaves it to Announce::TimeoutMs()
+        explicit Scraper(Farm& farm, int timeout_ms = 0);
+
+        void SetCallback(SwarmCallback fn) { on_swarm = std::move(fn); }
+        void Add(const Buffer& info_hash, const std::vector<std::string>& urls);
+        void Start();       // Sends everything Add()ed so far
+        bool Done() const;
+        size_t Requests() const { return running.size(); }
+
+        SwarmStats Get(const std::string& url, const Buffer& info_hash) const;
+        SwarmStats Best(const Buffer& info_hash) const; // The biggest swarm any tracker reported
+
+        // Trackers that see a live swarm first (biggest first), unknown ones next, empty ones last
+        std::vector<std::string> RankTrackers(const Buffer& info_hash, std::vector<std::string> urls) const;
+
+        // num_want for an announce: MAX_NUM_WANT, but no more than a known swarm holds. 0 only
+        // when we don't 'need_peers' (every slot is full and there are still peers to dial).
+        static int NumWant(const SwarmStats& swarm, bool need_peers);
+        // 2: peers there, 1: don't know, 0: nobody there
+        static int Health(const SwarmStats& swarm) { return !swarm.Known() ? 1 : swarm.Peers() > 0 ? 2 : 0; }
+
+    private:
+        Farm& farm;
+        int timeout_ms;
+        SwarmCallback on_swarm;
+        std::unordered_map<std::string, std::vector<Buffer>> pending;  // Tracker -> hashes to ask about
+        std::vector<std::unique_ptr<Announce>> running;
+        std::unordered_map<std::string, std::unordered_map<std::string, SwarmStats>> results; // Tracker -> raw hash -> stats
+    };
+}
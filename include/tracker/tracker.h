@@ -2,19 +2,23 @@
 #include "parsing/TorrentFile.h"
 #include "tracker/Url.h"
 #include "tracker/Peer.h"
+#include "tracker/Announce.h"
 #include <vector>
 
 namespace BitTorrent {
 
     class Tracker {
     public:
-        // Main Function: Input Torrent -> Output Peers
+        // GetPeers blocks its caller, so each announce it makes gets this long (a silent UDP
+        // tracker has its sends at 0 and 15 s) instead of the UDP retry schedule
+        static constexpr int TIMEOUT_MS = 20000;
+
+        // Main Function: Input Torrent -> Output Peers.
+        // Blocking convenience wrapper: announces to every tier on a private Farm until each one
+        // has answered or run out of trackers, and returns the merged peer list.
         static std::vector<Peer> GetPeers(const TorrentFile& tf, const std::string& peer_id, int port = 6881);
 
-    private:
-        static std::vector<Peer> GetPeersHTTP(const Url& url, const TorrentFile& tf, const std::string& peer_id, int port);
-        static std::vector<Peer> GetPeersUDP(const Url& url, const TorrentFile& tf, const std::string& peer_id, int port);
-        
-        static std::string UrlEncode(const Buffer& buffer);
+        // What a fresh download announces: nothing up or down yet, everything left
+        static AnnounceParams Params(const TorrentFile& tf, const std::string& peer_id, int port = 6881);
     };
 }
\ No newline at end of file
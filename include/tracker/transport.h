@@ -1,5 +1,6 @@
 #pragma once
 #include "parsing/Buffer.h"
+#include "tracker/Peer.h"
 #include <string>
 #include <vector>
 
@@ -26,6 +27,8 @@ namespace BitTorrent {
     class TcpClient : public Transport {
     public:
         TcpClient(const std::string& host, int port);
+        explicit TcpClient(const Peer& peer); // IPv4 or IPv6, no lookup
+        TcpClient(int fd, const Peer& peer);  // Takes over a socket that is already connected (e.g. by a Dialer)
         void Send(const Buffer& data) override;
         Buffer Receive(size_t buffer_size = 4096) override;
     };
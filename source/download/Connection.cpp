@@ -2,7 +2,19 @@
 #include "download/Downloader.h"
 #include "parsing/buffer.h"
 #include "download/Message.h"
+#include "download/Farm.h"
+#include "tracker/Dialer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
 
 namespace BitTorrent
 {
@@ -15,40 +27,263 @@ namespace BitTorrent
 
     Connection::Connection(Peer p, Downloader &d) : peer(p), downloader(d) {}
 
-    void Connection::Connect()
+    Connection::~Connection()
     {
-        try
+        if (farm && connect_timer)
+            farm->Cancel(connect_timer);
+        dialer.reset(); // Closes a connect still in flight
+        Drop();
+    }
+
+    void Connection::Connect(Farm &f, int timeout_ms)
+    {
+        farm = &f;
+        state = CONNECTING;
+        // The SYN goes out now and the loop carries on; EPOLLOUT + SO_ERROR tell us how it went.
+        // A peer that never answers is given up on after 'timeout_ms', not the kernel's ~2 minutes.
+        connect_timer = farm->After(std::chrono::milliseconds(timeout_ms), [this]()
+                                    {
+            connect_timer = 0;
+            timed_out = true;
+            dialer.reset();
+            downloader.OnPeerDialed(*this, "connect timed out"); });
+        dialer = std::make_unique<Dialer>(*farm, std::vector<sockaddr_storage>{peer.addr},
+                                          [this](int fd, const std::string &error)
+                                          { OnDialed(fd, error); });
+        dialer->Start(); // May finish (and reset 'dialer') right here, e.g. no route
+    }
+
+    void Connection::OnDialed(int fd, const std::string &error)
+    {
+        if (connect_timer)
+            farm->Cancel(connect_timer);
+        connect_timer = 0;
+        dialer.reset(); // Its fd (if any) is ours now; safe from inside its callback
+
+        if (fd < 0)
         {
-            socket = std::make_unique<TcpClient>(peer.ip, peer.port);
-            socket->SetTimeout(2);
-            state = CONNECTING;
+            downloader.OnPeerDialed(*this, error);
+            return;
         }
-        catch (...)
+        if (!downloader.OnPeerDialed(*this, ""))
         {
-            socket = nullptr;
+            cancelled = true; // Enough peers already: not the peer's fault
+            close(fd);
+            return;
         }
+        // The Dialer's socket is non-blocking and stays that way: reads and writes never wait
+        // Requests are tiny: Nagle would hold each one back until the previous one is acked
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        socket = std::make_unique<TcpClient>(fd, peer);
+        // Writable straight away: OnReadyWrite() sends the handshake
+        farm->Add(fd, EPOLLIN | EPOLLOUT, this);
+        want_write = true;
     }
 
-    void Connection::OnReadyWrite()
+    void Connection::Cancel()
+    {
+        cancelled = true;
+        if (farm && connect_timer)
+            farm->Cancel(connect_timer);
+        connect_timer = 0;
+        dialer.reset();
+        Drop();
+    }
+
+    void Connection::Drop()
     {
         if (!socket)
             return;
+        if (farm)
+            farm->Remove(socket->GetSocket());
+        socket = nullptr;
+        send_buffer.clear();
+        want_write = false;
+    }
 
-        if (state == CONNECTING)
+    void Connection::Send(const Buffer &data)
+    {
+        if (!socket)
+            return;
+        send_buffer.insert(send_buffer.end(), data.begin(), data.end());
+        Flush();
+    }
+
+    void Connection::Flush()
+    {
+        size_t sent = 0;
+        while (sent < send_buffer.size())
         {
-            try
+            // A peer that hung up must not take the process down with SIGPIPE
+            ssize_t n = ::send(socket->GetSocket(), send_buffer.data() + sent, send_buffer.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break; // Its window is full: the rest goes out on EPOLLOUT
+            if (n < 0)
+                throw std::runtime_error("TCP Send failed");
+            sent += n;
+        }
+        send_buffer.erase(send_buffer.begin(), send_buffer.begin() + sent);
+
+        // Wake up for EPOLLOUT only while something is waiting to go out
+        bool pending = !send_buffer.empty();
+        if (farm && pending != want_write)
+        {
+            farm->Modify(socket->GetSocket(), pending ? EPOLLIN | EPOLLOUT : EPOLLIN);
+            want_write = pending;
+        }
+    }
+
+    void Connection::OnReadyWrite()
+    {
+        if (!socket)
+            return;
+        try
+        {
+            if (state == CONNECTING)
             {
-                Buffer hs = Message::BuildHandshake(downloader.torrent, downloader.my_id);
-                socket->Send(hs);
                 state = HANDSHAKING;
-                std::cout << "[Conn] Connected & Handshake sent to " << peer.ip << std::endl;
+                std::cout << "[Conn] Connected & Handshake sent to " << peer.ToString() << std::endl;
+                Send(Message::BuildHandshake(downloader.torrent, downloader.my_id));
             }
-            catch (...)
+            else
             {
-                socket = nullptr;
+                Flush();
             }
         }
+        catch (...)
+        {
+            Drop();
+        }
+    }
+
+    void Connection::Kick()
+    {
+        if (!socket || state != DOWNLOADING)
+            return;
+        try
+        {
+            FillPipeline();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "[Conn] Error sending: " << e.what() << std::endl;
+            Drop();
+        }
+    }
+
+    size_t Connection::QueueDepth(double rate, double rtt_s, int reqq)
+    {
+        size_t cap = reqq > 0 ? (size_t)reqq : MAX_QUEUE_DEPTH;
+        if (rate <= 0 || rtt_s <= 0)
+            return std::min(INITIAL_QUEUE_DEPTH, cap);
+        double blocks = std::ceil(QUEUE_GAIN * rate * rtt_s / Downloader::BLOCK_SIZE);
+        return std::clamp((size_t)std::min(blocks, (double)cap), std::min(MIN_QUEUE_DEPTH, cap), cap);
+    }
+
+    bool Connection::Snubbed(Clock::time_point now) const
+    {
+        return !outstanding.empty() && now - last_block > std::chrono::milliseconds(downloader.snub_ms);
+    }
+
+    void Connection::CancelRequests()
+    {
+        try
+        {
+            for (const auto &r : outstanding)
+                Send(Message::BuildCancel(r.piece, r.begin, r.length));
+        }
+        catch (...)
+        {
+            Drop();
+        }
+        ReleaseRequests();
+    }
+
+    void Connection::ReleaseRequests()
+    {
+        // Hand each piece back once, the current one too: were it kept, a peer that stopped
+        // answering would be asked for it again and nobody else could finish it. Whoever takes
+        // it up skips the blocks that did arrive.
+        std::vector<int> pieces;
+        for (const auto &r : outstanding)
+        {
+            if (std::find(pieces.begin(), pieces.end(), (int)r.piece) == pieces.end())
+                pieces.push_back(r.piece);
+        }
+        if (current_piece != -1 && std::find(pieces.begin(), pieces.end(), current_piece) == pieces.end())
+            pieces.push_back(current_piece);
+        for (int piece : pieces)
+            downloader.RetryPiece(piece);
+        current_piece = -1;
+        block_offset = 0;
+        outstanding.clear();
+        window_start = Clock::time_point();
+        window_bytes = 0;
+    }
+
+    // Bookkeeping for a block that just arrived: its RTT, the rate, and the queue depth they give
+    void Connection::OnBlock(uint32_t index, uint32_t begin, size_t size)
+    {
+        Clock::time_point now = Clock::now();
+        for (auto it = outstanding.begin(); it != outstanding.end(); ++it)
+        {
+            if (it->piece != index || it->begin != begin)
+                continue;
+            // The lowest one is the path's delay without our own queue in it
+            double rtt = std::chrono::duration<double>(now - it->sent).count();
+            min_rtt = min_rtt > 0 ? std::min(min_rtt, rtt) : rtt;
+            outstanding.erase(it);
+            break;
+        }
+        last_block = now;
+        snubbed = false;
+
+        window_bytes += size;
+        double span = std::chrono::duration<double>(now - window_start).count();
+        if (span >= std::max(min_rtt, RATE_WINDOW_S))
+        {
+            double sample = window_bytes / span;
+            rate = rate > 0 ? (rate + sample) / 2 : sample;
+            window_start = now;
+            window_bytes = 0;
+            queue_depth = QueueDepth(rate, min_rtt, peer_reqq);
+        }
     }
+
+    void Connection::FillPipeline()
+    {
+        if (!socket || choked)
+            return;
+        Clock::time_point now = Clock::now();
+        if (outstanding.empty())
+            last_block = now; // The snub clock starts with the first request
+        if (window_start == Clock::time_point())
+            window_start = now;
+        // One send for the whole top-up
+        Buffer batch;
+        while (outstanding.size() < queue_depth && RequestNextBlock(batch))
+        {
+        }
+        if (!batch.empty())
+            Send(batch);
+    }
+
+    void Connection::OnEvent(uint32_t events)
+    {
+        // 1. Connection established OR Space available to write
+        if (events & EPOLLOUT)
+            OnReadyWrite();
+
+        // 2. Data arrived from peer
+        if (events & EPOLLIN)
+            OnReadyRead();
+
+        // 3. Errors / Hangups: the socket calls above notice and drop the socket themselves
+    }
+
     // The Concept: TCP is a Stream, not a message queue. If Peer A sends: [Msg1: 10 bytes] and [Msg2: 20 bytes]. Peer B might receive:
     // Packet 1: [Msg1] + [First 5 bytes of Msg2]
     // Packet 2: [Rest of Msg2]
@@ -59,22 +294,26 @@ namespace BitTorrent
         try
         {
             // 1. Grab whatever data is currently on the wire (could be half a message)
-            Buffer chunk = socket->Receive(8192);
-            if (chunk.empty())
+            uint8_t chunk[8192];
+            ssize_t n = recv(socket->GetSocket(), chunk, sizeof(chunk), 0);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+                return; // Nothing after all; epoll will say when
+            if (n <= 0)
             {
-                socket = nullptr;
+                if (n < 0)
+                    std::cerr << "[Conn] Error reading: " << strerror(errno) << std::endl;
+                Drop();
                 return;
             }
             // 2. Append it to our 'stomach' (the buffer)
-            recv_buffer.insert(recv_buffer.end(), chunk.begin(), chunk.end());
+            recv_buffer.insert(recv_buffer.end(), chunk, chunk + n);
             // 3. Try to digest it
             ProcessBuffer();
         }
         catch (const std::exception &e)
         {
-            socket = nullptr;
             std::cerr << "[Conn] Error reading: " << e.what() << std::endl;
-            socket = nullptr;
+            Drop();
         }
     }
 
@@ -88,11 +327,14 @@ namespace BitTorrent
                 if (recv_buffer.size() < 68)
                     break;
 
+                extensions = Message::SupportsExtensions(recv_buffer);
                 recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + 68);
                 handshake_done = true;
                 state = DOWNLOADING;
-                // std::cout << "[Conn] Handshake OK! Sent Interested to " << peer.ip << std::endl;
-                socket->Send(Message::BuildInterested());
+                // std::cout << "[Conn] Handshake OK! Sent Interested to " << peer.ToString() << std::endl;
+                Send(Message::BuildInterested());
+                if (extensions)
+                    Send(Message::BuildExtendedHandshake()); // Theirs carries 'reqq'
                 continue;
             }
 
@@ -124,10 +366,10 @@ namespace BitTorrent
             case Message::UNCHOKE:
                 // std::cout << "[Conn] Peer UNCHOKED us! Requesting blocks...\n";
                 choked = false;
-                RequestNextBlock();
+                FillPipeline();
                 break;
             case Message::BITFIELD:
-                peer_pieces.resize(downloader.torrent.piece_hashes.size(), false);
+                peer_pieces.resize(downloader.torrent.PieceCount(), false);
                 for (size_t i = 0; i < payload.size(); ++i)
                 {
                     uint8_t byte = payload[i];
@@ -146,7 +388,16 @@ namespace BitTorrent
                 }
                 break;
             case Message::CHOKE:
+                // The peer drops whatever we had queued with it: those blocks go to whoever is unchoked
                 choked = true;
+                ReleaseRequests();
+                break;
+            case Message::EXTENDED:
+                if (int reqq = Message::ReadReqq(payload))
+                {
+                    peer_reqq = reqq;
+                    queue_depth = QueueDepth(rate, min_rtt, peer_reqq);
+                }
                 break;
             case Message::PIECE:
             {
@@ -154,84 +405,111 @@ namespace BitTorrent
                 uint32_t index = BufferUtils::ReadBE32(payload, 0);
                 uint32_t begin = BufferUtils::ReadBE32(payload, 4);
                 Buffer data(payload.begin() + 8, payload.end());
+                bytes_received += data.size();
+                OnBlock(index, begin, data.size());
 
-                downloader.OnBlockReceived(index, begin, data);
-                RequestNextBlock();
+                if (!downloader.OnBlockReceived(index, begin, data))
+                {
+                    // v2: this exact block failed its leaf hash, so this peer sent bad data
+                    bad_blocks++;
+                    std::cerr << "\n[Integrity] Bad block (piece " << index << ", offset " << begin
+                              << ") from " << peer.ToString() << "\n";
+                    if (bad_blocks >= MAX_BAD_BLOCKS)
+                    {
+                        downloader.RetryPiece(index);
+                        if (current_piece != -1 && current_piece != (int)index)
+                            downloader.RetryPiece(current_piece);
+                        Drop();
+                        return;
+                    }
+                    // Fetch only that block again
+                    Send(Message::BuildRequest(index, begin, data.size()));
+                    outstanding.push_back({index, begin, (uint32_t)data.size(), Clock::now()});
+                    break;
+                }
+                FillPipeline();
                 break;
             }
+            case Message::HASHES:
+                downloader.OnHashesReceived(payload);
+                break;
+            case Message::HASH_REJECT:
+                // No leaves for this piece: it gets checked against its layer hash once complete
+                break;
             }
         }
     }
     // Piece: Large chunk (e.g., 256 KB). Tracks correctness (Hash).
     // Block: Network chunk (Standard is 16 KB).
-    void Connection::RequestNextBlock()
+    bool Connection::RequestNextBlock(Buffer &out)
     {
         if (choked)
-            return;
+            return false;
 
-        // 1. If we don't have a piece assigned, ask Downloader for one
-        if (current_piece == -1)
+        while (true)
         {
-            // LOOP until we find a piece this peer actually has
-            int attempts = 0;
-            while (true)
+            // 1. If we don't have a piece assigned, ask Downloader for one
+            if (current_piece == -1)
             {
-                int candidate = downloader.GetNextPieceToRequest();
-
-                // If downloader returns -1, we are done with the whole file
-                if (candidate == -1)
+                // LOOP until we find a piece this peer actually has. The ones it doesn't have go
+                // back in the queue afterwards (not during, or we'd just be handed them again),
+                // so other peers still get them.
+                std::vector<int> skipped;
+                while (true)
                 {
-                    std::cout << "[Conn] No more pieces to request." << std::endl;
-                    return;
-                }
+                    int candidate = downloader.GetNextPieceToRequest();
 
-                // CHECK: Does the peer have this piece?
-                if (HasPiece(candidate))
-                {
-                    current_piece = candidate;
-                    block_offset = 0;
-                    break; // Found a good one!
-                }
-                else
-                {
-                    // Peer doesn't have it. In a real client, we put this back in the queue.
-                    // For this simple version, we just skip it (which is inefficient but working).
-                    // Ideally: downloader.PutPieceBack(candidate);
+                    // If downloader returns -1, we are done with the whole file
+                    if (candidate == -1)
+                    {
+                        std::cout << "[Conn] No more pieces to request." << std::endl;
+                        break;
+                    }
+
+                    // CHECK: Does the peer have this piece?
+                    if (HasPiece(candidate))
+                    {
+                        current_piece = candidate;
+                        block_offset = 0;
+                        // v2: ask for the piece's leaf hashes first, they arrive before its blocks
+                        Buffer hash_request = downloader.HashRequestFor(candidate);
+                        out.insert(out.end(), hash_request.begin(), hash_request.end());
+                        break; // Found a good one!
+                    }
 
                     // Safety break to prevent infinite loops if peer has nothing
-                    attempts++;
-                    if (attempts > downloader.torrent.piece_hashes.size())
-                        return;
+                    skipped.push_back(candidate);
+                    if (skipped.size() > downloader.torrent.PieceCount())
+                        break;
                 }
+                for (int piece : skipped)
+                    downloader.RetryPiece(piece);
+                if (current_piece == -1)
+                    return false;
             }
-        }
 
-        // 2. Calculate Block Size (Existing logic is good)
-        long long piece_len = downloader.torrent.piece_length;
-        // Check if it's the last piece (might be smaller)
-        if (current_piece == downloader.torrent.piece_hashes.size() - 1)
-        {
-            long long rem = downloader.torrent.length % piece_len;
-            if (rem != 0)
-                piece_len = rem;
-        }
+            // 2. Calculate Block Size (the last piece might be smaller)
+            long long piece_len = downloader.torrent.PieceSize(current_piece);
+            block_offset = downloader.NextMissingBlock(current_piece, block_offset); // A retried piece may be partly here
+            if (block_offset >= piece_len)
+            {
+                current_piece = -1; // Nothing missing after all: on to the next piece
+                continue;
+            }
 
-        if (block_offset < piece_len)
-        {
-            uint32_t req_len = 16384; // 16KB standard
+            uint32_t req_len = Downloader::BLOCK_SIZE;
             if (block_offset + req_len > piece_len)
                 req_len = piece_len - block_offset;
 
-            socket->Send(Message::BuildRequest(current_piece, block_offset, req_len));
+            Buffer request = Message::BuildRequest(current_piece, block_offset, req_len);
+            out.insert(out.end(), request.begin(), request.end());
+            outstanding.push_back({(uint32_t)current_piece, (uint32_t)block_offset, req_len, Clock::now()});
             block_offset += req_len;
-        }
 
-        // 3. If piece is done, reset current_piece so we get a new one next time
-        if (block_offset >= piece_len)
-        {
-            current_piece = -1;
-            // OPTIONAL: Immediately request the next one to avoid latency gap
-            // RequestNextBlock();
+            // 3. If piece is done, reset current_piece so we get a new one next time
+            if (block_offset >= piece_len)
+                current_piece = -1;
+            return true;
         }
     }
 
@@ -239,6 +517,6 @@ namespace BitTorrent
 // Summary of the Flow
 // Epoll says: "Connected!" --> We send Handshake.
 // Epoll says: "Data In!" --> We read Handshake --> Send Interested.
-// Epoll says: "Data In!" --> We read UNCHOKE --> Send Request (Piece 0, Offset 0).
-// Epoll says: "Data In!" --> We read PIECE (0, 0) --> Write to Disk --> Send Request (Piece 0, Offset 16KB).
-// Repeat until the piece is done, then ask Downloader for the next Piece.
\ No newline at end of file
+// Epoll says: "Data In!" --> We read UNCHOKE --> Send Requests until queue_depth are outstanding.
+// Epoll says: "Data In!" --> We read PIECE (0, 0) --> Write to Disk --> Top the queue up again.
+// When a piece's blocks are all requested, ask Downloader for the next Piece.
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "download/Farm.h"
+#include "tracker/Resolver.h"
 #include <unistd.h>
 #include <iostream>
 #include <cstring>
@@ -13,64 +14,126 @@ namespace BitTorrent {
     }
 
     Farm::~Farm() {
+        connections.clear(); // They unregister and cancel their timers: before those maps go
+        resolver.reset(); // Unregisters from the epoll set, so before it closes
         if(epfd >= 0) close(epfd);
     }
 
-    void Farm::AddConnection(std::shared_ptr<Connection> conn) {
-        // Start the TCP connection
-        conn->Connect();
-        
-        if(conn->GetSocketFd() >= 0) { 
-            struct epoll_event ev;
-            // LISTEN for READ (Data in) and WRITE (Ready to send/Connect success)
-            ev.events = EPOLLIN | EPOLLOUT; 
-            ev.data.ptr = conn.get(); // Store pointer to retrieve later
-            
-            // Add to epoll
-            if(epoll_ctl(epfd, EPOLL_CTL_ADD, conn->GetSocketFd(), &ev) < 0) {
-                std::cerr << "[Farm] Failed to add socket to epoll\n";
-            } else {
-                connections.push_back(conn);
-            }
+    void Farm::AddConnection(std::shared_ptr<Connection> conn, int connect_timeout_ms) {
+        // Start the TCP connection. It doesn't block: the connection registers itself for
+        // EPOLLIN | EPOLLOUT once the connect has gone through.
+        connections.push_back(conn);
+        conn->Connect(*this, connect_timeout_ms);
+    }
+
+    Resolver& Farm::GetResolver() {
+        if(!resolver) resolver = std::make_unique<Resolver>(*this);
+        return *resolver;
+    }
+
+    void Farm::Watch(int fd, std::function<void()> on_readable) {
+        auto w = std::make_unique<FdWatcher>();
+        w->on_readable = std::move(on_readable);
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = static_cast<EventHandler*>(w.get());
+        if(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            throw std::runtime_error("[Farm] Failed to watch fd");
+        }
+        watchers.push_back(std::move(w));
+    }
+
+    void Farm::Add(int fd, uint32_t ev_mask, EventHandler* handler) {
+        struct epoll_event ev;
+        ev.events = ev_mask;
+        ev.data.ptr = handler;
+        if(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            throw std::runtime_error("[Farm] Failed to add fd to epoll");
+        }
+        handlers[fd] = handler;
+    }
+
+    void Farm::Modify(int fd, uint32_t ev_mask) {
+        auto it = handlers.find(fd);
+        if(it == handlers.end()) return;
+        struct epoll_event ev;
+        ev.events = ev_mask;
+        ev.data.ptr = it->second;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+    }
+
+    void Farm::Remove(int fd) {
+        auto it = handlers.find(fd);
+        if(it == handlers.end()) return;
+        epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+        // The handler may be gone before the rest of this batch is dispatched
+        for(int i=0; i<ready; ++i) {
+            if(events[i].data.ptr == it->second) events[i].data.ptr = nullptr;
+        }
+        handlers.erase(it);
+    }
+
+    Farm::TimerId Farm::After(std::chrono::milliseconds delay, std::function<void()> fn) {
+        TimerId id = next_timer++;
+        Clock::time_point due = Clock::now() + delay;
+        timers.emplace(std::make_pair(due, id), std::move(fn));
+        timer_due[id] = due;
+        return id;
+    }
+
+    void Farm::Cancel(TimerId id) {
+        auto it = timer_due.find(id);
+        if(it == timer_due.end()) return;
+        timers.erase({it->second, id});
+        timer_due.erase(it);
+    }
+
+    // Milliseconds epoll may sleep: until the next timer, but never more than a second
+    int Farm::NextTimeout() const {
+        if(timers.empty()) return 1000;
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(timers.begin()->first.first - Clock::now()).count();
+        if(wait < 0) return 0;
+        return wait > 1000 ? 1000 : (int)wait + 1; // Round up so we wake after the deadline, not just before
+    }
+
+    void Farm::RunTimers() {
+        Clock::time_point now = Clock::now();
+        // Timers added by a callback wait for the next pass, even if they are already due
+        while(!timers.empty() && timers.begin()->first.first <= now) {
+            auto it = timers.begin();
+            std::function<void()> fn = std::move(it->second);
+            timer_due.erase(it->first.second);
+            timers.erase(it);
+            fn();
         }
     }
 
     void Farm::Run(std::function<bool()> checkComplete) {
-        while(!connections.empty()) {
+        while(!connections.empty() || !watchers.empty() || !handlers.empty() || !timers.empty()) {
             // 1. CHECK IF DOWNLOAD IS FINISHED
             if (checkComplete()) {
                 // std::cout << "[Farm] Download limit reached. Stopping.\n";
                 break;
             }
-            // 2. Wait for events (Blocking)
-            int nfds = epoll_wait(epfd, events, 64, 1000); // 1 sec timeout
+            // 2. Wait for events (Blocking, but never past the next timer)
+            int nfds = epoll_wait(epfd, events, 64, NextTimeout());
             
             if(nfds < 0) {
                 if(errno == EINTR) continue;
                 break; // Error
             }
 
+            ready = nfds;
             for(int i=0; i<nfds; ++i) {
-                Connection* conn = static_cast<Connection*>(events[i].data.ptr);
-                
-                // --- HANDLING EVENTS ---
-                
-                // 1. Connection established OR Space available to write
-                if(events[i].events & EPOLLOUT) {
-                    conn->OnReadyWrite();
-                }
-
-                // 2. Data arrived from peer
-                if(events[i].events & EPOLLIN) {
-                    conn->OnReadyRead();
-                }
-                
-                // 3. Errors / Hangups
-                if(events[i].events & (EPOLLERR | EPOLLHUP)) {
-                    // We can handle disconnection cleanup here if we want
-                    // For now, Connection class handles socket closure safely
-                }
+                // Connections and watched fds alike: each knows how to handle its own events
+                EventHandler* handler = static_cast<EventHandler*>(events[i].data.ptr);
+                if(handler) handler->OnEvent(events[i].events);
             }
+            ready = 0;
+
+            // 3. Timeouts, retries, scheduled work
+            RunTimers();
             
             // Cleanup closed connections occasionally (Simplification)
             // In a pro client, we'd remove them from the vector here.
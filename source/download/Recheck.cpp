@@ -0,0 +1,137 @@
+#include "download/Recheck.h"
+#include "parsing/MappedFile.h"
+#include "parsing/Sha1.h"
+#include "parsing/Merkle.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+namespace BitTorrent {
+
+    namespace {
+        // One non-empty file of the torrent and how much of it exists on disk
+        struct FileView {
+            int64_t offset;
+            int64_t length;
+            MappedFile map;
+            int64_t Available() const { return std::min<int64_t>(length, map.size()); }
+        };
+
+        class Checker {
+        public:
+            Checker(const TorrentFile& tf, const std::string& root, Speed* progress)
+                : tf(tf), progress(progress), have(tf.PieceCount(), 0) {
+                for (const auto& f : tf.files) {
+                    if (f.length == 0 || f.pad) continue;
+                    FileView v{f.offset, f.length, MappedFile()};
+                    try {
+                        v.map = MappedFile((std::filesystem::path(root) / f.path).string());
+                    } catch (const std::exception&) {
+                        // Not downloaded yet: an empty view, every piece in it is missing
+                    }
+                    files.push_back(std::move(v));
+                }
+            }
+
+            std::vector<bool> Run(size_t threads) {
+                std::vector<std::thread> pool;
+                for (size_t i = 0; i < threads; ++i) pool.emplace_back([this] { Work(); });
+                for (auto& t : pool) t.join();
+                return std::vector<bool>(have.begin(), have.end());
+            }
+
+        private:
+            const TorrentFile& tf;
+            Speed* progress;
+            std::vector<FileView> files;    // In stream order
+            std::vector<uint8_t> have;      // Written by many threads, one byte per piece
+            std::atomic<size_t> next_batch{0};
+
+            // Pointer to the piece's bytes: straight into the mapping when the piece lies inside
+            // one file, otherwise gathered into 'scratch'. Null if any byte is missing on disk.
+            const uint8_t* Locate(size_t piece, Buffer& scratch) const {
+                int64_t start = (int64_t)piece * tf.piece_length;
+                int64_t size = tf.PieceSize(piece);
+
+                auto it = std::upper_bound(files.begin(), files.end(), start,
+                                           [](int64_t off, const FileView& f) { return off < f.offset; });
+                if (it != files.begin()) {
+                    --it;
+                    int64_t within = start - it->offset;
+                    if (within + size <= it->Available()) return it->map.data() + within;
+                    if (within + size <= it->length) return nullptr; // Inside one file, but it's short
+                    if (within >= it->length) ++it;                  // Starts in padding after it
+                }
+
+                // Straddles files: copy the parts together (padding between them stays zero)
+                scratch.assign(size, 0);
+                for (int64_t pos = start, end = start + size; pos < end && it != files.end(); ++it) {
+                    if (it->offset >= end) break;
+                    pos = std::max(pos, it->offset);
+                    int64_t in_file = pos - it->offset;
+                    int64_t n = std::min(end - pos, it->length - in_file);
+                    if (n <= 0) continue;
+                    if (in_file + n > it->Available()) return nullptr;
+                    std::memcpy(scratch.data() + (pos - start), it->map.data() + in_file, n);
+                    pos += n;
+                }
+                return scratch.data();
+            }
+
+            void Work() {
+                const size_t lanes = Sha1::LANES;
+                const size_t count = tf.PieceCount();
+                std::vector<Buffer> scratch(lanes);
+
+                while (true) {
+                    size_t first = next_batch.fetch_add(1) * lanes;
+                    if (first >= count) break;
+                    size_t last = std::min(first + lanes, count);
+
+                    // Pieces present on disk, split into full-size ones (hashed together) and the short last one
+                    const uint8_t* ptrs[Sha1::LANES];
+                    size_t index[Sha1::LANES];
+                    size_t n = 0;
+                    int64_t bytes = 0;
+                    for (size_t i = first; i < last; ++i) {
+                        bytes += tf.PieceSize(i);
+                        const uint8_t* p = Locate(i, scratch[i - first]);
+                        if (!p) continue;
+                        if (!tf.HasV1()) { // Pure v2: the SHA-256 Merkle tree is all there is
+                            have[i] = MerkleTree::VerifyPiece(tf, i, p, tf.PieceSize(i));
+                            continue;
+                        }
+                        if (tf.PieceSize(i) != tf.piece_length) {
+                            Check(i, p, tf.PieceSize(i));
+                            continue;
+                        }
+                        ptrs[n] = p;
+                        index[n++] = i;
+                    }
+
+                    uint8_t digests[Sha1::LANES][Sha1::DIGEST_SIZE];
+                    Sha1::DigestMany(ptrs, tf.piece_length, n, digests);
+                    for (size_t k = 0; k < n; ++k) {
+                        have[index[k]] = std::memcmp(digests[k], tf.PieceHash(index[k]), Sha1::DIGEST_SIZE) == 0;
+                    }
+
+                    if (progress) progress->add(bytes);
+                }
+            }
+
+            void Check(size_t piece, const uint8_t* data, int64_t size) {
+                uint8_t digest[Sha1::DIGEST_SIZE];
+                Sha1::Digest(data, size, digest);
+                have[piece] = std::memcmp(digest, tf.PieceHash(piece), Sha1::DIGEST_SIZE) == 0;
+            }
+        };
+    }
+
+    std::vector<bool> Recheck::Run(const TorrentFile& tf, const std::string& root, Speed* progress, size_t threads) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        Checker checker(tf, root, progress);
+        return checker.Run(threads);
+    }
+}
@@ -0,0 +1,158 @@
+#include "download/Storage.h"
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace BitTorrent {
+
+    // Local Helper: open (creating directories and the file as needed) for read/write
+    static int OpenPath(const std::string& path) {
+        std::filesystem::path p(path);
+        if (p.has_parent_path()) std::filesystem::create_directories(p.parent_path());
+
+        // No O_TRUNC: data already on disk from an earlier run is kept
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) throw std::runtime_error("Cannot open " + path);
+        return fd;
+    }
+
+    Storage::Storage(const TorrentFile& tf, const std::string& root, size_t max_open_files)
+        : stream_end(tf.length), max_open(std::max<size_t>(1, max_open_files)) {
+        for (const auto& f : tf.files) {
+            if (f.pad) continue; // Zero filler, never stored
+            size_t index = paths.size();
+            paths.push_back((std::filesystem::path(root) / f.path).string());
+
+            if (f.length > 0) {
+                segments.push_back({f.offset, f.length, index});
+            } else {
+                // Nothing will ever be written to an empty file, so create it now
+                close(OpenPath(paths[index]));
+            }
+        }
+        // Files are listed in stream order already, but the binary search depends on it
+        std::sort(segments.begin(), segments.end(),
+                  [](const Segment& a, const Segment& b) { return a.offset < b.offset; });
+    }
+
+    Storage::Storage(const std::string& filename) : stream_end(INT64_MAX), max_open(1) {
+        paths.push_back(filename);
+        segments.push_back({0, INT64_MAX, 0});
+    }
+
+    Storage::~Storage() {
+        for (auto& entry : open_files) close(entry.second.fd);
+    }
+
+    // Returns an open fd for the file, opening (and evicting the least recently used) if needed
+    int Storage::GetFd(size_t file) {
+        auto it = open_files.find(file);
+        if (it != open_files.end()) {
+            lru.splice(lru.begin(), lru, it->second.lru_pos); // Mark as most recently used
+            return it->second.fd;
+        }
+
+        if (open_files.size() >= max_open) {
+            size_t victim = lru.back();
+            lru.pop_back();
+            close(open_files[victim].fd);
+            open_files.erase(victim);
+        }
+
+        int fd = OpenPath(paths[file]);
+        lru.push_front(file);
+        open_files[file] = {fd, lru.begin()};
+        return fd;
+    }
+
+    std::vector<Storage::Segment>::const_iterator Storage::FindSegment(int64_t offset) const {
+        // First segment starting after 'offset', then step back if the one before contains it
+        auto it = std::upper_bound(segments.begin(), segments.end(), offset,
+                                   [](int64_t off, const Segment& s) { return off < s.offset; });
+        if (it != segments.begin() && offset < std::prev(it)->offset + std::prev(it)->length) --it;
+        return it;
+    }
+
+    void Storage::Write(int64_t offset, const uint8_t* data, size_t size) {
+        std::lock_guard<std::mutex> lk(mx);
+        if (offset < 0 || (int64_t)size > stream_end - offset) throw std::runtime_error("Storage write past end of torrent");
+        auto seg = FindSegment(offset);
+
+        while (size > 0) {
+            if (seg == segments.end()) return; // Only padding left
+            if (offset < seg->offset) {
+                // Padding before the next file: nothing to store
+                size_t skip = (size_t)std::min<int64_t>((int64_t)size, seg->offset - offset);
+                data += skip;
+                offset += skip;
+                size -= skip;
+                continue;
+            }
+
+            int64_t within = offset - seg->offset;
+            size_t n = (size_t)std::min<int64_t>((int64_t)size, seg->length - within);
+            int fd = GetFd(seg->file);
+
+            // pwrite may write less than asked; keep going until this segment's part is done
+            size_t done = 0;
+            while (done < n) {
+                ssize_t w = pwrite(fd, data + done, n - done, within + done);
+                if (w < 0) {
+                    if (errno == EINTR) continue;
+                    throw std::runtime_error("Write failed: " + paths[seg->file]);
+                }
+                done += w;
+            }
+
+            data += n;
+            offset += n;
+            size -= n;
+            ++seg;
+        }
+    }
+
+    size_t Storage::Read(int64_t offset, uint8_t* data, size_t size) {
+        std::lock_guard<std::mutex> lk(mx);
+        auto seg = FindSegment(offset);
+        size_t total = 0;
+
+        while (size > 0 && offset < stream_end) {
+            if (seg == segments.end() || offset < seg->offset) {
+                // Padding reads as zeros
+                int64_t next = seg == segments.end() ? stream_end : seg->offset;
+                size_t n = (size_t)std::min<int64_t>((int64_t)size, next - offset);
+                std::memset(data, 0, n);
+                total += n;
+                data += n;
+                offset += n;
+                size -= n;
+                continue;
+            }
+
+            int64_t within = offset - seg->offset;
+            size_t n = (size_t)std::min<int64_t>((int64_t)size, seg->length - within);
+            int fd = GetFd(seg->file);
+
+            size_t done = 0;
+            while (done < n) {
+                ssize_t r = pread(fd, data + done, n - done, within + done);
+                if (r < 0 && errno == EINTR) continue;
+                if (r <= 0) return total + done; // Short file: the rest was never written
+                done += r;
+            }
+
+            total += n;
+            data += n;
+            offset += n;
+            size -= n;
+            ++seg;
+        }
+        return total;
+    }
+}
@@ -0,0 +1,95 @@
+#include "download/Verifier.h"
+#include "parsing/Sha1.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace BitTorrent {
+
+    Verifier::Verifier(size_t threads) {
+        event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (event_fd < 0) throw std::runtime_error("Failed to create eventfd");
+
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        Sha1::Best(); // Pick the SHA-1 backend now rather than inside the first job
+        for (size_t i = 0; i < threads; ++i) pool.emplace_back([this] { Loop(); });
+    }
+
+    Verifier::~Verifier() {
+        { std::lock_guard<std::mutex> lk(mx); stop_flag = true; }
+        cv.notify_all();
+        for (auto& t : pool) t.join();
+        close(event_fd);
+    }
+
+    void Verifier::Submit(VerifyJob job) {
+        job.queued = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lk(mx);
+            jobs.push(std::move(job));
+            stats.queue_depth++;
+            stats.max_queue_depth = std::max(stats.max_queue_depth, stats.queue_depth);
+        }
+        cv.notify_one();
+    }
+
+    void Verifier::Loop() {
+        while (true) {
+            std::unique_lock<std::mutex> lock(mx);
+            cv.wait(lock, [this] { return !jobs.empty() || stop_flag; });
+            if (jobs.empty()) break; // Stopping, nothing left
+
+            VerifyJob job = std::move(jobs.front());
+            jobs.pop();
+            lock.unlock();
+
+            VerifyResult r;
+            r.piece = job.piece;
+            r.offset = job.offset;
+            r.expected = job.expected;
+            if (!job.sha) {
+                job.sha = std::make_unique<Sha1>();
+                job.hashed = 0;
+            }
+            job.sha->Update(job.data.data() + job.hashed, job.data.size() - job.hashed);
+            job.sha->Final(r.actual.data());
+            r.ok = std::memcmp(r.actual.data(), r.expected.data(), r.actual.size()) == 0;
+            r.data = std::move(job.data);
+            r.latency_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job.queued).count();
+
+            lock.lock();
+            stats.queue_depth--;
+            (r.ok ? stats.verified : stats.failed)++;
+            total_latency_ms += r.latency_ms;
+            stats.max_latency_ms = std::max(stats.max_latency_ms, r.latency_ms);
+            done.push_back(std::move(r));
+            lock.unlock();
+
+            // Wake the reactor (the counter just accumulates until Drain() reads it)
+            uint64_t one = 1;
+            ssize_t w = write(event_fd, &one, sizeof(one));
+            (void)w;
+        }
+    }
+
+    std::vector<VerifyResult> Verifier::Drain() {
+        uint64_t count;
+        ssize_t r = read(event_fd, &count, sizeof(count)); // EAGAIN when nothing was signalled
+        (void)r;
+
+        std::vector<VerifyResult> out;
+        std::lock_guard<std::mutex> lk(mx);
+        out.swap(done);
+        return out;
+    }
+
+    Verifier::Stats Verifier::GetStats() {
+        std::lock_guard<std::mutex> lk(mx);
+        Stats s = stats;
+        size_t n = s.verified + s.failed;
+        s.avg_latency_ms = n ? total_latency_ms / n : 0;
+        return s;
+    }
+}
@@ -9,7 +9,8 @@ using namespace std;
 namespace BitTorrent {
 
     // --- WRITER IMPLEMENTATION ---
-    Writer::Writer(string filename) : out(filename, ios::binary | ios::out) {}
+    Writer::Writer(string filename) : storage(make_unique<Storage>(filename)) {}
+    Writer::Writer(const TorrentFile& tf, const string& root) : storage(make_unique<Storage>(tf, root)) {}
 
     Writer::~Writer() {
         { lock_guard<mutex> lk(mx); stop_flag = true; }
@@ -28,9 +29,12 @@ namespace BitTorrent {
                     q.pop();
                     lock.unlock();
                     
-                    // Actual File Write
-                    out.seekp(j.offset);
-                    out.write((char*)j.b.data(), j.b.size());
+                    // Actual File Write (straight from the job's buffer, split per file)
+                    try {
+                        storage->Write(j.offset, j.b.data(), j.b.size());
+                    } catch (const exception& e) {
+                        cerr << "\n[Writer] " << e.what() << endl;
+                    }
                     
                     lock.lock();
                 }
@@ -94,7 +98,7 @@ namespace BitTorrent {
                 cout << "\033[H"; 
 
                 // --- LINE 1: Filename & Status ---
-                cout << "\033[1;36m[ Downloading ]\033[0m " << filename << "\033[K\n"; 
+                cout << "\033[1;36m[ " << label.load() << " ]\033[0m " << filename << "\033[K\n"; 
 
                 // --- LINE 2: Progress Bar & Spinner ---
                 cout << "\033[1;33m["; // Yellow Color
@@ -1,17 +1,46 @@
 #include "download/Downloader.h"
 #include "download/Connection.h"
 #include "download/Farm.h"
-#include "parsing/Sha1.h"
+#include "download/Recheck.h"
+#include "download/Message.h"
+#include "tracker/Tracker.h"
+#include "tracker/Announcer.h"
+#include "tracker/Scraper.h"
+#include "parsing/Merkle.h"
 #include <iostream>
 #include <algorithm>
 #include <cstring>
 namespace BitTorrent {
+    // Local Helper: digests are raw bytes, print them as hex
+    static std::string ToHex(const uint8_t* data, size_t size) {
+        static const char digits[] = "0123456789abcdef";
+        std::string out;
+        for (size_t i = 0; i < size; ++i) {
+            out += digits[data[i] >> 4];
+            out += digits[data[i] & 0xF];
+        }
+        return out;
+    }
+
+    // Local Helper: bytes covered by pieces. Equals the length except in pure v2 torrents,
+    // where the alignment gap after each file belongs to no piece.
+    static int64_t PieceBytes(const TorrentFile& tf) {
+        if (tf.HasV1()) return tf.length;
+        int64_t total = 0;
+        for (size_t i = 0; i < tf.PieceCount(); ++i) total += tf.PieceSize(i);
+        return total;
+    }
+
     // Constructor (Ensure downloaded_bytes is initialized)
     Downloader::Downloader(const TorrentFile& tf, const std::string& id, const std::vector<Peer>& p_list)
-        : torrent(tf), my_id(id), peers(p_list), 
-          file_writer(tf.name), s(tf.length, tf.name) 
+        : connect_timeout_ms(Connection::CONNECT_TIMEOUT_MS), snub_ms(Connection::SNUB_S * 1000), torrent(tf), my_id(id),
+          file_writer(tf), s(PieceBytes(tf), tf.name) 
     {
+        for (const auto& p : p_list) peers.Add(p, PeerSource::GIVEN);
         downloaded_bytes = 0; // Reset
+        completed_pieces.assign(torrent.PieceCount(), false);
+        total_bytes = PieceBytes(torrent);
+        merkle = !torrent.HasV1();
     }
     void Downloader::Start() {
         std::cout << "[Downloader] Starting download for: " << torrent.name << std::endl;
@@ -19,85 +48,395 @@ namespace BitTorrent {
         std::cout << "Wait for atleast 2 minutes to see progress" <<std:: endl;
         // 1. Start Background Threads
         file_writer.start();
+        s.SetLabel("Checking");
         s.start();
 
-        // 2. Create Connections
-        std::vector<std::shared_ptr<Connection>> conns;
-        int count = 0;
-        for(const auto& p : peers) {
-             if(count >= 5) break; // Limit to 5 peers to avoid file descriptor limits
-             std::cout << "[Downloader] Connecting to " << p.ip << "..." << std::endl;
-             conns.push_back(std::make_shared<Connection>(p, *this));
-             count++;
-        }
-        std::cout << "[Downloader] Initiating " << conns.size() << " connections..." << std::endl;
-
-        // 3. Add to Farm
-        Farm farm;
-        for(auto& c : conns) farm.AddConnection(c);
-        
-        // 4. Run the Event Loop (Blocks here until done)
-        // farm.Run();
-        // lambda expression
-        farm.Run([this]() {
-            return this->IsComplete();
+        // 1b. Keep whatever an earlier run left on disk: hash it all and seed the have-flags
+        //     before any peer connects
+        completed_pieces = Recheck::Run(torrent, ".", &s);
+        long long have_bytes = 0;
+        for (size_t i = 0; i < completed_pieces.size(); ++i) {
+            if (completed_pieces[i]) have_bytes += torrent.PieceSize(i);
+        }
+        downloaded_bytes = have_bytes;
+        start_bytes = have_bytes;
+        s.Reset(have_bytes);
+        s.SetLabel("Downloading");
+
+        // 2. One event loop for everything: peers, the tracker, and finished hashes
+        Farm loop;
+        farm = &loop;
+        refill_queued = false;
+        loop.Watch(verifier.GetEventFd(), [this]() { OnPiecesVerified(); });
+
+        // 3. Peers we were given up front, then whatever the trackers send. Every tier is
+        //    announced at once inside the loop, and each reply's peers are dialled as it lands,
+        //    so the first tracker to answer is the one we wait for.
+        DialCandidates();
+
+        //    The trackers keep being asked on their own interval for the whole download, with
+        //    what we actually have, so fresh peers keep replacing the ones that leave.
+        AnnounceParams params = Tracker::Params(torrent, my_id);
+        auto tiers = torrent.TrackerTiers();
+        std::cout << "[Downloader] Announcing to " << tiers.size() << " tracker tiers..." << std::endl;
+        Announcer tracker(loop, tiers, params, peers, [this](size_t fresh) {
+            std::cout << "[Tracker] " << fresh << " new peers" << std::endl;
+            DialCandidates();
+        });
+        tracker.SetProgress([this, &tracker](AnnounceParams& p) {
+            p.uploaded = 0; // We don't seed (yet)
+            p.downloaded = downloaded_bytes - start_bytes;
+            p.left = total_bytes - downloaded_bytes;
+            // As many as the swarm the trackers report holds; none only while every slot is full
+            // and the store still has peers to dial when one frees up
+            p.num_want = Scraper::NumWant(tracker.BestSwarm(), Established() < MAX_CONNECTIONS || !peers.HasCandidates());
+        });
+
+        //    Every tracker is scraped alongside the first round, and nothing waits for the answers.
+        //    As each lands, its swarm sizes num_want, and later rounds try the trackers that see
+        //    a live swarm first and the empty ones last.
+        Scraper scraper(loop);
+        scraper.SetCallback([&tracker](const std::string& url, const Buffer&, const SwarmStats& swarm) {
+            if (swarm.Known()) tracker.SetSwarm(url, swarm);
+        });
+        tracker.SetRanking([&scraper, &params](std::vector<std::string> urls) {
+            return scraper.RankTrackers(params.info_hash, std::move(urls));
+        });
+        for (const auto& tier : tiers) scraper.Add(params.info_hash, tier);
+        announcer = &tracker;
+        tracker.Start();
+        scraper.Start();
+
+        std::function<void()> maintain = [&]() {
+            Maintain();
+            loop.After(std::chrono::milliseconds(MAINTAIN_MS), maintain);
+        };
+        loop.After(std::chrono::milliseconds(MAINTAIN_MS), maintain);
+
+        // 4. Run the Event Loop (Blocks here until done, or until there is nobody left to ask)
+        loop.Run([&]() {
+            if (IsComplete()) return true;
+            if (peers.Size() == 0 && tracker.Done()) {
+                std::cerr << "[Downloader] No peers found! Aborting." << std::endl;
+                return true;
+            }
+            return false;
         });
         std::cout << "\n[Downloader] Download loop finished.\n";
+        for (auto& c : connections) c->Cancel(); // Connects still in flight too
+
+        // 5. Say goodbye: 'completed' if we got everything, then 'stopped'. Both give up after
+        //    Announcer::STOP_TIMEOUT_MS, so a dead tracker can't hold up the exit for long.
+        if (IsComplete()) {
+            tracker.Send(AnnounceEvent::COMPLETED);
+            loop.Run([&]() { return tracker.Done(); });
+        }
+        tracker.Stop();
+        loop.Run([&]() { return tracker.Done(); });
+        announcer = nullptr;
+        farm = nullptr;
+        connections.clear();
+
+        Verifier::Stats vs = verifier.GetStats();
+        std::cout << "[Verifier] " << vs.verified << " ok, " << vs.failed << " failed on "
+                  << verifier.ThreadCount() << " threads | latency avg " << vs.avg_latency_ms
+                  << " ms, max " << vs.max_latency_ms << " ms | peak queue " << vs.max_queue_depth << "\n";
+        if (merkle) std::cout << "[Merkle] " << merkle_bad_blocks << " bad blocks rejected\n";
+        std::cout << "[Dial] " << dial_stats.started << " connects: " << dial_stats.connected << " ok, "
+                  << dial_stats.failed << " failed, " << dial_stats.timed_out << " timed out | peak in flight "
+                  << dial_stats.peak_in_flight << "\n";
+    }
+
+    void Downloader::AddPeers(const std::vector<Peer>& list) {
+        for (const auto& p : list) peers.Add(p, PeerSource::TRACKER); // Known ones are ignored
+        DialCandidates();
+    }
+
+    size_t Downloader::Established() const {
+        size_t n = 0;
+        for (const auto& c : connections) n += c->GetSocketFd() >= 0;
+        return n;
+    }
+
+    size_t Downloader::Dialing() const {
+        size_t n = 0;
+        for (const auto& c : connections) n += c->Dialing();
+        return n;
+    }
+
+    void Downloader::DialCandidates() {
+        if (!farm) return;
+        uint32_t index;
+        size_t established = Established(), dialing = Dialing();
+        // Up to 'max_dials' connects race for the free slots. Take IPv6 and IPv4 peers in turn,
+        // so a dead family can't hold up every slot.
+        while (established < MAX_CONNECTIONS && dialing < max_dials &&
+               peers.Next(index, last_family == AF_INET ? AF_INET6 : last_family == AF_INET6 ? AF_INET : 0)) {
+            Peer p = peers[index].key.ToPeer();
+            last_family = p.Family();
+            std::cout << "[Downloader] Connecting to " << p.ToString() << "..." << std::endl;
+            auto conn = std::make_shared<Connection>(p, *this);
+            connections.push_back(conn);
+            dial_stats.started++;
+            farm->AddConnection(conn, connect_timeout_ms);
+            if (conn->Dialing()) dialing++; // Else it failed on the spot (e.g. no route)
+            dial_stats.peak_in_flight = std::max(dial_stats.peak_in_flight, dialing);
+        }
     }
 
-    void Downloader::OnBlockReceived(int piece_index, int offset, Buffer& data) {
-        
-        // 1. Initialize Buffer for New Piece
-        if (piece_index != current_piece_index) {
-            current_piece_index = piece_index;
-            piece_bytes_received = 0;
-            
-            // Allocate memory for the full piece (usually 256KB)
-            long long piece_len = torrent.piece_length;
-            
-            // Handle last piece case (it might be smaller)
-            if (piece_index == torrent.piece_hashes.size() - 1) {
-                long long rem = torrent.length % torrent.piece_length;
-                if (rem != 0) piece_len = rem;
+    bool Downloader::OnPeerDialed(Connection& c, const std::string& error) {
+        if (!error.empty()) {
+            (c.timed_out ? dial_stats.timed_out : dial_stats.failed)++;
+            // Its slot in the race is free: dial the next one, on the next pass (a connect can
+            // fail inside DialCandidates() itself)
+            if (farm && !refill_queued) {
+                refill_queued = true;
+                farm->After(std::chrono::milliseconds(0), [this]() {
+                    refill_queued = false;
+                    DialCandidates();
+                });
+            }
+            return false;
+        }
+
+        size_t established = Established();
+        if (established >= MAX_CONNECTIONS) return false; // Lost the race
+        dial_stats.connected++;
+        // That was the last slot: call off the rest, they go back in line for when one frees up
+        if (established + 1 == MAX_CONNECTIONS) {
+            for (auto& other : connections) {
+                if (other.get() != &c && other->Dialing()) other->Cancel();
+            }
+        }
+        return true;
+    }
+
+    // Runs every MAINTAIN_MS on the loop: swaps peers that hung up for new ones
+    void Downloader::Maintain() {
+        // 1. A peer sitting on our requests without sending anything gets them cancelled, so they
+        //    can be asked of someone else
+        for (auto& c : connections) {
+            if (c->GetSocketFd() >= 0 && c->Snubbed()) {
+                c->snubbed = true;
+                c->CancelRequests();
+            }
+        }
+
+        // 2. Drop dead connections. Pieces they were in the middle of (including a piece whose
+        //    last block was still on the wire) go back in the queue.
+        size_t before = connections.size();
+        std::set<int> orphans; // Pieces a dead connection had requests out for
+        //    The store hears how each went: peers that never got through (or sent nothing) back off.
+        connections.erase(std::remove_if(connections.begin(), connections.end(),
+                                         [this, &orphans](const std::shared_ptr<Connection>& c) {
+                                             if (c->GetSocketFd() >= 0 || c->Dialing()) return false;
+                                             for (const auto& r : c->outstanding) orphans.insert(r.piece);
+                                             if (c->current_piece >= 0) orphans.insert(c->current_piece);
+                                             int64_t index = peers.Find(PeerKey::From(c->peer));
+                                             if (index < 0) return true;
+                                             if (c->cancelled) peers.Requeue((uint32_t)index);
+                                             else peers.Closed((uint32_t)index, c->bytes_received > 0);
+                                             return true;
+                                         }),
+                          connections.end());
+        if (connections.size() < before) {
+            std::set<int> busy;
+            for (auto& c : connections) {
+                if (c->current_piece >= 0) busy.insert(c->current_piece);
+                for (const auto& r : c->outstanding) busy.insert(r.piece);
+            }
+            for (auto& entry : active_pieces) orphans.insert(entry.first);
+            for (int piece : orphans) {
+                if (!busy.count(piece) && !completed_pieces[piece]) RetryPiece(piece);
             }
-            
-            piece_buffer.assign(piece_len, 0); // Clear buffer
         }
 
-        // 2. Copy Data to RAM Buffer
-        if (offset + data.size() <= piece_buffer.size()) {
-            std::memcpy(piece_buffer.data() + offset, data.data(), data.size());
-            piece_bytes_received += data.size();
+        // 3. Refill the free slots, and wake idle peers if there is work to hand out again (not
+        //    the snubbed ones, or they would just be asked for the same blocks)
+        DialCandidates();
+        if (!retry_pieces.empty()) {
+            for (auto& c : connections) {
+                if (!c->snubbed) c->Kick();
+            }
         }
 
-        // 3. Update Speed UI (We still downloaded it, even if bad)
+        // 4. Nobody left to dial: ask the trackers now instead of at the next interval
+        if (Established() < MAX_CONNECTIONS && !peers.HasCandidates() && announcer) announcer->AnnounceSoon();
+    }
+
+    bool Downloader::OnBlockReceived(int piece_index, int offset, Buffer& data) {
+        if (piece_index < 0 || (size_t)piece_index >= torrent.PieceCount() || offset < 0) return true;
+        if (completed_pieces[piece_index]) return true; // Late duplicate of a finished piece
+
+        // 1. Update Speed UI (We still downloaded it, even if bad)
         s.add(data.size());
 
-        // 4. CHECK INTEGRITY: Is the Piece Full?
-        if (piece_bytes_received == piece_buffer.size()) {
-            
-            // A. Calculate Hash
-            std::string calculated_hash = Sha1::Calculate(piece_buffer);
-            
-            // B. Get Expected Hash from Torrent File
-            std::string expected_hash = torrent.piece_hashes[piece_index];
-
-            // C. Compare
-            if (calculated_hash == expected_hash) {
-                // SUCCESS: Write to Disk
-                int64_t global_offset = (int64_t)piece_index * torrent.piece_length;
-                file_writer.add(piece_buffer, global_offset);
-                
-                downloaded_bytes += piece_buffer.size();
-                // std::cout << "\r[Integrity] Piece " << piece_index << " Verified & Written.   " << std::flush;
+        // 2. Find or start the piece (allocated at its real size, the last one may be short)
+        PieceState& p = active_pieces[piece_index];
+        if (p.data.empty()) {
+            p.data.resize(torrent.PieceSize(piece_index));
+            p.sha = std::make_unique<Sha1>();
+        }
+
+        // 3. Copy Data to RAM Buffer. We only ever request whole 16KB blocks at 16KB offsets,
+        //    so anything else is bogus, and a block we already hold is a duplicate.
+        size_t off = offset, len = data.size();
+        if (off >= p.data.size() || off % BLOCK_SIZE != 0 || len != std::min(BLOCK_SIZE, p.data.size() - off)) return true;
+        if (off < p.hashed || p.held.count(off)) return true; // Duplicate (e.g. re-requested block)
+        if (merkle) return OnMerkleBlock(piece_index, p, off, data);
+        std::memcpy(p.data.data() + off, data.data(), len);
+        p.received += len;
+
+        // Extend the in-order prefix: this block, then any held blocks the gap was blocking
+        if (off == p.hashed) {
+            p.sha->Update(p.data.data() + off, len);
+            p.hashed += len;
+            for (auto it = p.held.begin(); it != p.held.end() && it->first == p.hashed; it = p.held.erase(it)) {
+                p.sha->Update(p.data.data() + it->first, it->second);
+                p.hashed += it->second;
+            }
+        } else {
+            p.held[off] = len;
+        }
+
+        // 4. Is the Piece Full? Only the tail (if any) is left to hash; the pool finishes it
+        if (p.received == p.data.size()) {
+            VerifyJob job;
+            job.piece = piece_index;
+            job.offset = (int64_t)piece_index * torrent.piece_length;
+            job.data = std::move(p.data);
+            job.sha = std::move(p.sha);
+            job.hashed = p.hashed;
+            std::memcpy(job.expected.data(), torrent.PieceHash(piece_index), job.expected.size());
+            verifier.Submit(std::move(job));
+
+            active_pieces.erase(piece_index);
+            completed_pieces[piece_index] = true;
+        }
+        return true;
+    }
+
+    // v2: every block is its own leaf. With the piece's leaves known (from HASHES) a bad block is
+    // refused on the spot, so only that block is fetched again and the caller knows who sent it.
+    bool Downloader::OnMerkleBlock(int piece_index, PieceState& p, size_t off, const Buffer& data) {
+        size_t block = off / BLOCK_SIZE;
+        Sha256Digest leaf = MerkleTree::HashBlock(data.data(), data.size());
+
+        auto known = piece_leaves.find(piece_index);
+        if (known != piece_leaves.end() && block < known->second.size() && known->second[block] != leaf) {
+            merkle_bad_blocks++;
+            return false;
+        }
+
+        if (p.leaves.empty()) p.leaves.resize((p.data.size() + BLOCK_SIZE - 1) / BLOCK_SIZE);
+        std::memcpy(p.data.data() + off, data.data(), data.size());
+        p.leaves[block] = leaf;
+        p.held[off] = data.size();
+        p.received += data.size();
+
+        if (p.received == p.data.size()) FinishMerklePiece(piece_index, p);
+        return true;
+    }
+
+    // All blocks are in; the leaves already exist, so checking the piece is a handful of hashes
+    // and is done right here instead of on the Verifier pool
+    void Downloader::FinishMerklePiece(int piece_index, PieceState& p) {
+        Sha256Digest root;
+        size_t width;
+        bool ok = MerkleTree::PieceTarget(torrent, piece_index, root, width) && MerkleTree::Root(p.leaves, width) == root;
+
+        if (ok) {
+            downloaded_bytes += p.data.size();
+            file_writer.add(p.data, (int64_t)piece_index * torrent.piece_length);
+            completed_pieces[piece_index] = true;
+            active_pieces.erase(piece_index);
+            piece_leaves.erase(piece_index);
+            return;
+        }
+
+        // Blocks stored before the leaves arrived: drop just the bad ones and fetch those again
+        auto known = piece_leaves.find(piece_index);
+        if (known != piece_leaves.end() && known->second.size() == p.leaves.size()) {
+            for (size_t i = 0; i < p.leaves.size(); ++i) {
+                if (p.leaves[i] == known->second[i]) continue;
+                size_t off = i * BLOCK_SIZE;
+                p.received -= p.held[off];
+                p.held.erase(off);
+                merkle_bad_blocks++;
+            }
+            std::cerr << "\n[Integrity] Bad blocks in Piece " << piece_index << ", fetching them again.\n";
+        } else {
+            std::cerr << "\n[Integrity] MERKLE MISMATCH on Piece " << piece_index << "! Discarding.\n";
+            active_pieces.erase(piece_index);
+        }
+        RetryPiece(piece_index);
+    }
+
+    Buffer Downloader::HashRequestFor(int piece) const {
+        if (!merkle || piece_leaves.count(piece)) return {};
+        const FileEntry* f;
+        int64_t begin, size;
+        Sha256Digest root;
+        size_t width;
+        if (!MerkleTree::PieceFileRange(torrent, piece, f, begin, size) || !MerkleTree::PieceTarget(torrent, piece, root, width))
+            return {};
+        // A one-block file is its own root; past 512 leaves peers refuse the request
+        if (width < 2 || width > 512) return {};
+        uint32_t index = (begin - f->offset) / BLOCK_SIZE;
+        return Message::BuildHashRequest(f->pieces_root, 0, index, width, 0);
+    }
+
+    void Downloader::OnHashesReceived(const Buffer& payload) {
+        if (!merkle || payload.size() < 48) return;
+        Sha256Digest root;
+        std::memcpy(root.data(), payload.data(), 32);
+        uint32_t base_layer = BufferUtils::ReadBE32(payload, 32);
+        uint32_t index = BufferUtils::ReadBE32(payload, 36);
+        uint32_t length = BufferUtils::ReadBE32(payload, 40);
+        if (base_layer != 0 || length == 0 || (payload.size() - 48) / 32 < length) return;
+
+        auto f = std::find_if(torrent.files.begin(), torrent.files.end(),
+                              [&](const FileEntry& e) { return e.length > 0 && e.pieces_root == root; });
+        if (f == torrent.files.end()) return;
+        int64_t start = f->offset + (int64_t)index * BLOCK_SIZE;
+        if (start >= f->offset + f->length || (start - f->offset) % torrent.piece_length != 0) return;
+        int piece = start / torrent.piece_length;
+
+        // Only leaves that hash up to what the torrent itself says are worth anything
+        Sha256Digest target;
+        size_t width;
+        if (!MerkleTree::PieceTarget(torrent, piece, target, width) || width != length) return;
+        std::vector<Sha256Digest> leaves(length);
+        std::memcpy(leaves.data(), payload.data() + 48, length * 32);
+        if (MerkleTree::Root(leaves, width) != target) {
+            std::cerr << "\n[Integrity] Leaf hashes for Piece " << piece << " don't match the torrent.\n";
+            return;
+        }
+        leaves.resize((torrent.PieceSize(piece) + BLOCK_SIZE - 1) / BLOCK_SIZE); // Drop the padding
+        piece_leaves[piece] = std::move(leaves);
+    }
+
+    int64_t Downloader::NextMissingBlock(int piece, int64_t from) const {
+        auto it = active_pieces.find(piece);
+        if (it == active_pieces.end()) return from;
+        const PieceState& p = it->second;
+        while (from < (int64_t)p.data.size() && ((size_t)from < p.hashed || p.held.count(from))) from += BLOCK_SIZE;
+        return from;
+    }
+
+    void Downloader::OnPiecesVerified() {
+        for (VerifyResult& r : verifier.Drain()) {
+            if (r.ok) {
+                // SUCCESS: Only verified data ever reaches the disk
+                downloaded_bytes += r.data.size();
+                file_writer.add(r.data, r.offset);
             } else {
-                // FAILURE: Discard
-                std::cerr << "\n[Integrity] HASH MISMATCH on Piece " << piece_index << "! Discarding.\n";
-                std::cerr << "Expected: " << expected_hash << "\n";
-                std::cerr << "Got:      " << calculated_hash << "\n";
-                
-                // In Phase 2, we would re-queue this piece. 
-                // For now, we just lose it (File will be incomplete).
+                // FAILURE: Discard, and hand the piece out again
+                completed_pieces[r.piece] = false;
+                RetryPiece(r.piece);
+                std::cerr << "\n[Integrity] HASH MISMATCH on Piece " << r.piece << "! Discarding.\n";
+                std::cerr << "Expected: " << ToHex(r.expected.data(), r.expected.size()) << "\n";
+                std::cerr << "Got:      " << ToHex(r.actual.data(), r.actual.size()) << "\n";
             }
         }
     }
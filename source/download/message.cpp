@@ -1,4 +1,6 @@
 #include "download/Message.h"
+#include "parsing/Bnode.h"
+#include <algorithm>
 #include <cstring>
 #include <iterator>
 // just a traslator to network form local and vice versa
@@ -22,8 +24,11 @@ namespace BitTorrent {
         std::string proto = "BitTorrent protocol"; // proto.size=19 
         hs.insert(hs.end(), proto.begin(), proto.end());
         
-        // 3. Reserved (8 bytes of zeros)
+        // 3. Reserved (8 bytes of zeros, plus the v2 bit if the torrent has v2 hashes, and
+        //    the extension protocol bit so the peer tells us its 'reqq')
         for(int i=0; i<8; i++) hs.push_back(0); 
+        if (t.HasV2()) hs.back() |= RESERVED_V2;
+        hs[20 + 5] |= RESERVED_EXTENSIONS;
         
         // 4. Info Hash (20 bytes) - From the parsing module
         // "I want the file with THIS ID".
@@ -72,6 +77,79 @@ namespace BitTorrent {
         return b;
     }
 
+    Buffer Message::BuildCancel(uint32_t index, uint32_t begin, uint32_t length) {
+        Buffer b = BuildRequest(index, begin, length); // Same layout, other ID
+        b[4] = CANCEL;
+        return b;
+    }
+
+    Buffer Message::BuildExtendedHandshake() {
+        BDict root;
+        root["m"] = Bnode(BDict()); // No extension messages on offer
+        Buffer body = Bnode::Encode(Bnode(std::move(root)));
+        Buffer b;
+        PushInt32(b, 2 + body.size());
+        b.push_back(EXTENDED);
+        b.push_back(EXTENDED_HANDSHAKE);
+        b.insert(b.end(), body.begin(), body.end());
+        return b;
+    }
+
+    Buffer Message::BuildPiece(uint32_t index, uint32_t begin, const uint8_t* data, size_t size) {
+        Buffer b;
+        b.reserve(13 + size);
+        PushInt32(b, 9 + size); // ID + Index + Begin + Block
+        b.push_back(PIECE);
+        PushInt32(b, index);
+        PushInt32(b, begin);
+        b.insert(b.end(), data, data + size);
+        return b;
+    }
+
+    Buffer Message::BuildBitfield(const std::vector<bool>& have) {
+        Buffer b;
+        size_t bytes = (have.size() + 7) / 8;
+        PushInt32(b, 1 + bytes);
+        b.push_back(BITFIELD);
+        b.resize(5 + bytes, 0);
+        for (size_t i = 0; i < have.size(); ++i) {
+            if (have[i]) b[5 + i / 8] |= 0x80 >> (i % 8); // Piece 0 is the high bit
+        }
+        return b;
+    }
+
+    // Shared layout of hash request / hashes / hash reject
+    static Buffer BuildHashMessage(uint8_t id, const Sha256Digest& root, uint32_t base_layer, uint32_t index,
+                                   uint32_t length, uint32_t proof_layers, size_t extra) {
+        Buffer b;
+        b.reserve(4 + 49 + extra);
+        PushInt32(b, 49 + extra); // ID + root(32) + 4 x uint32
+        b.push_back(id);
+        b.insert(b.end(), root.begin(), root.end());
+        PushInt32(b, base_layer);
+        PushInt32(b, index);
+        PushInt32(b, length);
+        PushInt32(b, proof_layers);
+        return b;
+    }
+
+    Buffer Message::BuildHashRequest(const Sha256Digest& root, uint32_t base_layer, uint32_t index,
+                                     uint32_t length, uint32_t proof_layers) {
+        return BuildHashMessage(HASH_REQUEST, root, base_layer, index, length, proof_layers, 0);
+    }
+
+    Buffer Message::BuildHashes(const Sha256Digest& root, uint32_t base_layer, uint32_t index,
+                                uint32_t length, uint32_t proof_layers, const std::vector<Sha256Digest>& hashes) {
+        Buffer b = BuildHashMessage(HASHES, root, base_layer, index, length, proof_layers, hashes.size() * 32);
+        for (const auto& h : hashes) b.insert(b.end(), h.begin(), h.end());
+        return b;
+    }
+
+    Buffer Message::BuildHashReject(const Sha256Digest& root, uint32_t base_layer, uint32_t index,
+                                    uint32_t length, uint32_t proof_layers) {
+        return BuildHashMessage(HASH_REJECT, root, base_layer, index, length, proof_layers, 0);
+    }
+
     uint32_t Message::ReadMessageLength(const Buffer& b) {
         if(b.size() < 4) return 0;
         // Reconstruct the integer from 4 bytes (Big Endian -> Host Endian)
@@ -82,6 +160,23 @@ namespace BitTorrent {
         if(b.size() < 5) return 0; // Should check length first
         return b[4];
     }
+
+    bool Message::SupportsExtensions(const Buffer& handshake) {
+        return handshake.size() >= 68 && (handshake[20 + 5] & RESERVED_EXTENSIONS);
+    }
+
+    int Message::ReadReqq(const Buffer& payload) {
+        if(payload.size() < 2 || payload[0] != EXTENDED_HANDSHAKE) return 0;
+        try {
+            Bnode root = Bnode::Decode(Buffer(payload.begin() + 1, payload.end()));
+            if(!root.IsDict() || !root.GetDict().count("reqq")) return 0;
+            const Bnode& reqq = root.GetDict().at("reqq");
+            if(!reqq.IsInt() || reqq.GetInt() <= 0) return 0;
+            return (int)std::min<BInt>(reqq.GetInt(), 1 << 16);
+        } catch(const std::exception&) {
+            return 0; // Malformed: as if it said nothing
+        }
+    }
     // Scenario:
     // We read 4 bytes: 00 00 40 09 (Hex for 16393).
     // ReadMessageLength returns 16393.
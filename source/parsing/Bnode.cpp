@@ -2,17 +2,51 @@
 #include <stdexcept>
 #include <iostream>
 #include <algorithm>
+#include <charconv>
 
 namespace BitTorrent {
 
-    Bnode Bnode::Decode(const Buffer& data) {
+    Bnode Bnode::Decode(const Buffer& data, std::pmr::memory_resource* mr) {
         size_t index = 0;
-        return DecodeElement(data, index);
+        return DecodeElement(data, index, mr);
     }
 
-    Bnode Bnode::DecodeElement(const Buffer& data, size_t& index) {
+    // Local Helper: parse [begin, end) as a decimal integer in place (no temporary string)
+    static int64_t ParseInt(const Buffer& data, size_t begin, size_t end, const char* error) {
+        int64_t value = 0;
+        const char* first = (const char*)data.data() + begin;
+        const char* last = (const char*)data.data() + end;
+        auto res = std::from_chars(first, last, value);
+        if (res.ec != std::errc() || res.ptr != last) throw std::runtime_error(error);
+        return value;
+    }
+
+    // Local Helper: reads "<len>:<bytes>" at index, returns a view of the bytes
+    static std::string_view ReadString(const Buffer& data, size_t& index) {
+        size_t colon = index;
+        while (colon < data.size() && data[colon] != ':') colon++;
+        if (colon >= data.size()) throw std::runtime_error("Invalid String length");
+
+        int64_t len = ParseInt(data, index, colon, "Invalid String length");
+
+        size_t body = colon + 1;
+        if (len < 0 || (size_t)len > data.size() - body) throw std::runtime_error("String length out of bounds");
+
+        index = body + len;
+        return std::string_view((const char*)data.data() + body, len);
+    }
+
+    Bnode Bnode::DecodeElement(const Buffer& data, size_t& index, std::pmr::memory_resource* mr) {
         if (index >= data.size()) throw std::runtime_error("Unexpected end of buffer");
 
+        // Stamp the node with the exact byte range it was decoded from
+        size_t start = index;
+        auto spanned = [&](Bnode node) {
+            node.raw_begin = start;
+            node.raw_end = index;
+            return node;
+        };
+
         char c = (char)data[index];
 
         // 1. Integer: starts with 'i', ends with 'e'
@@ -22,95 +56,94 @@ namespace BitTorrent {
             while (end < data.size() && data[end] != 'e') end++;
             if (end >= data.size()) throw std::runtime_error("Invalid Integer");
 
-            std::string numStr(data.begin() + index, data.begin() + end);
+            BInt num = ParseInt(data, index, end, "Invalid Integer");
             index = end + 1; // skip 'e'
-            return Bnode(std::stoll(numStr));
+            return spanned(Bnode(num));
         }
 
         // 2. List: starts with 'l', ends with 'e'
         else if (c == 'l') {
             index++; // skip 'l'
-            BList list;
+            BList list(mr);
             while (index < data.size() && data[index] != 'e') {
-                list.push_back(DecodeElement(data, index));
+                list.push_back(DecodeElement(data, index, mr));
             }
             if (index >= data.size()) throw std::runtime_error("Unclosed List");
             index++; // skip 'e'
-            return Bnode(list);
+            return spanned(Bnode(std::move(list)));
         }
 
         // 3. Dictionary: starts with 'd', ends with 'e'
         else if (c == 'd') {
             index++; // skip 'd'
-            BDict dict;
+            BDict dict(mr);
             while (index < data.size() && data[index] != 'e') {
-                // Keys must be strings
-                Bnode keyNode = DecodeElement(data, index);
-                if (!keyNode.IsString()) throw std::runtime_error("Dict key must be string");
-                std::string key = keyNode.ToString(); // Convert Key Buffer to std::string
-                Bnode val = DecodeElement(data, index);
-                dict[key] = val;
+                // Keys must be strings (read as a view, copied once into the dict's own storage)
+                if (!isdigit(data[index])) throw std::runtime_error("Dict key must be string");
+                std::string_view key = ReadString(data, index);
+                dict[key] = DecodeElement(data, index, mr);
             }
             if (index >= data.size()) throw std::runtime_error("Unclosed Dictionary");
             index++; // skip 'e'
-            return Bnode(dict);
+            return spanned(Bnode(std::move(dict)));
         }
 
         // 4. String: starts with "length:", e.g. "4:spam"
         else if (isdigit(c)) {
-            size_t colon = index;
-            while (colon < data.size() && data[colon] != ':') colon++;
-            if (colon >= data.size()) throw std::runtime_error("Invalid String length");
-
-            std::string lenStr(data.begin() + index, data.begin() + colon);
-            long long len = std::stoll(lenStr);
-            
-            size_t start = colon + 1;
-            if (start + len > data.size()) throw std::runtime_error("String length out of bounds");
-
-            // CHANGE: Copy into Buffer, not std::string
-            Buffer val(data.begin() + start, data.begin() + start + len);
-            
-            index = start + len;
-            return Bnode(val);
+            std::string_view bytes = ReadString(data, index);
+
+            // Copy into the arena-backed byte string
+            BString val(bytes.begin(), bytes.end(), mr);
+            return spanned(Bnode(std::move(val)));
         }
 
         throw std::runtime_error("Unknown Bencode type");
     }
 
-    // Encoding (Needed for hashing the 'info' dictionary)
+    // Encoding
+    // Pass 1 (EncodedSize) walks the tree once to get the exact byte count, so the output is
+    // allocated once and every byte is written exactly once by EncodeTo.
     Buffer Bnode::Encode(const Bnode& node) {
-        Buffer out;
-        if (node.IsInt()) {
-            std::string s = "i" + std::to_string(node.GetInt()) + "e";
-            out.insert(out.end(), s.begin(), s.end());
+        Buffer out(EncodedSize(node));
+        EncodeTo(node, out.data());
+        return out;
+    }
+
+    void Bnode::Encode(const Bnode& node, Buffer& out) {
+        size_t at = out.size();
+        out.resize(at + EncodedSize(node));
+        EncodeTo(node, out.data() + at);
+    }
+
+    size_t Bnode::IntLength(int64_t v) {
+        size_t n = v < 0 ? 2 : 1; // '-' plus at least one digit
+        uint64_t u = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+        while (u >= 10) { u /= 10; n++; }
+        return n;
+    }
+
+    size_t Bnode::EncodedSize(const Bnode& node) {
+        switch (node.value.index()) {
+        case 0: // i<n>e
+            return IntLength(std::get<BInt>(node.value)) + 2;
+        case 1: { // <len>:<bytes>
+            size_t len = std::get<BString>(node.value).size();
+            return IntLength((int64_t)len) + 1 + len;
         }
-        else if (node.IsString()) {
-            std::string val = node.ToString();
-            std::string s = std::to_string(val.length()) + ":" + val;
-            out.insert(out.end(), s.begin(), s.end());
+        case 2: { // l...e
+            size_t size = 2;
+            for (const auto& item : std::get<BList>(node.value)) size += EncodedSize(item);
+            return size;
         }
-        else if (node.IsList()) {
-            out.push_back('l');
-            for (const auto& item : node.GetList()) {
-                Buffer sub = Encode(item);
-                out.insert(out.end(), sub.begin(), sub.end());
+        case 3: { // d...e
+            size_t size = 2;
+            for (const auto& pair : std::get<BDict>(node.value)) {
+                size += IntLength((int64_t)pair.first.size()) + 1 + pair.first.size();
+                size += EncodedSize(pair.second);
             }
-            out.push_back('e');
+            return size;
         }
-        else if (node.IsDict()) {
-            out.push_back('d');
-            for (const auto& pair : node.GetDict()) {
-                // Encode key (string)
-                std::string kLen = std::to_string(pair.first.length()) + ":" + pair.first;
-                out.insert(out.end(), kLen.begin(), kLen.end());
-                
-                // Encode Value
-                Buffer sub = Encode(pair.second);
-                out.insert(out.end(), sub.begin(), sub.end());
-            }
-            out.push_back('e');
         }
-        return out;
+        return 0;
     }
 }
\ No newline at end of file
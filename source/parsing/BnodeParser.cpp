@@ -0,0 +1,153 @@
+#include "parsing/BnodeParser.h"
+#include <stdexcept>
+#include <cctype>
+
+namespace BitTorrent {
+
+    static constexpr size_t MAX_DEPTH = 512;
+
+    void BnodeParser::Feed(const uint8_t* p, size_t size) {
+        const uint8_t* end = p + size;
+
+        while (p < end) {
+            if (done) throw std::runtime_error("Trailing data after bencode value");
+
+            switch (state) {
+            case VALUE: {
+                char c = (char)*p;
+                bool inDict = !stack.empty() && stack.back().is_dict;
+
+                if (c == 'e') {
+                    if (stack.empty()) throw std::runtime_error("Unknown Bencode type");
+                    if (inDict && !stack.back().expecting_key) throw std::runtime_error("Dict key without value");
+                    stack.pop_back();
+                    p++;
+                    handler.OnEnd();
+                    ValueDone();
+                    break;
+                }
+                if (inDict && stack.back().expecting_key && !isdigit(c)) {
+                    throw std::runtime_error("Dict key must be string");
+                }
+
+                if (c == 'i') {
+                    state = INT;
+                    number = 0; negative = false; digits = 0;
+                    p++;
+                } else if (c == 'l' || c == 'd') {
+                    if (stack.size() >= MAX_DEPTH) throw std::runtime_error("Bencode nested too deeply");
+                    stack.push_back({c == 'd', true});
+                    p++;
+                    if (c == 'd') handler.OnDictBegin();
+                    else handler.OnListBegin();
+                } else if (isdigit(c)) {
+                    state = STR_LEN;
+                    number = 0; digits = 0;
+                } else {
+                    throw std::runtime_error("Unknown Bencode type");
+                }
+                break;
+            }
+
+            case INT:
+            case STR_LEN: {
+                // Accumulate digits across chunk boundaries; no temporary string, no stoll
+                char terminator = state == INT ? 'e' : ':';
+                while (p < end && *p != terminator) {
+                    if (state == INT && *p == '-' && digits == 0 && !negative) { negative = true; p++; continue; }
+                    if (*p < '0' || *p > '9') {
+                        throw std::runtime_error(state == INT ? "Invalid Integer" : "Invalid String length");
+                    }
+                    if (number > (uint64_t)INT64_MAX / 10) throw std::runtime_error("Integer overflow");
+                    number = number * 10 + (*p - '0');
+                    digits++;
+                    p++;
+                }
+                if (p == end) break; // Number continues in the next chunk
+                p++; // skip terminator
+
+                if (digits == 0) throw std::runtime_error(state == INT ? "Invalid Integer" : "Invalid String length");
+                if (number > (uint64_t)INT64_MAX) throw std::runtime_error("Integer overflow");
+
+                if (state == INT) {
+                    state = VALUE;
+                    handler.OnInt(negative ? -(int64_t)number : (int64_t)number);
+                    ValueDone();
+                } else if (number == 0) {
+                    state = VALUE;
+                    EmitString(std::string_view());
+                } else {
+                    state = STR_BODY;
+                    remaining = number;
+                }
+                break;
+            }
+
+            case STR_BODY: {
+                size_t avail = end - p;
+                // Fast path: the whole string is inside this chunk, hand out a view
+                if (pending.empty() && avail >= remaining) {
+                    std::string_view s((const char*)p, remaining);
+                    p += remaining;
+                    state = VALUE;
+                    EmitString(s);
+                    break;
+                }
+                // Slow path: stash the part we have, wait for the rest
+                size_t take = avail < remaining ? avail : remaining;
+                pending.insert(pending.end(), p, p + take);
+                p += take;
+                remaining -= take;
+                if (remaining == 0) {
+                    state = VALUE;
+                    EmitString(std::string_view((const char*)pending.data(), pending.size()));
+                    pending.clear();
+                }
+                break;
+            }
+            }
+        }
+    }
+
+    void BnodeParser::EmitString(std::string_view s) {
+        if (!stack.empty() && stack.back().is_dict && stack.back().expecting_key) {
+            stack.back().expecting_key = false;
+            handler.OnKey(s);
+            return;
+        }
+        handler.OnString(s);
+        ValueDone();
+    }
+
+    // A value (scalar or closed container) just finished
+    void BnodeParser::ValueDone() {
+        if (stack.empty()) done = true;
+        else if (stack.back().is_dict) stack.back().expecting_key = true;
+    }
+
+    // --- BnodeBuilder ---
+
+    void BnodeBuilder::OnString(std::string_view value) {
+        Attach(Bnode(BString(value.begin(), value.end(), mr)));
+    }
+
+    void BnodeBuilder::OnEnd() {
+        Bnode node = std::move(open.back());
+        open.pop_back();
+        Attach(std::move(node));
+    }
+
+    void BnodeBuilder::Attach(Bnode node) {
+        if (open.empty()) {
+            root = std::move(node);
+            return;
+        }
+        Bnode& parent = open.back();
+        if (parent.IsList()) {
+            std::get<BList>(parent.value).push_back(std::move(node));
+        } else {
+            std::get<BDict>(parent.value)[keys.back()] = std::move(node);
+            keys.pop_back();
+        }
+    }
+}
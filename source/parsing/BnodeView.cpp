@@ -0,0 +1,140 @@
+#include "parsing/BnodeView.h"
+#include <cstring>
+
+namespace BitTorrent {
+
+    // Deeper than any real torrent or tracker reply; stops a hostile input from blowing the stack
+    static constexpr int MAX_DEPTH = 512;
+
+    BnodeView BnodeView::Decode(const Buffer& data) {
+        return Decode(data.data(), data.size());
+    }
+
+    BnodeView BnodeView::Decode(const uint8_t* data, size_t size) {
+        if (size == 0) throw std::runtime_error("Unexpected end of buffer");
+        // One validating pass over the input. After this every view is known to be well formed.
+        const uint8_t* end = Skip(data, data + size, 0);
+        return BnodeView(data, end - data);
+    }
+
+    // Parses [-]digits in place, without building a std::string for stoll
+    int64_t BnodeView::ParseInt(const uint8_t* p, const uint8_t* end) {
+        bool negative = false;
+        if (p < end && *p == '-') { negative = true; p++; }
+        if (p == end) throw std::runtime_error("Invalid Integer");
+
+        uint64_t value = 0;
+        for (; p < end; p++) {
+            if (*p < '0' || *p > '9') throw std::runtime_error("Invalid Integer");
+            if (value > (UINT64_MAX - 9) / 10) throw std::runtime_error("Integer overflow");
+            value = value * 10 + (*p - '0');
+        }
+        if (value > (uint64_t)INT64_MAX + (negative ? 1 : 0)) throw std::runtime_error("Integer overflow");
+        return negative ? (int64_t)(0 - value) : (int64_t)value;
+    }
+
+    const uint8_t* BnodeView::Skip(const uint8_t* p, const uint8_t* end, int depth) {
+        if (p >= end) throw std::runtime_error("Unexpected end of buffer");
+        if (depth > MAX_DEPTH) throw std::runtime_error("Bencode nested too deeply");
+
+        char c = (char)*p;
+
+        // 1. Integer: i<digits>e
+        if (c == 'i') {
+            const uint8_t* e = (const uint8_t*)memchr(p + 1, 'e', end - (p + 1));
+            if (!e) throw std::runtime_error("Invalid Integer");
+            ParseInt(p + 1, e);
+            return e + 1;
+        }
+
+        // 2. List: l<items>e
+        if (c == 'l') {
+            p++;
+            while (p < end && *p != 'e') p = Skip(p, end, depth + 1);
+            if (p >= end) throw std::runtime_error("Unclosed List");
+            return p + 1;
+        }
+
+        // 3. Dictionary: d<key><value>...e
+        if (c == 'd') {
+            p++;
+            while (p < end && *p != 'e') {
+                if (*p < '0' || *p > '9') throw std::runtime_error("Dict key must be string");
+                p = Skip(p, end, depth + 1);
+                p = Skip(p, end, depth + 1);
+            }
+            if (p >= end) throw std::runtime_error("Unclosed Dictionary");
+            return p + 1;
+        }
+
+        // 4. String: <length>:<bytes>
+        if (c >= '0' && c <= '9') {
+            const uint8_t* colon = (const uint8_t*)memchr(p, ':', end - p);
+            if (!colon) throw std::runtime_error("Invalid String length");
+            int64_t n = ParseInt(p, colon);
+            if (n < 0 || n > end - (colon + 1)) throw std::runtime_error("String length out of bounds");
+            return colon + 1 + n;
+        }
+
+        throw std::runtime_error("Unknown Bencode type");
+    }
+
+    BnodeView::Type BnodeView::GetType() const {
+        if (IsInt()) return INT;
+        if (IsList()) return LIST;
+        if (IsDict()) return DICT;
+        if (IsString()) return STRING;
+        throw std::runtime_error("Empty BnodeView");
+    }
+
+    int64_t BnodeView::GetInt() const {
+        if (!IsInt()) throw std::runtime_error("Type mismatch: Expected Int");
+        return ParseInt(ptr + 1, ptr + len - 1);
+    }
+
+    std::string_view BnodeView::GetString() const {
+        if (!IsString()) throw std::runtime_error("Type mismatch: Expected String");
+        const uint8_t* colon = (const uint8_t*)memchr(ptr, ':', len);
+        const uint8_t* start = colon + 1;
+        return std::string_view((const char*)start, (ptr + len) - start);
+    }
+
+    size_t BnodeView::Count() const {
+        size_t n = 0;
+        ForEach([&n](BnodeView) { n++; });
+        return n;
+    }
+
+    BnodeView BnodeView::operator[](size_t index) const {
+        if (!IsList()) throw std::runtime_error("Type mismatch: Expected List");
+        const uint8_t* p = ptr + 1;
+        const uint8_t* end = ptr + len - 1;
+        for (size_t i = 0; p < end; i++) {
+            const uint8_t* next = Skip(p, end, 0);
+            if (i == index) return BnodeView(p, next - p);
+            p = next;
+        }
+        throw std::out_of_range("List index out of range");
+    }
+
+    BnodeView BnodeView::Find(std::string_view key) const {
+        if (!IsDict()) throw std::runtime_error("Type mismatch: Expected Dict");
+        const uint8_t* p = ptr + 1;
+        const uint8_t* end = ptr + len - 1;
+        while (p < end) {
+            const uint8_t* valStart = Skip(p, end, 0);
+            const uint8_t* next = Skip(valStart, end, 0);
+            if (BnodeView(p, valStart - p).GetString() == key) {
+                return BnodeView(valStart, next - valStart);
+            }
+            p = next; // skip the whole subtree without decoding it
+        }
+        return BnodeView();
+    }
+
+    BnodeView BnodeView::At(std::string_view key) const {
+        BnodeView v = Find(key);
+        if (!v) throw std::runtime_error("Missing key: " + std::string(key));
+        return v;
+    }
+}
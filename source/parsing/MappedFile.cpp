@@ -0,0 +1,51 @@
+#include "parsing/MappedFile.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <utility>
+
+namespace BitTorrent {
+
+    MappedFile::MappedFile(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw std::runtime_error("Cannot open file: " + path);
+
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            close(fd);
+            throw std::runtime_error("Cannot stat file: " + path);
+        }
+
+        // mmap(2) refuses zero-length mappings; an empty file is simply an empty view
+        if (st.st_size > 0) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Cannot map file: " + path);
+            }
+            // We read front to back, so tell the kernel to read ahead aggressively
+            madvise(p, st.st_size, MADV_SEQUENTIAL);
+            ptr = (const uint8_t*)p;
+            len = st.st_size;
+        }
+        close(fd); // The mapping keeps its own reference to the file
+    }
+
+    MappedFile::~MappedFile() {
+        if (ptr) munmap((void*)ptr, len);
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+        : ptr(std::exchange(other.ptr, nullptr)), len(std::exchange(other.len, 0)) {}
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            if (ptr) munmap((void*)ptr, len);
+            ptr = std::exchange(other.ptr, nullptr);
+            len = std::exchange(other.len, 0);
+        }
+        return *this;
+    }
+}
@@ -0,0 +1,137 @@
+#include "parsing/Merkle.h"
+#include <openssl/sha.h>
+#include <algorithm>
+#include <cstring>
+
+namespace BitTorrent {
+
+    Sha256Digest MerkleTree::HashBlock(const uint8_t* data, size_t size) {
+        Sha256Digest d;
+        SHA256(data, size, d.data());
+        return d;
+    }
+
+    Sha256Digest MerkleTree::HashPair(const Sha256Digest& left, const Sha256Digest& right) {
+        uint8_t both[64];
+        std::memcpy(both, left.data(), 32);
+        std::memcpy(both + 32, right.data(), 32);
+        return HashBlock(both, sizeof(both));
+    }
+
+    size_t MerkleTree::NextPow2(size_t n) {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    Sha256Digest MerkleTree::PadRoot(size_t width) {
+        Sha256Digest node{};
+        for (; width > 1; width >>= 1) node = HashPair(node, node);
+        return node;
+    }
+
+    Sha256Digest MerkleTree::Root(std::vector<Sha256Digest> layer, size_t width) {
+        if (width == 0 || layer.size() > width) return Sha256Digest{};
+        // Collapse one layer at a time; past the data, siblings are roots of all-padding subtrees
+        Sha256Digest pad{};
+        for (; width > 1; width >>= 1) {
+            if (layer.size() % 2) layer.push_back(pad);
+            for (size_t i = 0; i < layer.size() / 2; ++i) layer[i] = HashPair(layer[2 * i], layer[2 * i + 1]);
+            layer.resize(layer.size() / 2);
+            pad = HashPair(pad, pad);
+        }
+        return layer.empty() ? pad : layer[0];
+    }
+
+    std::vector<Sha256Digest> MerkleTree::BlockHashes(const uint8_t* data, size_t size) {
+        std::vector<Sha256Digest> leaves;
+        leaves.reserve((size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+        for (size_t off = 0; off < size; off += BLOCK_SIZE) {
+            leaves.push_back(HashBlock(data + off, std::min(BLOCK_SIZE, size - off)));
+        }
+        return leaves;
+    }
+
+    Sha256Digest MerkleTree::FileRoot(const uint8_t* data, size_t size, int64_t piece_length,
+                                      std::vector<Sha256Digest>* piece_layer) {
+        if (piece_layer) piece_layer->clear();
+        std::vector<Sha256Digest> leaves = BlockHashes(data, size);
+        size_t per_piece = (size_t)piece_length / BLOCK_SIZE;
+
+        if (size <= (size_t)piece_length) return Root(std::move(leaves), NextPow2(leaves.size()));
+
+        // Piece layer first, then the rest of the tree from it (same root either way)
+        std::vector<Sha256Digest> layer;
+        for (size_t i = 0; i < leaves.size(); i += per_piece) {
+            std::vector<Sha256Digest> part(leaves.begin() + i, leaves.begin() + std::min(leaves.size(), i + per_piece));
+            layer.push_back(Root(std::move(part), per_piece));
+        }
+        if (piece_layer) *piece_layer = layer;
+
+        // Padding at this level is a whole subtree of zero leaves
+        Sha256Digest pad = PadRoot(per_piece);
+        size_t width = NextPow2(layer.size());
+        layer.resize(width, pad);
+        for (; width > 1; width >>= 1) {
+            for (size_t i = 0; i < width / 2; ++i) layer[i] = HashPair(layer[2 * i], layer[2 * i + 1]);
+        }
+        return layer[0];
+    }
+
+    bool MerkleTree::PieceFileRange(const TorrentFile& tf, size_t piece, const FileEntry*& file, int64_t& begin, int64_t& size) {
+        int64_t start = (int64_t)piece * tf.piece_length;
+        int64_t end = start + tf.PieceSize(piece);
+        // v2 pieces cover at most one file; in a hybrid the rest of the piece is padding
+        for (int64_t pos = start; pos < end; ) {
+            if (const FileEntry* f = tf.FileAt(pos)) {
+                file = f;
+                begin = pos;
+                size = std::min(end, f->offset + f->length) - pos;
+                return true;
+            }
+            // Skip over padding to the next file
+            auto next = std::upper_bound(tf.files.begin(), tf.files.end(), pos,
+                                         [](int64_t off, const FileEntry& e) { return off < e.offset; });
+            if (next == tf.files.end()) break;
+            pos = next->offset;
+        }
+        return false;
+    }
+
+    bool MerkleTree::PieceTarget(const TorrentFile& tf, size_t piece, Sha256Digest& root, size_t& width) {
+        const FileEntry* f;
+        int64_t begin, size;
+        if (!PieceFileRange(tf, piece, f, begin, size)) return false;
+
+        if (f->length <= tf.piece_length) {
+            root = f->pieces_root;
+            width = NextPow2((f->length + BLOCK_SIZE - 1) / BLOCK_SIZE);
+            return true;
+        }
+        size_t index = (begin - f->offset) / tf.piece_length;
+        if (index >= f->piece_layer.size()) return false;
+        root = f->piece_layer[index];
+        width = tf.piece_length / BLOCK_SIZE;
+        return true;
+    }
+
+    bool MerkleTree::VerifyPiece(const TorrentFile& tf, size_t piece, const uint8_t* data, size_t size) {
+        int64_t start = (int64_t)piece * tf.piece_length;
+        const FileEntry* f;
+        int64_t begin, len;
+        if (!PieceFileRange(tf, piece, f, begin, len)) {
+            return std::all_of(data, data + size, [](uint8_t b) { return b == 0; });
+        }
+        size_t skip = begin - start;
+        if (skip + len > size) return false;
+
+        // Whatever isn't file data must be padding (zeros)
+        if (!std::all_of(data, data + skip, [](uint8_t b) { return b == 0; })) return false;
+        if (!std::all_of(data + skip + len, data + size, [](uint8_t b) { return b == 0; })) return false;
+
+        Sha256Digest root;
+        size_t width;
+        if (!PieceTarget(tf, piece, root, width)) return false;
+        return Root(BlockHashes(data + skip, len), width) == root;
+    }
+}
@@ -0,0 +1,410 @@
+#include "parsing/Sha1.h"
+#include <openssl/evp.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHA1_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace BitTorrent {
+
+    static const uint32_t INITIAL_STATE[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+    static inline uint32_t Rol(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+    static inline uint32_t LoadBE32(const uint8_t* p) {
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+    }
+
+    // The 80 rounds over an already expanded message schedule
+    static inline void Rounds(uint32_t h[5], const uint32_t w[80]) {
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        // One loop per round function, so no per-round branch
+#define SHA1_ROUND(F, K)                                    \
+        {                                                   \
+            uint32_t tmp = Rol(a, 5) + (F) + e + (K) + w[t]; \
+            e = d; d = c; c = Rol(b, 30); b = a; a = tmp;   \
+        }
+        int t = 0;
+        for (; t < 20; ++t) SHA1_ROUND(d ^ (b & (c ^ d)), 0x5A827999)
+        for (; t < 40; ++t) SHA1_ROUND(b ^ c ^ d, 0x6ED9EBA1)
+        for (; t < 60; ++t) SHA1_ROUND((b & c) | (d & (b | c)), 0x8F1BBCDC)
+        for (; t < 80; ++t) SHA1_ROUND(b ^ c ^ d, 0xCA62C1D6)
+#undef SHA1_ROUND
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    static void CompressScalar(uint32_t h[5], const uint8_t* data, size_t blocks) {
+        uint32_t w[80];
+        for (; blocks > 0; --blocks, data += 64) {
+            for (int t = 0; t < 16; ++t) w[t] = LoadBE32(data + 4 * t);
+            for (int t = 16; t < 80; ++t) w[t] = Rol(w[t - 3] ^ w[t - 8] ^ w[t - 14] ^ w[t - 16], 1);
+            Rounds(h, w);
+        }
+    }
+
+#ifdef SHA1_X86
+    // Message schedule four words at a time. W[t+3] depends on W[t], which is only known once
+    // the vector is computed, so lane 3 is patched afterwards: rol1(x ^ W[t]) == rol1(x) ^ rol1(W[t]).
+    __attribute__((target("ssse3")))
+    static void CompressSsse3(uint32_t h[5], const uint8_t* data, size_t blocks) {
+        alignas(16) uint32_t w[80];
+        const __m128i bswap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+        for (; blocks > 0; --blocks, data += 64) {
+            for (int i = 0; i < 4; ++i) {
+                __m128i m = _mm_loadu_si128((const __m128i*)(data + 16 * i));
+                _mm_store_si128((__m128i*)(w + 4 * i), _mm_shuffle_epi8(m, bswap));
+            }
+            for (int t = 16; t < 80; t += 4) {
+                // [W[t-3], W[t-2], W[t-1], 0]
+                __m128i x = _mm_srli_si128(_mm_load_si128((const __m128i*)(w + t - 4)), 4);
+                x = _mm_xor_si128(x, _mm_load_si128((const __m128i*)(w + t - 8)));
+                x = _mm_xor_si128(x, _mm_loadu_si128((const __m128i*)(w + t - 14)));
+                x = _mm_xor_si128(x, _mm_load_si128((const __m128i*)(w + t - 16)));
+                __m128i r = _mm_or_si128(_mm_slli_epi32(x, 1), _mm_srli_epi32(x, 31));
+
+                __m128i fix = _mm_slli_si128(r, 12); // W[t] moved into lane 3
+                fix = _mm_or_si128(_mm_slli_epi32(fix, 1), _mm_srli_epi32(fix, 31));
+                _mm_store_si128((__m128i*)(w + t), _mm_xor_si128(r, fix));
+            }
+            Rounds(h, w);
+        }
+    }
+
+    // Four rounds with the SHA extensions. 'g' is the round group (0..19); the message
+    // registers rotate, so M is the current one and M1..M3 the next three.
+#define SHA1_NI_ROUNDS4(g, E_CUR, E_NEXT, M, M1, M2, M3)                    \
+    E_CUR = _mm_sha1nexte_epu32(E_CUR, M);                                  \
+    E_NEXT = abcd;                                                          \
+    if ((g) >= 3 && (g) <= 18) M1 = _mm_sha1msg2_epu32(M1, M);              \
+    abcd = _mm_sha1rnds4_epu32(abcd, E_CUR, (g) / 5);                       \
+    if ((g) >= 1 && (g) <= 16) M3 = _mm_sha1msg1_epu32(M3, M);              \
+    if ((g) >= 2 && (g) <= 17) M2 = _mm_xor_si128(M2, M);
+
+    __attribute__((target("sha,sse4.1")))
+    static void CompressShaNi(uint32_t h[5], const uint8_t* data, size_t blocks) {
+        const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+        __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)h), 0x1B);
+        __m128i e0 = _mm_set_epi32((int)h[4], 0, 0, 0);
+        __m128i e1, m0, m1, m2, m3;
+
+        for (; blocks > 0; --blocks, data += 64) {
+            __m128i abcd_save = abcd, e0_save = e0;
+
+            m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 0)), bswap);
+            e0 = _mm_add_epi32(e0, m0);
+            e1 = abcd;
+            abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+            m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16)), bswap);
+            SHA1_NI_ROUNDS4(1, e1, e0, m1, m2, m3, m0)
+            m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 32)), bswap);
+            SHA1_NI_ROUNDS4(2, e0, e1, m2, m3, m0, m1)
+            m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 48)), bswap);
+            SHA1_NI_ROUNDS4(3, e1, e0, m3, m0, m1, m2)
+            SHA1_NI_ROUNDS4(4, e0, e1, m0, m1, m2, m3)
+            SHA1_NI_ROUNDS4(5, e1, e0, m1, m2, m3, m0)
+            SHA1_NI_ROUNDS4(6, e0, e1, m2, m3, m0, m1)
+            SHA1_NI_ROUNDS4(7, e1, e0, m3, m0, m1, m2)
+            SHA1_NI_ROUNDS4(8, e0, e1, m0, m1, m2, m3)
+            SHA1_NI_ROUNDS4(9, e1, e0, m1, m2, m3, m0)
+            SHA1_NI_ROUNDS4(10, e0, e1, m2, m3, m0, m1)
+            SHA1_NI_ROUNDS4(11, e1, e0, m3, m0, m1, m2)
+            SHA1_NI_ROUNDS4(12, e0, e1, m0, m1, m2, m3)
+            SHA1_NI_ROUNDS4(13, e1, e0, m1, m2, m3, m0)
+            SHA1_NI_ROUNDS4(14, e0, e1, m2, m3, m0, m1)
+            SHA1_NI_ROUNDS4(15, e1, e0, m3, m0, m1, m2)
+            SHA1_NI_ROUNDS4(16, e0, e1, m0, m1, m2, m3)
+            SHA1_NI_ROUNDS4(17, e1, e0, m1, m2, m3, m0)
+            SHA1_NI_ROUNDS4(18, e0, e1, m2, m3, m0, m1)
+            SHA1_NI_ROUNDS4(19, e1, e0, m3, m0, m1, m2)
+
+            e0 = _mm_sha1nexte_epu32(e0, e0_save);
+            abcd = _mm_add_epi32(abcd, abcd_save);
+        }
+
+        _mm_storeu_si128((__m128i*)h, _mm_shuffle_epi32(abcd, 0x1B));
+        h[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+    }
+#undef SHA1_NI_ROUNDS4
+
+    // Eight messages at once, message i in lane i of every register
+    __attribute__((target("avx2")))
+    static void CompressLanes(__m256i h[5], const uint8_t* const blocks[Sha1::LANES]) {
+        __m256i w[16];
+        for (int t = 0; t < 16; ++t) {
+            w[t] = _mm256_setr_epi32((int)LoadBE32(blocks[0] + 4 * t), (int)LoadBE32(blocks[1] + 4 * t),
+                                     (int)LoadBE32(blocks[2] + 4 * t), (int)LoadBE32(blocks[3] + 4 * t),
+                                     (int)LoadBE32(blocks[4] + 4 * t), (int)LoadBE32(blocks[5] + 4 * t),
+                                     (int)LoadBE32(blocks[6] + 4 * t), (int)LoadBE32(blocks[7] + 4 * t));
+        }
+
+        __m256i a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+#define ROL256(x, n) _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - (n)))
+#define SHA1_LANE_ROUND(F, K)                                                                   \
+        {                                                                                       \
+            if (t >= 16) {                                                                      \
+                __m256i x = _mm256_xor_si256(_mm256_xor_si256(w[(t - 3) & 15], w[(t - 8) & 15]), \
+                                             _mm256_xor_si256(w[(t - 14) & 15], w[t & 15]));   \
+                w[t & 15] = ROL256(x, 1);                                                       \
+            }                                                                                   \
+            __m256i tmp = _mm256_add_epi32(_mm256_add_epi32(ROL256(a, 5), (F)),                 \
+                                           _mm256_add_epi32(_mm256_add_epi32(e, (K)), w[t & 15])); \
+            e = d; d = c; c = ROL256(b, 30); b = a; a = tmp;                                    \
+        }
+        const __m256i k0 = _mm256_set1_epi32(0x5A827999), k1 = _mm256_set1_epi32(0x6ED9EBA1);
+        const __m256i k2 = _mm256_set1_epi32((int)0x8F1BBCDC), k3 = _mm256_set1_epi32((int)0xCA62C1D6);
+        int t = 0;
+        for (; t < 20; ++t) SHA1_LANE_ROUND(_mm256_xor_si256(d, _mm256_and_si256(b, _mm256_xor_si256(c, d))), k0)
+        for (; t < 40; ++t) SHA1_LANE_ROUND(_mm256_xor_si256(_mm256_xor_si256(b, c), d), k1)
+        for (; t < 60; ++t) SHA1_LANE_ROUND(_mm256_or_si256(_mm256_and_si256(b, c), _mm256_and_si256(d, _mm256_or_si256(b, c))), k2)
+        for (; t < 80; ++t) SHA1_LANE_ROUND(_mm256_xor_si256(_mm256_xor_si256(b, c), d), k3)
+#undef SHA1_LANE_ROUND
+#undef ROL256
+
+        h[0] = _mm256_add_epi32(h[0], a); h[1] = _mm256_add_epi32(h[1], b);
+        h[2] = _mm256_add_epi32(h[2], c); h[3] = _mm256_add_epi32(h[3], d);
+        h[4] = _mm256_add_epi32(h[4], e);
+    }
+
+    __attribute__((target("avx2")))
+    static void DigestLanesAvx2(const uint8_t* const data[Sha1::LANES], size_t size, uint8_t out[][Sha1::DIGEST_SIZE]) {
+        __m256i h[5];
+        for (int i = 0; i < 5; ++i) h[i] = _mm256_set1_epi32((int)INITIAL_STATE[i]);
+
+        const uint8_t* blocks[Sha1::LANES];
+        size_t whole = size / 64;
+        for (size_t n = 0; n < whole; ++n) {
+            for (size_t l = 0; l < Sha1::LANES; ++l) blocks[l] = data[l] + n * 64;
+            CompressLanes(h, blocks);
+        }
+
+        // Same length everywhere, so every lane needs the same number (1 or 2) of padded tail blocks
+        size_t rest = size % 64;
+        size_t tail_blocks = rest < 56 ? 1 : 2;
+        uint8_t tail[Sha1::LANES][128];
+        uint64_t bits = (uint64_t)size * 8;
+        for (size_t l = 0; l < Sha1::LANES; ++l) {
+            std::memset(tail[l], 0, sizeof(tail[l]));
+            std::memcpy(tail[l], data[l] + whole * 64, rest);
+            tail[l][rest] = 0x80;
+            for (int i = 0; i < 8; ++i) tail[l][tail_blocks * 64 - 1 - i] = (uint8_t)(bits >> (8 * i));
+        }
+        for (size_t n = 0; n < tail_blocks; ++n) {
+            for (size_t l = 0; l < Sha1::LANES; ++l) blocks[l] = tail[l] + n * 64;
+            CompressLanes(h, blocks);
+        }
+
+        alignas(32) uint32_t words[5][Sha1::LANES];
+        for (int i = 0; i < 5; ++i) _mm256_store_si256((__m256i*)words[i], h[i]);
+        for (size_t l = 0; l < Sha1::LANES; ++l) {
+            for (int i = 0; i < 5; ++i) {
+                out[l][4 * i]     = (uint8_t)(words[i][l] >> 24);
+                out[l][4 * i + 1] = (uint8_t)(words[i][l] >> 16);
+                out[l][4 * i + 2] = (uint8_t)(words[i][l] >> 8);
+                out[l][4 * i + 3] = (uint8_t)words[i][l];
+            }
+        }
+    }
+#endif
+
+    bool Sha1::Supported(Backend backend) {
+        switch (backend) {
+            case AUTO: case SCALAR: case OPENSSL: return true;
+#ifdef SHA1_X86
+            case SSSE3: {
+                unsigned a, b, c, d;
+                return __get_cpuid(1, &a, &b, &c, &d) && (c & bit_SSSE3);
+            }
+            case SHANI: {
+                unsigned a, b, c, d;
+                if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_SSE4_1)) return false;
+                return __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & bit_SHA);
+            }
+#endif
+            default: return false;
+        }
+    }
+
+    const char* Sha1::Name(Backend backend) {
+        switch (backend) {
+            case AUTO:    return "auto";
+            case SCALAR:  return "scalar";
+            case SSSE3:   return "ssse3";
+            case SHANI:   return "sha-ni";
+            case OPENSSL: return "openssl";
+        }
+        return "?";
+    }
+
+    // Hashes the same 256 KiB with every supported backend and keeps the fastest.
+    // SHA-NI wins wherever it exists; elsewhere OpenSSL's assembly usually beats the SSSE3 path,
+    // but not on every build of libcrypto, so measure rather than guess.
+    static Sha1::Backend Calibrate() {
+        std::vector<uint8_t> sample(256 * 1024, 0x5A);
+        uint8_t out[Sha1::DIGEST_SIZE];
+        Sha1::Backend best = Sha1::SCALAR;
+        double best_time = 1e300;
+
+        for (Sha1::Backend b : {Sha1::SHANI, Sha1::OPENSSL, Sha1::SSSE3, Sha1::SCALAR}) {
+            if (!Sha1::Supported(b)) continue;
+            Sha1::Digest(sample.data(), 4096, out, b); // Warm up
+            auto t0 = std::chrono::steady_clock::now();
+            Sha1::Digest(sample.data(), sample.size(), out, b);
+            double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            if (t < best_time) { best_time = t; best = b; }
+        }
+        return best;
+    }
+
+    Sha1::Backend Sha1::Best() {
+        static const Backend best = Calibrate();
+        return best;
+    }
+
+    bool Sha1::LanesSupported() {
+#ifdef SHA1_X86
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        return avx2;
+#else
+        return false;
+#endif
+    }
+
+    void Sha1::DigestLanes(const uint8_t* const data[LANES], size_t size, uint8_t out[][DIGEST_SIZE]) {
+#ifdef SHA1_X86
+        if (LanesSupported()) {
+            DigestLanesAvx2(data, size, out);
+            return;
+        }
+#endif
+        for (size_t l = 0; l < LANES; ++l) Digest(data[l], size, out[l]);
+    }
+
+    // Eight 64 KiB messages through the lanes vs. the same eight one after another with Best()
+    static bool LanesAreFaster() {
+        if (!Sha1::LanesSupported()) return false;
+        std::vector<uint8_t> sample(64 * 1024, 0xA5);
+        const uint8_t* data[Sha1::LANES];
+        for (auto& p : data) p = sample.data();
+        uint8_t out[Sha1::LANES][Sha1::DIGEST_SIZE];
+
+        Sha1::DigestLanes(data, 4096, out); // Warm up
+        auto t0 = std::chrono::steady_clock::now();
+        Sha1::DigestLanes(data, sample.size(), out);
+        auto t1 = std::chrono::steady_clock::now();
+        for (size_t l = 0; l < Sha1::LANES; ++l) Sha1::Digest(data[l], sample.size(), out[l]);
+        auto t2 = std::chrono::steady_clock::now();
+        return t1 - t0 < t2 - t1;
+    }
+
+    void Sha1::DigestMany(const uint8_t* const data[], size_t size, size_t count, uint8_t out[][DIGEST_SIZE]) {
+        static const bool use_lanes = LanesAreFaster();
+        size_t i = 0;
+        if (use_lanes) {
+            for (; i + LANES <= count; i += LANES) DigestLanes(data + i, size, out + i);
+        }
+        for (; i < count; ++i) Digest(data[i], size, out[i]);
+    }
+
+    Sha1::Sha1(Backend b) : backend(b == AUTO ? Best() : b) {
+        if (!Supported(backend)) throw std::runtime_error(std::string("SHA-1 backend not supported: ") + Name(backend));
+        if (backend == OPENSSL) {
+            evp = EVP_MD_CTX_new();
+            if (!evp) throw std::runtime_error("EVP_MD_CTX_new failed");
+        }
+        Reset();
+    }
+
+    Sha1::~Sha1() {
+        if (evp) EVP_MD_CTX_free(evp);
+    }
+
+    void Sha1::Reset() {
+        std::memcpy(state, INITIAL_STATE, sizeof(state));
+        block_len = 0;
+        total_len = 0;
+        if (evp && EVP_DigestInit_ex(evp, EVP_sha1(), nullptr) != 1) throw std::runtime_error("EVP_DigestInit_ex failed");
+    }
+
+    void Sha1::Compress(const uint8_t* blocks, size_t count) {
+        switch (backend) {
+#ifdef SHA1_X86
+            case SHANI: CompressShaNi(state, blocks, count); break;
+            case SSSE3: CompressSsse3(state, blocks, count); break;
+#endif
+            default: CompressScalar(state, blocks, count); break;
+        }
+    }
+
+    void Sha1::Update(const uint8_t* data, size_t size) {
+        if (evp) {
+            EVP_DigestUpdate(evp, data, size);
+            return;
+        }
+        total_len += size;
+
+        // Top up a partial block left by the previous call
+        if (block_len > 0) {
+            size_t n = std::min(size, sizeof(block) - block_len);
+            std::memcpy(block + block_len, data, n);
+            block_len += n;
+            data += n;
+            size -= n;
+            if (block_len < sizeof(block)) return;
+            Compress(block, 1);
+            block_len = 0;
+        }
+
+        // Whole blocks straight from the caller's memory
+        size_t whole = size / 64;
+        if (whole > 0) {
+            Compress(data, whole);
+            data += whole * 64;
+            size -= whole * 64;
+        }
+
+        std::memcpy(block, data, size);
+        block_len = size;
+    }
+
+    void Sha1::Final(uint8_t out[DIGEST_SIZE]) {
+        if (evp) {
+            EVP_DigestFinal_ex(evp, out, nullptr);
+            Reset();
+            return;
+        }
+
+        uint64_t bits = total_len * 8;
+        block[block_len++] = 0x80;
+        if (block_len > 56) {
+            std::memset(block + block_len, 0, 64 - block_len);
+            Compress(block, 1);
+            block_len = 0;
+        }
+        std::memset(block + block_len, 0, 56 - block_len);
+        for (int i = 0; i < 8; ++i) block[56 + i] = (uint8_t)(bits >> (56 - 8 * i));
+        Compress(block, 1);
+
+        for (int i = 0; i < 5; ++i) {
+            out[4 * i]     = (uint8_t)(state[i] >> 24);
+            out[4 * i + 1] = (uint8_t)(state[i] >> 16);
+            out[4 * i + 2] = (uint8_t)(state[i] >> 8);
+            out[4 * i + 3] = (uint8_t)state[i];
+        }
+        Reset();
+    }
+
+    void Sha1::Digest(const uint8_t* data, size_t size, uint8_t out[DIGEST_SIZE], Backend backend) {
+        Sha1 ctx(backend);
+        ctx.Update(data, size);
+        ctx.Final(out);
+    }
+}
@@ -0,0 +1,249 @@
+#include "parsing/TorrentCreator.h"
+#include "parsing/Sha1.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace BitTorrent {
+
+    int64_t TorrentCreator::AutoPieceLength(int64_t total_size) {
+        int64_t len = 16 * 1024;
+        while (len < 16 * 1024 * 1024 && total_size / len > 2000) len *= 2;
+        return len;
+    }
+
+    namespace {
+        // A run of whole pieces read from the payload
+        struct Chunk {
+            Buffer data;
+            size_t first_piece = 0;
+        };
+
+        class HashPipeline {
+        public:
+            HashPipeline(const std::vector<std::string>& paths, int64_t piece_length, size_t threads,
+                         const std::function<void(int64_t, int64_t)>& progress)
+                : paths(paths), piece_length(piece_length), threads(threads), progress(progress) {
+                for (const auto& p : paths) total += (int64_t)fs::file_size(p);
+                digests.resize((total + piece_length - 1) / piece_length);
+
+                // ~16 MiB per read keeps the disk streaming; a few more buffers than hashers
+                // lets the reader run ahead without unbounded memory
+                int64_t per_chunk = std::max<int64_t>(1, (16 * 1024 * 1024) / piece_length);
+                chunk_bytes = (size_t)(per_chunk * piece_length);
+                for (size_t i = 0; i < threads + 2; ++i) free_chunks.push(std::make_unique<Chunk>());
+            }
+
+            std::vector<PieceDigest> Run() {
+                std::vector<std::thread> hashers;
+                for (size_t i = 0; i < threads; ++i) hashers.emplace_back([this] { Hash(); });
+                try {
+                    Read();
+                } catch (...) {
+                    std::lock_guard<std::mutex> lk(mx);
+                    error = std::current_exception();
+                }
+                {
+                    std::lock_guard<std::mutex> lk(mx);
+                    reading_done = true;
+                }
+                cv_full.notify_all();
+                for (auto& t : hashers) t.join();
+
+                if (error) std::rethrow_exception(error);
+                return std::move(digests);
+            }
+
+        private:
+            const std::vector<std::string>& paths;
+            int64_t piece_length;
+            size_t threads;
+            const std::function<void(int64_t, int64_t)>& progress;
+            int64_t total = 0;
+            int64_t hashed = 0;
+            size_t chunk_bytes = 0;
+            std::vector<PieceDigest> digests; // Each hasher writes only its own pieces' slots
+
+            std::mutex mx;
+            std::condition_variable cv_full, cv_free;
+            std::queue<std::unique_ptr<Chunk>> full_chunks, free_chunks;
+            bool reading_done = false;
+            std::exception_ptr error;
+
+            std::unique_ptr<Chunk> TakeFree() {
+                std::unique_lock<std::mutex> lk(mx);
+                cv_free.wait(lk, [this] { return !free_chunks.empty(); });
+                auto c = std::move(free_chunks.front());
+                free_chunks.pop();
+                return c;
+            }
+
+            void PushFull(std::unique_ptr<Chunk> c) {
+                { std::lock_guard<std::mutex> lk(mx); full_chunks.push(std::move(c)); }
+                cv_full.notify_one();
+            }
+
+            // The reader: all files back to back, as one stream cut into chunk-sized runs of pieces
+            void Read() {
+                std::unique_ptr<Chunk> chunk = TakeFree();
+                chunk->data.resize(chunk_bytes);
+                size_t filled = 0, next_piece = 0;
+
+                for (const auto& path : paths) {
+                    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                    if (fd < 0) throw std::runtime_error("Cannot open " + path);
+                    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+                    while (true) {
+                        ssize_t r = read(fd, chunk->data.data() + filled, chunk_bytes - filled);
+                        if (r < 0 && errno == EINTR) continue;
+                        if (r < 0) { close(fd); throw std::runtime_error("Read failed: " + path); }
+                        if (r == 0) break;
+                        filled += r;
+
+                        if (filled == chunk_bytes) {
+                            chunk->first_piece = next_piece;
+                            next_piece += chunk_bytes / piece_length;
+                            PushFull(std::move(chunk));
+                            chunk = TakeFree();
+                            chunk->data.resize(chunk_bytes);
+                            filled = 0;
+                        }
+                    }
+                    close(fd);
+                }
+
+                if (filled > 0) {
+                    chunk->data.resize(filled);
+                    chunk->first_piece = next_piece;
+                    next_piece += (filled + piece_length - 1) / piece_length;
+                    PushFull(std::move(chunk));
+                }
+                if (next_piece != digests.size()) throw std::runtime_error("Files changed size while hashing");
+            }
+
+            void Hash() {
+                while (true) {
+                    std::unique_ptr<Chunk> chunk;
+                    {
+                        std::unique_lock<std::mutex> lk(mx);
+                        cv_full.wait(lk, [this] { return !full_chunks.empty() || reading_done; });
+                        if (full_chunks.empty()) return;
+                        chunk = std::move(full_chunks.front());
+                        full_chunks.pop();
+                    }
+
+                    size_t size = chunk->data.size();
+                    size_t whole = size / piece_length;
+                    std::vector<const uint8_t*> ptrs(whole);
+                    for (size_t i = 0; i < whole; ++i) ptrs[i] = chunk->data.data() + i * piece_length;
+                    Sha1::DigestMany(ptrs.data(), piece_length, whole,
+                                     reinterpret_cast<uint8_t(*)[Sha1::DIGEST_SIZE]>(digests[chunk->first_piece].data()));
+                    if (size % piece_length) { // Short last piece of the payload
+                        Sha1::Digest(chunk->data.data() + whole * piece_length, size % piece_length,
+                                     digests[chunk->first_piece + whole].data());
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> lk(mx);
+                        hashed += size;
+                        if (progress) progress(hashed, total);
+                        free_chunks.push(std::move(chunk));
+                    }
+                    cv_free.notify_one();
+                }
+            }
+        };
+
+        Bnode Str(const std::string& s) { return Bnode(BufferUtils::FromString(s)); }
+    }
+
+    std::vector<PieceDigest> TorrentCreator::HashFiles(const std::vector<std::string>& paths, int64_t piece_length,
+                                                       size_t threads, const std::function<void(int64_t, int64_t)>& progress) {
+        if (piece_length <= 0) throw std::runtime_error("Invalid piece length");
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        HashPipeline pipeline(paths, piece_length, threads, progress);
+        return pipeline.Run();
+    }
+
+    Buffer TorrentCreator::Create(const std::string& path, const CreateOptions& options) {
+        fs::path root = fs::absolute(path).lexically_normal();
+        if (!root.has_filename()) root = root.parent_path(); // "dir/" -> "dir"
+        if (!fs::exists(root)) throw std::runtime_error("No such file or directory: " + path);
+
+        // Files in a stable order (sorted by their path inside the torrent)
+        std::vector<fs::path> relative;
+        if (fs::is_directory(root)) {
+            for (const auto& e : fs::recursive_directory_iterator(root)) {
+                if (e.is_regular_file()) relative.push_back(fs::relative(e.path(), root));
+            }
+            std::sort(relative.begin(), relative.end());
+            if (relative.empty()) throw std::runtime_error("No files under " + path);
+        }
+
+        std::vector<std::string> paths;
+        int64_t total = 0;
+        if (relative.empty()) {
+            paths.push_back(root.string());
+        } else {
+            for (const auto& r : relative) paths.push_back((root / r).string());
+        }
+        for (const auto& p : paths) total += (int64_t)fs::file_size(p);
+
+        int64_t piece_length = options.piece_length > 0 ? options.piece_length : AutoPieceLength(total);
+        std::vector<PieceDigest> digests = HashFiles(paths, piece_length, options.threads, options.progress);
+
+        BDict info;
+        info["name"] = Str(root.filename().string());
+        info["piece length"] = Bnode((BInt)piece_length);
+        BString pieces(digests.size() * Sha1::DIGEST_SIZE);
+        if (!digests.empty()) std::memcpy(pieces.data(), digests.data(), pieces.size());
+        info["pieces"] = Bnode(std::move(pieces));
+        if (options.is_private) info["private"] = Bnode((BInt)1);
+
+        if (relative.empty()) {
+            info["length"] = Bnode((BInt)total);
+        } else {
+            BList files;
+            for (size_t i = 0; i < relative.size(); ++i) {
+                BDict file;
+                file["length"] = Bnode((BInt)fs::file_size(paths[i]));
+                BList components;
+                for (const auto& part : relative[i]) components.push_back(Str(part.string()));
+                file["path"] = Bnode(std::move(components));
+                files.push_back(Bnode(std::move(file)));
+            }
+            info["files"] = Bnode(std::move(files));
+        }
+
+        BDict torrent;
+        if (!options.announce.empty()) torrent["announce"] = Str(options.announce);
+        if (!options.comment.empty()) torrent["comment"] = Str(options.comment);
+        if (!options.created_by.empty()) torrent["created by"] = Str(options.created_by);
+        torrent["creation date"] = Bnode((BInt)std::time(nullptr));
+        torrent["info"] = Bnode(std::move(info));
+        return Bnode::Encode(Bnode(std::move(torrent)));
+    }
+
+    void TorrentCreator::CreateFile(const std::string& path, const std::string& output, const CreateOptions& options) {
+        Buffer data = Create(path, options);
+        std::ofstream out(output, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("Cannot write " + output);
+        out.write((const char*)data.data(), data.size());
+        if (!out) throw std::runtime_error("Write failed: " + output);
+    }
+}
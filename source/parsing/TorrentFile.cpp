@@ -1,64 +1,234 @@
 #include "parsing/TorrentFile.h"
-#include <fstream>
+#include "parsing/BnodeView.h"
+#include "parsing/MappedFile.h"
+#include <cstring>
 #include <iostream>
-#include <openssl/sha.h> // Requires -lcrypto
+#include "parsing/Sha1.h"
+#include "parsing/Merkle.h"
+#include <algorithm>
+#include <openssl/sha.h>
 
 namespace BitTorrent {
 
+    // Local Helper: a path component from the torrent must not escape the download directory
+    static void ValidatePathComponent(const std::string& part) {
+        if (part.empty() || part == "." || part == ".." || part.find('/') != std::string::npos) {
+            throw std::runtime_error("Invalid Torrent: unsafe path component '" + part + "'");
+        }
+    }
+
+    int64_t TorrentFile::PieceSize(size_t index) const {
+        int64_t start = piece_length * (int64_t)index;
+        int64_t size = std::min<int64_t>(piece_length, length - start);
+        if (!HasV1()) {
+            // v2 pieces never cross a file boundary; the alignment gap after a file isn't data
+            if (const FileEntry* f = FileAt(start)) size = std::min<int64_t>(size, f->offset + f->length - start);
+        }
+        return size;
+    }
+
+    std::vector<std::vector<std::string>> TorrentFile::TrackerTiers() const {
+        if (!announce_list.empty()) return announce_list;
+        if (announce.empty()) return {};
+        return {{announce}};
+    }
+
+    const FileEntry* TorrentFile::FileAt(int64_t offset) const {
+        // Files are in stream order; zero-length ones share their offset with the next file
+        auto it = std::upper_bound(files.begin(), files.end(), offset,
+                                   [](int64_t off, const FileEntry& f) { return off < f.offset; });
+        while (it != files.begin()) {
+            --it;
+            if (it->length == 0) continue;
+            if (it->pad || offset >= it->offset + it->length) return nullptr;
+            return &*it;
+        }
+        return nullptr;
+    }
+
+    // Local Helper: walks a BEP 52 'file tree' in key (= path) order.
+    // A directory maps names to subtrees; a file is a dict whose only key is "".
+    static void WalkFileTree(BnodeView node, const std::string& prefix, std::vector<FileEntry>& out) {
+        node.ForEachPair([&](std::string_view name, BnodeView child) {
+            if (name.empty()) {
+                FileEntry f;
+                f.path = prefix;
+                f.length = child.At("length").GetInt();
+                f.offset = 0;
+                if (f.length < 0) throw std::runtime_error("Invalid Torrent: negative file length");
+                if (f.length > 0) {
+                    std::string_view root = child.At("pieces root").GetString();
+                    if (root.size() != 32) throw std::runtime_error("Invalid Torrent: bad pieces root");
+                    std::memcpy(f.pieces_root.data(), root.data(), 32);
+                }
+                out.push_back(std::move(f));
+                return;
+            }
+            std::string component(name);
+            ValidatePathComponent(component);
+            WalkFileTree(child, prefix + "/" + component, out);
+        });
+    }
+
     TorrentFile TorrentFile::Load(const std::string& filepath) {
-        // 1. Read File
-        std::ifstream file(filepath, std::ios::binary);
-        if (!file) throw std::runtime_error("Cannot open file: " + filepath);
-        // Explanation: This is a C++ "one-liner" to read a file.
-        // iterator<char>(file) points to the Start of the file.
-        // iterator<char>() (empty) points to the End of the file.
-        // The Buffer constructor says: "Copy everything from Start to End."
-        Buffer data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-        
-        // 2. Decode Bencode
-        Bnode root = Bnode::Decode(data);
-        const auto& rootDict = root.GetDict();
+        // 1. Map File
+        // The kernel pages the file in as the parser walks it. No istreambuf_iterator copy,
+        // and the mapping is released as soon as we return.
+        MappedFile file(filepath);
+        return Parse(file.data(), file.size());
+    }
+
+    TorrentFile TorrentFile::Parse(const uint8_t* data, size_t size) {
+        // 2. Decode Bencode (zero-copy: every view points into 'data')
+        BnodeView root = BnodeView::Decode(data, size);
 
         TorrentFile t;
-        t.announce = rootDict.at("announce").ToString();
+        // Trackerless torrents (DHT only) have no announce URL
+        if (root.Has("announce")) t.announce = root.At("announce").ToString();
+        if (BnodeView list = root.Find("announce-list")) {
+            list.ForEach([&t](BnodeView tier) {
+                std::vector<std::string> urls;
+                tier.ForEach([&urls](BnodeView url) { urls.push_back(url.ToString()); });
+                if (!urls.empty()) t.announce_list.push_back(std::move(urls));
+            });
+        }
 
         // 3. Process 'info' dictionary
-        // We MUST keep 'info' as a Bnode to hash it later
-        if (rootDict.count("info") == 0) throw std::runtime_error("Invalid Torrent: Missing info");
-        const Bnode& infoNode = rootDict.at("info");
-        const auto& infoDict = infoNode.GetDict();
-
-        t.name = infoDict.at("name").ToString();
-        t.piece_length = infoDict.at("piece length").GetInt();
-        
-        // Handle Length (Single file mode for now)
-        if (infoDict.count("length")) {
-            t.length = infoDict.at("length").GetInt();
+        // We keep 'info' as a view so we can hash its exact bytes later
+        BnodeView infoNode = root.Find("info");
+        if (!infoNode) throw std::runtime_error("Invalid Torrent: Missing info");
+
+        t.name = infoNode.At("name").ToString();
+        t.piece_length = infoNode.At("piece length").GetInt();
+        if (t.piece_length <= 0) throw std::runtime_error("Invalid Torrent: bad piece length");
+
+        // BEP 52: 'meta version' 2 is a v2 torrent, or a hybrid if the v1 keys are there too
+        if (BnodeView version = infoNode.Find("meta version")) {
+            t.meta_version = (int)version.GetInt();
+            if (t.meta_version != 1 && t.meta_version != 2) throw std::runtime_error("Unsupported meta version");
+        }
+        bool has_v1 = infoNode.Has("pieces");
+        if (!has_v1 && t.meta_version != 2) throw std::runtime_error("Invalid Torrent: Missing pieces");
+        if (has_v1) ParseV1(infoNode, t);
+        if (t.meta_version == 2) ParseV2(root, infoNode, t, has_v1);
+
+        // 5. Calculate Info Hash (CRITICAL STEP)
+        // The view spans the original bytes of the 'info' value, so there is nothing to re-encode
+        // (a decode -> encode round trip would also change non-canonical input and break the hash)
+        t.info_offset = infoNode.Data() - data;
+        t.info_size = infoNode.Size();
+        t.info_hash.resize(20);
+        Sha1::Digest(data + t.info_offset, t.info_size, t.info_hash.data());
+
+        if (t.meta_version == 2) {
+            t.info_hash_v2.resize(32);
+            SHA256(data + t.info_offset, t.info_size, t.info_hash_v2.data());
+            // Pure v2 swarms are identified by the truncated SHA-256 hash
+            if (!has_v1) t.info_hash.assign(t.info_hash_v2.begin(), t.info_hash_v2.begin() + 20);
+        }
+        return t;
+    }
+
+    // v1 layout ('length' or 'files') and the SHA-1 piece table
+    void TorrentFile::ParseV1(BnodeView infoNode, TorrentFile& t) {
+        // Handle Length
+        // Single file: 'length' is the file. Multi file: 'files' lists them, stored under 'name'/
+        if (BnodeView lengthNode = infoNode.Find("length")) {
+            t.length = lengthNode.GetInt();
+            if (t.length < 0) throw std::runtime_error("Invalid Torrent: negative length");
+            ValidatePathComponent(t.name);
+            t.files.push_back({t.name, t.length, 0});
+        } else if (BnodeView filesNode = infoNode.Find("files")) {
+            ValidatePathComponent(t.name);
+            t.length = 0;
+            filesNode.ForEach([&t](BnodeView file) {
+                int64_t len = file.At("length").GetInt();
+                if (len < 0) throw std::runtime_error("Invalid Torrent: negative file length");
+
+                std::string path = t.name;
+                file.At("path").ForEach([&path](BnodeView part) {
+                    std::string component = part.ToString();
+                    ValidatePathComponent(component);
+                    path += "/" + component;
+                });
+                if (path == t.name) throw std::runtime_error("Invalid Torrent: empty file path");
+
+                FileEntry entry{path, len, t.length};
+                // Hybrid torrents align files to pieces with pad files (attr contains 'p')
+                if (BnodeView attr = file.Find("attr")) entry.pad = attr.GetString().find('p') != std::string_view::npos;
+                t.files.push_back(std::move(entry));
+                t.length += len;
+            });
         } else {
-             throw std::runtime_error("Multi-file torrents not supported yet");
+            throw std::runtime_error("Invalid Torrent: Missing length and files");
         }
 
         // 4. Extract Pieces (Split big string into 20-byte chunks)
-        const Buffer& piecesBlob = infoDict.at("pieces").GetString();
+        std::string_view piecesBlob = infoNode.At("pieces").GetString();
         if (piecesBlob.size() % 20 != 0) throw std::runtime_error("Invalid pieces length");
 
-        for (size_t i = 0; i < piecesBlob.size(); i += 20) {
-            // Store as raw string or hex string? 
-            // Your struct TorrentFile uses std::vector<std::string> piece_hashes;
-            // Let's keep that for now to avoid breaking Downloader, but construct it safely.
-            
-            std::string hashChunk(piecesBlob.begin() + i, 
-                                  piecesBlob.begin() + i + 20);
-            t.piece_hashes.push_back(hashChunk);
+        // One allocation and one memcpy for the whole table
+        t.piece_hashes.resize(piecesBlob.size() / 20);
+        static_assert(sizeof(PieceDigest) == 20, "piece table must be tightly packed");
+        std::memcpy(t.piece_hashes.data(), piecesBlob.data(), piecesBlob.size());
+    }
+
+    // v2 'file tree' and 'piece layers'. A hybrid keeps the v1 layout (pad files included) and
+    // only gains the Merkle roots; a pure v2 torrent starts every file on a piece boundary.
+    void TorrentFile::ParseV2(BnodeView root, BnodeView infoNode, TorrentFile& t, bool has_v1) {
+        if (t.piece_length < (int64_t)MerkleTree::BLOCK_SIZE || (t.piece_length & (t.piece_length - 1)))
+            throw std::runtime_error("Invalid Torrent: v2 piece length must be a power of two >= 16 KiB");
+        ValidatePathComponent(t.name);
+
+        std::vector<FileEntry> tree;
+        WalkFileTree(infoNode.At("file tree"), "", tree);
+        if (tree.empty()) throw std::runtime_error("Invalid Torrent: empty file tree");
+        for (auto& f : tree) f.path = f.path.substr(1); // Drop the leading '/'
+
+        // A single file sits at the top of the tree under its own name, which is also 'name'
+        bool single = tree.size() == 1 && tree[0].path.find('/') == std::string::npos;
+        for (auto& f : tree) f.path = single ? t.name : t.name + "/" + f.path;
+
+        if (has_v1) {
+            for (auto& f : t.files) {
+                if (f.pad) continue;
+                auto it = std::find_if(tree.begin(), tree.end(), [&](const FileEntry& v) { return v.path == f.path; });
+                if (it == tree.end() || it->length != f.length)
+                    throw std::runtime_error("Invalid Torrent: v1 and v2 file lists differ at " + f.path);
+                f.pieces_root = it->pieces_root;
+            }
+        } else {
+            int64_t offset = 0;
+            for (auto& f : tree) {
+                if (f.length > 0) offset = (offset + t.piece_length - 1) / t.piece_length * t.piece_length;
+                f.offset = offset;
+                offset += f.length;
+            }
+            t.files = std::move(tree);
+            t.length = offset;
         }
 
-        // 5. Calculate Info Hash (CRITICAL STEP)
-        // We re-encode the 'info' node back to raw bytes
-        Buffer infoBytes = Bnode::Encode(infoNode);
-        
-        t.info_hash.resize(20);
-        SHA1(infoBytes.data(), infoBytes.size(), t.info_hash.data());
+        // Piece layers, keyed by pieces root, for every file longer than one piece
+        BnodeView layers = root.Find("piece layers");
+        for (auto& f : t.files) {
+            if (f.pad || f.length <= t.piece_length) continue;
+            BnodeView layer = layers ? layers.Find(std::string_view((const char*)f.pieces_root.data(), 32)) : BnodeView();
+            if (!layer) throw std::runtime_error("Invalid Torrent: missing piece layer for " + f.path);
 
-        return t;
+            std::string_view blob = layer.GetString();
+            size_t count = (f.length + t.piece_length - 1) / t.piece_length;
+            if (blob.size() != count * 32) throw std::runtime_error("Invalid Torrent: bad piece layer for " + f.path);
+            f.piece_layer.resize(count);
+            std::memcpy(f.piece_layer.data(), blob.data(), blob.size());
+
+            // The layer must hash up to the root, or every piece checked against it is meaningless
+            std::vector<Sha256Digest> padded = f.piece_layer;
+            padded.resize(MerkleTree::NextPow2(count), MerkleTree::PadRoot(t.piece_length / MerkleTree::BLOCK_SIZE));
+            while (padded.size() > 1) {
+                for (size_t i = 0; i < padded.size() / 2; ++i) padded[i] = MerkleTree::HashPair(padded[2 * i], padded[2 * i + 1]);
+                padded.resize(padded.size() / 2);
+            }
+            if (padded[0] != f.pieces_root) throw std::runtime_error("Invalid Torrent: piece layer does not match root of " + f.path);
+        }
     }
 }
\ No newline at end of file
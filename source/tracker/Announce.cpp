@@ -0,0 +1,789 @@
+#include "tracker/Announce.h"
+#include "parsing/BnodeParser.h"
+#include "tracker/HttpResponse.h"
+#include "tracker/PeerStore.h"
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <random>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace BitTorrent {
+
+    // Local Helper: Random 32-bit Integer for Transaction ID
+    static uint32_t RandomTransactionID() {
+        static std::random_device rd;
+        static std::mt19937 gen(rd());
+        static std::uniform_int_distribution<uint32_t> dis(0, UINT32_MAX);
+        return dis(gen);
+    }
+
+    // Local Helper: Write Big Endian Integers
+    static void WriteBE32(Buffer& b, uint32_t val) {
+        b.push_back((val >> 24) & 0xFF);
+        b.push_back((val >> 16) & 0xFF);
+        b.push_back((val >> 8) & 0xFF);
+        b.push_back(val & 0xFF);
+    }
+    static void WriteBE64(Buffer& b, uint64_t val) {
+        WriteBE32(b, (val >> 32) & 0xFFFFFFFF);
+        WriteBE32(b, val & 0xFFFFFFFF);
+    }
+
+    // Local Helper: "Compact" peer list, 6 bytes per peer (IP: 4, Port: 2)
+    static void ParseCompactPeers(const uint8_t* data, size_t size, std::vector<Peer>& out) {
+        out.reserve(out.size() + size / 6);
+        for (size_t i = 0; i + 6 <= size; i += 6) {
+            uint16_t port = (data[i+4] << 8) | data[i+5]; // Big Endian
+            out.push_back(Peer::FromV4(data + i, port));
+        }
+    }
+
+    // Local Helper: BEP 7 "peers6", 18 bytes per peer (IP: 16, Port: 2)
+    static void ParseCompactPeers6(const uint8_t* data, size_t size, std::vector<Peer>& out) {
+        out.reserve(out.size() + size / 18);
+        for (size_t i = 0; i + 18 <= size; i += 18) {
+            uint16_t port = (data[i+16] << 8) | data[i+17];
+            out.push_back(Peer::FromV6(data + i, port));
+        }
+    }
+
+    // Local Helper: the HTTP spelling of an event (empty for a regular announce)
+    static const char* EventName(AnnounceEvent event) {
+        switch (event) {
+            case AnnounceEvent::STARTED: return "started";
+            case AnnounceEvent::COMPLETED: return "completed";
+            case AnnounceEvent::STOPPED: return "stopped";
+            default: return "";
+        }
+    }
+
+    // Local Helper: the Host header value (RFC 7230): IPv6 literals in brackets, port unless 80
+    static std::string HostHeader(const Url& url) {
+        std::string host = url.host.find(':') != std::string::npos ? "[" + url.host + "]" : url.host;
+        return url.port == 80 ? host : host + ":" + std::to_string(url.port);
+    }
+
+    // Local Helper: AF_INET or AF_INET6 of a connected socket
+    static int SocketFamily(int fd) {
+        sockaddr_storage addr{};
+        socklen_t len = sizeof(addr);
+        getsockname(fd, (sockaddr*)&addr, &len);
+        return addr.ss_family;
+    }
+
+    // --- Announce (shared plumbing) ---
+
+    std::unique_ptr<Announce> Announce::Scrape(Farm& farm, const std::string& url, const std::vector<Buffer>& info_hashes,
+                                               int timeout_ms, Callback done) {
+        AnnounceParams params;
+        params.scrape = info_hashes;
+        params.timeout_ms = timeout_ms;
+        return Create(farm, url, params, std::move(done));
+    }
+
+    // BEP 48 convention: only trackers whose path ends in "/announce..." can be scraped
+    std::string Announce::ScrapeUrl(const std::string& announce_url) {
+        size_t slash = announce_url.rfind('/');
+        if (slash == std::string::npos || announce_url.compare(slash, 9, "/announce") != 0) return "";
+        return announce_url.substr(0, slash) + "/scrape" + announce_url.substr(slash + 9);
+    }
+
+    int64_t Announce::TimeoutMs(const Url& url, const AnnounceParams& params) {
+        if (params.timeout_ms > 0) return params.timeout_ms;
+        // A shorter UDP deadline would cut the BEP 15 retransmissions off
+        return url.protocol == "udp" ? UdpAnnounce::RetryScheduleMs(params.udp_retry_ms) : HttpAnnounce::TIMEOUT_MS;
+    }
+
+    std::unique_ptr<Announce> Announce::Create(Farm& farm, const std::string& url_str, const AnnounceParams& params, Callback done) {
+        Url url = Url::Parse(url_str);
+        std::unique_ptr<Announce> a;
+        if (url.protocol == "http") a = std::make_unique<HttpAnnounce>(farm, url, params, std::move(done));
+        else if (url.protocol == "udp") a = std::make_unique<UdpAnnounce>(farm, url, params, std::move(done));
+        else throw std::runtime_error("Unsupported Tracker Protocol: " + url.protocol);
+
+        a->started = Farm::Clock::now();
+        Announce* raw = a.get();
+        a->timer = farm.After(std::chrono::milliseconds(TimeoutMs(url, params)), [raw]() {
+            raw->timer = 0;
+            raw->Fail("timed out");
+        });
+        try {
+            a->Begin();
+        } catch (const std::exception& e) {
+            a->Fail(e.what());
+        }
+        return a;
+    }
+
+    Announce::Announce(Farm& farm, const Url& url, const AnnounceParams& params, Callback done)
+        : farm(farm), url(url), params(params), done(std::move(done)) {}
+
+    Announce::~Announce() {
+        Close();
+    }
+
+    void Announce::Close() {
+        Closed();
+        if (timer) farm.Cancel(timer);
+        timer = 0;
+        if (resolving) farm.GetResolver().Cancel(resolving);
+        resolving = 0;
+        dialer.reset();
+        if (fd >= 0) {
+            farm.Remove(fd);
+            close(fd);
+        }
+        fd = -1;
+    }
+
+    void Announce::OpenSocket(int type, std::function<void()> then) {
+        resolving = farm.GetResolver().Resolve(url.host, [this, type, then](const ResolveResult& r) {
+            resolving = 0;
+            if (!r.ok) return Fail(r.error);
+            std::vector<sockaddr_storage> addresses;
+            for (const auto& a : r.addresses) {
+                addresses.emplace_back();
+                Resolver::WithPort(a, url.port, addresses.back());
+            }
+            addresses = Dialer::Interleave(addresses);
+
+            // TCP: race the addresses, IPv6 and IPv4 in turn
+            if (type == SOCK_STREAM) {
+                dialer = std::make_unique<Dialer>(farm, addresses, [this, then](int s, const std::string& error) {
+                    if (s < 0) return Fail("Could not connect to " + url.host + ": " + error);
+                    fd = s;
+                    family = SocketFamily(fd);
+                    then();
+                });
+                return dialer->Start();
+            }
+
+            // UDP: connect() only fixes the peer address, so the first one with a route wins
+            std::string error = "no addresses";
+            for (const auto& addr : addresses) {
+                socklen_t len = addr.ss_family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+                fd = socket(addr.ss_family, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+                if (fd >= 0 && connect(fd, (const sockaddr*)&addr, len) == 0) {
+                    family = addr.ss_family;
+                    try {
+                        then();
+                    } catch (const std::exception& e) {
+                        Fail(e.what());
+                    }
+                    return;
+                }
+                error = strerror(errno);
+                if (fd >= 0) close(fd);
+                fd = -1;
+            }
+            Fail("Could not connect to " + url.host + ": " + error);
+        });
+    }
+
+    void Announce::Cancel() {
+        finished = true;
+        Close();
+    }
+
+    void Announce::Finish(AnnounceResult result) {
+        if (finished) return;
+        finished = true;
+        Close();
+        result.latency_ms = std::chrono::duration<double, std::milli>(Farm::Clock::now() - started).count();
+        done(result);
+    }
+
+    void Announce::Fail(const std::string& error) {
+        AnnounceResult r;
+        r.error = error;
+        Finish(std::move(r));
+    }
+
+    // --- HTTP ---
+
+    // Local Helper: picks the fields we need out of the announce reply as the parser emits them.
+    // Only top-level keys matter, so nested values are skipped without being stored.
+    // Scrape replies put one such dict per hash under 'files' (d5:filesd20:<hash>d8:complete...).
+    class AnnounceHandler : public BnodeHandler {
+        int depth = 0;
+        enum { OTHER, PEERS, PEERS6, FAILURE, INTERVAL, MIN_INTERVAL, FILES, COMPLETE, INCOMPLETE, DOWNLOADED } field = OTHER;
+        bool in_files = false;
+        SwarmStats* stats = nullptr; // Where COMPLETE / INCOMPLETE / DOWNLOADED go
+
+        static bool StatField(std::string_view key, decltype(field)& f) {
+            if (key == "complete") f = COMPLETE;
+            else if (key == "incomplete") f = INCOMPLETE;
+            else if (key == "downloaded") f = DOWNLOADED;
+            else return false;
+            return true;
+        }
+
+        void SetStat(int64_t value) {
+            if (!stats) return;
+            if (field == COMPLETE) stats->seeders = (int)value;
+            if (field == INCOMPLETE) stats->leechers = (int)value;
+            if (field == DOWNLOADED) stats->downloaded = (int)value;
+        }
+
+    public:
+        std::vector<Peer> peers;
+        std::string failure;
+        int interval = 0;
+        int min_interval = 0;
+        SwarmStats swarm;
+        std::unordered_map<std::string, SwarmStats> files; // Raw 20-byte hash -> stats
+        PeerStore* store = nullptr; // Peers go here if set, else to 'peers'
+        std::vector<uint32_t> fresh;
+
+        void OnDictBegin() override {
+            depth++;
+            if (depth == 2 && field == FILES) in_files = true;
+        }
+        void OnListBegin() override { depth++; }
+        void OnEnd() override {
+            depth--;
+            if (depth < 2) in_files = false;
+        }
+
+        void OnKey(std::string_view key) override {
+            if (in_files && depth == 2) { // A hash
+                stats = &files[std::string(key)];
+                field = OTHER;
+                return;
+            }
+            if (in_files && depth == 3) {
+                if (!StatField(key, field)) field = OTHER;
+                return;
+            }
+            if (depth != 1) return;
+            stats = &swarm;
+            if (key == "peers") field = PEERS;
+            else if (key == "peers6") field = PEERS6;
+            else if (key == "failure reason") field = FAILURE;
+            else if (key == "interval") field = INTERVAL;
+            else if (key == "min interval") field = MIN_INTERVAL;
+            else if (key == "files") field = FILES;
+            else if (!StatField(key, field)) field = OTHER;
+        }
+
+        void OnInt(int64_t value) override {
+            if (in_files && depth == 3) return SetStat(value);
+            if (depth != 1) return;
+            if (field == INTERVAL) interval = (int)value;
+            if (field == MIN_INTERVAL) min_interval = (int)value;
+            SetStat(value);
+        }
+
+        void OnString(std::string_view value) override {
+            if (depth != 1) return;
+            if (field == FAILURE) failure = std::string(value);
+            const uint8_t* data = (const uint8_t*)value.data();
+            if (field == PEERS && store) store->AddCompact(data, value.size(), PeerSource::TRACKER, &fresh);
+            else if (field == PEERS) ParseCompactPeers(data, value.size(), peers);
+            if (field == PEERS6 && store) store->AddCompact6(data, value.size(), PeerSource::TRACKER, &fresh);
+            else if (field == PEERS6) ParseCompactPeers6(data, value.size(), peers);
+        }
+    };
+
+    struct HttpAnnounce::Reply {
+        AnnounceHandler handler;
+        BnodeParser parser{handler};
+        // Only a 2xx body is the bencoded reply; redirects and errors have theirs skipped
+        HttpResponse response{[this](const uint8_t* data, size_t size) {
+            if (response.Status() / 100 == 2 && !parser.Done()) parser.Feed(data, size);
+        }};
+    };
+
+    // Local Helper: idle keep-alive connections per "host:port", newest last. Announces only
+    // ever run on their Farm's thread, so each loop gets its own pool.
+    struct IdleConnection {
+        int fd;
+        Farm::Clock::time_point since;
+    };
+    struct ConnectionPool {
+        std::unordered_map<std::string, std::vector<IdleConnection>> hosts;
+        ~ConnectionPool() { Clear(); }
+        void Clear() {
+            for (auto& entry : hosts) {
+                for (auto& c : entry.second) close(c.fd);
+            }
+            hosts.clear();
+        }
+    };
+    static thread_local ConnectionPool pool;
+
+    static std::string PoolKey(const Url& url) {
+        return url.host + ":" + std::to_string(url.port);
+    }
+
+    // A pooled connection that is still open, or -1
+    static int TakeIdle(const Url& url) {
+        auto& idle = pool.hosts[PoolKey(url)];
+        auto now = Farm::Clock::now();
+        while (!idle.empty()) {
+            IdleConnection c = idle.back();
+            idle.pop_back();
+            if (now - c.since < std::chrono::seconds(HttpAnnounce::IDLE_TIMEOUT_S)) {
+                // Nothing to read is the healthy state; EOF or stray bytes mean it's unusable
+                char b;
+                if (recv(c.fd, &b, 1, MSG_PEEK | MSG_DONTWAIT) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return c.fd;
+            }
+            close(c.fd);
+        }
+        return -1;
+    }
+
+    static void PutIdle(const Url& url, int fd) {
+        auto& idle = pool.hosts[PoolKey(url)];
+        if (idle.size() >= HttpAnnounce::MAX_IDLE_PER_HOST) {
+            close(idle.front().fd); // Oldest goes
+            idle.erase(idle.begin());
+        }
+        idle.push_back({fd, Farm::Clock::now()});
+    }
+
+    void HttpAnnounce::ClearPool() {
+        pool.Clear();
+    }
+
+    HttpAnnounce::HttpAnnounce(Farm& farm, const Url& url, const AnnounceParams& params, Callback done)
+        : Announce(farm, url, params, std::move(done)) {}
+    HttpAnnounce::~HttpAnnounce() = default;
+
+    std::string HttpAnnounce::UrlEncode(const Buffer& buffer) {
+        std::ostringstream escaped;
+        escaped.fill('0');
+        escaped << std::hex;
+
+        for (uint8_t c : buffer) {
+            // Keep alphanumeric characters as is
+            if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+                escaped << c;
+            } else {
+                // Encode others as %XX
+                escaped << '%' << std::setw(2) << int(c);
+            }
+        }
+        return escaped.str();
+    }
+
+    void HttpAnnounce::Begin() {
+        // 1. Build HTTP GET Request
+        // Key Detail: compact=1. This tells the server: "Don't send me a huge Dictionary. Send me a tiny binary blob of IPs."
+        std::ostringstream req;
+        if (!params.scrape.empty()) {
+            // Scrape: same tracker, "/scrape" instead of "/announce", one info_hash per torrent
+            std::string path = query_in_path ? url.path : ScrapeUrl(url.path);
+            if (path.empty()) throw std::runtime_error("Tracker doesn't support scrape");
+            req << "GET " << path;
+            char sep = path.find('?') == std::string::npos ? '?' : '&';
+            if (!query_in_path) {
+                for (const auto& hash : params.scrape) {
+                    req << sep << "info_hash=" << UrlEncode(hash);
+                    sep = '&';
+                }
+            }
+        } else {
+            req << "GET " << url.path;
+        }
+        if (!query_in_path && params.scrape.empty()) {
+            req << (url.path.find('?') == std::string::npos ? "?" : "&")
+                << "info_hash=" << UrlEncode(params.info_hash)
+                << "&peer_id=" << params.peer_id
+                << "&port=" << params.port
+                << "&uploaded=" << params.uploaded
+                << "&downloaded=" << params.downloaded
+                << "&compact=1" // Important: Ask for binary peer list
+                << "&left=" << params.left
+                << "&numwant=" << params.num_want;
+            if (params.event != AnnounceEvent::NONE) req << "&event=" << EventName(params.event);
+        }
+        req << " HTTP/1.1\r\n"
+            << "Host: " << HostHeader(url) << "\r\n"
+            << "User-Agent: BitTorrent/1.0\r\n\r\n"; // HTTP/1.1: the connection stays open
+        request = req.str();
+        Restart();
+    }
+
+    // 2. Send on a pooled connection to this host if there is one, else connect; the request
+    //    goes out once the socket turns writable
+    void HttpAnnounce::Restart() {
+        reply = std::make_unique<Reply>();
+        reply->handler.store = params.store;
+        sent = 0;
+        received = 0;
+        fd = TakeIdle(url);
+        reused = fd >= 0;
+        if (reused) {
+            state = SENDING;
+            farm.Add(fd, EPOLLOUT, this);
+            return;
+        }
+        state = CONNECTING;
+        OpenSocket(SOCK_STREAM, [this]() { farm.Add(fd, EPOLLOUT, this); });
+    }
+
+    // The pooled connection we picked had been dropped by the server in the meantime
+    void HttpAnnounce::Reconnect() {
+        Release(false);
+        try {
+            Restart();
+        } catch (const std::exception& e) {
+            Fail(e.what());
+        }
+    }
+
+    void HttpAnnounce::Release(bool keep) {
+        if (fd < 0) return;
+        farm.Remove(fd);
+        if (keep) PutIdle(url, fd);
+        else close(fd);
+        fd = -1;
+    }
+
+    void HttpAnnounce::OnEvent(uint32_t events) {
+        if (state == CONNECTING) {
+            if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) return;
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err) return Fail(std::string("connect: ") + strerror(err));
+            state = SENDING;
+        }
+
+        if (state == SENDING) {
+            while (sent < request.size()) {
+                ssize_t n = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+                if (n < 0) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) return; // Wait for the next EPOLLOUT
+                    if (reused) return Reconnect();
+                    return Fail(std::string("send: ") + strerror(errno));
+                }
+                sent += n;
+            }
+            state = RECEIVING;
+            farm.Modify(fd, EPOLLIN);
+            return;
+        }
+
+        if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) OnReadable();
+    }
+
+    // 3. Receive & Parse as the bytes arrive
+    // The body is fed to the incremental parser chunk by chunk, so decoding overlaps the
+    // transfer. The whole response is read, so the connection can carry the next request.
+    void HttpAnnounce::OnReadable() {
+        uint8_t chunk[8192];
+        try {
+            while (!reply->response.Done()) {
+                ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return; // More later
+                if (n <= 0 && reused && received == 0) return Reconnect();
+                if (n < 0) return Fail(std::string("recv: ") + strerror(errno));
+                if (n == 0) { // Server closed the connection
+                    reply->response.FeedEof();
+                    break;
+                }
+                received += n;
+                reply->response.Feed(chunk, n);
+            }
+        } catch (const std::exception& e) {
+            return Fail(std::string("bad reply: ") + e.what());
+        }
+        Complete();
+    }
+
+    void HttpAnnounce::Complete() {
+        HttpResponse& response = reply->response;
+        if (response.Done()) Release(response.KeepAlive());
+
+        if (response.Done() && response.IsRedirect()) return Redirect(response.Header("location"));
+
+        AnnounceHandler& h = reply->handler;
+        AnnounceResult r;
+        if (!response.Done()) r.error = "truncated reply";
+        else if (response.Status() / 100 != 2) r.error = "HTTP " + std::to_string(response.Status());
+        else if (!reply->parser.Done()) r.error = "truncated reply";
+        else if (!h.failure.empty()) r.error = "tracker refused announce: " + h.failure;
+        r.ok = r.error.empty();
+        r.peers = std::move(h.peers);
+        r.fresh = std::move(h.fresh);
+        r.interval = h.interval;
+        r.min_interval = h.min_interval;
+        r.swarm = h.swarm;
+        for (const auto& hash : params.scrape) {
+            auto it = h.files.find(std::string(hash.begin(), hash.end()));
+            r.swarms.push_back(it == h.files.end() ? SwarmStats() : it->second);
+        }
+        Finish(std::move(r));
+    }
+
+    void HttpAnnounce::Redirect(const std::string& location) {
+        if (location.empty()) return Fail("redirect without a location");
+        if (++redirects > MAX_REDIRECTS) return Fail("too many redirects");
+        try {
+            if (location[0] == '/') {
+                url.path = location; // Same host
+            } else {
+                Url next = Url::Parse(location);
+                if (next.protocol != "http") return Fail("redirect to " + location);
+                url = next;
+            }
+            // Trackers usually redirect to the full announce URL; don't add the query twice
+            query_in_path = url.path.find("info_hash=") != std::string::npos;
+            Begin();
+        } catch (const std::exception& e) {
+            Fail(e.what());
+        }
+    }
+
+    // --- UDP ---
+
+    // What we know about one UDP tracker (host:port): the connection ID it gave us, and the
+    // announces waiting for a connect that is already on its way
+    struct UdpAnnounce::Endpoint {
+        uint64_t connection_id = 0;
+        Farm::Clock::time_point expires;
+        UdpAnnounce* connecting = nullptr;
+        std::vector<UdpAnnounce*> waiting;
+    };
+
+    // Announces only ever run on their Farm's thread, so each loop gets its own cache
+    std::unordered_map<std::string, UdpAnnounce::Endpoint>& UdpAnnounce::Endpoints() {
+        static thread_local std::unordered_map<std::string, Endpoint> endpoints;
+        return endpoints;
+    }
+
+    UdpAnnounce::Endpoint& UdpAnnounce::GetEndpoint() const {
+        return Endpoints()[url.host + ":" + std::to_string(url.port)]; // References stay valid on rehash
+    }
+
+    void UdpAnnounce::ClearConnectionCache() {
+        for (auto& entry : Endpoints()) entry.second.expires = Farm::Clock::time_point();
+    }
+
+    UdpAnnounce::~UdpAnnounce() {
+        Closed(); // The base destructor can't reach this class's override any more
+    }
+
+    void UdpAnnounce::Closed() {
+        if (retry) farm.Cancel(retry);
+        retry = 0;
+        if (state == ANNOUNCING) return;
+
+        Endpoint& ep = GetEndpoint();
+        ep.waiting.erase(std::remove(ep.waiting.begin(), ep.waiting.end(), this), ep.waiting.end());
+        if (ep.connecting != this) return;
+        // We were connecting for everyone: hand the job to the next one in line
+        ep.connecting = nullptr;
+        state = ANNOUNCING; // Don't come back in here
+        if (!ep.waiting.empty()) {
+            UdpAnnounce* next = ep.waiting.front();
+            ep.waiting.erase(ep.waiting.begin());
+            next->SendConnect();
+        }
+    }
+
+    void UdpAnnounce::Begin() {
+        if (params.scrape.size() > MAX_UDP_SCRAPE) throw std::runtime_error("Too many hashes for one UDP scrape");
+        OpenSocket(SOCK_DGRAM, [this]() {
+            // A reply is 20 bytes of header and 6 per peer (18 over IPv6); size the buffer for what we ask for.
+            // A scrape reply is 8 bytes of header and 12 per hash.
+            recv_buf.resize(std::max(20 + (family == AF_INET6 ? 18 : 6) * (size_t)std::max(params.num_want, 50),
+                                     8 + 12 * params.scrape.size()));
+            farm.Add(fd, EPOLLIN, this);
+            Endpoint& ep = GetEndpoint();
+            if (Farm::Clock::now() < ep.expires) {
+                cached_id = true;
+                return SendRequest(ep.connection_id);
+            }
+            if (ep.connecting) {
+                ep.waiting.push_back(this); // Rides on the connect already in flight
+                return;
+            }
+            SendConnect();
+        });
+    }
+
+    void UdpAnnounce::SendConnect() {
+        // --- STEP 1: CONNECT REQUEST ---
+        // Format: [ProtocolID (8 bytes)] [Action=0 (4 bytes)] [TransID (4 bytes)]
+        uint64_t magic_protocol_id = 0x41727101980;
+        transaction_id = RandomTransactionID();
+        request.clear();
+        WriteBE64(request, magic_protocol_id);
+        WriteBE32(request, 0); // Action = 0 (Connect)
+        WriteBE32(request, transaction_id);
+
+        GetEndpoint().connecting = this;
+        cached_id = false;
+        state = CONNECTING;
+        Transmit();
+    }
+
+    // Sends 'request' and arms the retransmission timer: 1, 2, 4 ... 256 times udp_retry_ms
+    void UdpAnnounce::Transmit() {
+        if (send(fd, request.data(), request.size(), 0) < 0) {
+            return Fail(std::string("send: ") + strerror(errno));
+        }
+        if (retry) farm.Cancel(retry);
+        retry = farm.After(std::chrono::milliseconds((int64_t)params.udp_retry_ms << retransmits), [this]() {
+            retry = 0;
+            if (Done()) return;
+            if (retransmits == MAX_RETRANSMITS) return Fail("no reply");
+            retransmits++;
+            // The connection ID has run out while we waited: resending it is pointless
+            if (state == ANNOUNCING && Farm::Clock::now() >= id_expires) return Reconnect();
+            Transmit();
+        });
+    }
+
+    void UdpAnnounce::Reconnect() {
+        Endpoint& ep = GetEndpoint();
+        reconnected = true;
+        if (ep.expires > id_expires) return SendRequest(ep.connection_id); // Someone got a newer one
+        ep.expires = Farm::Clock::time_point();
+        if (ep.connecting) {
+            state = WAITING;
+            ep.waiting.push_back(this);
+        } else {
+            SendConnect();
+        }
+    }
+
+    void UdpAnnounce::OnEvent(uint32_t events) {
+        if (!(events & (EPOLLIN | EPOLLERR))) return;
+        while (!Done()) {
+            // MSG_TRUNC: 'len' is the real datagram size, even if it didn't fit
+            ssize_t len = recv(fd, recv_buf.data(), recv_buf.size(), MSG_TRUNC);
+            if (len < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+                return Fail(std::string("recv: ") + strerror(errno)); // e.g. ICMP port unreachable
+            }
+            if ((size_t)len > recv_buf.size()) {
+                std::cerr << "[Tracker] " << url.host << ": reply cut to " << recv_buf.size() << " of " << len << " bytes" << std::endl;
+                len = recv_buf.size();
+            }
+            OnDatagram(Buffer(recv_buf.begin(), recv_buf.begin() + len));
+        }
+    }
+
+    void UdpAnnounce::OnDatagram(const Buffer& b) {
+        // Every reply starts with [Action (4)] [TransID (4)]; anything else isn't ours
+        if (b.size() < 8 || BufferUtils::ReadBE32(b, 4) != transaction_id) return;
+        uint32_t action = BufferUtils::ReadBE32(b, 0);
+
+        if (action == 3) { // Error: the rest is a message
+            // Most likely our cached connection ID has expired on the tracker's side. Try once more.
+            if (state == ANNOUNCING && cached_id && !reconnected) return Reconnect();
+            return Fail("tracker error: " + std::string(b.begin() + 8, b.end()));
+        }
+
+        if (state == CONNECTING && action == 0 && b.size() >= 16) {
+            // [Action (4)] [TransID (4)] [ConnectionID (8)]
+            uint64_t connection_id = 0;
+            for (int i = 0; i < 8; i++) connection_id = (connection_id << 8) | b[8 + i];
+
+            Endpoint& ep = GetEndpoint();
+            ep.connection_id = connection_id;
+            ep.expires = Farm::Clock::now() + std::chrono::seconds(CONNECTION_ID_TTL_S);
+            ep.connecting = nullptr;
+            std::vector<UdpAnnounce*> waiting;
+            waiting.swap(ep.waiting);
+
+            SendRequest(connection_id);
+            for (UdpAnnounce* other : waiting) other->SendRequest(connection_id);
+            return;
+        }
+
+        if (state == ANNOUNCING && action == 2 && !params.scrape.empty()) {
+            // Response Format: [Action (4)] [TransID (4)] then per hash, in request order:
+            // [Seeders (4)] [Completed (4)] [Leechers (4)]. Hashes it doesn't know may be cut off the end.
+            AnnounceResult r;
+            r.ok = true;
+            for (size_t i = 0; i < params.scrape.size(); i++) {
+                SwarmStats s;
+                size_t off = 8 + 12 * i;
+                if (off + 12 <= b.size()) {
+                    s.seeders = (int)BufferUtils::ReadBE32(b, off);
+                    s.downloaded = (int)BufferUtils::ReadBE32(b, off + 4);
+                    s.leechers = (int)BufferUtils::ReadBE32(b, off + 8);
+                }
+                r.swarms.push_back(s);
+            }
+            return Finish(std::move(r));
+        }
+
+        if (state == ANNOUNCING && action == 1 && b.size() >= 20 && params.scrape.empty()) {
+            // Response Format: [Action (4)] [TransID (4)] [Interval (4)] [Leechers (4)] [Seeders (4)] [Peers...]
+            AnnounceResult r;
+            r.ok = true;
+            r.interval = BufferUtils::ReadBE32(b, 8);
+            r.swarm.leechers = (int)BufferUtils::ReadBE32(b, 12);
+            r.swarm.seeders = (int)BufferUtils::ReadBE32(b, 16);
+            // BEP 15: the tracker answers with peers of the family we asked over
+            if (params.store && family == AF_INET6) params.store->AddCompact6(b.data() + 20, b.size() - 20, PeerSource::TRACKER, &r.fresh);
+            else if (params.store) params.store->AddCompact(b.data() + 20, b.size() - 20, PeerSource::TRACKER, &r.fresh);
+            else if (family == AF_INET6) ParseCompactPeers6(b.data() + 20, b.size() - 20, r.peers);
+            else ParseCompactPeers(b.data() + 20, b.size() - 20, r.peers);
+            Finish(std::move(r));
+        }
+    }
+
+    void UdpAnnounce::SendRequest(uint64_t connection_id) {
+        if (params.scrape.empty()) SendAnnounce(connection_id);
+        else SendScrape(connection_id);
+    }
+
+    void UdpAnnounce::SendScrape(uint64_t connection_id) {
+        // Format: [ConnID (8)] [Action=2 (4)] [TransID (4)] [InfoHash (20)] * N
+        transaction_id = RandomTransactionID();
+        request.clear();
+        WriteBE64(request, connection_id);
+        WriteBE32(request, 2);                  // Action = 2 (Scrape)
+        WriteBE32(request, transaction_id);
+        for (const auto& hash : params.scrape) request.insert(request.end(), hash.begin(), hash.end());
+
+        id_expires = GetEndpoint().expires;
+        state = ANNOUNCING;
+        Transmit();
+    }
+
+    void UdpAnnounce::SendAnnounce(uint64_t connection_id) {
+        // --- STEP 2: ANNOUNCE REQUEST ---
+        // Format: [ConnID (8)] [Action=1 (4)] [TransID (4)] [InfoHash (20)] [PeerID (20)] [Downloaded (8)] ...
+        transaction_id = RandomTransactionID();
+        request.clear();
+        WriteBE64(request, connection_id);      // Connection ID from Step 1
+        WriteBE32(request, 1);                  // Action = 1 (Announce)
+        WriteBE32(request, transaction_id);
+
+        // Info Hash & Peer ID
+        request.insert(request.end(), params.info_hash.begin(), params.info_hash.end());
+        request.insert(request.end(), params.peer_id.begin(), params.peer_id.end());
+
+        WriteBE64(request, params.downloaded);
+        WriteBE64(request, params.left);
+        WriteBE64(request, params.uploaded);
+        WriteBE32(request, (uint32_t)params.event); // Event (0 = None, 1 = Completed, 2 = Started, 3 = Stopped)
+        WriteBE32(request, 0); // IP (0 = Default)
+        WriteBE32(request, RandomTransactionID()); // Key (Random)
+        WriteBE32(request, params.num_want);
+
+        // Port (2 bytes)
+        request.push_back((params.port >> 8) & 0xFF);
+        request.push_back(params.port & 0xFF);
+
+        id_expires = GetEndpoint().expires;
+        state = ANNOUNCING;
+        Transmit();
+    }
+}
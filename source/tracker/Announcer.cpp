@@ -0,0 +1,235 @@
+#include "tracker/Announcer.h"
+#include "tracker/Scraper.h"
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+
+namespace BitTorrent {
+
+    // Local Helper: 'p' times out after 'cap_ms' at the latest
+    static void Cap(AnnounceParams& p, int cap_ms) {
+        p.timeout_ms = p.timeout_ms > 0 ? std::min(p.timeout_ms, cap_ms) : cap_ms;
+    }
+
+    void TrackerStats::Record(const AnnounceResult& r) {
+        attempts++;
+        if (!r.ok) return;
+        successes++;
+        avg_latency_ms += (r.latency_ms - avg_latency_ms) / successes; // Running mean
+    }
+
+    TrackerStats& Announcer::Stats(const std::string& url) {
+        static std::unordered_map<std::string, TrackerStats> stats; // Loop thread only
+        return stats[url];
+    }
+
+    Announcer::Announcer(Farm& farm, std::vector<std::vector<std::string>> tier_urls, const AnnounceParams& params, PeersCallback on_peers)
+        : Announcer(farm, std::move(tier_urls), params, own_store, nullptr) {
+        this->on_peers = std::move(on_peers);
+    }
+
+    Announcer::Announcer(Farm& farm, std::vector<std::vector<std::string>> tier_urls, const AnnounceParams& params, PeerStore& store,
+                         FreshCallback on_fresh)
+        : farm(farm), params(params), on_fresh(std::move(on_fresh)), store(&store) {
+        for (auto& urls : tier_urls) {
+            if (urls.empty()) continue;
+            tiers.emplace_back();
+            tiers.back().urls = std::move(urls);
+        }
+    }
+
+    Announcer::~Announcer() {
+        for (auto& tier : tiers) {
+            if (tier.stagger) farm.Cancel(tier.stagger);
+            if (tier.reannounce) farm.Cancel(tier.reannounce);
+        }
+        // 'running' announces unregister themselves from the Farm as they are destroyed
+    }
+
+    void Announcer::Start() {
+        for (auto& tier : tiers) Round(tier, AnnounceEvent::STARTED, START_TIMEOUT_MS);
+    }
+
+    void Announcer::Send(AnnounceEvent event) {
+        for (auto& tier : tiers) Round(tier, event, event == AnnounceEvent::COMPLETED ? STOP_TIMEOUT_MS : 0);
+    }
+
+    void Announcer::AnnounceSoon() {
+        auto now = Farm::Clock::now();
+        for (auto& tier : tiers) {
+            if (!tier.settled || now - tier.last_round < std::chrono::seconds(tier.min_interval)) continue;
+            Round(tier, AnnounceEvent::NONE);
+        }
+    }
+
+    void Announcer::Stop() {
+        if (stopped) return;
+        stopped = true;
+        for (auto& tier : tiers) {
+            Abandon(tier);
+            tier.settled = true;
+            if (tier.working.empty()) continue; // Never got through: nobody to say goodbye to
+
+            AnnounceParams p = CurrentParams(AnnounceEvent::STOPPED);
+            Cap(p, STOP_TIMEOUT_MS);
+            try {
+                tier.running.push_back({tier.working, Announce::Create(farm, tier.working, p, [](AnnounceResult&) {})});
+            } catch (const std::exception&) {}
+        }
+    }
+
+    bool Announcer::Done() const {
+        for (const auto& tier : tiers) {
+            if (!tier.settled && tier.next < tier.urls.size()) return false;
+            for (const auto& a : tier.running) {
+                if (!a.announce->Done()) return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<Peer> Announcer::Peers() const {
+        std::vector<Peer> out;
+        out.reserve(store->Size());
+        for (uint32_t i = 0; i < store->Size(); i++) out.push_back((*store)[i].key.ToPeer());
+        return out;
+    }
+
+    SwarmStats Announcer::BestSwarm() const {
+        SwarmStats best;
+        for (const auto& [url, swarm] : swarms) {
+            if (swarm.Known() && (!best.Known() || swarm.Peers() > best.Peers())) best = swarm;
+        }
+        return best;
+    }
+
+    AnnounceParams Announcer::CurrentParams(AnnounceEvent event) const {
+        AnnounceParams p = params;
+        if (progress) progress(p);
+        p.event = event;
+        p.store = store;
+        return p;
+    }
+
+    // Drops the tier's timers and whatever it still has in flight
+    void Announcer::Abandon(Tier& tier) {
+        if (tier.stagger) farm.Cancel(tier.stagger);
+        if (tier.reannounce) farm.Cancel(tier.reannounce);
+        tier.stagger = tier.reannounce = 0;
+        for (auto& a : tier.running) {
+            if (!a.announce->Done()) a.announce->Cancel();
+        }
+        tier.running.clear();
+    }
+
+    // A fresh race through the tier, best-ranked tracker first
+    void Announcer::Round(Tier& tier, AnnounceEvent event, int timeout_ms) {
+        if (stopped) return;
+        Abandon(tier);
+        if (ranking) tier.urls = ranking(std::move(tier.urls));
+        // Trackers with an empty swarm last; otherwise fastest, most reliable first; ties keep the order above
+        auto alive = [this](const std::string& url) {
+            auto it = swarms.find(url);
+            return it == swarms.end() || Scraper::Health(it->second) > 0;
+        };
+        std::stable_sort(tier.urls.begin(), tier.urls.end(), [&](const std::string& a, const std::string& b) {
+            if (alive(a) != alive(b)) return alive(a);
+            return Stats(a).ExpectedMs() < Stats(b).ExpectedMs();
+        });
+        tier.next = 0;
+        tier.settled = false;
+        tier.event = event;
+        tier.timeout_ms = timeout_ms;
+        tier.last_round = Farm::Clock::now();
+        Launch(tier);
+    }
+
+    // Starts the tier's next tracker, and arms the stagger timer for the one after it
+    void Announcer::Launch(Tier& tier) {
+        if (tier.stagger) farm.Cancel(tier.stagger);
+        tier.stagger = 0;
+
+        while (!tier.settled && tier.next < tier.urls.size()) {
+            std::string url = tier.urls[tier.next++];
+            AnnounceParams p = CurrentParams(tier.event);
+            if (tier.timeout_ms > 0) Cap(p, tier.timeout_ms);
+            try {
+                tier.running.push_back({url, Announce::Create(farm, url, p, [this, &tier, url](AnnounceResult& r) {
+                    OnResult(tier, url, r);
+                })});
+            } catch (const std::exception& e) {
+                std::cerr << "[Tracker] " << url << ": " << e.what() << std::endl; // e.g. https://
+                continue;
+            }
+            if (tier.running.back().announce->Done()) continue; // Failed on the spot, try the next one now
+
+            if (tier.next < tier.urls.size()) {
+                tier.stagger = farm.After(std::chrono::milliseconds(stagger_ms), [this, &tier]() {
+                    tier.stagger = 0;
+                    Launch(tier);
+                });
+            }
+            return;
+        }
+        CheckExhausted(tier);
+    }
+
+    void Announcer::OnResult(Tier& tier, const std::string& url, AnnounceResult& r) {
+        Stats(url).Record(r);
+        if (stopped) return;
+        if (!r.ok) {
+            std::cerr << "[Tracker] " << url << ": " << r.error << std::endl;
+            // Don't sit out the stagger: the next tracker can go right now. (A failure inside
+            // Create() has no timer armed yet; Launch() moves on by itself then.)
+            if (tier.stagger) Launch(tier);
+            else CheckExhausted(tier);
+            return;
+        }
+
+        // First answer wins the round: stop the timer and everyone still waiting. Losing the race
+        // counts as an attempt without success, so slow trackers sink in the ranking too.
+        tier.settled = true;
+        if (tier.stagger) farm.Cancel(tier.stagger);
+        tier.stagger = 0;
+        for (auto& a : tier.running) {
+            if (a.announce->Done()) continue;
+            a.announce->Cancel();
+            Stats(a.url).attempts++;
+        }
+
+        tier.working = url;
+        tier.failed_rounds = 0;
+        if (r.swarm.Known()) swarms[url] = r.swarm;
+        tier.interval = r.interval > 0 ? r.interval : DEFAULT_INTERVAL_S;
+        tier.min_interval = r.min_interval > 0 ? r.min_interval : std::min(DEFAULT_MIN_INTERVAL_S, tier.interval);
+        Schedule(tier, std::max(tier.interval, tier.min_interval));
+
+        if (on_fresh) return on_fresh(r.fresh.size());
+        std::vector<Peer> fresh;
+        for (uint32_t i : r.fresh) fresh.push_back((*store)[i].key.ToPeer());
+        if (on_peers) on_peers(fresh);
+    }
+
+    // Every tracker of the tier failed this round: back off, then race them all again
+    void Announcer::CheckExhausted(Tier& tier) {
+        if (tier.settled || tier.next < tier.urls.size()) return;
+        for (const auto& a : tier.running) {
+            if (!a.announce->Done()) return;
+        }
+        tier.settled = true;
+        int backoff = RETRY_BASE_S << std::min(tier.failed_rounds, 7);
+        tier.failed_rounds++;
+        Schedule(tier, std::min(backoff, tier.interval));
+    }
+
+    void Announcer::Schedule(Tier& tier, int seconds) {
+        if (tier.reannounce) farm.Cancel(tier.reannounce);
+        tier.reannounce = 0;
+        if (stopped) return;
+        tier.reannounce = farm.After(std::chrono::seconds(seconds), [this, &tier]() {
+            tier.reannounce = 0;
+            // Until some tracker of the tier has heard 'started', every retry is still the start
+            Round(tier, tier.working.empty() ? AnnounceEvent::STARTED : AnnounceEvent::NONE);
+        });
+    }
+}
@@ -0,0 +1,113 @@
+#include "tracker/Dialer.h"
+#include <netinet/in.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+namespace BitTorrent {
+
+    Dialer::Dialer(Farm& farm, std::vector<sockaddr_storage> addresses, Callback done)
+        : farm(farm), addresses(std::move(addresses)), done(std::move(done)) {}
+
+    Dialer::~Dialer() {
+        if (stagger) farm.Cancel(stagger);
+        for (auto& a : attempts) {
+            farm.Remove(a->fd);
+            close(a->fd);
+        }
+    }
+
+    std::vector<sockaddr_storage> Dialer::Interleave(const std::vector<sockaddr_storage>& addresses) {
+        if (addresses.empty()) return {};
+        int first = addresses[0].ss_family;
+        std::vector<sockaddr_storage> same, other, out;
+        for (const auto& a : addresses) (a.ss_family == first ? same : other).push_back(a);
+        for (size_t i = 0; i < same.size() || i < other.size(); ++i) {
+            if (i < same.size()) out.push_back(same[i]);
+            if (i < other.size()) out.push_back(other[i]);
+        }
+        return out;
+    }
+
+    void Dialer::Start() {
+        if (addresses.empty()) return Finish(-1, "no addresses");
+        StartNext();
+    }
+
+    // Launches attempts until one is pending (or connected on the spot), then arms the stagger
+    void Dialer::StartNext() {
+        if (stagger) farm.Cancel(stagger);
+        stagger = 0;
+
+        while (next < addresses.size()) {
+            const sockaddr_storage& addr = addresses[next++];
+            socklen_t len = addr.ss_family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+            int fd = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd < 0) {
+                last_error = std::string("socket: ") + strerror(errno);
+                continue;
+            }
+            if (connect(fd, (const sockaddr*)&addr, len) < 0 && errno != EINPROGRESS) {
+                last_error = std::string("connect: ") + strerror(errno); // e.g. no IPv6 route
+                close(fd);
+                continue;
+            }
+            auto a = std::make_unique<Attempt>();
+            a->owner = this;
+            a->fd = fd;
+            farm.Add(fd, EPOLLOUT, a.get());
+            attempts.push_back(std::move(a));
+
+            if (next < addresses.size()) {
+                stagger = farm.After(std::chrono::milliseconds(STAGGER_MS), [this]() {
+                    stagger = 0;
+                    StartNext();
+                });
+            }
+            return;
+        }
+        if (attempts.empty()) Finish(-1, last_error);
+    }
+
+    void Dialer::OnWritable(Attempt* a) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(a->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err) {
+            last_error = std::string("connect: ") + strerror(err);
+            Drop(a);
+            return StartNext(); // Don't wait out the stagger after a failure
+        }
+
+        // Winner: it leaves the epoll set and goes to the caller; the rest are closed
+        int fd = a->fd;
+        farm.Remove(fd);
+        for (auto& other : attempts) {
+            if (other.get() == a) continue;
+            farm.Remove(other->fd);
+            close(other->fd);
+        }
+        attempts.clear();
+        Finish(fd, "");
+    }
+
+    void Dialer::Drop(Attempt* a) {
+        farm.Remove(a->fd);
+        close(a->fd);
+        for (auto it = attempts.begin(); it != attempts.end(); ++it) {
+            if (it->get() == a) {
+                attempts.erase(it);
+                break;
+            }
+        }
+    }
+
+    void Dialer::Finish(int fd, const std::string& error) {
+        if (stagger) farm.Cancel(stagger);
+        stagger = 0;
+        next = addresses.size();
+        Callback cb = std::move(done);
+        done = nullptr;
+        if (cb) cb(fd, error); // May destroy us: nothing after this
+    }
+}
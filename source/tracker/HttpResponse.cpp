@@ -0,0 +1,178 @@
+#include "tracker/HttpResponse.h"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace BitTorrent {
+
+    static std::string Lower(std::string s) {
+        std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        return s;
+    }
+
+    static std::string Trim(const std::string& s) {
+        size_t b = s.find_first_not_of(" \t"), e = s.find_last_not_of(" \t\r");
+        return b == std::string::npos ? "" : s.substr(b, e - b + 1);
+    }
+
+    HttpResponse::HttpResponse(BodyFn on_body) : on_body(std::move(on_body)) {}
+
+    std::string HttpResponse::Header(const std::string& name) const {
+        std::string key = Lower(name);
+        for (const auto& h : headers) {
+            if (h.first == key) return h.second;
+        }
+        return "";
+    }
+
+    bool HttpResponse::KeepAlive() const {
+        std::string conn = Lower(Header("connection"));
+        if (conn.find("close") != std::string::npos) return false;
+        if (http10) return conn.find("keep-alive") != std::string::npos;
+        return true; // HTTP/1.1 default
+    }
+
+    // Appends bytes to 'line' until CRLF; true (with the CRLF stripped) once the line is complete
+    bool HttpResponse::TakeLine(const uint8_t*& p, const uint8_t* end) {
+        const uint8_t* nl = std::find(p, end, (uint8_t)'\n');
+        line.append((const char*)p, (nl == end ? end : nl) - p);
+        if (line.size() > MAX_HEADER_BYTES) throw std::runtime_error("HTTP line too long");
+        if (nl == end) {
+            p = end;
+            return false;
+        }
+        p = nl + 1;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        return true;
+    }
+
+    size_t HttpResponse::Feed(const uint8_t* data, size_t size) {
+        const uint8_t* p = data;
+        const uint8_t* end = data + size;
+
+        while (p < end && state != DONE) {
+            switch (state) {
+                case HEADERS: {
+                    // Only look for the blank line in the part not searched before
+                    size_t scan_from = line.size() >= 3 ? line.size() - 3 : 0;
+                    size_t before = line.size();
+                    line.append((const char*)p, end - p);
+                    size_t header_end = line.find("\r\n\r\n", scan_from);
+                    if (header_end == std::string::npos) {
+                        if (line.size() > MAX_HEADER_BYTES) throw std::runtime_error("HTTP header too large");
+                        p = end;
+                        break;
+                    }
+                    p += header_end + 4 - before;
+                    line.resize(header_end);
+                    ParseHeaders();
+                    break;
+                }
+
+                case BODY_LENGTH: {
+                    size_t n = (size_t)std::min<uint64_t>(remaining, end - p);
+                    on_body(p, n);
+                    p += n;
+                    remaining -= n;
+                    if (remaining == 0) state = DONE;
+                    break;
+                }
+
+                case BODY_UNTIL_CLOSE:
+                    on_body(p, end - p);
+                    p = end;
+                    break;
+
+                case CHUNK_SIZE: {
+                    if (!TakeLine(p, end)) break;
+                    // "1a2b;name=value": hex size, extensions ignored
+                    size_t digits = 0;
+                    remaining = 0;
+                    while (digits < line.size() && std::isxdigit((unsigned char)line[digits])) {
+                        if (digits == 16) throw std::runtime_error("HTTP chunk too large");
+                        char c = (char)std::tolower((unsigned char)line[digits]);
+                        remaining = remaining * 16 + (std::isdigit((unsigned char)c) ? c - '0' : c - 'a' + 10);
+                        digits++;
+                    }
+                    if (digits == 0) throw std::runtime_error("bad HTTP chunk size");
+                    line.clear();
+                    state = remaining ? CHUNK_DATA : TRAILERS;
+                    break;
+                }
+
+                case CHUNK_DATA: {
+                    size_t n = (size_t)std::min<uint64_t>(remaining, end - p);
+                    on_body(p, n);
+                    p += n;
+                    remaining -= n;
+                    if (remaining == 0) state = CHUNK_END;
+                    break;
+                }
+
+                case CHUNK_END: // The CRLF after the chunk data
+                    if (!TakeLine(p, end)) break;
+                    if (!line.empty()) throw std::runtime_error("bad HTTP chunk");
+                    state = CHUNK_SIZE;
+                    break;
+
+                case TRAILERS: // Zero or more trailer fields, then an empty line
+                    if (!TakeLine(p, end)) break;
+                    if (line.empty()) state = DONE;
+                    line.clear();
+                    break;
+
+                case DONE:
+                    break;
+            }
+        }
+        return p - data;
+    }
+
+    void HttpResponse::FeedEof() {
+        if (state == BODY_UNTIL_CLOSE) state = DONE;
+    }
+
+    // Status line and fields of the block in 'line'; picks how the body is framed
+    void HttpResponse::ParseHeaders() {
+        std::string block = std::move(line);
+        line.clear();
+        headers.clear();
+
+        size_t eol = block.find("\r\n");
+        std::string status_line = block.substr(0, eol);
+        if (status_line.compare(0, 5, "HTTP/") != 0 || status_line.size() < 12) {
+            throw std::runtime_error("not an HTTP response");
+        }
+        http10 = status_line.compare(5, 3, "1.0") == 0;
+        status = std::stoi(status_line.substr(9, 3));
+
+        while (eol != std::string::npos) {
+            size_t start = eol + 2;
+            eol = block.find("\r\n", start);
+            std::string field = block.substr(start, eol == std::string::npos ? std::string::npos : eol - start);
+            size_t colon = field.find(':');
+            if (colon == std::string::npos) continue;
+            headers.emplace_back(Lower(Trim(field.substr(0, colon))), Trim(field.substr(colon + 1)));
+        }
+
+        if (status >= 100 && status < 200) { // Interim (100 Continue): the real one follows
+            state = HEADERS;
+            return;
+        }
+        if (status == 204 || status == 304) {
+            state = DONE;
+            return;
+        }
+        if (Lower(Header("transfer-encoding")).find("chunked") != std::string::npos) {
+            state = CHUNK_SIZE;
+            return;
+        }
+        std::string length = Header("content-length");
+        if (!length.empty()) {
+            remaining = std::stoull(length);
+            state = remaining ? BODY_LENGTH : DONE;
+            return;
+        }
+        state = BODY_UNTIL_CLOSE;
+    }
+}
@@ -0,0 +1,61 @@
+#include "tracker/Peer.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <cstring>
+#include <stdexcept>
+
+namespace BitTorrent {
+
+    Peer::Peer(const std::string& ip, uint16_t port, std::string pid) : id(std::move(pid)) {
+        auto* v4 = (sockaddr_in*)&addr;
+        auto* v6 = (sockaddr_in6*)&addr;
+        if (inet_pton(AF_INET, ip.c_str(), &v4->sin_addr) == 1) {
+            v4->sin_family = AF_INET;
+            v4->sin_port = htons(port);
+        } else if (inet_pton(AF_INET6, ip.c_str(), &v6->sin6_addr) == 1) {
+            v6->sin6_family = AF_INET6;
+            v6->sin6_port = htons(port);
+        } else {
+            throw std::runtime_error("Invalid peer address: " + ip);
+        }
+    }
+
+    Peer Peer::FromV4(const uint8_t* ip, uint16_t port) {
+        Peer p;
+        auto* v4 = (sockaddr_in*)&p.addr;
+        v4->sin_family = AF_INET;
+        std::memcpy(&v4->sin_addr, ip, 4);
+        v4->sin_port = htons(port);
+        return p;
+    }
+
+    Peer Peer::FromV6(const uint8_t* ip, uint16_t port) {
+        Peer p;
+        auto* v6 = (sockaddr_in6*)&p.addr;
+        v6->sin6_family = AF_INET6;
+        std::memcpy(&v6->sin6_addr, ip, 16);
+        v6->sin6_port = htons(port);
+        return p;
+    }
+
+    uint16_t Peer::Port() const {
+        if (Family() == AF_INET6) return ntohs(((const sockaddr_in6*)&addr)->sin6_port);
+        return ntohs(((const sockaddr_in*)&addr)->sin_port);
+    }
+
+    socklen_t Peer::Length() const {
+        return Family() == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+    }
+
+    std::string Peer::Ip() const {
+        char s[INET6_ADDRSTRLEN] = "";
+        if (Family() == AF_INET6) inet_ntop(AF_INET6, &((const sockaddr_in6*)&addr)->sin6_addr, s, sizeof(s));
+        else if (Family() == AF_INET) inet_ntop(AF_INET, &((const sockaddr_in*)&addr)->sin_addr, s, sizeof(s));
+        return s;
+    }
+
+    std::string Peer::ToString() const {
+        if (Family() == AF_INET6) return "[" + Ip() + "]:" + std::to_string(Port());
+        return Ip() + ":" + std::to_string(Port());
+    }
+}
@@ -0,0 +1,178 @@
+#include "tracker/PeerStore.h"
+#include <netinet/in.h>
+#include <algorithm>
+#include <cstring>
+
+namespace BitTorrent {
+
+    static const uint8_t V4_MAPPED[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+
+    PeerKey PeerKey::FromV4(const uint8_t* ip, uint16_t port) {
+        PeerKey k;
+        std::memcpy(k.ip, V4_MAPPED, 12);
+        std::memcpy(k.ip + 12, ip, 4);
+        k.port = port;
+        return k;
+    }
+
+    PeerKey PeerKey::FromV6(const uint8_t* ip, uint16_t port) {
+        PeerKey k;
+        std::memcpy(k.ip, ip, 16);
+        k.port = port;
+        return k;
+    }
+
+    PeerKey PeerKey::From(const Peer& p) {
+        if (p.Family() == AF_INET6) return FromV6((const uint8_t*)&((const sockaddr_in6*)&p.addr)->sin6_addr, p.Port());
+        return FromV4((const uint8_t*)&((const sockaddr_in*)&p.addr)->sin_addr, p.Port());
+    }
+
+    bool PeerKey::IsV4() const { return std::memcmp(ip, V4_MAPPED, 12) == 0; }
+
+    Peer PeerKey::ToPeer() const { return IsV4() ? Peer::FromV4(ip + 12, port) : Peer::FromV6(ip, port); }
+
+    bool PeerKey::operator==(const PeerKey& o) const { return port == o.port && std::memcmp(ip, o.ip, 16) == 0; }
+
+    // Two 64-bit halves of the address and the port through a multiply-xorshift mix
+    uint64_t PeerStore::Hash(const PeerKey& key) {
+        uint64_t a, b;
+        std::memcpy(&a, key.ip, 8);
+        std::memcpy(&b, key.ip + 8, 8);
+        uint64_t h = (a * 0x9E3779B97F4A7C15ull) ^ (b + key.port) * 0xC2B2AE3D27D4EB4Full;
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ull;
+        return h ^ (h >> 32);
+    }
+
+    PeerStore::PeerStore() : slots(64, 0) {}
+
+    void PeerStore::Grow() {
+        std::vector<uint32_t> bigger(slots.size() * 2, 0);
+        size_t mask = bigger.size() - 1;
+        for (uint32_t i = 0; i < peers.size(); ++i) {
+            size_t s = Hash(peers[i].key) & mask;
+            while (bigger[s]) s = (s + 1) & mask;
+            bigger[s] = i + 1;
+        }
+        slots.swap(bigger);
+    }
+
+    int64_t PeerStore::Find(const PeerKey& key) const {
+        size_t mask = slots.size() - 1;
+        for (size_t s = Hash(key) & mask; slots[s]; s = (s + 1) & mask) {
+            if (peers[slots[s] - 1].key == key) return slots[s] - 1;
+        }
+        return -1;
+    }
+
+    uint32_t PeerStore::Add(const PeerKey& key, PeerSource source, bool* added) {
+        if ((peers.size() + 1) * 2 > slots.size()) Grow();
+        size_t mask = slots.size() - 1;
+        size_t s = Hash(key) & mask;
+        for (; slots[s]; s = (s + 1) & mask) {
+            if (peers[slots[s] - 1].key == key) {
+                if (added) *added = false;
+                return slots[s] - 1;
+            }
+        }
+        uint32_t index = (uint32_t)peers.size();
+        slots[s] = index + 1;
+        PeerInfo info;
+        info.key = key;
+        info.source = source;
+        info.score = source == PeerSource::GIVEN ? 1 : 0; // Someone picked these for us
+        peers.push_back(info);
+        MakeReady(index);
+        if (added) *added = true;
+        return index;
+    }
+
+    size_t PeerStore::AddCompact(const uint8_t* data, size_t size, PeerSource source, std::vector<uint32_t>* fresh) {
+        size_t count = 0;
+        for (size_t i = 0; i + 6 <= size; i += 6) {
+            bool added;
+            uint32_t index = Add(PeerKey::FromV4(data + i, (uint16_t)(data[i + 4] << 8 | data[i + 5])), source, &added);
+            if (!added) continue;
+            count++;
+            if (fresh) fresh->push_back(index);
+        }
+        return count;
+    }
+
+    size_t PeerStore::AddCompact6(const uint8_t* data, size_t size, PeerSource source, std::vector<uint32_t>* fresh) {
+        size_t count = 0;
+        for (size_t i = 0; i + 18 <= size; i += 18) {
+            bool added;
+            uint32_t index = Add(PeerKey::FromV6(data + i, (uint16_t)(data[i + 16] << 8 | data[i + 17])), source, &added);
+            if (!added) continue;
+            count++;
+            if (fresh) fresh->push_back(index);
+        }
+        return count;
+    }
+
+    void PeerStore::MakeReady(uint32_t index) {
+        PeerInfo& p = peers[index];
+        p.state = PeerInfo::READY;
+        ready[p.key.IsV4() ? 0 : 1].push({p.score, index});
+    }
+
+    void PeerStore::Promote(Clock::time_point now) {
+        while (!waiting.empty() && waiting.top().first <= now) {
+            uint32_t index = waiting.top().second;
+            waiting.pop();
+            MakeReady(index);
+        }
+    }
+
+    bool PeerStore::Next(uint32_t& index, int family, Clock::time_point now) {
+        Promote(now);
+        int first = family == AF_INET6 ? 1 : 0;
+        // Without a preference, the better of the two heads
+        if (!family && !ready[0].empty() && !ready[1].empty() && ready[0].top() < ready[1].top()) first = 1;
+        for (int f : {first, 1 - first}) {
+            if (ready[f].empty()) continue;
+            index = ready[f].top().index;
+            ready[f].pop();
+            peers[index].state = PeerInfo::DIALLED;
+            return true;
+        }
+        return false;
+    }
+
+    bool PeerStore::HasCandidates(Clock::time_point now) {
+        Promote(now);
+        return !ready[0].empty() || !ready[1].empty();
+    }
+
+    void PeerStore::Closed(uint32_t index, bool useful, Clock::time_point now) {
+        if (!useful) return Failed(index, now);
+        PeerInfo& p = peers[index];
+        if (p.state != PeerInfo::DIALLED) return;
+        p.failures = 0;
+        p.score = std::min(p.score + 2, 100);
+        p.state = PeerInfo::WAITING;
+        p.retry_at = now + std::chrono::seconds(REDIAL_S);
+        waiting.push({p.retry_at, index});
+    }
+
+    void PeerStore::Requeue(uint32_t index) {
+        if (peers[index].state != PeerInfo::DIALLED) return;
+        MakeReady(index);
+    }
+
+    void PeerStore::Failed(uint32_t index, Clock::time_point now) {
+        PeerInfo& p = peers[index];
+        if (p.state != PeerInfo::DIALLED) return;
+        p.failures++;
+        p.score = std::max(p.score - 1, -100);
+        p.last_failure = now;
+        if (p.failures >= MAX_FAILURES) {
+            p.state = PeerInfo::RETIRED;
+            return;
+        }
+        p.state = PeerInfo::WAITING;
+        p.retry_at = now + std::chrono::seconds(std::min(BACKOFF_BASE_S << (p.failures - 1), MAX_BACKOFF_S));
+        waiting.push({p.retry_at, index});
+    }
+}
@@ -0,0 +1,277 @@
+#include "tracker/Resolver.h"
+#include "download/Farm.h"
+#include <algorithm>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace BitTorrent {
+
+    // Local Helper: the real lookup. Both families, in the system's preferred order (RFC 6724).
+    static ResolveResult SystemLookup(const std::string& host) {
+        ResolveResult r;
+        struct addrinfo hints{}, *res = nullptr;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_flags = AI_ADDRCONFIG; // No AAAA answers on hosts without IPv6, and vice versa
+        int rc = getaddrinfo(host.c_str(), nullptr, &hints, &res);
+        if (rc != 0) {
+            r.error = "Could not resolve host: " + host + " (" + gai_strerror(rc) + ")";
+            return r;
+        }
+        for (auto* ai = res; ai; ai = ai->ai_next) {
+            sockaddr_storage a{};
+            std::memcpy(&a, ai->ai_addr, ai->ai_addrlen);
+            bool dup = false;
+            for (auto& b : r.addresses) dup = dup || std::memcmp(&a, &b, sizeof(a)) == 0;
+            if (!dup) r.addresses.push_back(a); // One entry per socket type otherwise
+        }
+        freeaddrinfo(res);
+        r.ok = !r.addresses.empty();
+        if (!r.ok) r.error = "No addresses for host: " + host;
+        return r;
+    }
+
+    // Local Helper: "1.2.3.4" or "::1" needs no lookup at all
+    static bool ParseLiteral(const std::string& host, ResolveResult& r) {
+        sockaddr_storage a{};
+        auto* v4 = (sockaddr_in*)&a;
+        auto* v6 = (sockaddr_in6*)&a;
+        if (inet_pton(AF_INET, host.c_str(), &v4->sin_addr) == 1) v4->sin_family = AF_INET;
+        else if (inet_pton(AF_INET6, host.c_str(), &v6->sin6_addr) == 1) v6->sin6_family = AF_INET6;
+        else return false;
+        r.ok = true;
+        r.addresses = {a};
+        return true;
+    }
+
+    // The process-wide part: worker threads, the cache, and who waits for which host
+    struct ResolverPool {
+        using LookupFn = Resolver::LookupFn;
+        struct Entry {
+            ResolveResult result;
+            std::chrono::steady_clock::time_point expires;
+        };
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<std::string> queue;
+        std::unordered_map<std::string, Entry> cache;
+        std::unordered_map<std::string, std::vector<Resolver*>> in_flight; // Host -> resolvers waiting
+        std::vector<std::thread> threads;
+        Resolver::LookupFn lookup = SystemLookup;
+        size_t lookups = 0;
+        bool stopping = false;
+
+        static ResolverPool& Get() {
+            static ResolverPool pool;
+            return pool;
+        }
+
+        ~ResolverPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto& t : threads) t.join();
+        }
+
+        // Caller holds 'mutex'
+        bool Cached(const std::string& host, ResolveResult& out) {
+            auto it = cache.find(host);
+            if (it == cache.end()) return false;
+            if (std::chrono::steady_clock::now() >= it->second.expires) {
+                cache.erase(it);
+                return false;
+            }
+            out = it->second.result;
+            return true;
+        }
+
+        void Store(const std::string& host, const ResolveResult& r) {
+            int ttl = r.ok ? Resolver::CACHE_TTL_S : Resolver::NEGATIVE_TTL_S;
+            cache[host] = {r, std::chrono::steady_clock::now() + std::chrono::seconds(ttl)};
+            lookups++;
+        }
+
+        // Caller holds 'mutex'. Adds 'r' to the waiters of 'host', starting a lookup if there is none.
+        void Enqueue(const std::string& host, Resolver* r) {
+            auto it = in_flight.find(host);
+            if (it != in_flight.end()) {
+                it->second.push_back(r);
+                return;
+            }
+            in_flight[host].push_back(r);
+            queue.push_back(host);
+            if (threads.size() < Resolver::THREADS) threads.emplace_back([this]() { Work(); });
+            wake.notify_one();
+        }
+
+        void Forget(Resolver* r) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& entry : in_flight) {
+                auto& v = entry.second;
+                v.erase(std::remove(v.begin(), v.end(), r), v.end());
+            }
+        }
+
+        void Work() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+                if (stopping) return;
+                std::string host = std::move(queue.front());
+                queue.pop_front();
+                LookupFn fn = lookup;
+
+                lock.unlock();
+                ResolveResult r = fn(host); // The slow part, outside the lock
+                lock.lock();
+
+                Store(host, r);
+                auto waiting = std::move(in_flight[host]);
+                in_flight.erase(host);
+                for (Resolver* res : waiting) res->Post(host, r);
+            }
+        }
+    };
+
+    Resolver::Resolver(Farm& farm) : farm(farm) {
+        efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (efd < 0) throw std::runtime_error("[Resolver] eventfd failed");
+    }
+
+    Resolver::~Resolver() {
+        ResolverPool::Get().Forget(this); // No more Post()s after this
+        if (watching) farm.Remove(efd);
+        close(efd);
+    }
+
+    Resolver::RequestId Resolver::Resolve(const std::string& host, Callback done) {
+        ResolveResult r;
+        if (ParseLiteral(host, r)) {
+            done(r);
+            return 0;
+        }
+
+        ResolverPool& pool = ResolverPool::Get();
+        {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            if (!pool.Cached(host, r)) {
+                RequestId id = next_id++;
+                pending[id] = {host, std::move(done)};
+                if (asked.insert(host).second) pool.Enqueue(host, this);
+                if (!watching) {
+                    farm.Add(efd, EPOLLIN, this);
+                    watching = true;
+                }
+                return id;
+            }
+        }
+        done(r);
+        return 0;
+    }
+
+    void Resolver::Cancel(RequestId id) {
+        pending.erase(id);
+        // The lookup itself runs on and its answer still fills the cache, but nobody here waits
+        if (pending.empty() && watching) {
+            farm.Remove(efd);
+            watching = false;
+        }
+    }
+
+    void Resolver::Post(const std::string& host, const ResolveResult& result) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            answers.emplace_back(host, result);
+        }
+        uint64_t one = 1;
+        ssize_t rc = write(efd, &one, sizeof(one));
+        (void)rc;
+    }
+
+    void Resolver::OnEvent(uint32_t) {
+        uint64_t count;
+        ssize_t rc = read(efd, &count, sizeof(count));
+        (void)rc;
+        std::deque<std::pair<std::string, ResolveResult>> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.swap(answers);
+        }
+        for (auto& a : ready) Deliver(a.first, a.second);
+
+        if (pending.empty() && watching) {
+            farm.Remove(efd); // Nothing to wait for: don't keep the loop alive
+            watching = false;
+        }
+    }
+
+    void Resolver::Deliver(const std::string& host, const ResolveResult& result) {
+        asked.erase(host);
+        // Callbacks may start or cancel requests, so collect first
+        std::vector<RequestId> ids;
+        for (auto& p : pending) {
+            if (p.second.host == host) ids.push_back(p.first);
+        }
+        for (RequestId id : ids) {
+            auto it = pending.find(id);
+            if (it == pending.end()) continue;
+            Callback done = std::move(it->second.done);
+            pending.erase(it);
+            done(result);
+        }
+    }
+
+    ResolveResult Resolver::ResolveNow(const std::string& host) {
+        ResolveResult r;
+        if (ParseLiteral(host, r)) return r;
+        ResolverPool& pool = ResolverPool::Get();
+        LookupFn fn;
+        {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            if (pool.Cached(host, r)) return r;
+            fn = pool.lookup;
+        }
+        r = fn(host);
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.Store(host, r);
+        return r;
+    }
+
+    socklen_t Resolver::WithPort(const sockaddr_storage& addr, int port, sockaddr_storage& out) {
+        out = addr;
+        if (out.ss_family == AF_INET6) {
+            ((sockaddr_in6*)&out)->sin6_port = htons(port);
+            return sizeof(sockaddr_in6);
+        }
+        ((sockaddr_in*)&out)->sin_port = htons(port);
+        return sizeof(sockaddr_in);
+    }
+
+    void Resolver::SetLookup(LookupFn fn) {
+        ResolverPool& pool = ResolverPool::Get();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.lookup = fn ? std::move(fn) : SystemLookup;
+    }
+
+    void Resolver::ClearCache() {
+        ResolverPool& pool = ResolverPool::Get();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.cache.clear();
+    }
+
+    size_t Resolver::Lookups() {
+        ResolverPool& pool = ResolverPool::Get();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        return pool.lookups;
+    }
+}
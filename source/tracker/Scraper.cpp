@@ -0,0 +1,83 @@
+#include "tracker/Scraper.h"
+#include <algorithm>
+#include <iostream>
+
+namespace BitTorrent {
+
+    static std::string Key(const Buffer& hash) { return std::string(hash.begin(), hash.end()); }
+
+    Scraper::Scraper(Farm& farm, int timeout_ms) : farm(farm), timeout_ms(timeout_ms) {}
+
+    void Scraper::Add(const Buffer& info_hash, const std::vector<std::string>& urls) {
+        for (const auto& url : urls) {
+            if (url.rfind("http://", 0) == 0 && Announce::ScrapeUrl(url).empty()) continue; // Can't be scraped
+            auto& hashes = pending[url];
+            if (std::find(hashes.begin(), hashes.end(), info_hash) == hashes.end()) hashes.push_back(info_hash);
+        }
+    }
+
+    void Scraper::Start() {
+        for (auto& [url, hashes] : pending) {
+            size_t chunk = url.rfind("udp://", 0) == 0 ? Announce::MAX_UDP_SCRAPE : MAX_HTTP_SCRAPE;
+            for (size_t i = 0; i < hashes.size(); i += chunk) {
+                std::vector<Buffer> batch(hashes.begin() + i, hashes.begin() + std::min(hashes.size(), i + chunk));
+                try {
+                    running.push_back(Announce::Scrape(farm, url, batch, timeout_ms, [this, url = url, batch](AnnounceResult& r) {
+                        if (!r.ok) {
+                            std::cerr << "[Tracker] " << url << ": scrape: " << r.error << std::endl;
+                            return;
+                        }
+                        auto& stats = results[url];
+                        for (size_t j = 0; j < batch.size() && j < r.swarms.size(); j++) {
+                            stats[Key(batch[j])] = r.swarms[j];
+                            if (on_swarm) on_swarm(url, batch[j], r.swarms[j]);
+                        }
+                    }));
+                } catch (const std::exception& e) {
+                    std::cerr << "[Tracker] " << url << ": " << e.what() << std::endl;
+                }
+            }
+        }
+        pending.clear();
+    }
+
+    bool Scraper::Done() const {
+        for (const auto& a : running) {
+            if (!a->Done()) return false;
+        }
+        return true;
+    }
+
+    SwarmStats Scraper::Get(const std::string& url, const Buffer& info_hash) const {
+        auto it = results.find(url);
+        if (it == results.end()) return SwarmStats();
+        auto s = it->second.find(Key(info_hash));
+        return s == it->second.end() ? SwarmStats() : s->second;
+    }
+
+    SwarmStats Scraper::Best(const Buffer& info_hash) const {
+        SwarmStats best;
+        for (const auto& [url, stats] : results) {
+            auto s = stats.find(Key(info_hash));
+            if (s == stats.end() || !s->second.Known()) continue;
+            if (!best.Known() || s->second.Peers() > best.Peers()) best = s->second;
+        }
+        return best;
+    }
+
+    std::vector<std::string> Scraper::RankTrackers(const Buffer& info_hash, std::vector<std::string> urls) const {
+        std::stable_sort(urls.begin(), urls.end(), [&](const std::string& a, const std::string& b) {
+            SwarmStats sa = Get(a, info_hash), sb = Get(b, info_hash);
+            if (Health(sa) != Health(sb)) return Health(sa) > Health(sb);
+            return sa.Peers() > sb.Peers();
+        });
+        return urls;
+    }
+
+    int Scraper::NumWant(const SwarmStats& swarm, bool need_peers) {
+        if (!need_peers) return 0; // Announce for the stats and the tracker's sake, but we're set
+        // A small swarm can't give more than it has; still leave room for whoever joined since
+        if (swarm.Known()) return std::min(MAX_NUM_WANT, std::max(swarm.Peers(), MIN_NUM_WANT));
+        return MAX_NUM_WANT;
+    }
+}
@@ -25,8 +25,13 @@ namespace BitTorrent {
             res.path = "/";
         }
 
-        // 3. Extract Port (everything after ':')
-        pos = s.find(':');
+        // 3. Extract Port (everything after ':'). IPv6 literals come in brackets: "[::1]:6969"
+        size_t host_end = 0;
+        if (!s.empty() && s[0] == '[') {
+            host_end = s.find(']');
+            if (host_end == std::string::npos) throw std::runtime_error("Invalid URL: Unclosed [");
+        }
+        pos = s.find(':', host_end);
         if (pos != std::string::npos) {
             res.port = std::stoi(s.substr(pos + 1));
             res.host = s.substr(0, pos);
@@ -38,6 +43,7 @@ namespace BitTorrent {
             else res.port = 6969; // Common tracker port
         }
 
+        if (host_end) res.host = res.host.substr(1, host_end - 1);
         return res;
     }
 }
\ No newline at end of file
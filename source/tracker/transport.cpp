@@ -1,4 +1,5 @@
 #include "tracker/Transport.h"
+#include "tracker/Resolver.h"
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netdb.h>
@@ -31,32 +32,43 @@ namespace BitTorrent {
 
     // --- TCP Implementation ---
     TcpClient::TcpClient(const std::string& host, int port) : Transport(host, port) {
-        // 1. Resolve Hostname (DNS Lookup)
-        struct addrinfo hints{}, *res;
-        hints.ai_family = AF_INET;       // IPv4
-        hints.ai_socktype = SOCK_STREAM; // TCP
-        // "hints" tells the OS: "I want an IPv4 address (AF_INET) for TCP (SOCK_STREAM)"
-        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0) {
-            throw std::runtime_error("Could not resolve host: " + host);
-        }
+        // 1. Resolve Hostname (DNS Lookup), through the shared cache. Peer IPs skip it entirely.
+        ResolveResult r = Resolver::ResolveNow(host);
+        if (!r.ok) throw std::runtime_error(r.error);
+        sockaddr_storage addr;
+        socklen_t len = Resolver::WithPort(r.addresses.front(), port, addr);
 
         // 2. Create Socket
         // Returns a File Descriptor (e.g., 3)
-        sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        sock = socket(addr.ss_family, SOCK_STREAM, 0);
         if (sock < 0) throw std::runtime_error("Could not create TCP socket");
 
         // Step 3: Connect (The Handshake) -- THIS IS BLOCKING!
         // Sends SYN -> Waits for SYN-ACK -> Sends ACK.
-        if (connect(sock, res->ai_addr, res->ai_addrlen) < 0) {
+        if (connect(sock, (sockaddr*)&addr, len) < 0) {
             close(sock);
+            sock = -1;
             throw std::runtime_error("Could not connect to " + host);
         }
+    }
+
+    TcpClient::TcpClient(const Peer& peer) : Transport(peer.Ip(), peer.Port()) {
+        sock = socket(peer.Family(), SOCK_STREAM, 0);
+        if (sock < 0) throw std::runtime_error("Could not create TCP socket");
+        if (connect(sock, (const sockaddr*)&peer.addr, peer.Length()) < 0) {
+            close(sock);
+            sock = -1;
+            throw std::runtime_error("Could not connect to " + peer.ToString());
+        }
+    }
 
-        freeaddrinfo(res);
+    TcpClient::TcpClient(int fd, const Peer& peer) : Transport(peer.Ip(), peer.Port()) {
+        sock = fd;
     }
 
     void TcpClient::Send(const Buffer& data) {
-        if (send(sock, data.data(), data.size(), 0) < 0) {
+        // A peer that hung up must not take the process down with SIGPIPE
+        if (send(sock, data.data(), data.size(), MSG_NOSIGNAL) < 0) {
             throw std::runtime_error("TCP Send failed");
         }
     }
@@ -73,23 +85,19 @@ namespace BitTorrent {
 
     // --- UDP Implementation ---
     UdpClient::UdpClient(const std::string& host, int port) : Transport(host, port) {
-        struct addrinfo hints{}, *res;
-        hints.ai_family = AF_INET;      // IPv4
-        hints.ai_socktype = SOCK_DGRAM; // UDP
-
-        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0) {
-            throw std::runtime_error("Could not resolve host: " + host);
-        }
+        ResolveResult r = Resolver::ResolveNow(host);
+        if (!r.ok) throw std::runtime_error(r.error);
+        sockaddr_storage addr;
+        socklen_t len = Resolver::WithPort(r.addresses.front(), port, addr);
 
-        sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        sock = socket(addr.ss_family, SOCK_DGRAM, 0);
         if (sock < 0) throw std::runtime_error("Could not create UDP socket");
 
         // For UDP, we 'connect' to set the default destination for send()
         // This makes the code simpler (no need for sendto every time)
-        if (connect(sock, res->ai_addr, res->ai_addrlen) < 0) {
+        if (connect(sock, (sockaddr*)&addr, len) < 0) {
             throw std::runtime_error("UDP Connect failed");
         }
-        freeaddrinfo(res);
     }
 
     void UdpClient::Send(const Buffer& data) {
@@ -0,0 +1,89 @@
+#include "parsing/Bnode.h"
+#include "parsing/BnodeView.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <filesystem>
+#include <memory_resource>
+
+using namespace BitTorrent;
+
+// Usage: ./bench_bnode [file.torrent ...]   (defaults to every file in torrentFiles/)
+// Compares the owning Bnode decoder (global heap and arena) against the zero-copy BnodeView on the
+// fields TorrentFile::Load actually needs.
+
+static Buffer ReadFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return Buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+// Before: full tree, then the same lookups Load used to do
+static size_t LoadWithBnode(const Buffer& data) {
+    Bnode root = Bnode::Decode(data);
+    const auto& info = root.GetDict().at("info").GetDict();
+    size_t sink = info.at("name").GetString().size();
+    sink += info.at("pieces").GetString().size();
+    sink += info.at("piece length").GetInt();
+    return sink;
+}
+
+// Full tree again, but carved out of a monotonic arena and released in one go
+static size_t LoadWithArena(const Buffer& data) {
+    std::pmr::monotonic_buffer_resource arena(data.size() * 2);
+    Bnode root = Bnode::Decode(data, &arena);
+    const auto& info = root.GetDict().at("info").GetDict();
+    size_t sink = info.at("name").GetString().size();
+    sink += info.at("pieces").GetString().size();
+    sink += info.at("piece length").GetInt();
+    return sink;
+}
+
+// After: one validating pass, then lazy lookups
+static size_t LoadWithView(const Buffer& data) {
+    BnodeView root = BnodeView::Decode(data);
+    BnodeView info = root.At("info");
+    size_t sink = info.At("name").GetString().size();
+    sink += info.At("pieces").GetString().size();
+    sink += info.At("piece length").GetInt();
+    return sink;
+}
+
+template <typename F>
+static double TimeIt(F f, const Buffer& data, int iterations, size_t& sink) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) sink += f(data);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) files.push_back(argv[i]);
+    if (files.empty()) {
+        for (const auto& entry : std::filesystem::directory_iterator("torrentFiles")) {
+            if (entry.path().extension() == ".torrent") files.push_back(entry.path().string());
+        }
+    }
+
+    size_t sink = 0;
+    std::cout << std::left << std::setw(36) << "file" << std::setw(10) << "bytes"
+              << std::setw(14) << "Bnode (us)" << std::setw(14) << "Arena (us)"
+              << std::setw(14) << "View (us)" << "speedup\n";
+
+    for (const auto& path : files) {
+        Buffer data = ReadFile(path);
+        try {
+            int iterations = data.size() > 100000 ? 200 : 2000;
+            double before = TimeIt(LoadWithBnode, data, iterations, sink);
+            double arena = TimeIt(LoadWithArena, data, iterations, sink);
+            double after = TimeIt(LoadWithView, data, iterations, sink);
+            std::cout << std::left << std::setw(36) << path << std::setw(10) << data.size()
+                      << std::setw(14) << std::fixed << std::setprecision(2) << before
+                      << std::setw(14) << arena << std::setw(14) << after << before / after << "x\n";
+        } catch (std::exception& e) {
+            std::cout << std::left << std::setw(36) << path << "skipped: " << e.what() << "\n";
+        }
+    }
+    return sink == 0; // keeps the optimizer honest
+}
@@ -0,0 +1,108 @@
+#include "parsing/Bnode.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <cassert>
+
+using namespace BitTorrent;
+
+// Usage: ./bench_encode [file.torrent]
+// Compares Bnode::Encode against the original recursive encoder, which built a
+// temporary Buffer per child and a std::to_string per length prefix.
+
+static Buffer LegacyEncode(const Bnode& node) {
+    Buffer out;
+    if (node.IsInt()) {
+        std::string s = "i" + std::to_string(node.GetInt()) + "e";
+        out.insert(out.end(), s.begin(), s.end());
+    }
+    else if (node.IsString()) {
+        std::string val = node.ToString();
+        std::string s = std::to_string(val.length()) + ":" + val;
+        out.insert(out.end(), s.begin(), s.end());
+    }
+    else if (node.IsList()) {
+        out.push_back('l');
+        for (const auto& item : node.GetList()) {
+            Buffer sub = LegacyEncode(item);
+            out.insert(out.end(), sub.begin(), sub.end());
+        }
+        out.push_back('e');
+    }
+    else if (node.IsDict()) {
+        out.push_back('d');
+        for (const auto& pair : node.GetDict()) {
+            std::string kLen = std::to_string(pair.first.length()) + ":" + std::string(pair.first);
+            out.insert(out.end(), kLen.begin(), kLen.end());
+            Buffer sub = LegacyEncode(pair.second);
+            out.insert(out.end(), sub.begin(), sub.end());
+        }
+        out.push_back('e');
+    }
+    return out;
+}
+
+// A non-compact tracker reply: the deepest, most node-heavy thing we encode
+static Bnode MakeTrackerReply(int peers) {
+    BList list;
+    for (int i = 0; i < peers; ++i) {
+        BDict peer;
+        peer["ip"] = Bnode(BufferUtils::FromString("10.0." + std::to_string(i / 256) + "." + std::to_string(i % 256)));
+        peer["peer id"] = Bnode(BufferUtils::FromString("-CPP100-" + std::to_string(100000000000LL + i)));
+        peer["port"] = Bnode((BInt)(6881 + i % 100));
+        list.push_back(Bnode(peer));
+    }
+    BDict root;
+    root["complete"] = Bnode((BInt)peers / 2);
+    root["incomplete"] = Bnode((BInt)peers - peers / 2);
+    root["interval"] = Bnode((BInt)1800);
+    root["peers"] = Bnode(list);
+    return Bnode(root);
+}
+
+// A small extension-protocol style message, encoded at high rates
+static Bnode MakeExtensionMessage() {
+    BDict m;
+    m["ut_metadata"] = Bnode((BInt)3);
+    m["ut_pex"] = Bnode((BInt)1);
+    BDict root;
+    root["m"] = Bnode(m);
+    root["reqq"] = Bnode((BInt)250);
+    root["v"] = Bnode(BufferUtils::FromString("CPP 1.0"));
+    root["metadata_size"] = Bnode((BInt)-123456789);
+    return Bnode(root);
+}
+
+static void Run(const std::string& label, const Bnode& node, int iterations) {
+    assert(Bnode::Encode(node) == LegacyEncode(node));
+    size_t sink = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) sink += LegacyEncode(node).size();
+    auto t1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) sink += Bnode::Encode(node).size();
+    auto t2 = std::chrono::steady_clock::now();
+
+    double before = std::chrono::duration<double, std::micro>(t1 - t0).count() / iterations;
+    double after = std::chrono::duration<double, std::micro>(t2 - t1).count() / iterations;
+    std::cout << std::left << std::setw(34) << label << std::setw(10) << sink / (2 * iterations)
+              << std::setw(14) << std::fixed << std::setprecision(2) << before
+              << std::setw(14) << after << before / after << "x\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::cout << std::left << std::setw(34) << "tree" << std::setw(10) << "bytes"
+              << std::setw(14) << "legacy (us)" << std::setw(14) << "new (us)" << "speedup\n";
+
+    Run("extension message", MakeExtensionMessage(), 200000);
+    Run("tracker reply (5000 peers)", MakeTrackerReply(5000), 50);
+
+    std::string path = argc > 1 ? argv[1] : "torrentFiles/testUbuntu.torrent";
+    std::ifstream file(path, std::ios::binary);
+    if (file) {
+        Buffer data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        Run(path, Bnode::Decode(data), 200);
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include "parsing/TorrentCreator.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace BitTorrent;
+
+// Usage: ./bench_make_torrent [payload_gib] [dir]
+// Generates a multi-file payload (default 2 GiB under ./bench_make_torrent_data) and hashes it
+// with 1, 2, 4, ... threads up to the core count. The first pass also warms the page cache,
+// so later rows measure hashing rather than the disk.
+
+int main(int argc, char* argv[]) {
+    double gib = argc > 1 ? std::stod(argv[1]) : 2.0;
+    std::string dir = argc > 2 ? argv[2] : "bench_make_torrent_data";
+    const int64_t file_size = 256LL * 1024 * 1024;
+    int64_t total = (int64_t)(gib * 1024 * 1024 * 1024);
+
+    std::filesystem::create_directories(dir);
+    std::vector<char> block(1 << 20);
+    for (size_t i = 0; i < block.size(); ++i) block[i] = (char)(i * 2654435761u >> 11);
+    for (int64_t written = 0, n = 0; written < total; ++n) {
+        int64_t size = std::min(file_size, total - written);
+        std::ofstream out(dir + "/part" + std::to_string(n) + ".bin", std::ios::binary);
+        for (int64_t done = 0; done < size; done += block.size()) {
+            block[0] = (char)(done >> 20); // Not every block identical
+            out.write(block.data(), std::min<int64_t>(block.size(), size - done));
+        }
+        written += size;
+    }
+
+    CreateOptions opts;
+    opts.announce = "http://127.0.0.1:6969/announce";
+    std::cout << "payload " << gib << " GiB, piece length " << TorrentCreator::AutoPieceLength(total) / 1024 << " KiB\n";
+    std::cout << std::left << std::setw(10) << "threads" << std::setw(10) << "seconds" << "GB/s\n";
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> counts;
+    for (size_t t = 1; t < cores; t *= 2) counts.push_back(t);
+    counts.push_back(cores);
+    counts.insert(counts.begin(), cores); // Cold pass first, reported separately
+
+    for (size_t i = 0; i < counts.size(); ++i) {
+        opts.threads = counts[i];
+        auto t0 = std::chrono::steady_clock::now();
+        Buffer meta = TorrentCreator::Create(dir, opts);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        std::cout << std::setw(10) << (std::to_string(counts[i]) + (i == 0 ? " cold" : ""))
+                  << std::setw(10) << std::fixed << std::setprecision(3) << secs
+                  << std::setprecision(2) << total / secs / 1e9 << "\n";
+    }
+
+    std::filesystem::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include "parsing/Sha1.h"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cassert>
+
+using namespace BitTorrent;
+
+// Usage: ./bench_sha1 [piece_kib]
+// Hashes 256 MiB as a stream of pieces (default 256 KiB, a typical piece size)
+// with every supported backend and reports throughput.
+
+int main(int argc, char* argv[]) {
+    size_t piece = (argc > 1 ? std::stoul(argv[1]) : 256) * 1024;
+    const size_t total = 256ull * 1024 * 1024;
+    std::vector<uint8_t> data(piece);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = (uint8_t)(i * 2654435761u >> 13);
+
+    uint8_t reference[Sha1::DIGEST_SIZE];
+    Sha1::Digest(data.data(), data.size(), reference, Sha1::OPENSSL);
+
+    std::cout << "piece size " << piece / 1024 << " KiB, auto-selected backend: " << Sha1::Name(Sha1::Best()) << "\n";
+    std::cout << std::left << std::setw(10) << "backend" << std::setw(12) << "GB/s" << "ms per piece\n";
+
+    for (Sha1::Backend b : {Sha1::SCALAR, Sha1::SSSE3, Sha1::OPENSSL, Sha1::SHANI}) {
+        if (!Sha1::Supported(b)) continue;
+        uint8_t out[Sha1::DIGEST_SIZE];
+        Sha1::Digest(data.data(), data.size(), out, b);
+        assert(std::memcmp(out, reference, sizeof(out)) == 0);
+
+        size_t pieces = total / piece;
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < pieces; ++i) Sha1::Digest(data.data(), data.size(), out, b);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        std::cout << std::setw(10) << Sha1::Name(b) << std::setw(12) << std::fixed << std::setprecision(2)
+                  << (double)pieces * piece / secs / 1e9 << std::setprecision(3) << secs * 1000 / pieces << "\n";
+    }
+
+    if (Sha1::LanesSupported()) {
+        const uint8_t* lanes[Sha1::LANES];
+        for (auto& p : lanes) p = data.data();
+        uint8_t out[Sha1::LANES][Sha1::DIGEST_SIZE];
+        Sha1::DigestLanes(lanes, data.size(), out);
+        assert(std::memcmp(out[Sha1::LANES - 1], reference, sizeof(reference)) == 0);
+
+        size_t rounds = total / piece / Sha1::LANES;
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < rounds; ++i) Sha1::DigestLanes(lanes, data.size(), out);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        std::cout << std::setw(10) << "avx2 x8" << std::setw(12) << std::fixed << std::setprecision(2)
+                  << (double)rounds * Sha1::LANES * piece / secs / 1e9
+                  << std::setprecision(3) << secs * 1000 / (rounds * Sha1::LANES) << "\n";
+    }
+    return 0;
+}
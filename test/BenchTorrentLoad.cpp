@@ -0,0 +1,102 @@
+#include "parsing/TorrentFile.h"
+#include "parsing/Bnode.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <openssl/sha.h>
+
+using namespace BitTorrent;
+
+// Usage: ./bench_torrent_load [num_pieces]   (default 1,000,000)
+// Writes a synthetic single-file torrent and loads it with the original
+// read -> Bnode -> vector<string> path and with the mmap + flat table path.
+// Each run happens in its own child process so peak RSS is measured in isolation.
+
+static const char* TORRENT_PATH = "bench_synthetic.torrent";
+
+static void WriteSyntheticTorrent(size_t pieces) {
+    const int64_t piece_length = 256 * 1024;
+    std::ofstream out(TORRENT_PATH, std::ios::binary);
+    out << "d8:announce30:http://127.0.0.1:6969/announce4:info"
+        << "d6:lengthi" << piece_length * (int64_t)pieces << "e"
+        << "4:name13:synthetic.bin"
+        << "12:piece lengthi" << piece_length << "e"
+        << "6:pieces" << pieces * 20 << ":";
+    uint8_t digest[20];
+    for (size_t i = 0; i < pieces; ++i) {
+        SHA1((const uint8_t*)&i, sizeof(i), digest);
+        out.write((const char*)digest, 20);
+    }
+    out << "ee";
+}
+
+// The loader as it was before: copy the file into a Buffer, build the full tree,
+// split 'pieces' into one heap string per piece, re-encode 'info' to hash it.
+static size_t LoadOriginal() {
+    std::ifstream file(TORRENT_PATH, std::ios::binary);
+    Buffer data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    Bnode root = Bnode::Decode(data);
+    const Bnode& infoNode = root.GetDict().at("info");
+    const BString& blob = infoNode.GetDict().at("pieces").GetString();
+    std::vector<std::string> piece_hashes;
+    for (size_t i = 0; i < blob.size(); i += 20) {
+        piece_hashes.push_back(std::string(blob.begin() + i, blob.begin() + i + 20));
+    }
+    Buffer infoBytes = Bnode::Encode(infoNode);
+    Buffer info_hash(20);
+    SHA1(infoBytes.data(), infoBytes.size(), info_hash.data());
+    return piece_hashes.size();
+}
+
+static size_t LoadMapped() {
+    TorrentFile t = TorrentFile::Load(TORRENT_PATH);
+    return t.PieceCount();
+}
+
+// Reads a "VmXXX:   1234 kB" line from /proc/self/status
+static long ReadStatusKB(const char* key) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, strlen(key), key) == 0) return std::stol(line.substr(strlen(key) + 1));
+    }
+    return -1;
+}
+
+static void RunInChild(const char* label, size_t (*load)()) {
+    std::cout.flush(); // otherwise the child inherits (and repeats) our buffered output
+    pid_t pid = fork();
+    if (pid == 0) {
+        long before = ReadStatusKB("VmRSS");
+        auto start = std::chrono::steady_clock::now();
+        size_t pieces = load();
+        auto end = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        std::cout << std::left << std::setw(28) << label
+                  << std::setw(12) << pieces
+                  << std::setw(14) << std::fixed << std::setprecision(1) << ms
+                  << std::setw(16) << (ReadStatusKB("VmHWM") - before) / 1024.0 << "\n";
+        std::cout.flush();
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+}
+
+int main(int argc, char* argv[]) {
+    size_t pieces = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    std::cout << "[Bench] Writing synthetic torrent with " << pieces << " pieces...\n";
+    WriteSyntheticTorrent(pieces);
+
+    std::cout << std::left << std::setw(28) << "loader" << std::setw(12) << "pieces"
+              << std::setw(14) << "time (ms)" << std::setw(16) << "peak RSS (MB)" << "\n";
+    RunInChild("read + Bnode + strings", LoadOriginal);
+    RunInChild("mmap + BnodeView + table", LoadMapped);
+
+    std::remove(TORRENT_PATH);
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "LocalTracker.h"
+#include "tracker/Announce.h"
+#include "tracker/Scraper.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+
+using namespace BitTorrent;
+
+// Usage: ./bench_tracker [announces]
+// Tracker client latency and throughput against a LocalTracker on loopback: one announce at a
+// time and all at once, over HTTP and UDP, on a clean link and with injected latency, loss and
+// truncation, then batched scrapes. Runs without network, and the tracker's randomness is
+// seeded, so the ok counts and tracker counters repeat from run to run.
+
+struct Row {
+    int ok = 0, total = 0;
+    std::vector<double> latency_ms;
+    double secs = 0;
+};
+
+static Buffer Hash(int n) {
+    Buffer h(20, 0);
+    for (int i = 0; i < 4; i++) h[i] = (uint8_t)(n >> (8 * i));
+    return h;
+}
+
+static AnnounceParams Params(int n) {
+    AnnounceParams p;
+    p.info_hash = Hash(n);
+    p.peer_id = "-CPP100-000000000000";
+    p.left = 1000;
+    p.num_want = 50;
+    p.timeout_ms = 5000;
+    p.udp_retry_ms = 20; // The link is loopback: retransmit in ms, not BEP 15's 15 s
+    return p;
+}
+
+// 'count' announces to 'url', one after the other or all in flight at once
+static Row Announces(Farm& farm, const std::string& url, int count, bool concurrent) {
+    Row row;
+    row.total = count;
+    std::vector<std::unique_ptr<Announce>> running;
+    auto record = [&row](AnnounceResult& r) {
+        if (!r.ok) return;
+        row.ok++;
+        row.latency_ms.push_back(r.latency_ms);
+    };
+    auto t0 = Farm::Clock::now();
+    for (int i = 0; i < count; i++) {
+        running.push_back(Announce::Create(farm, url, Params(i), record));
+        if (!concurrent) farm.Run([&]() { return running.back()->Done(); });
+    }
+    farm.Run([&]() { return std::all_of(running.begin(), running.end(), [](auto& a) { return a->Done(); }); });
+    row.secs = std::chrono::duration<double>(Farm::Clock::now() - t0).count();
+    return row;
+}
+
+static double Percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+}
+
+static void Print(const std::string& name, const std::string& proto, const Row& row, const LocalTracker& tracker) {
+    auto s = tracker.Stats();
+    std::cout << std::left << std::setw(16) << name << std::setw(6) << proto
+              << std::right << std::setw(5) << row.ok << "/" << std::left << std::setw(5) << row.total
+              << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << Percentile(row.latency_ms, 0.5) << std::setw(10) << Percentile(row.latency_ms, 0.99)
+              << std::setprecision(0) << std::setw(10) << row.ok / row.secs
+              << "   conn " << s.http_connections << " udp-connect " << s.udp_connects
+              << " dropped " << s.dropped << " cut " << s.truncated << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::stoi(argv[1]) : 100;
+    LocalTracker::Config base;
+    base.peers = LocalTracker::SyntheticPeers(200);
+
+    struct Scenario {
+        std::string name;
+        bool concurrent;
+        int latency_ms;
+        double loss, truncate;
+    };
+    const Scenario scenarios[] = {
+        {"sequential", false, 0, 0, 0},
+        {"burst", true, 0, 0, 0},
+        {"burst 20ms", true, 20, 0, 0},
+        {"lossy 20%", false, 0, 0.2, 0},
+        {"truncated 20%", false, 0, 0, 0.2},
+    };
+
+    std::cout << count << " announces per row; p50/p99 in ms, rate in announces/s\n";
+    std::cout << std::left << std::setw(16) << "scenario" << std::setw(6) << "proto" << std::setw(11) << "   ok"
+              << std::right << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "rate" << "\n";
+    for (const auto& sc : scenarios) {
+        for (bool udp : {false, true}) {
+            LocalTracker::Config c = base;
+            c.latency_ms = sc.latency_ms;
+            c.loss = sc.loss;
+            c.truncate = sc.truncate;
+            LocalTracker tracker(c); // Fresh counters and connection state per row
+            Farm farm;
+            UdpAnnounce::ClearConnectionCache();
+            Row row = Announces(farm, udp ? tracker.UdpUrl() : tracker.HttpUrl(), count, sc.concurrent);
+            Print(sc.name, udp ? "udp" : "http", row, tracker);
+        }
+    }
+
+    // Many torrents on one tracker: how many hashes a second batched scrapes get through
+    std::cout << "\nscrape of " << count * 10 << " torrents\n";
+    for (bool udp : {false, true}) {
+        LocalTracker tracker(base);
+        Farm farm;
+        Scraper scraper(farm, 5000);
+        std::string url = udp ? tracker.UdpUrl() : tracker.HttpUrl();
+        for (int i = 0; i < count * 10; i++) scraper.Add(Hash(i), {url});
+        auto t0 = Farm::Clock::now();
+        scraper.Start();
+        size_t requests = scraper.Requests();
+        farm.Run([&]() { return scraper.Done(); });
+        double secs = std::chrono::duration<double>(Farm::Clock::now() - t0).count();
+        std::cout << std::left << std::setw(6) << (udp ? "udp" : "http") << std::right << std::setw(6) << requests
+                  << " requests " << std::fixed << std::setprecision(3) << std::setw(10) << secs * 1000 << " ms\n";
+    }
+    return 0;
+}
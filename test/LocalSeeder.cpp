@@ -0,0 +1,218 @@
+#include "LocalSeeder.h"
+#include "parsing/Bnode.h"
+#include "parsing/Merkle.h"
+#include "download/Downloader.h"
+#include "download/Message.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+namespace BitTorrent {
+
+    int Loopback::Listen(int family, int type, uint16_t& port, int backlog, bool any) {
+        int fd = socket(family, type, 0);
+        sockaddr_storage addr{};
+        socklen_t len;
+        if (family == AF_INET6) {
+            auto* v6 = (sockaddr_in6*)&addr;
+            v6->sin6_family = AF_INET6;
+            v6->sin6_addr = any ? in6addr_any : in6addr_loopback;
+            len = sizeof(sockaddr_in6);
+        } else {
+            auto* v4 = (sockaddr_in*)&addr;
+            v4->sin_family = AF_INET;
+            v4->sin_addr.s_addr = htonl(any ? INADDR_ANY : INADDR_LOOPBACK);
+            len = sizeof(sockaddr_in);
+        }
+        if (fd < 0 || bind(fd, (sockaddr*)&addr, len) < 0 || (type == SOCK_STREAM && listen(fd, backlog) < 0)) {
+            std::string error = strerror(errno);
+            if (fd >= 0) close(fd);
+            throw std::runtime_error("Listen: " + error);
+        }
+        getsockname(fd, (sockaddr*)&addr, &len);
+        port = ntohs(family == AF_INET6 ? ((sockaddr_in6*)&addr)->sin6_port : ((sockaddr_in*)&addr)->sin_port);
+        return fd;
+    }
+
+    bool Loopback::ReadExact(int fd, uint8_t* out, size_t size) {
+        while (size > 0) {
+            ssize_t n = recv(fd, out, size, 0);
+            if (n <= 0) return false;
+            out += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    void Loopback::SendAll(int fd, const Buffer& b) {
+        size_t sent = 0;
+        while (sent < b.size()) {
+            ssize_t n = send(fd, b.data() + sent, b.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return;
+            sent += n;
+        }
+    }
+
+    LocalSeeder::LocalSeeder(const TorrentFile& t, const Buffer& s, const Config& c) : tf(t), stream(s), config(c) {
+        listener = Loopback::Listen(config.family, SOCK_STREAM, port, 4);
+        thread = std::thread(&LocalSeeder::Run, this);
+    }
+
+    LocalSeeder::~LocalSeeder() {
+        if (thread.joinable()) {
+            // Wakes accept() or the read loop, whichever the thread is in
+            shutdown(listener, SHUT_RDWR);
+            int fd = session.load();
+            if (fd >= 0) shutdown(fd, SHUT_RDWR);
+            thread.join();
+        }
+        close(listener);
+    }
+
+    void LocalSeeder::Join() {
+        if (thread.joinable()) thread.join();
+    }
+
+    void LocalSeeder::Run() {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) return;
+        session = fd;
+        Serve(fd);
+        session = -1;
+        close(fd);
+    }
+
+    // This thread reads requests; a second one answers each 'delay_ms' after it came in
+    void LocalSeeder::Serve(int fd) {
+        using Clock = std::chrono::steady_clock;
+        uint8_t hs[68];
+        if (!Loopback::ReadExact(fd, hs, sizeof(hs))) return;
+        Buffer mine = Message::BuildHandshake(tf, "-SEED00-000000000000");
+        if (!config.reqq) mine[20 + 5] &= ~Message::RESERVED_EXTENSIONS;
+        Loopback::SendAll(fd, mine);
+        if (config.reqq) {
+            BDict ext;
+            ext["m"] = Bnode(BDict());
+            ext["reqq"] = Bnode((BInt)config.reqq);
+            Buffer body = Bnode::Encode(Bnode(std::move(ext)));
+            Buffer msg = {0, 0, 0, 0, Message::EXTENDED, Message::EXTENDED_HANDSHAKE};
+            uint32_t len = 2 + body.size();
+            msg[0] = len >> 24, msg[1] = len >> 16, msg[2] = len >> 8, msg[3] = len;
+            msg.insert(msg.end(), body.begin(), body.end());
+            Loopback::SendAll(fd, msg);
+        }
+        Loopback::SendAll(fd, Message::BuildBitfield(std::vector<bool>(tf.PieceCount(), true)));
+        Loopback::SendAll(fd, Message::BuildUnchoke());
+
+        struct Pending { Clock::time_point due; uint32_t index, begin, length; };
+        std::deque<Pending> queue;
+        std::mutex mu;
+        std::condition_variable cv;
+        bool done = false, choked = false;
+        std::mutex out; // PIECEs (writer) and HASHES (reader) must not interleave on the wire
+        auto transmit = [&](const Buffer& b) {
+            std::lock_guard<std::mutex> lock(out);
+            Loopback::SendAll(fd, b);
+        };
+
+        std::thread writer([&]() {
+            int served = 0;
+            bool corrupted = false;
+            std::unique_lock<std::mutex> lock(mu);
+            while (true) {
+                if (queue.empty()) {
+                    if (done) break;
+                    cv.wait(lock);
+                    continue;
+                }
+                if (Clock::now() < queue.front().due) {
+                    cv.wait_until(lock, queue.front().due);
+                    continue;
+                }
+                Pending p = queue.front();
+                queue.pop_front();
+                lock.unlock();
+                Buffer block = Block(p.index, p.begin, p.length, corrupted);
+                transmit(Message::BuildPiece(p.index, p.begin, block.data(), block.size()));
+                lock.lock();
+                if (++served == config.max_blocks) {
+                    shutdown(fd, SHUT_RDWR); // The reader sees it and winds down
+                    queue.clear();
+                    done = true;
+                } else if (served == config.stall_after) {
+                    queue.clear();
+                    done = true; // Takes no more requests; the reader still drains the socket
+                } else if (served == config.choke_after) {
+                    // Choked: everything still queued is dropped, as the protocol says
+                    choked = stats.choked = true;
+                    queue.clear();
+                    lock.unlock();
+                    transmit(Message::BuildChoke());
+                    std::this_thread::sleep_for(std::chrono::milliseconds(config.choke_ms));
+                    lock.lock();
+                    choked = false;
+                    lock.unlock();
+                    transmit(Message::BuildUnchoke());
+                    lock.lock();
+                }
+            }
+        });
+
+        uint8_t head[4];
+        while (Loopback::ReadExact(fd, head, 4)) {
+            uint32_t len = (uint32_t)head[0] << 24 | head[1] << 16 | head[2] << 8 | head[3];
+            if (len == 0) continue;
+            Buffer msg(len);
+            if (!Loopback::ReadExact(fd, msg.data(), len)) break;
+            Buffer body(msg.begin() + 1, msg.end());
+            if (msg[0] == Message::EXTENDED) stats.got_extended = true;
+            if (msg[0] == Message::HASH_REQUEST) transmit(Hashes(body));
+            if (msg[0] != Message::REQUEST) continue;
+            std::lock_guard<std::mutex> lock(mu);
+            if (choked) continue; // Requests while choked are ignored
+            stats.requests++;
+            if (done) continue;   // Gone silent: seen, never answered
+            queue.push_back({Clock::now() + std::chrono::milliseconds(config.delay_ms), BufferUtils::ReadBE32(body, 0),
+                             BufferUtils::ReadBE32(body, 4), BufferUtils::ReadBE32(body, 8)});
+            stats.peak_outstanding = std::max(stats.peak_outstanding, queue.size());
+            cv.notify_all();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            done = true;
+            cv.notify_all();
+        }
+        writer.join();
+    }
+
+    Buffer LocalSeeder::Block(uint32_t index, uint32_t begin, uint32_t length, bool& corrupted) const {
+        int64_t at = (int64_t)index * tf.piece_length + begin;
+        Buffer block(stream.begin() + at, stream.begin() + at + length);
+        if (index == config.corrupt_piece && begin == Downloader::BLOCK_SIZE && !corrupted) {
+            block[7] ^= 0xFF;
+            corrupted = true;
+        }
+        return block;
+    }
+
+    // BEP 52 HASHES for a HASH_REQUEST: leaf hashes of the file whose root it names
+    Buffer LocalSeeder::Hashes(const Buffer& request) const {
+        Sha256Digest root;
+        std::memcpy(root.data(), request.data(), 32);
+        uint32_t index = BufferUtils::ReadBE32(request, 36), length = BufferUtils::ReadBE32(request, 40);
+        for (const auto& f : tf.files) {
+            if (f.length == 0 || f.pieces_root != root) continue;
+            std::vector<Sha256Digest> leaves = MerkleTree::BlockHashes(stream.data() + f.offset, f.length);
+            leaves.resize(std::max<size_t>(leaves.size(), index + length)); // Zero leaves past the end
+            std::vector<Sha256Digest> slice(leaves.begin() + index, leaves.begin() + index + length);
+            return Message::BuildHashes(root, 0, index, length, 0, slice);
+        }
+        return Buffer();
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "parsing/TorrentFile.h"
+#include "parsing/Buffer.h"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <sys/socket.h>
+
+namespace BitTorrent {
+
+    // Socket helpers the loopback tests share
+    namespace Loopback {
+        // Bound to the loopback address of 'family' ('any': the wildcard one); a SOCK_STREAM socket
+        // also listens. 'port' gets the one picked. Throws std::runtime_error on failure.
+        int Listen(int family, int type, uint16_t& port, int backlog = 8, bool any = false);
+        bool ReadExact(int fd, uint8_t* out, size_t size); // False once the peer is gone
+        void SendAll(int fd, const Buffer& b);             // Gives up quietly if the peer is gone
+    }
+
+    struct LocalSeederConfig {
+        int family = AF_INET;
+        int delay_ms = 0;         // Each block goes out this long after its request came in (an RTT)
+        int reqq = 0;             // Sent in a BEP 10 handshake; 0: the seeder doesn't speak BEP 10
+        int max_blocks = -1;      // Hangs up after serving this many (-1: never)
+        int stall_after = -1;     // Goes silent after serving this many, but stays connected (-1: never)
+        int choke_after = -1;     // Blocks served before it chokes for 'choke_ms', dropping the queue
+        int choke_ms = 100;
+        int64_t corrupt_piece = -1; // The first copy of this piece's second block goes out damaged
+    };
+
+    // A seeder on loopback for download tests: takes one leecher, serves every block of 'stream'
+    // (the torrent's bytes, index * piece_length + begin) and BEP 52 leaf hashes, and can be made
+    // slow, stingy or unreliable. Runs on its own thread until the leecher leaves.
+    class LocalSeeder {
+    public:
+        using Config = LocalSeederConfig;
+
+        // What the seeder has seen, final once Join() returns
+        struct Stats {
+            size_t requests = 0;         // REQUESTs seen, not counting those ignored while choked
+            size_t peak_outstanding = 0; // Most requests queued at once
+            bool got_extended = false;   // Our extended handshake arrived
+            bool choked = false;
+        };
+
+        // 'tf' and 'stream' must outlive the seeder. Throws std::runtime_error if it can't listen.
+        LocalSeeder(const TorrentFile& tf, const Buffer& stream, const Config& config = Config());
+        ~LocalSeeder(); // Cuts the leecher off if it is still there
+
+        uint16_t Port() const { return port; }
+        void Join(); // Waits for the leecher to leave
+        const Stats& Seen() const { return stats; }
+
+    private:
+        const TorrentFile& tf;
+        const Buffer& stream;
+        Config config;
+        int listener = -1;
+        std::atomic<int> session{-1};
+        uint16_t port = 0;
+        Stats stats;
+        std::thread thread;
+
+        void Run();
+        void Serve(int fd);
+        Buffer Block(uint32_t index, uint32_t begin, uint32_t length, bool& corrupted) const;
+        Buffer Hashes(const Buffer& request) const;
+    };
+}
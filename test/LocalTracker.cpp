@@ -0,0 +1,408 @@
+#include "LocalTracker.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+namespace BitTorrent {
+
+    static uint32_t ReadBE32(const uint8_t* p) { return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]; }
+    static uint64_t ReadBE64(const uint8_t* p) { return (uint64_t)ReadBE32(p) << 32 | ReadBE32(p + 4); }
+
+    static void WriteBE32(std::string& out, uint32_t v) {
+        for (int shift = 24; shift >= 0; shift -= 8) out.push_back((char)(v >> shift));
+    }
+    static void WriteBE64(std::string& out, uint64_t v) {
+        WriteBE32(out, (uint32_t)(v >> 32));
+        WriteBE32(out, (uint32_t)v);
+    }
+
+    static std::string UrlDecode(const std::string& s) {
+        std::string out;
+        for (size_t i = 0; i < s.size(); i++) {
+            if (s[i] == '%' && i + 2 < s.size()) {
+                out.push_back((char)std::stoi(s.substr(i + 1, 2), nullptr, 16));
+                i += 2;
+            } else {
+                out.push_back(s[i] == '+' ? ' ' : s[i]);
+            }
+        }
+        return out;
+    }
+
+    static void SetNonBlocking(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    std::vector<Peer> LocalTracker::SyntheticPeers(int count, int v6) {
+        std::vector<Peer> peers;
+        for (int i = 0; i < count; i++) {
+            uint8_t ip[4] = {10, (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i};
+            peers.push_back(Peer::FromV4(ip, (uint16_t)(6881 + i % 1000)));
+        }
+        for (int i = 0; i < v6; i++) {
+            uint8_t ip[16] = {0xfd};
+            ip[14] = (uint8_t)(i >> 8);
+            ip[15] = (uint8_t)i;
+            peers.push_back(Peer::FromV6(ip, (uint16_t)(6881 + i % 1000)));
+        }
+        return peers;
+    }
+
+    LocalTracker::LocalTracker(const Config& c, uint16_t want_port) : config(std::make_shared<Config>(c)) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(want_port);
+        socklen_t len = sizeof(addr);
+
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listener, 128) < 0) {
+            close(listener);
+            throw std::runtime_error(std::string("LocalTracker: tcp: ") + strerror(errno));
+        }
+        getsockname(listener, (sockaddr*)&addr, &len);
+        port = ntohs(addr.sin_port);
+
+        // UDP on the same number, so one port describes the tracker
+        udp = socket(AF_INET, SOCK_DGRAM, 0);
+        if (bind(udp, (sockaddr*)&addr, sizeof(addr)) < 0) {
+            close(listener);
+            close(udp);
+            throw std::runtime_error(std::string("LocalTracker: udp: ") + strerror(errno));
+        }
+        SetNonBlocking(listener);
+        SetNonBlocking(udp);
+        if (pipe(wake) < 0) throw std::runtime_error("LocalTracker: pipe");
+        thread = std::thread([this]() { Run(); });
+    }
+
+    LocalTracker::~LocalTracker() {
+        stopping = true;
+        if (write(wake[1], "x", 1) < 0) {} // Nothing to do about it; poll() times out anyway
+        thread.join();
+        for (auto& [id, conn] : conns) close(conn.fd);
+        close(listener);
+        close(udp);
+        close(wake[0]);
+        close(wake[1]);
+    }
+
+    void LocalTracker::Configure(const Config& c) {
+        std::lock_guard<std::mutex> lock(mutex);
+        config = std::make_shared<Config>(c);
+        generation++;
+    }
+
+    LocalTracker::Counters LocalTracker::Stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+
+    std::shared_ptr<const LocalTracker::Config> LocalTracker::Current() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (seeded != generation) {
+            rng.seed(config->seed);
+            seeded = generation;
+        }
+        return config;
+    }
+
+    bool LocalTracker::Chance(double p) {
+        if (p <= 0) return false;
+        return std::uniform_real_distribution<double>(0, 1)(rng) < p;
+    }
+
+    void LocalTracker::Run() {
+        std::vector<pollfd> fds;
+        std::vector<uint64_t> ids;
+        while (!stopping) {
+            fds.assign({{wake[0], POLLIN, 0}, {listener, POLLIN, 0}, {udp, POLLIN, 0}});
+            ids.clear();
+            for (auto& [id, conn] : conns) {
+                fds.push_back({conn.fd, POLLIN, 0});
+                ids.push_back(id);
+            }
+            int timeout = -1;
+            if (!due.empty()) {
+                auto wait = std::chrono::ceil<std::chrono::milliseconds>(due.begin()->first - Clock::now()).count();
+                timeout = (int)std::max<int64_t>(wait, 0);
+            }
+            if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) break;
+
+            if (fds[1].revents) Accept();
+            if (fds[2].revents) ReadUdp();
+            for (size_t i = 0; i < ids.size(); i++) {
+                if (fds[3 + i].revents) ReadHttp(ids[i]);
+            }
+            Flush();
+        }
+    }
+
+    void LocalTracker::Accept() {
+        while (true) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd < 0) return;
+            SetNonBlocking(fd);
+            conns[next_conn++].fd = fd;
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.http_connections++;
+        }
+    }
+
+    void LocalTracker::CloseConn(uint64_t id) {
+        auto it = conns.find(id);
+        if (it == conns.end()) return;
+        close(it->second.fd);
+        conns.erase(it);
+    }
+
+    void LocalTracker::ReadHttp(uint64_t id) {
+        auto it = conns.find(id);
+        if (it == conns.end()) return;
+        HttpConn& conn = it->second;
+        char buf[4096];
+        while (true) {
+            ssize_t n = recv(conn.fd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                conn.in.append(buf, n);
+                continue;
+            }
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) return CloseConn(id);
+            break;
+        }
+        // Every complete request (GETs have no body); replies go out in order as their latency allows
+        size_t end;
+        while ((end = conn.in.find("\r\n\r\n")) != std::string::npos) {
+            std::string line = conn.in.substr(0, conn.in.find("\r\n"));
+            conn.in.erase(0, end + 4);
+            auto c = Current();
+            Reply r;
+            r.conn = id;
+            r.data = HttpReply(line, *c, r.close_after);
+            Queue(std::move(r), *c);
+        }
+    }
+
+    std::string LocalTracker::HttpReply(const std::string& line, const Config& c, bool& close_after) {
+        // "GET /announce?info_hash=...&numwant=50 HTTP/1.1"
+        size_t sp1 = line.find(' '), sp2 = line.rfind(' ');
+        std::string target = sp1 != std::string::npos && sp2 > sp1 ? line.substr(sp1 + 1, sp2 - sp1 - 1) : "";
+        size_t q = target.find('?');
+        std::string path = target.substr(0, q);
+        std::vector<std::string> hashes;
+        int num_want = -1;
+        if (q != std::string::npos) {
+            std::string query = target.substr(q + 1);
+            for (size_t at = 0; at <= query.size();) {
+                size_t amp = query.find('&', at);
+                if (amp == std::string::npos) amp = query.size();
+                std::string kv = query.substr(at, amp - at);
+                size_t eq = kv.find('=');
+                std::string key = kv.substr(0, eq), value = eq == std::string::npos ? "" : UrlDecode(kv.substr(eq + 1));
+                if (key == "info_hash") hashes.push_back(value);
+                if (key == "numwant" && !value.empty()) num_want = std::atoi(value.c_str());
+                at = amp + 1;
+            }
+        }
+
+        BDict reply;
+        std::string status = "200 OK";
+        if (path == "/announce" && hashes.size() == 1) {
+            std::string peers6;
+            std::string peers = Announced(num_want, true, c, peers6);
+            reply["interval"] = Bnode((BInt)c.interval);
+            reply["min interval"] = Bnode((BInt)c.min_interval);
+            reply["complete"] = Bnode((BInt)c.seeders);
+            reply["incomplete"] = Bnode((BInt)c.leechers);
+            reply["peers"] = Bnode(Buffer(peers.begin(), peers.end()));
+            if (!peers6.empty()) reply["peers6"] = Bnode(Buffer(peers6.begin(), peers6.end()));
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.http_announces++;
+        } else if (path == "/scrape") {
+            BDict files;
+            for (const auto& h : hashes) files[h] = ScrapeEntry(c);
+            reply["files"] = Bnode(std::move(files));
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.http_scrapes++;
+        } else {
+            std::string msg = path == "/announce" ? "missing info_hash" : "unknown path";
+            reply["failure reason"] = Bnode(Buffer(msg.begin(), msg.end()));
+            status = path == "/announce" ? "200 OK" : "404 Not Found";
+        }
+
+        Buffer body = Bnode::Encode(Bnode(std::move(reply)));
+        close_after = !c.keep_alive;
+        bool cut = Chance(c.truncate);
+        std::string out = "HTTP/1.1 " + status + "\r\nContent-Type: text/plain\r\nContent-Length: " + std::to_string(body.size()) +
+                          (close_after ? "\r\nConnection: close" : "") + "\r\n\r\n";
+        // Cut: half the promised body, then the connection drops
+        out.append(body.begin(), body.begin() + (cut ? body.size() / 2 : body.size()));
+        if (cut) {
+            close_after = true;
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.truncated++;
+        }
+        return out;
+    }
+
+    void LocalTracker::ReadUdp() {
+        uint8_t buf[2048];
+        while (true) {
+            Reply r;
+            socklen_t len = sizeof(r.to);
+            ssize_t n = recvfrom(udp, buf, sizeof(buf), 0, (sockaddr*)&r.to, &len);
+            if (n < 0) return;
+            auto c = Current();
+            if (Chance(c->loss)) {
+                std::lock_guard<std::mutex> lock(mutex);
+                counters.dropped++;
+                continue;
+            }
+            r.data = UdpReply(buf, n, *c);
+            if (r.data.empty()) continue;
+            if (Chance(c->truncate)) {
+                // Mid-peer for an announce, half a header for anything shorter
+                r.data.resize(r.data.size() > 20 ? r.data.size() - 3 : r.data.size() / 2);
+                std::lock_guard<std::mutex> lock(mutex);
+                counters.truncated++;
+            }
+            Queue(std::move(r), *c);
+        }
+    }
+
+    std::string LocalTracker::UdpReply(const uint8_t* data, size_t size, const Config& c) {
+        if (size < 16) return "";
+        uint64_t connection_id = ReadBE64(data);
+        uint32_t action = ReadBE32(data + 8);
+        uint32_t transaction_id = ReadBE32(data + 12);
+        auto now = Clock::now();
+        std::string out;
+
+        if (action == 0) {
+            if (connection_id != 0x41727101980ull) return "";
+            uint64_t id = ((uint64_t)rng() << 32) | rng();
+            connection_ids[id] = now + std::chrono::seconds(CONNECTION_ID_TTL_S);
+            WriteBE32(out, 0);
+            WriteBE32(out, transaction_id);
+            WriteBE64(out, id);
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.udp_connects++;
+            return out;
+        }
+
+        auto id = connection_ids.find(connection_id);
+        if (id == connection_ids.end() || id->second < now) {
+            WriteBE32(out, 3);
+            WriteBE32(out, transaction_id);
+            out += "connection id expired";
+            return out;
+        }
+
+        if (action == 1 && size >= 98) {
+            std::string unused;
+            std::string peers = Announced((int32_t)ReadBE32(data + 92), false, c, unused);
+            WriteBE32(out, 1);
+            WriteBE32(out, transaction_id);
+            WriteBE32(out, c.interval);
+            WriteBE32(out, c.leechers);
+            WriteBE32(out, c.seeders);
+            out += peers;
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.udp_announces++;
+            return out;
+        }
+        if (action == 2 && (size - 16) % 20 == 0) {
+            WriteBE32(out, 2);
+            WriteBE32(out, transaction_id);
+            for (size_t off = 16; off < size; off += 20) {
+                WriteBE32(out, c.seeders);
+                WriteBE32(out, c.seeders); // Completed: at least everyone seeding now
+                WriteBE32(out, c.leechers);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.udp_scrapes++;
+            return out;
+        }
+        WriteBE32(out, 3);
+        WriteBE32(out, transaction_id);
+        out += "bad request";
+        return out;
+    }
+
+    // Up to 'num_want' peers (BEP 3 default 50), taking turns through the list. IPv4 ones come back
+    // compact; IPv6 ones go to 'peers6' if 'v6_too', else they are skipped.
+    std::string LocalTracker::Announced(int num_want, bool v6_too, const Config& c, std::string& peers6) {
+        if (num_want < 0) num_want = 50;
+        std::string peers;
+        size_t total = c.peers.size();
+        int given = 0;
+        for (size_t i = 0; i < total && given < num_want; i++) {
+            const Peer& p = c.peers[(rotation + i) % total];
+            uint16_t port = p.Port();
+            if (p.Family() == AF_INET) {
+                const auto* a = (const sockaddr_in*)&p.addr;
+                peers.append((const char*)&a->sin_addr, 4);
+            } else if (v6_too) {
+                const auto* a = (const sockaddr_in6*)&p.addr;
+                peers6.append((const char*)&a->sin6_addr, 16);
+            } else {
+                continue;
+            }
+            std::string& to = p.Family() == AF_INET ? peers : peers6;
+            to.push_back((char)(port >> 8));
+            to.push_back((char)port);
+            given++;
+        }
+        if (total) rotation = (rotation + given) % total;
+        return peers;
+    }
+
+    Bnode LocalTracker::ScrapeEntry(const Config& c) const {
+        BDict entry;
+        entry["complete"] = Bnode((BInt)c.seeders);
+        entry["downloaded"] = Bnode((BInt)c.seeders);
+        entry["incomplete"] = Bnode((BInt)c.leechers);
+        return Bnode(std::move(entry));
+    }
+
+    void LocalTracker::Queue(Reply reply, const Config& c) {
+        int delay = c.latency_ms;
+        if (c.jitter_ms > 0) delay += std::uniform_int_distribution<int>(0, c.jitter_ms)(rng);
+        due.emplace(Clock::now() + std::chrono::milliseconds(delay), std::move(reply));
+    }
+
+    void LocalTracker::Flush() {
+        auto now = Clock::now();
+        while (!due.empty() && due.begin()->first <= now) {
+            Reply r = std::move(due.begin()->second);
+            due.erase(due.begin());
+            if (!r.conn) {
+                sendto(udp, r.data.data(), r.data.size(), 0, (sockaddr*)&r.to, sizeof(r.to));
+                continue;
+            }
+            auto it = conns.find(r.conn);
+            if (it == conns.end()) continue; // The client hung up meanwhile
+            int fd = it->second.fd;
+            size_t sent = 0;
+            while (sent < r.data.size()) {
+                ssize_t n = send(fd, r.data.data() + sent, r.data.size() - sent, MSG_NOSIGNAL);
+                if (n > 0) {
+                    sent += n;
+                } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    pollfd p = {fd, POLLOUT, 0};
+                    poll(&p, 1, 100);
+                } else {
+                    break;
+                }
+            }
+            if (sent < r.data.size() || r.close_after) CloseConn(r.conn);
+        }
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include "tracker/Peer.h"
+#include "parsing/Bnode.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <netinet/in.h>
+
+namespace BitTorrent {
+
+    struct LocalTrackerConfig {
+        std::vector<Peer> peers;  // What announces hand out (IPv6 ones as 'peers6'); see SyntheticPeers
+        int interval = 1800;
+        int min_interval = 60;
+        int seeders = 10;         // Reported for every torrent, in announces and scrapes
+        int leechers = 20;
+        int latency_ms = 0;       // Before every reply
+        int jitter_ms = 0;        // Plus up to this much more
+        double loss = 0;          // Share of UDP requests dropped unseen
+        double truncate = 0;      // Share of replies cut short: HTTP loses half its body and the
+                                  // connection, UDP datagrams end in the middle of a peer
+        bool keep_alive = true;   // HTTP: else "Connection: close" after every reply
+        uint32_t seed = 1;
+    };
+
+    // A tracker on 127.0.0.1 for tests and benchmarks that must not touch the network: HTTP
+    // announce and scrape (keep-alive) on a TCP port, BEP 15 connect / announce / scrape on the
+    // UDP port of the same number. It hands out a fixed peer list and can be made slow, lossy or
+    // sloppy. Everything random comes from 'seed', so a run with the same config repeats exactly.
+    // Runs on its own thread; replies wait out their latency without holding up other clients.
+    class LocalTracker {
+    public:
+        using Config = LocalTrackerConfig;
+
+        // What the tracker has seen so far
+        struct Counters {
+            int http_announces = 0, http_scrapes = 0;
+            int udp_connects = 0, udp_announces = 0, udp_scrapes = 0;
+            int dropped = 0, truncated = 0;
+            int http_connections = 0;
+        };
+
+        static constexpr int CONNECTION_ID_TTL_S = 120; // BEP 15: accept an id for two minutes
+
+        // 'port' 0 picks a free one. Throws std::runtime_error if the sockets can't be set up.
+        explicit LocalTracker(const Config& config = Config(), uint16_t port = 0);
+        ~LocalTracker(); // Stops the thread and closes every socket
+
+        void Configure(const Config& config); // Applies to requests arriving from now on
+        Counters Stats() const;
+
+        uint16_t Port() const { return port; }
+        std::string HttpUrl() const { return "http://127.0.0.1:" + std::to_string(port) + "/announce"; }
+        std::string UdpUrl() const { return "udp://127.0.0.1:" + std::to_string(port); }
+
+        // 'count' distinct peers 10.x.y.z:6881+ (then IPv6 fd00::x if 'v6'), the same every time
+        static std::vector<Peer> SyntheticPeers(int count, int v6 = 0);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+        struct HttpConn {
+            int fd = -1;
+            std::string in;
+        };
+        struct Reply {
+            uint64_t conn = 0;        // HTTP connection, 0 for UDP
+            sockaddr_in to{};         // UDP
+            std::string data;
+            bool close_after = false;
+        };
+
+        int listener = -1, udp = -1;
+        int wake[2] = {-1, -1};       // Pipe that gets Run() out of poll()
+        uint16_t port = 0;
+        std::thread thread;
+
+        mutable std::mutex mutex;     // Guards 'config', 'generation' and 'counters'
+        std::shared_ptr<const Config> config;
+        uint64_t generation = 0;      // Bumped by Configure(), so the server thread reseeds
+        Counters counters;
+        std::atomic<bool> stopping{false};
+
+        // Server thread only
+        std::mt19937 rng;
+        uint64_t seeded = ~0ull;      // Generation 'rng' was seeded for
+        uint64_t next_conn = 1;
+        std::unordered_map<uint64_t, HttpConn> conns;
+        std::multimap<Clock::time_point, Reply> due;
+        std::unordered_map<uint64_t, Clock::time_point> connection_ids;
+        size_t rotation = 0;          // Where the next peer list starts, so announces differ
+
+        void Run();
+        void Accept();
+        void ReadHttp(uint64_t id);
+        void ReadUdp();
+        void CloseConn(uint64_t id);
+        std::shared_ptr<const Config> Current();
+        void Queue(Reply reply, const Config& c);
+        void Flush();
+        bool Chance(double p);
+
+        std::string HttpReply(const std::string& request_line, const Config& c, bool& close_after);
+        std::string UdpReply(const uint8_t* data, size_t size, const Config& c);
+        std::string Announced(int num_want, bool v6_too, const Config& c, std::string& peers6);
+        Bnode ScrapeEntry(const Config& c) const;
+    };
+}
@@ -0,0 +1,55 @@
+#include "parsing/TorrentCreator.h"
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <filesystem>
+
+// Usage: ./make_torrent <file-or-dir> -o <out.torrent> [-a announce] [-p piece_kib] [-t threads]
+//                       [-c comment] [--private]
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: ./make_torrent <file-or-dir> -o <out.torrent> [-a announce] [-p piece_kib]"
+                     " [-t threads] [-c comment] [--private]\n";
+        return 1;
+    }
+
+    std::string input = argv[1];
+    std::string output;
+    BitTorrent::CreateOptions opts;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "-o" && has_value) output = argv[++i];
+        else if (arg == "-a" && has_value) opts.announce = argv[++i];
+        else if (arg == "-c" && has_value) opts.comment = argv[++i];
+        else if (arg == "-p" && has_value) opts.piece_length = std::stoll(argv[++i]) * 1024;
+        else if (arg == "-t" && has_value) opts.threads = std::stoul(argv[++i]);
+        else if (arg == "--private") opts.is_private = true;
+        else {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            return 1;
+        }
+    }
+    if (output.empty()) output = std::filesystem::path(input).filename().string() + ".torrent";
+
+    int last_percent = -1;
+    opts.progress = [&](int64_t done, int64_t total) {
+        int percent = total ? (int)(done * 100 / total) : 100;
+        if (percent != last_percent) {
+            last_percent = percent;
+            std::cout << "\r[Hashing] " << percent << "%" << std::flush;
+        }
+    };
+
+    try {
+        auto t0 = std::chrono::steady_clock::now();
+        BitTorrent::TorrentCreator::CreateFile(input, output, opts);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        std::cout << "\rWrote " << output << " in " << secs << " s\n";
+    } catch (const std::exception& e) {
+        std::cerr << "\nError: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
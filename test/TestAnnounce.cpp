@@ -0,0 +1,350 @@
+#include "tracker/Announce.h"
+#include "tracker/Announcer.h"
+#include "parsing/Bnode.h"
+#include "LocalSeeder.h"
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cassert>
+#include <set>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace BitTorrent;
+
+// Usage: ./test_announce
+// HTTP and UDP announces against loopback trackers running on threads. A slow tracker must not
+// hold up a fast one sharing the same Farm, and a silent one must time out on its own.
+// Then BEP 12 tiers: racing inside a tier, merging across tiers, and ranking by past results,
+// and BEP 15 retransmission and connection ID reuse against a tracker that loses packets.
+// Last, the default deadlines: a UDP announce must outlive its whole retransmit schedule, unless
+// something waits on it.
+
+static std::string CompactPeers(int count) {
+    std::string s;
+    for (int i = 0; i < count; ++i) {
+        uint8_t e[6] = {10, 0, (uint8_t)(i >> 8), (uint8_t)i, (uint8_t)((6881 + i) >> 8), (uint8_t)(6881 + i)};
+        s.append((const char*)e, 6);
+    }
+    return s;
+}
+
+// One HTTP announce on an accepted socket, answered after 'delay_ms'
+static void ServeHttp(int fd, int delay_ms, int peers) {
+    std::string req;
+    char buf[4096];
+    while (req.find("\r\n\r\n") == std::string::npos) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) break;
+        req.append(buf, n);
+    }
+    assert(req.find("info_hash=%01%02") != std::string::npos && req.find("compact=1") != std::string::npos);
+    std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+
+    BDict reply;
+    reply["interval"] = Bnode((BInt)1800);
+    reply["min interval"] = Bnode((BInt)60);
+    std::string compact = CompactPeers(peers);
+    reply["peers"] = Bnode(Buffer(compact.begin(), compact.end()));
+    Buffer body = Bnode::Encode(Bnode(std::move(reply)));
+    std::string head = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+    send(fd, head.data(), head.size(), MSG_NOSIGNAL);
+    // The body in two writes, so the reader has to pick it up across segments
+    send(fd, body.data(), body.size() / 2, MSG_NOSIGNAL);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    send(fd, body.data() + body.size() / 2, body.size() - body.size() / 2, MSG_NOSIGNAL);
+    close(fd);
+}
+
+// Answers 'requests' HTTP announces
+static void HttpTracker(int listener, int delay_ms, int peers, int requests) {
+    for (int r = 0; r < requests; ++r) ServeHttp(accept(listener, nullptr, nullptr), delay_ms, peers);
+}
+
+// One BEP 15 announce, after a connect unless the client still has the connection id
+static void ServeUdp(int fd, int peers) {
+    uint8_t buf[2048];
+    sockaddr_in from{};
+    socklen_t len = sizeof(from);
+    ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, (sockaddr*)&from, &len);
+    if (n == 16) {
+        uint8_t connect_reply[16] = {0, 0, 0, 0};
+        std::memcpy(connect_reply + 4, buf + 12, 4); // Transaction id
+        std::memset(connect_reply + 8, 0xAB, 8);      // Connection id
+        sendto(fd, connect_reply, sizeof(connect_reply), 0, (sockaddr*)&from, len);
+        n = recvfrom(fd, buf, sizeof(buf), 0, (sockaddr*)&from, &len);
+    }
+    assert(n == 98 && buf[0] == 0xAB && buf[11] == 1);
+    Buffer reply = {0, 0, 0, 1};
+    reply.insert(reply.end(), buf + 12, buf + 16);
+    uint8_t tail[12] = {0, 0, 0x07, 0x08}; // Interval 1800, leechers and seeders 0
+    reply.insert(reply.end(), tail, tail + sizeof(tail));
+    std::string compact = CompactPeers(peers);
+    reply.insert(reply.end(), compact.begin(), compact.end());
+    sendto(fd, reply.data(), reply.size(), 0, (sockaddr*)&from, len);
+}
+
+// Answers 'rounds' exchanges
+static void UdpTracker(int fd, int peers, int rounds) {
+    for (int r = 0; r < rounds; ++r) ServeUdp(fd, peers);
+}
+
+struct UdpLog {
+    int connects = 0, announces = 0, errors = 0, dropped = 0;
+};
+
+// BEP 15 tracker behind a lossy link: the first copy of every request is lost. Hands out a
+// connection id of eight 'id' bytes and refuses announces carrying any other.
+static void LossyUdpTracker(int fd, uint8_t id, int peers, int announces, UdpLog& log) {
+    std::set<uint32_t> seen;
+    uint8_t buf[2048];
+    while (log.announces < announces) {
+        sockaddr_in from{};
+        socklen_t len = sizeof(from);
+        ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, (sockaddr*)&from, &len);
+        if (n < 16) continue;
+        uint32_t tid = (uint32_t)buf[12] << 24 | buf[13] << 16 | buf[14] << 8 | buf[15];
+        if (seen.insert(tid).second) {
+            log.dropped++;
+            continue;
+        }
+
+        Buffer reply = {0, 0, 0, 0};
+        reply.insert(reply.end(), buf + 12, buf + 16);
+        if (n == 16) {
+            reply.insert(reply.end(), 8, id);
+            log.connects++;
+        } else if (buf[0] != id) {
+            reply[3] = 3;
+            std::string msg = "connection id expired";
+            reply.insert(reply.end(), msg.begin(), msg.end());
+            log.errors++;
+        } else {
+            reply[3] = 1;
+            uint8_t tail[12] = {0, 0, 0x07, 0x08};
+            reply.insert(reply.end(), tail, tail + sizeof(tail));
+            int want = buf[92] << 24 | buf[93] << 16 | buf[94] << 8 | buf[95];
+            std::string compact = CompactPeers(std::min(want, peers));
+            reply.insert(reply.end(), compact.begin(), compact.end());
+            log.announces++;
+        }
+        sendto(fd, reply.data(), reply.size(), 0, (sockaddr*)&from, len);
+    }
+}
+
+static AnnounceParams Params(int timeout_ms) {
+    AnnounceParams p;
+    p.info_hash = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20};
+    p.peer_id = "-CPP100-000000000000";
+    p.left = 1000;
+    p.timeout_ms = timeout_ms;
+    return p;
+}
+
+static void TestTiers() {
+    std::cout << "[Test] Tier racing and merging...\n";
+    uint16_t http_port, udp_port, silent_port;
+    int http_fd = Loopback::Listen(AF_INET, SOCK_STREAM, http_port);
+    int udp_fd = Loopback::Listen(AF_INET, SOCK_DGRAM, udp_port);
+    int silent_fd = Loopback::Listen(AF_INET, SOCK_DGRAM, silent_port);
+    std::string http = "http://127.0.0.1:" + std::to_string(http_port) + "/announce";
+    std::string udp = "udp://127.0.0.1:" + std::to_string(udp_port);
+    std::string silent = "udp://127.0.0.1:" + std::to_string(silent_port);
+
+    std::thread http_tracker(HttpTracker, http_fd, 0, 50, 2);
+    std::thread udp_tracker(UdpTracker, udp_fd, 40, 2);
+
+    // Tier 1 lists the dead tracker first; tier 2 overlaps tier 1's peers
+    std::vector<std::vector<std::string>> tiers = {{silent, http}, {udp}};
+    Farm farm;
+    double first_round_ms = 0, second_round_ms = 0;
+    for (int round = 0; round < 2; ++round) {
+        size_t calls = 0;
+        auto start = Farm::Clock::now();
+        Announcer announcer(farm, tiers, Params(5000), [&](const std::vector<Peer>&) { calls++; });
+        announcer.stagger_ms = 150;
+        announcer.Start();
+        farm.Run([&]() { return announcer.Done(); });
+        double ms = std::chrono::duration<double, std::milli>(Farm::Clock::now() - start).count();
+        (round == 0 ? first_round_ms : second_round_ms) = ms;
+
+        assert(calls == 2);                          // One answer per tier, the dead tracker cancelled
+        assert(announcer.Peers().size() == 50);      // 50 + 40, of which 40 are the same peers
+    }
+    http_tracker.join();
+    udp_tracker.join();
+
+    // Round 1 waited out one stagger before the live tracker joined; round 2 asked it first
+    assert(first_round_ms >= 150 && second_round_ms < 150);
+    assert(Announcer::Stats(silent).attempts == 1 && Announcer::Stats(silent).successes == 0);
+    assert(Announcer::Stats(http).successes == 2 && Announcer::Stats(udp).successes == 2);
+    assert(Announcer::Stats(http).ExpectedMs() < Announcer::Stats(silent).ExpectedMs());
+    std::cout << "[PASS] first round " << first_round_ms << " ms, second round " << second_round_ms << " ms\n";
+
+    close(http_fd);
+    close(udp_fd);
+    close(silent_fd);
+}
+
+static void TestLossyUdp() {
+    std::cout << "[Test] UDP retransmission and connection id cache...\n";
+    uint16_t port;
+    int fd = Loopback::Listen(AF_INET, SOCK_DGRAM, port);
+    std::string url = "udp://127.0.0.1:" + std::to_string(port);
+    Farm farm;
+
+    // Three torrents at once: one connect serves them all, every datagram needs a resend,
+    // and 300 peers (1820 bytes) come back whole
+    UdpLog first;
+    std::thread tracker(LossyUdpTracker, fd, 0x11, 400, 3, std::ref(first));
+    std::vector<std::unique_ptr<Announce>> batch;
+    std::vector<AnnounceResult> results(3);
+    for (int i = 0; i < 3; ++i) {
+        AnnounceParams p = Params(5000);
+        p.info_hash[0] = (uint8_t)(100 + i);
+        p.num_want = 300;
+        p.udp_retry_ms = 50;
+        batch.push_back(Announce::Create(farm, url, p, [&results, i](AnnounceResult& r) { results[i] = std::move(r); }));
+    }
+    farm.Run([&]() { return batch[0]->Done() && batch[1]->Done() && batch[2]->Done(); });
+    tracker.join();
+    for (auto& r : results) assert(r.ok && r.peers.size() == 300);
+    assert(first.connects == 1 && first.announces == 3 && first.dropped == 4);
+
+    // Within the minute: straight to the announce
+    auto once = [&](uint8_t id, UdpLog& log) {
+        std::thread t(LossyUdpTracker, fd, id, 10, 1, std::ref(log));
+        AnnounceParams p = Params(5000);
+        p.udp_retry_ms = 50;
+        AnnounceResult result;
+        auto a = Announce::Create(farm, url, p, [&](AnnounceResult& r) { result = std::move(r); });
+        farm.Run([&]() { return a->Done(); });
+        t.join();
+        return result;
+    };
+    UdpLog cached;
+    assert(once(0x11, cached).ok && cached.connects == 0 && cached.announces == 1);
+
+    // The tracker has moved on to a new id: the error sends us back to connect
+    UdpLog rotated;
+    assert(once(0x22, rotated).ok && rotated.errors == 1 && rotated.connects == 1 && rotated.announces == 1);
+    close(fd);
+    std::cout << "[PASS] " << first.dropped << " lost datagrams recovered, one connect for three torrents\n";
+}
+
+static void TestDefaultTimeouts() {
+    std::cout << "[Test] Default deadlines leave room for every UDP retransmit...\n";
+    AnnounceParams defaults; // As Tracker::Params leaves them
+    Url udp = Url::Parse("udp://tracker.example:6969"), http = Url::Parse("http://tracker.example/announce");
+    int64_t deadline = Announce::TimeoutMs(udp, defaults);
+    int64_t last_resend = UdpAnnounce::RetryScheduleMs(defaults.udp_retry_ms) - ((int64_t)defaults.udp_retry_ms << UdpAnnounce::MAX_RETRANSMITS);
+    assert(defaults.udp_retry_ms < deadline);  // The first retransmit goes out
+    assert(last_resend < deadline);            // So does the last one...
+    assert(deadline >= UdpAnnounce::RetryScheduleMs(defaults.udp_retry_ms)); // ...and gets its full wait
+    assert(Announce::TimeoutMs(http, defaults) == HttpAnnounce::TIMEOUT_MS);
+    AnnounceParams capped = defaults;
+    capped.timeout_ms = 2000;
+    assert(Announce::TimeoutMs(udp, capped) == 2000 && Announce::TimeoutMs(http, capped) == 2000);
+
+    // The same with a fast schedule, against a tracker that never answers: every datagram is sent
+    uint16_t port;
+    int fd = Loopback::Listen(AF_INET, SOCK_DGRAM, port);
+    AnnounceParams p = Params(0);
+    p.udp_retry_ms = 2;
+    Farm farm;
+    AnnounceResult result;
+    auto a = Announce::Create(farm, "udp://127.0.0.1:" + std::to_string(port), p, [&](AnnounceResult& r) { result = std::move(r); });
+    farm.Run([&]() { return a->Done(); });
+    int datagrams = 0;
+    uint8_t buf[2048];
+    while (recv(fd, buf, sizeof(buf), MSG_DONTWAIT) > 0) datagrams++;
+    close(fd);
+    assert(!result.ok && datagrams == 1 + UdpAnnounce::MAX_RETRANSMITS);
+    assert(result.latency_ms >= UdpAnnounce::RetryScheduleMs(p.udp_retry_ms));
+    std::cout << "[PASS] UDP gives up after " << deadline / 1000 << " s by default; " << datagrams << " datagrams in "
+              << result.latency_ms << " ms at " << p.udp_retry_ms << " ms\n";
+}
+
+// Rounds someone blocks on are capped: 'completed' to a silent UDP tracker gives up like 'stopped'
+static void TestWaitedRounds() {
+    std::cout << "[Test] A silent UDP tracker can't hold up 'completed'...\n";
+    assert(Announcer::START_TIMEOUT_MS < UdpAnnounce::RetryScheduleMs(AnnounceParams().udp_retry_ms));
+    uint16_t port;
+    int fd = Loopback::Listen(AF_INET, SOCK_DGRAM, port);
+    AnnounceParams p = Params(0); // Default deadlines, default retry schedule
+    Farm farm;
+    Announcer announcer(farm, {{"udp://127.0.0.1:" + std::to_string(port)}}, p, [](const std::vector<Peer>&) {});
+    auto start = Farm::Clock::now();
+    announcer.Send(AnnounceEvent::COMPLETED);
+    farm.Run([&]() { return announcer.Done(); });
+    double ms = std::chrono::duration<double, std::milli>(Farm::Clock::now() - start).count();
+    announcer.Stop(); // Nobody answered: no 'stopped' goes out
+    assert(announcer.Done());
+    close(fd);
+    assert(ms >= Announcer::STOP_TIMEOUT_MS - 50 && ms < Announcer::STOP_TIMEOUT_MS + 1000);
+    std::cout << "[PASS] Gave up after " << ms << " ms\n";
+}
+
+int main() {
+    std::cout << "[Test] Concurrent non-blocking announces...\n";
+    uint16_t http_port, udp_port, silent_port;
+    int http_fd = Loopback::Listen(AF_INET, SOCK_STREAM, http_port);
+    int udp_fd = Loopback::Listen(AF_INET, SOCK_DGRAM, udp_port);
+    int silent_fd = Loopback::Listen(AF_INET, SOCK_DGRAM, silent_port); // Bound, never answers
+
+    std::thread slow_http(HttpTracker, http_fd, 600, 50, 1);
+    std::thread fast_udp(UdpTracker, udp_fd, 40, 1);
+
+    Farm farm;
+    std::vector<std::string> order;
+    AnnounceResult http_result, udp_result, silent_result;
+    auto record = [&](const char* name, AnnounceResult& into) {
+        return [&, name](AnnounceResult& r) { order.push_back(name); into = std::move(r); };
+    };
+
+    auto start = Farm::Clock::now();
+    auto a = Announce::Create(farm, "http://127.0.0.1:" + std::to_string(http_port) + "/announce", Params(5000), record("http", http_result));
+    auto b = Announce::Create(farm, "udp://127.0.0.1:" + std::to_string(udp_port), Params(5000), record("udp", udp_result));
+    auto c = Announce::Create(farm, "udp://127.0.0.1:" + std::to_string(silent_port), Params(300), record("silent", silent_result));
+    // Nothing has blocked: all three are in flight
+    assert(Farm::Clock::now() - start < std::chrono::milliseconds(100));
+    farm.Run([&]() { return a->Done() && b->Done() && c->Done(); });
+    double total_ms = std::chrono::duration<double, std::milli>(Farm::Clock::now() - start).count();
+    slow_http.join();
+    fast_udp.join();
+
+    assert(udp_result.ok && udp_result.peers.size() == 40 && udp_result.interval == 1800);
+    assert(udp_result.peers[1].Ip() == "10.0.0.1" && udp_result.peers[1].Port() == 6882);
+    assert(http_result.ok && http_result.peers.size() == 50);
+    assert(http_result.interval == 1800 && http_result.min_interval == 60);
+    assert(!silent_result.ok && silent_result.error == "timed out");
+
+    // The fast tracker answered first, and the slow one cost its own delay, not the sum
+    assert(order.size() == 3 && order[0] == "udp" && order[1] == "silent" && order[2] == "http");
+    assert(udp_result.latency_ms < 300 && http_result.latency_ms >= 600);
+    assert(total_ms < 600 + 300);
+    std::cout << "[PASS] udp " << udp_result.latency_ms << " ms, timeout " << silent_result.latency_ms
+              << " ms, http " << http_result.latency_ms << " ms, all done in " << total_ms << " ms\n";
+
+    std::cout << "[Test] Refused connection...\n";
+    close(http_fd); // Nobody listens there any more
+    AnnounceResult refused;
+    auto d = Announce::Create(farm, "http://127.0.0.1:" + std::to_string(http_port) + "/announce", Params(5000),
+                              [&](AnnounceResult& r) { refused = std::move(r); });
+    farm.Run([&]() { return d->Done(); });
+    assert(!refused.ok && refused.latency_ms < 1000);
+    std::cout << "[PASS] " << refused.error << "\n";
+
+    close(udp_fd);
+    close(silent_fd);
+
+    TestTiers();
+    TestLossyUdp();
+    TestDefaultTimeouts();
+    TestWaitedRounds();
+    std::cout << "All announce tests passed.\n";
+    return 0;
+}
@@ -1,9 +1,9 @@
 #include "download/Connection.h"
 #include "download/Downloader.h"
+#include "download/Farm.h"
 #include "tracker/Tracker.h"
 #include <iostream>
-#include <unistd.h>
-#include <poll.h>
+#include <chrono>
 
 int main(int argc, char* argv[]) {
     if(argc < 2) { std::cout << "Usage: ./test_connection <file.torrent>\n"; return 1; }
@@ -27,36 +27,22 @@ int main(int argc, char* argv[]) {
         for(const auto& p : peers) {
             if(attempts++ > 5) break; 
 
-            std::cout << "[Test] Connecting to " << p.ip << ":" << p.port << "... ";
+            std::cout << "[Test] Connecting to " << p.ToString() << "... ";
+            Farm farm; // Before 'conn', so it outlives it
             Connection conn(p, d);
-            conn.Connect();
-
-            if(conn.GetSocketFd() == -1) {
-                std::cout << "Failed (Socket Error)\n";
-                continue;
-            }
-
-            // Mini Event Loop
-            struct pollfd pfd;
-            pfd.fd = conn.GetSocketFd();
-            pfd.events = POLLIN | POLLOUT;
+            conn.Connect(farm, 3000);
 
+            // Mini Event Loop: the connect, then the handshake, all on the Farm
             auto start = std::chrono::steady_clock::now();
-            bool handshook = false;
-
-            while(true) {
-                if(std::chrono::steady_clock::now() - start > std::chrono::seconds(3)) break;
-
-                int ret = poll(&pfd, 1, 500); 
-                if(ret > 0) {
-                    if(pfd.revents & POLLOUT) conn.OnReadyWrite();
-                    if(pfd.revents & POLLIN)  conn.OnReadyRead();
-                }
-
-                if(conn.handshake_done) {
-                    handshook = true;
-                    break;
-                }
+            farm.Run([&]() {
+                if(conn.handshake_done) return true;
+                if(!conn.Dialing() && conn.GetSocketFd() == -1) return true; // Refused, timed out, hung up
+                return std::chrono::steady_clock::now() - start > std::chrono::seconds(6);
+            });
+            bool handshook = conn.handshake_done;
+            if(!handshook && conn.GetSocketFd() == -1) {
+                std::cout << (conn.timed_out ? "Failed (Connect timed out)\n" : "Failed (Socket Error)\n");
+                continue;
             }
 
             if(handshook) {
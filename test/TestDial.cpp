@@ -0,0 +1,204 @@
+#include "parsing/TorrentCreator.h"
+#include "download/Downloader.h"
+#include "download/Connection.h"
+#include "download/Farm.h"
+#include "LocalSeeder.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <chrono>
+#include <cassert>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+using namespace BitTorrent;
+using Clock = std::chrono::steady_clock;
+
+// Usage: ./test_dial
+// Peer connects must not block the loop. A listener whose accept queue is full drops every SYN,
+// so peers behind it never answer (like a dead host). The download is handed 195 of those,
+// 10 refused ports and one real seeder, dialled last: it must still finish long before any
+// connect could time out, with never more than 'max_dials' connects in flight. Once connected,
+// the socket stays non-blocking, so a peer that stops reading can't hold up the loop either.
+
+static const int64_t PIECE = 32 * 1024;
+static const int PIECES = 8;
+static const int TARPIT = 195;
+static const int REFUSED = 10;
+
+// Fills the (one slot) accept queue of 'listener' so later SYNs are dropped. Returns the fillers.
+static std::vector<int> Clog(uint16_t port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    std::vector<int> fds;
+    for (int i = 0; i < 2; ++i) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        connect(fd, (sockaddr*)&addr, sizeof(addr));
+        fds.push_back(fd);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    return fds;
+}
+
+static Peer At(const std::string& ip, uint16_t port) { return Peer(ip, port); }
+
+// A peer that never answers is given up on after the connect timeout, and the loop isn't held up
+static void TestTimeout(const TorrentFile& tf, uint16_t tarpit) {
+    std::cout << "[Test] Connect timeout...\n";
+    Downloader d(tf, "-CPP100-000000000000", {});
+    Farm farm;
+    Connection conn(At("127.0.1.250", tarpit), d);
+    auto start = Clock::now();
+    conn.Connect(farm, 200);
+    assert(conn.Dialing());
+    assert(Clock::now() - start < std::chrono::milliseconds(50)); // Connect() returned at once
+
+    int ticks = 0;
+    std::function<void()> tick = [&]() { ticks++; farm.After(std::chrono::milliseconds(10), tick); };
+    farm.After(std::chrono::milliseconds(10), tick);
+    farm.Run([&]() { return !conn.Dialing(); });
+    auto took = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+
+    assert(conn.timed_out && conn.GetSocketFd() == -1);
+    assert(d.dial_stats.timed_out == 1);
+    assert(took >= 190 && took < 1000);
+    assert(ticks >= 10); // The loop kept running meanwhile
+    std::cout << "[PASS] Gave up after " << took << " ms, " << ticks << " timer ticks meanwhile.\n";
+}
+
+// A peer that takes the connection and then never reads: everything we write must return at once
+static void TestNonBlocking(const TorrentFile& tf) {
+    std::cout << "[Test] Connected sockets stay non-blocking...\n";
+    uint16_t port;
+    int listener = Loopback::Listen(AF_INET, SOCK_STREAM, port);
+    int small = 4096; // Small socket buffers on both ends, so they fill up after a few KB
+    setsockopt(listener, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+    Downloader d(tf, "-CPP100-000000000000", {});
+    Farm farm;
+    Connection conn(At("127.0.0.1", port), d);
+    conn.Connect(farm, 1000);
+    farm.Run([&]() { return conn.state == Connection::HANDSHAKING || (!conn.Dialing() && conn.GetSocketFd() < 0); });
+    int fd = conn.GetSocketFd();
+    assert(fd >= 0 && (fcntl(fd, F_GETFL) & O_NONBLOCK));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+
+    // Keep the requests coming until the peer's window and ours are full: the rest piles up in
+    // the send buffer instead of blocking the loop
+    conn.state = Connection::DOWNLOADING;
+    conn.choked = false;
+    conn.peer_pieces.assign(tf.PieceCount(), true);
+    conn.queue_depth = 1u << 20;
+    auto start = Clock::now();
+    for (int i = 0; i < 1000 && conn.send_buffer.empty(); ++i) {
+        conn.outstanding.clear();
+        d.next_req_index = 0;
+        conn.Kick();
+    }
+    auto took = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+    assert(conn.GetSocketFd() == fd && !conn.send_buffer.empty());
+    assert(took < 1000);
+    size_t waiting = conn.send_buffer.size();
+
+    // The peer starts reading: EPOLLOUT sends the rest
+    int peer = accept(listener, nullptr, nullptr);
+    size_t got = 0;
+    uint8_t buf[4096];
+    farm.Run([&]() {
+        for (ssize_t n; (n = recv(peer, buf, sizeof(buf), MSG_DONTWAIT)) > 0;) got += n;
+        return conn.send_buffer.empty() || conn.GetSocketFd() < 0;
+    });
+    assert(conn.GetSocketFd() == fd && conn.send_buffer.empty());
+    close(peer);
+    close(listener);
+    std::cout << "[PASS] " << waiting << " bytes waited for EPOLLOUT after " << took << " ms; " << got << " bytes read in all.\n";
+}
+
+static void TestRace(const TorrentFile& tf, const Buffer& payload, const std::string& root, uint16_t tarpit) {
+    std::cout << "[Test] " << TARPIT + REFUSED + 1 << " peers dialled at once...\n";
+    LocalSeeder seeder(tf, payload);
+
+    // Ports nobody listens on
+    std::vector<uint16_t> refused;
+    for (int i = 0; i < REFUSED; ++i) {
+        uint16_t port;
+        close(Loopback::Listen(AF_INET, SOCK_STREAM, port, 1));
+        refused.push_back(port);
+    }
+
+    // Equal scores are dialled newest first: the seeder goes in first so it is dialled last
+    std::vector<Peer> peers = {At("127.0.0.1", seeder.Port())};
+    for (int i = 0; i < TARPIT; ++i) peers.push_back(At("127.0.1." + std::to_string(i + 1), tarpit));
+    for (uint16_t port : refused) peers.push_back(At("127.0.0.1", port));
+
+    std::string cwd = std::filesystem::current_path();
+    assert(chdir((root + "/dl").c_str()) == 0);
+    long long took;
+    DialStats stats;
+    {
+        Downloader d(tf, "-CPP100-000000000000", peers);
+        d.connect_timeout_ms = 5000;
+        d.max_dials = 200;
+        auto start = Clock::now();
+        d.Start();
+        took = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+        assert(d.IsComplete());
+        stats = d.dial_stats;
+    } // Writer flushes here
+    assert(chdir(cwd.c_str()) == 0);
+
+    std::ifstream in(root + "/dl/payload.bin", std::ios::binary);
+    Buffer got((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    assert(got == payload);
+
+    assert(stats.started == peers.size());
+    assert(stats.connected == 1);
+    assert(stats.failed == REFUSED);
+    assert(stats.timed_out == 0);
+    assert(stats.peak_in_flight >= 150 && stats.peak_in_flight <= 200);
+    assert(took < 2500); // Blocking connects would have sat out the dead peers one after another
+    std::cout << "[PASS] Done in " << took << " ms; peak " << stats.peak_in_flight << " connects in flight.\n";
+}
+
+int main() {
+    const std::string root = std::filesystem::absolute("test_dial_out");
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root + "/src");
+    std::filesystem::create_directories(root + "/dl");
+
+    Buffer payload(PIECE * PIECES);
+    uint32_t seed = 11;
+    for (auto& c : payload) { seed = seed * 1103515245 + 12345; c = (uint8_t)(seed >> 16); }
+    {
+        std::ofstream out(root + "/src/payload.bin", std::ios::binary);
+        out.write((const char*)payload.data(), payload.size());
+    }
+
+    // No tracker answers: the peers below are all there is
+    uint16_t dead_tracker;
+    close(Loopback::Listen(AF_INET, SOCK_STREAM, dead_tracker, 1));
+    CreateOptions opts;
+    opts.announce = "http://127.0.0.1:" + std::to_string(dead_tracker) + "/announce";
+    opts.piece_length = PIECE;
+    Buffer meta = TorrentCreator::Create(root + "/src/payload.bin", opts);
+    TorrentFile tf = TorrentFile::Parse(meta.data(), meta.size());
+
+    // Every 127.0.x.y reaches this listener, and it drops every SYN
+    uint16_t tarpit;
+    int tarpit_fd = Loopback::Listen(AF_INET, SOCK_STREAM, tarpit, 0, true);
+    std::vector<int> clog = Clog(tarpit);
+
+    TestTimeout(tf, tarpit);
+    TestNonBlocking(tf);
+    TestRace(tf, payload, root, tarpit);
+
+    for (int fd : clog) close(fd);
+    close(tarpit_fd);
+    std::filesystem::remove_all(root);
+    std::cout << "All dial tests passed.\n";
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include "tracker/HttpResponse.h"
+#include "tracker/Announce.h"
+#include "parsing/Bnode.h"
+#include <iostream>
+#include <thread>
+#include <cassert>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace BitTorrent;
+
+// Usage: ./test_http
+// The HTTP/1.1 response reader on its own (fed a byte at a time), then announces against a
+// loopback tracker that keeps connections alive, redirects, and sends 30 KB peer lists both
+// chunked and with Content-Length.
+
+// Feeds 'raw' one byte at a time; returns the decoded body
+static std::string FeedBytewise(HttpResponse& r, const std::string& raw) {
+    size_t used = 0;
+    for (char c : raw) {
+        if (r.Done()) break;
+        used += r.Feed((const uint8_t*)&c, 1);
+    }
+    return raw.substr(used); // Not part of this response
+}
+
+static void TestReader() {
+    std::cout << "[Test] HTTP response reader...\n";
+    std::string body;
+    auto sink = [&](const uint8_t* d, size_t n) { body.append((const char*)d, n); };
+
+    HttpResponse fixed(sink);
+    std::string rest = FeedBytewise(fixed, "HTTP/1.1 200 OK\r\nCONTENT-length: 5\r\nX: y\r\n\r\nhelloHTTP/1.1");
+    assert(fixed.Done() && fixed.Status() == 200 && body == "hello" && rest == "HTTP/1.1");
+    assert(fixed.KeepAlive() && fixed.Header("x") == "y" && fixed.Header("Content-Length") == "5");
+
+    body.clear();
+    HttpResponse chunked(sink);
+    rest = FeedBytewise(chunked, "HTTP/1.1 100 Continue\r\n\r\n"
+                                 "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n"
+                                 "4;name=value\r\nWiki\r\nA\r\npedia in\r\n\r\n0\r\nX-Trailer: 1\r\n\r\nnext");
+    assert(chunked.Done() && body == "Wikipedia in\r\n" && rest == "next" && !chunked.KeepAlive());
+
+    body.clear();
+    HttpResponse until_close(sink);
+    std::string raw = "HTTP/1.0 200 OK\r\n\r\nall of it";
+    until_close.Feed((const uint8_t*)raw.data(), raw.size());
+    assert(!until_close.Done() && !until_close.KeepAlive());
+    until_close.FeedEof();
+    assert(until_close.Done() && body == "all of it");
+
+    HttpResponse cut(sink);
+    raw = "HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\nshort";
+    cut.Feed((const uint8_t*)raw.data(), raw.size());
+    cut.FeedEof();
+    assert(!cut.Done());
+
+    HttpResponse moved(sink);
+    raw = "HTTP/1.1 302 Found\r\nLocation: /elsewhere\r\nContent-Length: 0\r\n\r\n";
+    moved.Feed((const uint8_t*)raw.data(), raw.size());
+    assert(moved.Done() && moved.IsRedirect() && moved.Header("location") == "/elsewhere");
+
+    bool threw = false;
+    try {
+        HttpResponse bad(sink);
+        raw = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n";
+        bad.Feed((const uint8_t*)raw.data(), raw.size());
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "[PASS]\n";
+}
+
+struct ServerLog {
+    int connections = 0;
+    int requests = 0;
+};
+
+static std::string CompactPeers(int count) {
+    std::string s;
+    for (int i = 0; i < count; ++i) {
+        uint8_t e[6] = {10, (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i, 0x1A, 0xE1};
+        s.append((const char*)e, 6);
+    }
+    return s;
+}
+
+static void SendAll(int fd, const std::string& s) {
+    size_t sent = 0;
+    while (sent < s.size()) {
+        ssize_t n = send(fd, s.data() + sent, s.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        sent += n;
+    }
+}
+
+// Keep-alive tracker: serves requests on each connection until the client leaves, and hangs
+// up itself after 'close_after' requests in total. "/old" redirects to "/announce"; every other
+// reply alternates between chunked and Content-Length framing.
+static void KeepAliveTracker(int listener, int peers, int close_after, int total, ServerLog& log) {
+    while (log.requests < total) {
+        int fd = accept(listener, nullptr, nullptr);
+        log.connections++;
+        std::string buffer;
+        char chunk[4096];
+        while (log.requests < total) {
+            size_t end = buffer.find("\r\n\r\n");
+            if (end == std::string::npos) {
+                ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+                if (n <= 0) break;
+                buffer.append(chunk, n);
+                continue;
+            }
+            std::string request = buffer.substr(0, end);
+            buffer.erase(0, end + 4);
+            log.requests++;
+            assert(request.find("info_hash=") != std::string::npos && request.find("numwant=") != std::string::npos);
+
+            if (request.compare(0, 8, "GET /old") == 0) {
+                SendAll(fd, "HTTP/1.1 301 Moved Permanently\r\nLocation: /announce\r\nContent-Length: 0\r\n\r\n");
+            } else {
+                BDict reply;
+                reply["interval"] = Bnode((BInt)1800);
+                std::string compact = CompactPeers(peers);
+                reply["peers"] = Bnode(Buffer(compact.begin(), compact.end()));
+                Buffer b = Bnode::Encode(Bnode(std::move(reply)));
+                std::string body(b.begin(), b.end());
+                if (log.requests % 2) {
+                    SendAll(fd, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n");
+                    for (size_t at = 0; at < body.size(); at += 4000) {
+                        std::string part = body.substr(at, 4000);
+                        char size[16];
+                        snprintf(size, sizeof(size), "%zx", part.size());
+                        SendAll(fd, std::string(size) + (at ? "" : ";ext=1") + "\r\n" + part + "\r\n");
+                    }
+                    SendAll(fd, "0\r\nX-Served-By: test\r\n\r\n");
+                } else {
+                    SendAll(fd, "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n");
+                    SendAll(fd, body.substr(0, body.size() / 2));
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    SendAll(fd, body.substr(body.size() / 2));
+                }
+            }
+            if (log.requests == close_after) break;
+        }
+        close(fd);
+    }
+}
+
+static void TestKeepAlive() {
+    std::cout << "[Test] Keep-alive announces with large peer lists...\n";
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    assert(bind(listener, (sockaddr*)&addr, sizeof(addr)) == 0 && listen(listener, 4) == 0);
+    getsockname(listener, (sockaddr*)&addr, &len);
+    std::string base = "http://127.0.0.1:" + std::to_string(ntohs(addr.sin_port));
+
+    const int peers = 5000; // 30 KB of compact peers
+    ServerLog log;
+    std::thread tracker(KeepAliveTracker, listener, peers, 4, 5, std::ref(log));
+
+    Farm farm;
+    auto announce = [&](const std::string& path, uint8_t torrent) {
+        AnnounceParams p;
+        p.info_hash = Buffer(20, torrent);
+        p.peer_id = "-CPP100-000000000000";
+        p.timeout_ms = 5000;
+        AnnounceResult result;
+        auto a = Announce::Create(farm, base + path, p, [&](AnnounceResult& r) { result = std::move(r); });
+        farm.Run([&]() { return a->Done(); });
+        return result;
+    };
+
+    // Torrent 1 through a redirect, torrent 2, torrent 1 again: one connection for all four requests
+    AnnounceResult first = announce("/old", 1);
+    assert(first.ok && first.peers.size() == (size_t)peers && first.interval == 1800);
+    assert(first.peers[peers - 1].Ip() == "10.0.19.135" && first.peers[0].Port() == 6881);
+    assert(announce("/announce", 2).ok);
+    assert(announce("/announce", 1).peers.size() == (size_t)peers);
+    assert(log.connections == 1 && log.requests == 4);
+
+    // The server has closed the pooled connection by now: the next announce reconnects
+    AnnounceResult after_close = announce("/announce", 2);
+    assert(after_close.ok && after_close.peers.size() == (size_t)peers);
+    tracker.join();
+    assert(log.connections == 2 && log.requests == 5);
+    HttpAnnounce::ClearPool();
+    close(listener);
+    std::cout << "[PASS] 5 announces over " << log.connections << " connections\n";
+}
+
+int main() {
+    TestReader();
+    TestKeepAlive();
+    std::cout << "All HTTP tests passed.\n";
+    return 0;
+}
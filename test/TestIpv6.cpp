@@ -0,0 +1,218 @@
+#include "tracker/Announce.h"
+#include "tracker/Dialer.h"
+#include "tracker/Url.h"
+#include "parsing/TorrentCreator.h"
+#include "parsing/Bnode.h"
+#include "download/Downloader.h"
+#include "LocalSeeder.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <cstring>
+#include <cassert>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+using namespace BitTorrent;
+
+// Usage: ./test_ipv6
+// Dual stack on loopback: IPv6 peers from HTTP 'peers6' and from a UDP tracker on ::1, the
+// IPv4/IPv6 connect race, and a download fed by one seeder on ::1 and one on 127.0.0.1.
+
+static const int64_t PIECE = 32 * 1024;
+
+static std::string Compact(const Peer& p) {
+    std::string s;
+    if (p.Family() == AF_INET6) s.append((const char*)&((const sockaddr_in6*)&p.addr)->sin6_addr, 16);
+    else s.append((const char*)&((const sockaddr_in*)&p.addr)->sin_addr, 4);
+    s.push_back((char)(p.Port() >> 8));
+    s.push_back((char)p.Port());
+    return s;
+}
+
+static AnnounceParams Params() {
+    AnnounceParams p;
+    p.info_hash = Buffer(20, 9);
+    p.peer_id = "-CPP100-000000000000";
+    p.timeout_ms = 3000;
+    p.udp_retry_ms = 200;
+    return p;
+}
+
+static void TestAddresses() {
+    std::cout << "[Test] Binary peer addresses and bracketed URLs...\n";
+    Peer v6("2001:db8::7", 51413), v4("192.0.2.1", 6881);
+    assert(v6.Family() == AF_INET6 && v6.Port() == 51413 && v6.ToString() == "[2001:db8::7]:51413");
+    assert(v4.Family() == AF_INET && v4.Ip() == "192.0.2.1" && v4.Length() == sizeof(sockaddr_in));
+    bool threw = false;
+    try { Peer("not-an-ip", 1); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+
+    Url u = Url::Parse("udp://[::1]:6969/announce");
+    assert(u.host == "::1" && u.port == 6969 && u.path == "/announce");
+    assert(Url::Parse("http://[2001:db8::1]/a").host == "2001:db8::1" && Url::Parse("http://[2001:db8::1]/a").port == 80);
+    assert(Url::Parse("http://example.org:8080/a").host == "example.org");
+    std::cout << "[PASS]\n";
+}
+
+static void TestHttpPeers6(Farm& farm) {
+    std::cout << "[Test] HTTP tracker on ::1 with peers and peers6...\n";
+    uint16_t port;
+    int listener = Loopback::Listen(AF_INET6, SOCK_STREAM, port);
+    std::string req;
+    std::thread tracker([listener, &req]() {
+        int fd = accept(listener, nullptr, nullptr);
+        char buf[4096];
+        while (req.find("\r\n\r\n") == std::string::npos) {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) break;
+            req.append(buf, n);
+        }
+        BDict reply;
+        reply["interval"] = Bnode((BInt)1800);
+        std::string v4 = Compact(Peer("10.0.0.1", 6881));
+        std::string v6 = Compact(Peer("2001:db8::1", 6881)) + Compact(Peer("2001:db8::2", 6882));
+        reply["peers"] = Bnode(Buffer(v4.begin(), v4.end()));
+        reply["peers6"] = Bnode(Buffer(v6.begin(), v6.end()));
+        Buffer body = Bnode::Encode(Bnode(std::move(reply)));
+        std::string head = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+        send(fd, head.data(), head.size(), MSG_NOSIGNAL);
+        send(fd, body.data(), body.size(), MSG_NOSIGNAL);
+        close(fd);
+    });
+
+    AnnounceResult result;
+    auto a = Announce::Create(farm, "http://[::1]:" + std::to_string(port) + "/announce", Params(),
+                              [&](AnnounceResult& r) { result = std::move(r); });
+    farm.Run([&]() { return a->Done(); });
+    tracker.join();
+    close(listener);
+    assert(result.ok && result.peers.size() == 3);
+    assert(result.peers[0].ToString() == "10.0.0.1:6881");
+    assert(result.peers[2].ToString() == "[2001:db8::2]:6882");
+    assert(req.find("\r\nHost: [::1]:" + std::to_string(port) + "\r\n") != std::string::npos);
+    std::cout << "[PASS]\n";
+}
+
+static void TestUdp6(Farm& farm) {
+    std::cout << "[Test] UDP tracker on ::1 answers with 18-byte peers...\n";
+    uint16_t port;
+    int fd = Loopback::Listen(AF_INET6, SOCK_DGRAM, port);
+    std::thread tracker([fd]() {
+        uint8_t buf[2048];
+        for (int i = 0; i < 2; ++i) {
+            sockaddr_in6 from{};
+            socklen_t len = sizeof(from);
+            ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, (sockaddr*)&from, &len);
+            Buffer reply = {0, 0, 0, (uint8_t)(n == 16 ? 0 : 1)};
+            reply.insert(reply.end(), buf + 12, buf + 16);
+            if (n == 16) {
+                reply.insert(reply.end(), 8, 0x42);
+            } else {
+                uint8_t tail[12] = {0, 0, 0x07, 0x08};
+                reply.insert(reply.end(), tail, tail + sizeof(tail));
+                for (int p = 0; p < 100; ++p) {
+                    std::string c = Compact(Peer("2001:db8::" + std::to_string(p + 1), 7000 + p));
+                    reply.insert(reply.end(), c.begin(), c.end());
+                }
+            }
+            sendto(fd, reply.data(), reply.size(), 0, (sockaddr*)&from, len);
+        }
+    });
+
+    AnnounceResult result;
+    auto a = Announce::Create(farm, "udp://[::1]:" + std::to_string(port), Params(), [&](AnnounceResult& r) { result = std::move(r); });
+    farm.Run([&]() { return a->Done(); });
+    tracker.join();
+    close(fd);
+    assert(result.ok && result.peers.size() == 100);
+    assert(result.peers[99].ToString() == "[2001:db8::100]:7099");
+    std::cout << "[PASS]\n";
+}
+
+static void TestRace(Farm& farm) {
+    std::cout << "[Test] IPv4 / IPv6 connect race...\n";
+    uint16_t refused_port, live_port;
+    int refused = Loopback::Listen(AF_INET, SOCK_STREAM, refused_port);
+    close(refused); // Nobody there any more: connection refused
+    int live = Loopback::Listen(AF_INET6, SOCK_STREAM, live_port);
+
+    std::vector<sockaddr_storage> addrs = {Peer("127.0.0.1", refused_port).addr, Peer("127.0.0.2", refused_port).addr,
+                                           Peer("::1", live_port).addr};
+    auto order = Dialer::Interleave(addrs);
+    assert(order[0].ss_family == AF_INET && order[1].ss_family == AF_INET6 && order[2].ss_family == AF_INET);
+
+    // The IPv4 attempt fails at once, so IPv6 starts without waiting out the stagger
+    int connected = -2;
+    auto start = Farm::Clock::now();
+    Dialer dialer(farm, order, [&](int fd, const std::string&) { connected = fd; });
+    dialer.Start();
+    farm.Run([&]() { return connected != -2; });
+    double ms = std::chrono::duration<double, std::milli>(Farm::Clock::now() - start).count();
+    assert(connected >= 0 && ms < Dialer::STAGGER_MS);
+    sockaddr_storage peer{};
+    socklen_t len = sizeof(peer);
+    getpeername(connected, (sockaddr*)&peer, &len);
+    assert(peer.ss_family == AF_INET6);
+    close(connected);
+
+    // Nothing reachable: one failure with the last error
+    std::string error;
+    connected = -2;
+    Dialer none(farm, {Peer("127.0.0.1", refused_port).addr}, [&](int fd, const std::string& e) { connected = fd; error = e; });
+    none.Start();
+    farm.Run([&]() { return connected != -2; });
+    assert(connected == -1 && error.find("refused") != std::string::npos);
+    close(live);
+    std::cout << "[PASS] IPv6 won after " << ms << " ms\n";
+}
+
+static void TestDualStackDownload() {
+    std::cout << "[Test] Download from seeders on ::1 and 127.0.0.1...\n";
+    const std::string root = std::filesystem::absolute("test_ipv6_out");
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root + "/dl");
+    Buffer payload(PIECE * 6);
+    uint32_t seed = 3;
+    for (auto& c : payload) { seed = seed * 1103515245 + 12345; c = (uint8_t)(seed >> 16); }
+    {
+        std::ofstream out(root + "/payload.bin", std::ios::binary);
+        out.write((const char*)payload.data(), payload.size());
+    }
+    CreateOptions opts;
+    opts.piece_length = PIECE;
+    Buffer meta = TorrentCreator::Create(root + "/payload.bin", opts);
+    TorrentFile tf = TorrentFile::Parse(meta.data(), meta.size());
+
+    LocalSeeder::Config on_v6;
+    on_v6.family = AF_INET6;
+    LocalSeeder s6(tf, payload, on_v6), s4(tf, payload);
+
+    std::string cwd = std::filesystem::current_path();
+    assert(chdir((root + "/dl").c_str()) == 0);
+    {
+        Downloader d(tf, "-CPP100-000000000000", {Peer("::1", s6.Port()), Peer("127.0.0.1", s4.Port())});
+        d.Start();
+        assert(d.IsComplete());
+    }
+    assert(chdir(cwd.c_str()) == 0);
+
+    std::ifstream in(root + "/dl/payload.bin", std::ios::binary);
+    Buffer got((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    assert(got == payload);
+    std::filesystem::remove_all(root);
+    std::cout << "[PASS]\n";
+}
+
+int main() {
+    TestAddresses();
+    Farm farm;
+    TestHttpPeers6(farm);
+    TestUdp6(farm);
+    TestRace(farm);
+    TestDualStackDownload();
+    std::cout << "All IPv6 tests passed.\n";
+    return 0;
+}
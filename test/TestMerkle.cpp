@@ -0,0 +1,259 @@
+#include "parsing/Merkle.h"
+#include "parsing/Bnode.h"
+#include "download/Downloader.h"
+#include "LocalSeeder.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <cassert>
+#include <unistd.h>
+
+using namespace BitTorrent;
+
+// Usage: ./test_merkle
+// BEP 52 hash trees, v2 / hybrid metainfo generated right here, and a download from a loopback
+// seeder that corrupts one block: the block must be caught on arrival and fetched again alone.
+
+struct SourceFile {
+    std::vector<std::string> path; // Components below the torrent name
+    Buffer data;
+};
+
+static Buffer MakePayload(size_t size, uint32_t seed) {
+    Buffer b(size);
+    for (auto& c : b) { seed = seed * 1103515245 + 12345; c = (uint8_t)(seed >> 16); }
+    return b;
+}
+
+static Bnode Str(const std::string& s) { return Bnode(BufferUtils::FromString(s)); }
+
+// Metainfo for 'files' under 'name'. Pure v2 unless 'hybrid', which adds the v1 'files' list
+// (with pad files up to each piece boundary) and the SHA-1 'pieces' over that padded stream.
+static Buffer BuildTorrent(const std::string& name, const std::vector<SourceFile>& files, int64_t piece_length, bool hybrid) {
+    BDict tree, layers;
+    for (const auto& f : files) {
+        BDict leaf;
+        leaf["length"] = Bnode((BInt)f.data.size());
+        if (!f.data.empty()) {
+            std::vector<Sha256Digest> layer;
+            Sha256Digest root = MerkleTree::FileRoot(f.data.data(), f.data.size(), piece_length, &layer);
+            leaf["pieces root"] = Bnode(Buffer(root.begin(), root.end()));
+            if (!layer.empty()) {
+                Buffer blob;
+                for (auto& h : layer) blob.insert(blob.end(), h.begin(), h.end());
+                layers[std::string_view((const char*)root.data(), 32)] = Bnode(blob);
+            }
+        }
+        // Walk down (creating) the directories, then hang the leaf under ""
+        BDict* dir = &tree;
+        for (size_t i = 0; i + 1 < f.path.size(); ++i) {
+            Bnode& sub = (*dir)[f.path[i]];
+            if (!std::holds_alternative<BDict>(sub.value)) sub = Bnode(BDict());
+            dir = &std::get<BDict>(sub.value);
+        }
+        BDict file;
+        file[""] = Bnode(std::move(leaf));
+        (*dir)[f.path.back()] = Bnode(std::move(file));
+    }
+
+    BDict info;
+    info["name"] = Str(name);
+    info["piece length"] = Bnode((BInt)piece_length);
+    info["meta version"] = Bnode((BInt)2);
+    info["file tree"] = Bnode(std::move(tree));
+
+    if (hybrid) {
+        BList list;
+        Buffer stream;
+        for (size_t i = 0; i < files.size(); ++i) {
+            const auto& f = files[i];
+            BDict entry;
+            entry["length"] = Bnode((BInt)f.data.size());
+            BList path;
+            for (auto& part : f.path) path.push_back(Str(part));
+            entry["path"] = Bnode(std::move(path));
+            list.push_back(Bnode(std::move(entry)));
+            stream.insert(stream.end(), f.data.begin(), f.data.end());
+
+            size_t gap = (piece_length - stream.size() % piece_length) % piece_length;
+            if (gap && i + 1 < files.size()) {
+                BDict pad;
+                pad["attr"] = Str("p");
+                pad["length"] = Bnode((BInt)gap);
+                BList pad_path;
+                pad_path.push_back(Str(".pad"));
+                pad_path.push_back(Str(std::to_string(gap)));
+                pad["path"] = Bnode(std::move(pad_path));
+                list.push_back(Bnode(std::move(pad)));
+                stream.resize(stream.size() + gap, 0);
+            }
+        }
+        info["files"] = Bnode(std::move(list));
+        Buffer pieces;
+        for (size_t off = 0; off < stream.size(); off += piece_length) {
+            uint8_t digest[Sha1::DIGEST_SIZE];
+            Sha1::Digest(stream.data() + off, std::min<size_t>(piece_length, stream.size() - off), digest);
+            pieces.insert(pieces.end(), digest, digest + sizeof(digest));
+        }
+        info["pieces"] = Bnode(pieces);
+    }
+
+    BDict torrent;
+    torrent["info"] = Bnode(std::move(info));
+    if (!layers.empty()) torrent["piece layers"] = Bnode(std::move(layers));
+    return Bnode::Encode(Bnode(std::move(torrent)));
+}
+
+// The torrent's byte stream (alignment gaps and pad files are zeros)
+static Buffer Stream(const TorrentFile& tf, const std::vector<SourceFile>& files) {
+    Buffer stream(tf.length, 0);
+    for (const auto& e : tf.files) {
+        if (e.pad || e.length == 0) continue;
+        for (const auto& f : files) {
+            std::string path = tf.name;
+            for (auto& part : f.path) path += "/" + part;
+            if (e.path == path || (tf.files.size() == 1 && e.path == tf.name)) {
+                std::memcpy(stream.data() + e.offset, f.data.data(), f.data.size());
+            }
+        }
+    }
+    return stream;
+}
+
+static void TestTreeMath() {
+    std::cout << "[Test] Merkle tree math...\n";
+    Sha256Digest zero{};
+    Sha256Digest a = MerkleTree::HashBlock((const uint8_t*)"a", 1), b = MerkleTree::HashBlock((const uint8_t*)"b", 1);
+    assert(MerkleTree::Root({a}, 1) == a);
+    assert(MerkleTree::Root({a, b}, 4) == MerkleTree::HashPair(MerkleTree::HashPair(a, b), MerkleTree::HashPair(zero, zero)));
+    assert(MerkleTree::PadRoot(4) == MerkleTree::HashPair(MerkleTree::HashPair(zero, zero), MerkleTree::HashPair(zero, zero)));
+    assert(MerkleTree::NextPow2(5) == 8 && MerkleTree::NextPow2(8) == 8 && MerkleTree::NextPow2(1) == 1);
+
+    // Going through the piece layer must give the same root as hashing the leaves straight up
+    Buffer data = MakePayload(100000, 1); // 7 leaves, the last one short
+    std::vector<Sha256Digest> layer;
+    Sha256Digest root = MerkleTree::FileRoot(data.data(), data.size(), 32768, &layer);
+    assert(layer.size() == 4);
+    assert(root == MerkleTree::Root(MerkleTree::BlockHashes(data.data(), data.size()), 8));
+    std::cout << "[PASS] Roots, padding and piece layers agree.\n";
+}
+
+static void TestParseV2() {
+    std::cout << "[Test] Pure v2 metainfo...\n";
+    const int64_t piece = 32768;
+    std::vector<SourceFile> files = {
+        {{"big.bin"}, MakePayload(100000, 2)},       // Several pieces, has a piece layer
+        {{"empty"}, Buffer()},
+        {{"sub", "small.bin"}, MakePayload(5000, 3)}, // Fits in one piece: checked against its root
+    };
+    Buffer meta = BuildTorrent("v2", files, piece, false);
+    TorrentFile tf = TorrentFile::Parse(meta.data(), meta.size());
+
+    assert(tf.HasV2() && !tf.HasV1());
+    assert(tf.info_hash_v2.size() == 32 && std::equal(tf.info_hash.begin(), tf.info_hash.end(), tf.info_hash_v2.begin()));
+    assert(tf.files.size() == 3 && tf.files[0].path == "v2/big.bin" && tf.files[2].path == "v2/sub/small.bin");
+    assert(tf.files[2].offset == 4 * piece); // Aligned to the next piece
+    assert(tf.length == 4 * piece + 5000 && tf.PieceCount() == 5);
+    assert(tf.PieceSize(3) == 100000 - 3 * piece && tf.PieceSize(4) == 5000);
+
+    Buffer stream = Stream(tf, files);
+    for (size_t i = 0; i < tf.PieceCount(); ++i) {
+        int64_t start = (int64_t)i * piece;
+        assert(MerkleTree::VerifyPiece(tf, i, stream.data() + start, tf.PieceSize(i)));
+    }
+    stream[piece + 100] ^= 1;
+    assert(!MerkleTree::VerifyPiece(tf, 1, stream.data() + piece, piece));
+
+    // A piece layer that doesn't hash up to the file's root is refused at load time
+    Buffer bad = meta;
+    std::string key = "12:piece layers";
+    auto at = std::search(bad.begin(), bad.end(), key.begin(), key.end());
+    assert(at != bad.end());
+    bad[(at - bad.begin()) + key.size() + 3 + 32 + 5] ^= 1; // "32:<root>128:" then the layer
+    bool threw = false;
+    try { TorrentFile::Parse(bad.data(), bad.size()); } catch (const std::exception&) { threw = true; }
+    assert(threw);
+    std::cout << "[PASS] File tree, alignment and piece layers.\n";
+}
+
+static void TestParseHybrid() {
+    std::cout << "[Test] Hybrid metainfo...\n";
+    const int64_t piece = 16384;
+    std::vector<SourceFile> files = {
+        {{"a.bin"}, MakePayload(40000, 4)},
+        {{"b.bin"}, MakePayload(20000, 5)},
+    };
+    Buffer meta = BuildTorrent("hy", files, piece, true);
+    TorrentFile tf = TorrentFile::Parse(meta.data(), meta.size());
+
+    assert(tf.HasV1() && tf.HasV2());
+    assert(tf.files.size() == 3 && tf.files[1].pad && tf.files[2].offset == 3 * piece);
+    assert(tf.PieceCount() == 5 && tf.FileAt(40000) == nullptr && tf.FileAt(3 * piece) == &tf.files[2]);
+    assert(tf.files[0].pieces_root != Sha256Digest{} && tf.files[2].pieces_root != Sha256Digest{});
+
+    // Both hash sets accept the same stream, pad bytes included
+    Buffer stream = Stream(tf, files);
+    for (size_t i = 0; i < tf.PieceCount(); ++i) {
+        const uint8_t* p = stream.data() + i * piece;
+        uint8_t sha1[Sha1::DIGEST_SIZE];
+        Sha1::Digest(p, tf.PieceSize(i), sha1);
+        assert(std::memcmp(sha1, tf.PieceHash(i), sizeof(sha1)) == 0);
+        assert(MerkleTree::VerifyPiece(tf, i, p, tf.PieceSize(i)));
+    }
+    stream[40000 + 10] = 1; // Junk in the pad file
+    assert(!MerkleTree::VerifyPiece(tf, 2, stream.data() + 2 * piece, piece));
+    std::cout << "[PASS] v1 and v2 views of the same files.\n";
+}
+
+static void TestLoopbackDownload() {
+    std::cout << "[Test] v2 download from a loopback seeder with one corrupt block...\n";
+    const int64_t piece = 65536; // 4 blocks per piece
+    std::vector<SourceFile> files = {
+        {{"movie.bin"}, MakePayload(300000, 6)},
+        {{"notes.txt"}, MakePayload(20000, 7)},
+    };
+    Buffer meta = BuildTorrent("loop", files, piece, false);
+    TorrentFile tf = TorrentFile::Parse(meta.data(), meta.size());
+
+    // Serves every piece and every leaf hash asked for, but the first copy of piece 2 block 1 is garbage
+    Buffer stream = Stream(tf, files);
+    LocalSeeder::Config bad;
+    bad.corrupt_piece = 2;
+    LocalSeeder seeder(tf, stream, bad);
+
+    // The Downloader writes below the working directory
+    const std::string root = std::filesystem::absolute("test_merkle_out");
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root);
+    std::string cwd = std::filesystem::current_path();
+    assert(chdir(root.c_str()) == 0);
+
+    size_t bad_blocks;
+    {
+        Downloader d(tf, "-CPP100-000000000000", {Peer("127.0.0.1", seeder.Port())});
+        d.Start();
+        assert(d.IsComplete());
+        bad_blocks = d.merkle_bad_blocks;
+    } // Writer flushes here
+    seeder.Join();
+    assert(chdir(cwd.c_str()) == 0);
+
+    assert(bad_blocks == 1);
+    for (const auto& f : files) {
+        std::ifstream in(root + "/loop/" + f.path[0], std::ios::binary);
+        Buffer got((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        assert(got == f.data);
+    }
+    std::filesystem::remove_all(root);
+    std::cout << "[PASS] Bad block rejected on arrival, re-fetched alone, files intact.\n";
+}
+
+int main() {
+    TestTreeMath();
+    TestParseV2();
+    TestParseHybrid();
+    TestLoopbackDownload();
+    std::cout << "All Merkle tests passed.\n";
+    return 0;
+}
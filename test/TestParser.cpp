@@ -1,7 +1,14 @@
 #include "parsing/TorrentFile.h"
 #include "parsing/Buffer.h"
+#include "parsing/BnodeView.h"
+#include "parsing/BnodeParser.h"
 #include <iostream>
 #include <cassert>
+#include <algorithm>
+#include <memory_resource>
+#include <fstream>
+#include <cstdio>
+#include <openssl/sha.h>
 
 using namespace BitTorrent;
 
@@ -19,7 +26,155 @@ void TestBencode() {
     
     Bnode root = Bnode::Decode(b);
     assert(root.IsDict());
-    assert(root.GetDict().at("key").GetString() == "value");
+    assert(root.GetDict().at("key").ToString() == "value");
+    std::cout << "PASS" << std::endl;
+}
+
+void TestBnodeView() {
+    std::cout << "[Test] Bencode View..." << std::endl;
+    std::string raw = "d4:infod6:lengthi-42e4:name3:abce4:listli1ei2e3:xyze3:zzz0:e";
+    Buffer b(raw.begin(), raw.end());
+
+    BnodeView root = BnodeView::Decode(b);
+    assert(root.IsDict());
+    assert(root.At("zzz").GetString().empty());
+    assert(!root.Find("missing"));
+
+    BnodeView info = root.At("info");
+    assert(info.At("length").GetInt() == -42);
+    assert(info.At("name").ToString() == "abc");
+    // The view spans the exact encoded bytes of the value
+    assert(std::string((const char*)info.Data(), info.Size()) == "d6:lengthi-42e4:name3:abce");
+
+    BnodeView list = root.At("list");
+    assert(list.Count() == 3);
+    assert(list[1].GetInt() == 2);
+    assert(list[2].GetString() == "xyz");
+
+    // Malformed input must throw, not read past the end
+    for (std::string bad : {"d3:key", "i12", "5:abc", "li1e", "d1:ai1e", "i1x2e", "di1ei2ee"}) {
+        Buffer bb(bad.begin(), bad.end());
+        bool threw = false;
+        try { BnodeView::Decode(bb); } catch (std::exception&) { threw = true; }
+        assert(threw);
+    }
+    std::cout << "PASS" << std::endl;
+}
+void TestInfoHashFromRawBytes() {
+    std::cout << "[Test] Info Hash over raw bytes..." << std::endl;
+    // Keys out of order and a zero-padded integer: re-encoding would "fix" both and change the hash
+    std::string info = "d6:pieces20:AAAAAAAAAAAAAAAAAAAA4:name1:x12:piece lengthi0016384e6:lengthi5ee";
+    std::string raw = "d8:announce9:http://x/4:info" + info + "e";
+    Buffer b(raw.begin(), raw.end());
+
+    // The owning decoder records where every node came from
+    Bnode root = Bnode::Decode(b);
+    const Bnode& infoNode = root.GetDict().at("info");
+    assert(std::string(b.begin() + infoNode.raw_begin, b.begin() + infoNode.raw_end) == info);
+    assert(Bnode::Encode(infoNode) != Buffer(info.begin(), info.end()));
+
+    std::string path = "test_info_hash.torrent";
+    { std::ofstream(path, std::ios::binary) << raw; }
+    TorrentFile t = TorrentFile::Load(path);
+    std::remove(path.c_str());
+
+    Buffer expected(20);
+    SHA1((const uint8_t*)info.data(), info.size(), expected.data());
+    assert(t.info_hash == expected);
+    assert(raw.compare(t.info_offset, t.info_size, info) == 0);
+    std::cout << "PASS" << std::endl;
+}
+void TestAnnounceList() {
+    std::cout << "[Test] announce-list tiers..." << std::endl;
+    std::string info = "d6:lengthi5e4:name1:x12:piece lengthi16384e6:pieces20:AAAAAAAAAAAAAAAAAAAAe";
+    std::string raw = "d8:announce8:http://a13:announce-listll8:http://a9:udp://b:1elel8:http://cee4:info" + info + "e";
+    TorrentFile t = TorrentFile::Parse((const uint8_t*)raw.data(), raw.size());
+    auto tiers = t.TrackerTiers();
+    assert(tiers.size() == 2); // The empty tier is dropped
+    assert(tiers[0] == std::vector<std::string>({"http://a", "udp://b:1"}));
+    assert(tiers[1] == std::vector<std::string>({"http://c"}));
+
+    // Without a list, 'announce' is the only tier
+    std::string single = "d8:announce8:http://a4:info" + info + "e";
+    t = TorrentFile::Parse((const uint8_t*)single.data(), single.size());
+    assert(t.TrackerTiers().size() == 1 && t.TrackerTiers()[0][0] == "http://a");
+    std::cout << "PASS" << std::endl;
+}
+void TestIncrementalParser() {
+    std::cout << "[Test] Incremental Bencode Parser..." << std::endl;
+    std::string raw = "d5:peers12:AAAAAABBBBBB8:intervali-1800e4:listl0:i0ed1:ai1eeee";
+    Buffer b(raw.begin(), raw.end());
+    Buffer expected = Bnode::Encode(Bnode::Decode(b));
+
+    // Every split point, including byte-at-a-time, must produce the same tree
+    for (size_t chunk = 1; chunk <= b.size(); ++chunk) {
+        BnodeBuilder builder;
+        BnodeParser parser(builder);
+        for (size_t i = 0; i < b.size(); i += chunk) {
+            assert(!parser.Done());
+            parser.Feed(b.data() + i, std::min(chunk, b.size() - i));
+        }
+        assert(parser.Done());
+        assert(Bnode::Encode(builder.Result()) == expected);
+    }
+
+    // Truncated input is not an error, just "not done yet"
+    BnodeHandler ignore;
+    BnodeParser partial(ignore);
+    partial.Feed(b.data(), b.size() - 1);
+    assert(!partial.Done());
+
+    // Malformed input still throws
+    bool threw = false;
+    BnodeParser bad(ignore);
+    try { bad.Feed(BufferUtils::FromString("di1ei2ee")); } catch (std::exception&) { threw = true; }
+    assert(threw);
+    std::cout << "PASS" << std::endl;
+}
+// Counts how often the arena has to go back to the heap
+class CountingResource : public std::pmr::memory_resource {
+public:
+    int allocations = 0;
+private:
+    void* do_allocate(size_t bytes, size_t align) override {
+        allocations++;
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+    void do_deallocate(void* p, size_t bytes, size_t align) override {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+void TestArenaDecode() {
+    std::cout << "[Test] Arena Decode & Flat Dict..." << std::endl;
+    std::string raw = "d1:al";
+    for (int i = 0; i < 500; ++i) {
+        std::string id = std::to_string(i);
+        raw += "d2:id" + std::to_string(id.size()) + ":" + id + "4:porti" + id + "ee";
+    }
+    raw += "e1:bi7ee";
+    Buffer b(raw.begin(), raw.end());
+
+    CountingResource heap;
+    {
+        std::pmr::monotonic_buffer_resource arena(64 * 1024, &heap);
+        Bnode root = Bnode::Decode(b, &arena);
+        assert(root.GetDict().at("b").GetInt() == 7);
+        assert(root.GetDict().at("a").GetList()[499].GetDict().at("port").GetInt() == 499);
+        assert(Bnode::Encode(root) == b);
+    }
+    // ~1500 containers, but only a handful of big blocks from the heap
+    assert(heap.allocations > 0 && heap.allocations < 10);
+
+    // Out-of-order inserts still iterate (and encode) in key order
+    BDict d;
+    d["zeta"] = Bnode((BInt)1);
+    d["alpha"] = Bnode((BInt)2);
+    d["mid"] = Bnode((BInt)3);
+    d["alpha"] = Bnode((BInt)4);
+    assert(d.size() == 3 && d.count("alpha") && !d.count("beta"));
+    assert(Bnode::Encode(Bnode(d)) == BufferUtils::FromString("d5:alphai4e3:midi3e4:zetai1ee"));
     std::cout << "PASS" << std::endl;
 }
 // argc (Argument Count): How many words did you type in the terminal?
@@ -28,6 +183,11 @@ int main(int argc, char* argv[]) {
     try {
         TestBuffer();
         TestBencode();
+        TestBnodeView();
+        TestInfoHashFromRawBytes();
+        TestAnnounceList();
+        TestIncrementalParser();
+        TestArenaDecode();
 
         if (argc > 1) {
             std::cout << "[Test] Loading Torrent: " << argv[1] << std::endl;
@@ -35,7 +195,7 @@ int main(int argc, char* argv[]) {
             std::cout << "Name: " << t.name << std::endl;
             std::cout << "Announce: " << t.announce << std::endl;
             std::cout << "Size: " << t.length << " bytes" << std::endl;
-            std::cout << "Pieces: " << t.piece_hashes.size() << std::endl;
+            std::cout << "Pieces: " << t.PieceCount() << std::endl;
             std::cout << "Info Hash: ";
             for(auto c : t.info_hash) printf("%02x", c);
             std::cout << std::endl;
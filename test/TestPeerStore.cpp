@@ -0,0 +1,147 @@
+#include "tracker/PeerStore.h"
+#include "tracker/Announce.h"
+#include "LocalTracker.h"
+#include <iostream>
+#include <chrono>
+#include <cassert>
+#include <netinet/in.h>
+
+using namespace BitTorrent;
+
+// Usage: ./test_peer_store
+// De-duplication by binary address across IPv4/IPv6 and compact blobs, dialling order (score,
+// family, backoff, retirement), a few hundred thousand peers at once, and tracker replies
+// parsed straight into a store from a LocalTracker.
+
+static std::string Compact(int count, int first = 0) {
+    std::string s;
+    for (int i = first; i < first + count; ++i) {
+        uint8_t e[6] = {10, (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i, (uint8_t)((6881 + i % 1000) >> 8), (uint8_t)(6881 + i % 1000)};
+        s.append((const char*)e, 6);
+    }
+    return s;
+}
+
+static void TestDedup() {
+    std::cout << "[Test] De-duplication...\n";
+    PeerStore store;
+    bool added;
+    uint32_t a = store.Add(Peer("1.2.3.4", 6881), PeerSource::TRACKER, &added);
+    assert(added);
+    assert(store.Add(Peer("1.2.3.4", 6881), PeerSource::TRACKER, &added) == a && !added);
+    store.Add(Peer("1.2.3.4", 6882), PeerSource::TRACKER, &added);
+    assert(added); // Same host, other port: another peer
+    store.Add(Peer("2001:db8::1", 6881), PeerSource::TRACKER, &added);
+    assert(added && store.Size() == 3);
+    // IPv4 written as v4-mapped IPv6 is the same peer
+    store.Add(Peer("::ffff:1.2.3.4", 6881), PeerSource::TRACKER, &added);
+    assert(!added);
+
+    assert(store[a].key.IsV4() && store[a].key.ToPeer().ToString() == "1.2.3.4:6881");
+    assert(store.Find(PeerKey::From(Peer("2001:db8::1", 6881))) == 2);
+    assert(store.Find(PeerKey::From(Peer("2001:db8::1", 1))) == -1);
+
+    std::string blob = Compact(10);
+    std::vector<uint32_t> fresh;
+    assert(store.AddCompact((const uint8_t*)blob.data(), blob.size() + 0, PeerSource::TRACKER, &fresh) == 10);
+    assert(fresh.size() == 10 && fresh[0] == 3);
+    // Again, with a torn last entry: nothing new
+    assert(store.AddCompact((const uint8_t*)blob.data(), blob.size() - 3, PeerSource::TRACKER) == 0);
+    assert(store.Size() == 13);
+    std::cout << "[PASS]\n";
+}
+
+static void TestOrder() {
+    std::cout << "[Test] Dialling order and backoff...\n";
+    PeerStore store;
+    auto t0 = PeerStore::Clock::now();
+    uint32_t v4a = store.Add(Peer("10.0.0.1", 1), PeerSource::TRACKER);
+    uint32_t v4b = store.Add(Peer("10.0.0.2", 1), PeerSource::TRACKER);
+    uint32_t given = store.Add(Peer("10.0.0.3", 1), PeerSource::GIVEN);
+    uint32_t v6 = store.Add(Peer("fd00::1", 1), PeerSource::TRACKER);
+
+    uint32_t i;
+    assert(store.Next(i, 0, t0) && i == given);      // Scored higher
+    assert(store.Next(i, AF_INET6, t0) && i == v6);  // Asked for the other family
+    assert(store.Next(i, AF_INET6, t0) && i == v4b); // None left there: newest IPv4
+    store.Failed(v4b, t0);
+    store.Closed(given, true, t0);
+    assert(store.Next(i, 0, t0) && i == v4a);
+    store.Requeue(v4a); // Called off by us: straight back, no penalty
+    assert(store[v4a].state == PeerInfo::READY && store[v4a].failures == 0);
+    assert(store.Next(i, 0, t0) && i == v4a);
+    assert(!store.Next(i, 0, t0) && !store.HasCandidates(t0));
+
+    // Backing off: 30 s after the first failure, then 60 s
+    assert(!store.HasCandidates(t0 + std::chrono::seconds(29)));
+    assert(store.Next(i, 0, t0 + std::chrono::seconds(30)) && i == v4b);
+    store.Failed(v4b, t0 + std::chrono::seconds(30));
+    assert(store[v4b].failures == 2 && store[v4b].score == -2);
+    // A useful peer comes back after REDIAL_S, ahead of the one that keeps failing
+    auto later = t0 + std::chrono::seconds(200);
+    assert(store.Next(i, 0, later) && i == given && store[given].score == 3);
+    assert(store.Next(i, 0, later) && i == v4b);
+
+    // Enough failures in a row and it is never offered again
+    for (int n = store[v4b].failures; n < PeerStore::MAX_FAILURES; n++) {
+        store.Failed(v4b, later);
+        later += std::chrono::seconds(PeerStore::MAX_BACKOFF_S);
+        if (n + 1 < PeerStore::MAX_FAILURES) assert(store.Next(i, AF_INET, later) && i == v4b);
+    }
+    assert(store[v4b].state == PeerInfo::RETIRED);
+    while (store.Next(i, 0, later)) assert(i != v4b);
+    std::cout << "[PASS]\n";
+}
+
+static void TestScale() {
+    std::cout << "[Test] 300k peers...\n";
+    const int count = 300000;
+    std::string blob = Compact(count);
+    PeerStore store;
+    auto start = std::chrono::steady_clock::now();
+    assert(store.AddCompact((const uint8_t*)blob.data(), blob.size(), PeerSource::TRACKER) == (size_t)count);
+    double add_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    assert(store.AddCompact((const uint8_t*)blob.data(), blob.size(), PeerSource::TRACKER) == 0);
+    double dup_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    assert(store.Size() == (size_t)count);
+    uint32_t i;
+    assert(store.Next(i) && i == count - 1); // Newest first
+    std::cout << "[PASS] added in " << add_ms << " ms, re-offered in " << dup_ms << " ms, "
+              << sizeof(PeerInfo) << " bytes per peer\n";
+}
+
+static void TestAnnounceIntoStore() {
+    std::cout << "[Test] Tracker replies parsed into a store...\n";
+    LocalTracker::Config config;
+    config.peers = LocalTracker::SyntheticPeers(300, 20);
+    LocalTracker tracker(config);
+    PeerStore store;
+    Farm farm;
+    AnnounceParams p;
+    p.info_hash = Buffer(20, 1);
+    p.peer_id = "-CPP100-000000000000";
+    p.store = &store;
+    AnnounceResult h, u;
+    auto a = Announce::Create(farm, tracker.UdpUrl(), p, [&](AnnounceResult& r) { u = std::move(r); });
+    farm.Run([&]() { return a->Done(); });
+    p.num_want = 400;
+    auto b = Announce::Create(farm, tracker.HttpUrl(), p, [&](AnnounceResult& r) { h = std::move(r); });
+    farm.Run([&]() { return b->Done(); });
+
+    // UDP: the first 200 IPv4 peers. HTTP: everyone, so only the other 100 IPv4 and the 20 IPv6 are new
+    assert(u.ok && u.peers.empty() && u.fresh.size() == 200);
+    assert(h.ok && h.peers.empty() && h.fresh.size() == 120);
+    assert(store[h.fresh.front()].key.IsV4() && !store[h.fresh.back()].key.IsV4()); // peers6 comes after peers
+    assert(store.Size() == 320);
+    std::cout << "[PASS]\n";
+}
+
+int main() {
+    TestDedup();
+    TestOrder();
+    TestScale();
+    TestAnnounceIntoStore();
+    std::cout << "All peer store tests passed.\n";
+    return 0;
+}
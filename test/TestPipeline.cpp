@@ -0,0 +1,204 @@
+#include "parsing/TorrentCreator.h"
+#include "download/Downloader.h"
+#include "download/Connection.h"
+#include "download/Farm.h"
+#include "LocalSeeder.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cassert>
+#include <unistd.h>
+
+using namespace BitTorrent;
+using Clock = std::chrono::steady_clock;
+
+// Usage: ./test_pipeline
+// Requests must be pipelined. The seeder answers every REQUEST only after a fixed delay (an RTT),
+// so one request at a time would take blocks x delay. With a queue sized to the bandwidth-delay
+// product it takes a small multiple of the delay, and never more requests are outstanding than
+// the peer's 'reqq' allows. A peer that chokes us mid-way drops what we had queued; those
+// blocks must be asked for again. A peer that goes silent mid-piece is snubbed, and another one
+// must finish that piece. Pieces a peer doesn't have stay in the queue for the others.
+
+static const int64_t PIECE = 256 * 1024;
+static const int PIECES = 16;
+static const int DELAY_MS = 40;
+static const size_t BLOCKS = PIECE * PIECES / Downloader::BLOCK_SIZE; // 256: ~10 s one at a time
+
+static void TestQueueDepth() {
+    std::cout << "[Test] Queue depth from rate and RTT...\n";
+    assert(Connection::QueueDepth(0, 0, 0) == Connection::INITIAL_QUEUE_DEPTH);
+    assert(Connection::QueueDepth(0, 0, 2) == 2);                       // Never past 'reqq'
+    assert(Connection::QueueDepth(1e6, 0.1, 0) == 13);                  // 2 x 100 KB in 16 KiB blocks
+    assert(Connection::QueueDepth(1e4, 0.1, 0) == Connection::MIN_QUEUE_DEPTH);
+    assert(Connection::QueueDepth(1e9, 0.1, 0) == Connection::MAX_QUEUE_DEPTH);
+    assert(Connection::QueueDepth(1e9, 0.1, 500) == 500);               // 'reqq' beats our default cap
+    assert(Connection::QueueDepth(1e9, 0.1, 50) == 50);
+    std::cout << "[PASS]\n";
+}
+
+// Downloads the payload from one delayed seeder; returns how long it took
+static long long Download(const TorrentFile& tf, const Buffer& payload, const std::string& root, LocalSeeder::Config opts,
+                          LocalSeeder::Stats& stats) {
+    opts.delay_ms = DELAY_MS;
+    LocalSeeder seeder(tf, payload, opts);
+
+    std::filesystem::remove_all(root + "/dl");
+    std::filesystem::create_directories(root + "/dl");
+    std::string cwd = std::filesystem::current_path();
+    assert(chdir((root + "/dl").c_str()) == 0);
+    long long took;
+    {
+        Downloader d(tf, "-CPP100-000000000000", {Peer("127.0.0.1", seeder.Port())});
+        auto start = Clock::now();
+        d.Start();
+        took = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+        assert(d.IsComplete());
+    } // Writer flushes here; the connection closes when the Farm goes
+    assert(chdir(cwd.c_str()) == 0);
+    seeder.Join();
+    stats = seeder.Seen();
+
+    std::ifstream in(root + "/dl/payload.bin", std::ios::binary);
+    Buffer got((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    assert(got == payload);
+    return took;
+}
+
+// Seeder A stops answering partway through its first piece (its reqq of 4 keeps every request in
+// that piece) but stays connected; B is fine. Once A is snubbed the piece must go to B.
+static void TestStall(const TorrentFile& tf, const Buffer& payload, const std::string& root) {
+    std::cout << "[Test] A seeder goes silent mid-piece: another one finishes it...\n";
+    LocalSeeder::Config silent, fine;
+    silent.reqq = 4;
+    silent.stall_after = 6;
+    fine.delay_ms = DELAY_MS;
+    LocalSeeder a(tf, payload, silent), b(tf, payload, fine);
+
+    std::filesystem::remove_all(root + "/dl");
+    std::filesystem::create_directories(root + "/dl");
+    std::string cwd = std::filesystem::current_path();
+    assert(chdir((root + "/dl").c_str()) == 0);
+    std::atomic<bool> finished{false};
+    std::thread watchdog([&]() {
+        for (int i = 0; i < 200 && !finished; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (finished) return;
+        std::cerr << "[FAIL] Stalled: the piece never left the silent seeder\n";
+        std::_Exit(1);
+    });
+    long long took;
+    {
+        Downloader d(tf, "-CPP100-000000000000", {Peer("127.0.0.1", a.Port()), Peer("127.0.0.1", b.Port())});
+        d.snub_ms = 300;
+        auto start = Clock::now();
+        d.Start();
+        took = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+        assert(d.IsComplete());
+    } // Writer flushes here
+    finished = true;
+    watchdog.join();
+    assert(chdir(cwd.c_str()) == 0);
+    a.Join();
+    b.Join();
+
+    std::ifstream in(root + "/dl/payload.bin", std::ios::binary);
+    Buffer got((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    assert(got == payload);
+    assert(a.Seen().requests > (size_t)silent.stall_after); // A really was left holding requests
+    std::cout << "[PASS] " << took << " ms, " << a.Seen().requests << " requests sent to the silent seeder.\n";
+}
+
+// A peer without the first pieces: they are passed over, not lost
+static void TestMissingPieces(const TorrentFile& tf) {
+    std::cout << "[Test] Pieces the peer lacks go back in the queue...\n";
+    uint16_t port;
+    int listener = Loopback::Listen(AF_INET, SOCK_STREAM, port);
+    Downloader d(tf, "-CPP100-000000000000", {});
+    Farm farm;
+    Connection conn(Peer("127.0.0.1", port), d);
+    conn.Connect(farm, 1000);
+    farm.Run([&]() { return conn.state == Connection::HANDSHAKING || (!conn.Dialing() && conn.GetSocketFd() < 0); });
+    assert(conn.GetSocketFd() >= 0);
+
+    conn.state = Connection::DOWNLOADING;
+    conn.choked = false;
+    conn.peer_pieces.assign(tf.PieceCount(), true);
+    conn.peer_pieces[0] = conn.peer_pieces[1] = false;
+    conn.Kick();
+    assert(!conn.outstanding.empty() && conn.outstanding.front().piece == 2);
+    assert((d.retry_pieces == std::deque<int>{0, 1}));
+    // Still nothing it has among them: handed back again, in the same order
+    conn.outstanding.clear();
+    conn.current_piece = -1;
+    conn.Kick();
+    assert(conn.outstanding.front().piece == 3 && (d.retry_pieces == std::deque<int>{0, 1}));
+    close(listener);
+    std::cout << "[PASS]\n";
+}
+
+int main() {
+    TestQueueDepth();
+
+    const std::string root = std::filesystem::absolute("test_pipeline_out");
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root + "/src");
+
+    Buffer payload(PIECE * PIECES);
+    uint32_t seed = 5;
+    for (auto& c : payload) { seed = seed * 1103515245 + 12345; c = (uint8_t)(seed >> 16); }
+    {
+        std::ofstream out(root + "/src/payload.bin", std::ios::binary);
+        out.write((const char*)payload.data(), payload.size());
+    }
+    // No tracker answers: the seeder is handed over directly
+    uint16_t dead_tracker;
+    close(Loopback::Listen(AF_INET, SOCK_STREAM, dead_tracker));
+    CreateOptions opts;
+    opts.announce = "http://127.0.0.1:" + std::to_string(dead_tracker) + "/announce";
+    opts.piece_length = PIECE;
+    Buffer meta = TorrentCreator::Create(root + "/src/payload.bin", opts);
+    TorrentFile tf = TorrentFile::Parse(meta.data(), meta.size());
+    TestMissingPieces(tf);
+
+    {
+        std::cout << "[Test] " << BLOCKS << " blocks, " << DELAY_MS << " ms RTT, peer says reqq=32...\n";
+        LocalSeeder::Config o;
+        o.reqq = 32;
+        LocalSeeder::Stats stats;
+        long long took = Download(tf, payload, root, o, stats);
+        assert(stats.got_extended);
+        assert(stats.peak_outstanding <= 32 && stats.peak_outstanding >= 16);
+        assert(took < (long long)(BLOCKS * DELAY_MS) / 4);
+        std::cout << "[PASS] " << took << " ms, peak " << stats.peak_outstanding << " requests outstanding.\n";
+    }
+    {
+        std::cout << "[Test] Same without BEP 10: the queue grows with the measured rate...\n";
+        LocalSeeder::Config o;
+        LocalSeeder::Stats stats;
+        long long took = Download(tf, payload, root, o, stats);
+        assert(stats.peak_outstanding >= 4 * Connection::INITIAL_QUEUE_DEPTH);
+        assert(stats.peak_outstanding <= Connection::MAX_QUEUE_DEPTH);
+        assert(took < (long long)(BLOCKS * DELAY_MS) / 4);
+        std::cout << "[PASS] " << took << " ms, peak " << stats.peak_outstanding << " requests outstanding.\n";
+    }
+    {
+        std::cout << "[Test] Choked mid-way: the dropped requests are asked for again...\n";
+        LocalSeeder::Config o;
+        o.reqq = 64;
+        o.choke_after = 60;
+        LocalSeeder::Stats stats;
+        long long took = Download(tf, payload, root, o, stats);
+        assert(stats.choked);
+        assert(stats.requests > BLOCKS); // Some went out twice
+        std::cout << "[PASS] " << took << " ms, " << stats.requests << " requests for " << BLOCKS << " blocks.\n";
+    }
+
+    TestStall(tf, payload, root);
+
+    std::filesystem::remove_all(root);
+    std::cout << "All pipeline tests passed.\n";
+    return 0;
+}
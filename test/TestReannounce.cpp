@@ -0,0 +1,124 @@
+#include "parsing/TorrentCreator.h"
+#include "parsing/Bnode.h"
+#include "download/Downloader.h"
+#include "LocalSeeder.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <cassert>
+#include <unistd.h>
+#include <sys/socket.h>
+
+using namespace BitTorrent;
+
+// Usage: ./test_reannounce
+// A download whose only peer leaves halfway. The tracker (interval 1 s) hands out a second
+// seeder on a later announce, which must be picked up and finish the job; the tracker must
+// see started, regular announces, completed with nothing left, and finally stopped.
+
+static const int64_t PIECE = 32 * 1024;
+static const int PIECES = 8;
+
+struct Seen {
+    std::string event; // "none" when the parameter is absent
+    int64_t left;
+};
+
+static std::string QueryValue(const std::string& request, const std::string& key) {
+    size_t at = request.find("&" + key + "=");
+    if (at == std::string::npos) return "";
+    at += key.size() + 2;
+    return request.substr(at, request.find_first_of("& ", at) - at);
+}
+
+// HTTP tracker: the first announce lists seeder A, every later one seeder B. Ends on 'stopped'.
+// Scrapes get an empty 'files' dict: the swarm is unknown.
+static void Tracker(int listener, uint16_t port_a, uint16_t port_b, std::vector<Seen>& seen) {
+    while (seen.empty() || seen.back().event != "stopped") {
+        int fd = accept(listener, nullptr, nullptr);
+        std::string req;
+        char buf[4096];
+        while (req.find("\r\n\r\n") == std::string::npos) {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) break;
+            req.append(buf, n);
+        }
+        if (req.rfind("GET /scrape", 0) == 0) {
+            std::string reply = "HTTP/1.1 200 OK\r\nContent-Length: 11\r\n\r\nd5:filesdee";
+            send(fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+            close(fd);
+            continue;
+        }
+        std::string event = QueryValue(req, "event");
+        seen.push_back({event.empty() ? "none" : event, std::stoll(QueryValue(req, "left"))});
+
+        uint16_t port = seen.size() == 1 ? port_a : port_b;
+        uint8_t peer[6] = {127, 0, 0, 1, (uint8_t)(port >> 8), (uint8_t)port};
+        BDict reply;
+        reply["interval"] = Bnode((BInt)1);
+        reply["min interval"] = Bnode((BInt)1);
+        reply["peers"] = Bnode(Buffer(peer, peer + 6));
+        Buffer body = Bnode::Encode(Bnode(std::move(reply)));
+        std::string head = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+        send(fd, head.data(), head.size(), MSG_NOSIGNAL);
+        send(fd, body.data(), body.size(), MSG_NOSIGNAL);
+        close(fd);
+    }
+}
+
+int main() {
+    std::cout << "[Test] Re-announce replaces a peer that left...\n";
+    const std::string root = std::filesystem::absolute("test_reannounce_out");
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root + "/src");
+    std::filesystem::create_directories(root + "/dl");
+
+    Buffer payload(PIECE * PIECES);
+    uint32_t seed = 7;
+    for (auto& c : payload) { seed = seed * 1103515245 + 12345; c = (uint8_t)(seed >> 16); }
+    {
+        std::ofstream out(root + "/src/payload.bin", std::ios::binary);
+        out.write((const char*)payload.data(), payload.size());
+    }
+
+    uint16_t tracker_port;
+    int tracker_fd = Loopback::Listen(AF_INET, SOCK_STREAM, tracker_port);
+    CreateOptions opts;
+    opts.announce = "http://127.0.0.1:" + std::to_string(tracker_port) + "/announce";
+    opts.piece_length = PIECE;
+    Buffer meta = TorrentCreator::Create(root + "/src/payload.bin", opts);
+    TorrentFile tf = TorrentFile::Parse(meta.data(), meta.size());
+
+    LocalSeeder::Config leaves;
+    leaves.max_blocks = 5; // In piece 2
+    LocalSeeder a(tf, payload, leaves), b(tf, payload);
+    std::vector<Seen> seen;
+    std::thread tracker(Tracker, tracker_fd, a.Port(), b.Port(), std::ref(seen));
+
+    std::string cwd = std::filesystem::current_path();
+    assert(chdir((root + "/dl").c_str()) == 0);
+    {
+        Downloader d(tf, "-CPP100-000000000000", {});
+        d.Start();
+        assert(d.IsComplete());
+    } // Writer flushes here
+    assert(chdir(cwd.c_str()) == 0);
+    tracker.join();
+    close(tracker_fd);
+
+    std::ifstream in(root + "/dl/payload.bin", std::ios::binary);
+    Buffer got((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    assert(got == payload);
+
+    // started, at least one regular announce (which brought seeder B), completed, stopped
+    assert(seen.size() >= 4);
+    assert(seen.front().event == "started" && seen.front().left == tf.length);
+    assert(seen[1].event == "none");
+    assert(seen[seen.size() - 2].event == "completed" && seen[seen.size() - 2].left == 0);
+    assert(seen.back().event == "stopped" && seen.back().left == 0);
+    std::filesystem::remove_all(root);
+    std::cout << "[PASS] " << seen.size() << " announces, file intact.\n";
+    std::cout << "All re-announce tests passed.\n";
+    return 0;
+}
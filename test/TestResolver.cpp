@@ -0,0 +1,159 @@
+#include "tracker/Resolver.h"
+#include "tracker/Announce.h"
+#include "download/Farm.h"
+#include "parsing/Bnode.h"
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <cassert>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace BitTorrent;
+
+// Usage: ./test_resolver
+// Host lookups off the loop thread, with getaddrinfo swapped for a slow fake resolver:
+// the loop keeps running while it works, concurrent lookups share one call, answers (and
+// failures) are cached, and announces to a tracker by name only resolve it once.
+
+static std::atomic<int> calls{0};
+
+// 200 ms per lookup; "*.test" names are loopback, anything else doesn't exist
+static ResolveResult SlowLookup(const std::string& host) {
+    calls++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    ResolveResult r;
+    if (host.size() < 5 || host.compare(host.size() - 5, 5, ".test") != 0) {
+        r.error = "Could not resolve host: " + host;
+        return r;
+    }
+    sockaddr_storage a{};
+    auto* v4 = (sockaddr_in*)&a;
+    v4->sin_family = AF_INET;
+    v4->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    r.ok = true;
+    r.addresses = {a};
+    return r;
+}
+
+static std::string Ip(const ResolveResult& r) {
+    char s[INET_ADDRSTRLEN] = "";
+    if (r.ok) inet_ntop(AF_INET, &((const sockaddr_in*)&r.addresses[0])->sin_addr, s, sizeof(s));
+    return s;
+}
+
+static void TestLookups() {
+    std::cout << "[Test] Asynchronous, coalesced, cached lookups...\n";
+    Farm farm;
+    Resolver& resolver = farm.GetResolver();
+    std::vector<std::string> order;
+    int answers = 0;
+
+    auto start = Farm::Clock::now();
+    for (int i = 0; i < 3; ++i) {
+        resolver.Resolve("tracker.test", [&](const ResolveResult& r) {
+            assert(Ip(r) == "127.0.0.1");
+            order.push_back("dns");
+            answers++;
+        });
+    }
+    assert(Farm::Clock::now() - start < std::chrono::milliseconds(50)); // Didn't wait for it
+    farm.After(std::chrono::milliseconds(20), [&]() { order.push_back("timer"); });
+    farm.Run([&]() { return answers == 3; });
+    assert(calls == 1 && order.size() == 4 && order[0] == "timer"); // The loop ran meanwhile
+
+    // Cached: answered on the spot
+    bool hit = false;
+    resolver.Resolve("tracker.test", [&](const ResolveResult& r) { hit = r.ok; });
+    assert(hit && calls == 1);
+
+    // Failures are cached too
+    ResolveResult missing;
+    resolver.Resolve("missing.example", [&](const ResolveResult& r) { missing = r; answers++; });
+    farm.Run([&]() { return answers == 4; });
+    assert(!missing.ok && calls == 2);
+    assert(!Resolver::ResolveNow("missing.example").ok && calls == 2);
+
+    // Literal addresses never reach the resolver
+    assert(Ip(Resolver::ResolveNow("10.1.2.3")) == "10.1.2.3" && calls == 2);
+
+    // A cancelled lookup neither calls back nor keeps the loop alive
+    bool called = false;
+    Resolver::RequestId id = resolver.Resolve("other.test", [&](const ResolveResult&) { called = true; });
+    resolver.Cancel(id);
+    farm.Run();
+    assert(!called);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300)); // Let it land in the cache
+    assert(calls == 3 && Resolver::ResolveNow("other.test").ok && calls == 3);
+    std::cout << "[PASS] " << calls << " lookups behind 9 requests\n";
+}
+
+// Serves 'requests' HTTP announces, one per connection
+static void Tracker(int listener, int requests) {
+    for (int i = 0; i < requests; ++i) {
+        int fd = accept(listener, nullptr, nullptr);
+        char buf[4096];
+        std::string req;
+        while (req.find("\r\n\r\n") == std::string::npos) {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) break;
+            req.append(buf, n);
+        }
+        BDict reply;
+        reply["interval"] = Bnode((BInt)1800);
+        uint8_t peer[6] = {10, 0, 0, 1, 0x1A, 0xE1};
+        reply["peers"] = Bnode(Buffer(peer, peer + 6));
+        Buffer body = Bnode::Encode(Bnode(std::move(reply)));
+        std::string head = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+        send(fd, head.data(), head.size(), MSG_NOSIGNAL);
+        send(fd, body.data(), body.size(), MSG_NOSIGNAL);
+        close(fd);
+    }
+}
+
+static void TestAnnounceByName() {
+    std::cout << "[Test] Announces resolve the tracker once...\n";
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    assert(bind(listener, (sockaddr*)&addr, sizeof(addr)) == 0 && listen(listener, 4) == 0);
+    getsockname(listener, (sockaddr*)&addr, &len);
+    std::thread tracker(Tracker, listener, 3);
+
+    Farm farm;
+    std::string url = "http://announce.test:" + std::to_string(ntohs(addr.sin_port)) + "/announce";
+    AnnounceParams p;
+    p.info_hash = Buffer(20, 7);
+    p.peer_id = "-CPP100-000000000000";
+    int before = calls;
+    for (int round = 0; round < 3; ++round) {
+        AnnounceResult result;
+        auto a = Announce::Create(farm, url, p, [&](AnnounceResult& r) { result = std::move(r); });
+        farm.Run([&]() { return a->Done(); });
+        assert(result.ok && result.peers.size() == 1);
+    }
+    tracker.join();
+    close(listener);
+    assert(calls == before + 1);
+
+    // An unknown name fails the announce cleanly, through the callback
+    AnnounceResult failed;
+    auto a = Announce::Create(farm, "udp://nowhere.example:80", p, [&](AnnounceResult& r) { failed = std::move(r); });
+    farm.Run([&]() { return a->Done(); });
+    assert(!failed.ok && failed.error.find("nowhere.example") != std::string::npos);
+    std::cout << "[PASS] 3 announces, 1 lookup\n";
+}
+
+int main() {
+    Resolver::SetLookup(SlowLookup);
+    TestLookups();
+    TestAnnounceByName();
+    Resolver::SetLookup(nullptr);
+    std::cout << "All resolver tests passed.\n";
+    return 0;
+}
@@ -0,0 +1,320 @@
+#include "tracker/Announce.h"
+#include "tracker/Announcer.h"
+#include "tracker/Scraper.h"
+#include "parsing/Bnode.h"
+#include "parsing/TorrentCreator.h"
+#include "download/Downloader.h"
+#include "LocalSeeder.h"
+#include "LocalTracker.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <cstring>
+#include <cassert>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace BitTorrent;
+
+// Usage: ./test_scrape
+// HTTP /scrape and UDP action 2 against loopback trackers, many hashes per request, then the
+// Scraper sharing one tracker between 100 torrents and ranking trackers by the answers, and
+// swarm sizes picked up from ordinary announce replies. Last, a download whose scrape, answered
+// while the first announce is out, sends its later announces to the tracker with a live swarm.
+//
+// Torrent n (1..100) has the 20-byte hash n, n, n ... Over HTTP its swarm has n % 10 seeders and
+// n % 3 leechers; over UDP twice the seeders. So 30, 60 and 90 are empty everywhere.
+
+static Buffer Hash(int n) { return Buffer(20, (uint8_t)n); }
+
+static std::vector<Buffer> InfoHashes(const std::string& line) {
+    std::vector<Buffer> hashes;
+    for (size_t at = line.find("info_hash="); at != std::string::npos; at = line.find("info_hash=", at + 1)) {
+        Buffer h;
+        for (size_t i = at + 10; i < line.size() && line[i] != '&' && line[i] != ' '; i++) {
+            if (line[i] == '%') {
+                h.push_back((uint8_t)std::stoi(line.substr(i + 1, 2), nullptr, 16));
+                i += 2;
+            } else {
+                h.push_back((uint8_t)line[i]);
+            }
+        }
+        hashes.push_back(h);
+    }
+    return hashes;
+}
+
+// Answers 'requests' scrapes (or announces, with a swarm of 12 seeders and 30 leechers), one per connection
+static void HttpTracker(int listener, int requests, std::vector<size_t>& sizes) {
+    for (int r = 0; r < requests; ++r) {
+        int fd = accept(listener, nullptr, nullptr);
+        std::string req;
+        char buf[8192];
+        while (req.find("\r\n\r\n") == std::string::npos) {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) break;
+            req.append(buf, n);
+        }
+        std::string line = req.substr(0, req.find("\r\n"));
+        BDict reply;
+        if (line.rfind("GET /scrape?", 0) == 0) {
+            auto hashes = InfoHashes(line);
+            sizes.push_back(hashes.size());
+            BDict files;
+            for (const auto& h : hashes) {
+                BDict stats;
+                stats["complete"] = Bnode((BInt)(h[0] % 10));
+                stats["incomplete"] = Bnode((BInt)(h[0] % 3));
+                stats["downloaded"] = Bnode((BInt)100);
+                files[std::string(h.begin(), h.end())] = Bnode(std::move(stats));
+            }
+            reply["files"] = Bnode(std::move(files));
+        } else {
+            assert(line.rfind("GET /announce?", 0) == 0);
+            reply["interval"] = Bnode((BInt)1800);
+            reply["complete"] = Bnode((BInt)12);
+            reply["incomplete"] = Bnode((BInt)30);
+            reply["peers"] = Bnode(Buffer());
+        }
+        Buffer body = Bnode::Encode(Bnode(std::move(reply)));
+        std::string head = "HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+        send(fd, head.data(), head.size(), MSG_NOSIGNAL);
+        send(fd, body.data(), body.size(), MSG_NOSIGNAL);
+        close(fd);
+    }
+}
+
+// Answers connects and 'requests' scrapes / announces (3 seeders, 7 leechers, no peers)
+static void UdpTracker(int fd, int requests, std::vector<size_t>& sizes) {
+    uint8_t buf[4096];
+    while (requests > 0) {
+        sockaddr_in from{};
+        socklen_t len = sizeof(from);
+        ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, (sockaddr*)&from, &len);
+        Buffer reply = {0, 0, 0, buf[11]};
+        reply.insert(reply.end(), buf + 12, buf + 16);
+        if (n == 16) {
+            reply[3] = 0;
+            reply.insert(reply.end(), 8, 0xAB);
+        } else if (buf[11] == 2) {
+            assert((n - 16) % 20 == 0);
+            sizes.push_back((n - 16) / 20);
+            for (ssize_t off = 16; off < n; off += 20) {
+                uint8_t h = buf[off];
+                uint8_t entry[12] = {0, 0, 0, (uint8_t)(h % 10 * 2), 0, 0, 0, 200, 0, 0, 0, (uint8_t)(h % 3)};
+                reply.insert(reply.end(), entry, entry + 12);
+            }
+            requests--;
+        } else {
+            assert(n == 98 && buf[11] == 1);
+            uint8_t tail[12] = {0, 0, 0x07, 0x08, 0, 0, 0, 7, 0, 0, 0, 3}; // Interval, leechers, seeders
+            reply.insert(reply.end(), tail, tail + 12);
+            requests--;
+        }
+        sendto(fd, reply.data(), reply.size(), 0, (sockaddr*)&from, len);
+    }
+}
+
+static void TestScrapeUrl() {
+    std::cout << "[Test] Scrape URLs...\n";
+    assert(Announce::ScrapeUrl("http://t.example/announce") == "http://t.example/scrape");
+    assert(Announce::ScrapeUrl("http://t.example/x/announce.php?pk=1") == "http://t.example/x/scrape.php?pk=1");
+    assert(Announce::ScrapeUrl("http://t.example/a") == "");
+    assert(Announce::ScrapeUrl("http://t.example/announce/x") == "");
+    std::cout << "[PASS]\n";
+}
+
+static void TestSingle(Farm& farm, const std::string& http, const std::string& udp) {
+    std::cout << "[Test] One scrape per protocol...\n";
+    AnnounceResult h, u;
+    std::vector<Buffer> hashes = {Hash(5), Hash(30), Hash(7)};
+    auto a = Announce::Scrape(farm, http, hashes, 5000, [&](AnnounceResult& r) { h = std::move(r); });
+    auto b = Announce::Scrape(farm, udp, hashes, 5000, [&](AnnounceResult& r) { u = std::move(r); });
+    farm.Run([&]() { return a->Done() && b->Done(); });
+
+    assert(h.ok && h.swarms.size() == 3 && u.ok && u.swarms.size() == 3);
+    assert(h.swarms[0].seeders == 5 && h.swarms[0].leechers == 2 && h.swarms[0].downloaded == 100);
+    assert(h.swarms[1].Known() && h.swarms[1].Peers() == 0);
+    assert(u.swarms[2].seeders == 14 && u.swarms[2].leechers == 1 && u.swarms[2].downloaded == 200);
+
+    std::vector<Buffer> too_many(Announce::MAX_UDP_SCRAPE + 1, Hash(1));
+    AnnounceResult over;
+    auto c = Announce::Scrape(farm, udp, too_many, 5000, [&](AnnounceResult& r) { over = std::move(r); });
+    assert(c->Done() && !over.ok);
+    std::cout << "[PASS] " << over.error << "\n";
+}
+
+static void TestScraper(Farm& farm, const std::string& http, const std::string& udp) {
+    std::cout << "[Test] Scraper over 100 torrents...\n";
+    Scraper scraper(farm, 5000);
+    for (int n = 1; n <= 100; n++) scraper.Add(Hash(n), {http, udp, "http://127.0.0.1:1/no-scrape-here"});
+    scraper.Start();
+    assert(scraper.Requests() == 4); // 50 + 50 over HTTP, 74 + 26 over UDP
+    farm.Run([&]() { return scraper.Done(); });
+
+    assert(scraper.Get(http, Hash(5)).seeders == 5 && scraper.Get(udp, Hash(5)).seeders == 10);
+    assert(scraper.Best(Hash(5)).seeders == 10);
+    assert(!scraper.Best(Hash(101)).Known());
+    assert((scraper.RankTrackers(Hash(5), {http, udp}) == std::vector<std::string>{udp, http}));
+    // Unknown ones go before the ones known to be empty
+    std::string unknown = "http://127.0.0.1:1/announce";
+    assert((scraper.RankTrackers(Hash(30), {http, unknown, udp}) == std::vector<std::string>{unknown, http, udp}));
+    std::cout << "[PASS]\n";
+}
+
+static void TestNumWant() {
+    std::cout << "[Test] num_want from swarm size...\n";
+    SwarmStats unknown, small, big;
+    small.seeders = 3;
+    small.leechers = 2;
+    big.seeders = big.leechers = 500;
+    assert(Scraper::NumWant(unknown, true) == AnnounceParams().num_want); // The default, for the dial race
+    assert(Scraper::NumWant(unknown, false) == 0);
+    assert(Scraper::NumWant(small, true) == Scraper::MIN_NUM_WANT);
+    assert(Scraper::NumWant(big, true) == Scraper::MAX_NUM_WANT);
+    assert(Scraper::NumWant(big, false) == 0);
+    std::cout << "[PASS]\n";
+}
+
+static void TestAnnounceSwarm(Farm& farm, const std::string& http, const std::string& udp) {
+    std::cout << "[Test] Swarm size from announce replies...\n";
+    AnnounceParams p;
+    p.info_hash = Hash(1);
+    p.peer_id = "-CPP100-000000000000";
+    p.timeout_ms = 5000;
+    AnnounceResult h, u;
+    auto a = Announce::Create(farm, http, p, [&](AnnounceResult& r) { h = std::move(r); });
+    auto b = Announce::Create(farm, udp, p, [&](AnnounceResult& r) { u = std::move(r); });
+    farm.Run([&]() { return a->Done() && b->Done(); });
+    assert(h.ok && h.swarm.seeders == 12 && h.swarm.leechers == 30 && h.swarms.empty());
+    assert(u.ok && u.swarm.seeders == 3 && u.swarm.leechers == 7);
+
+    Announcer announcer(farm, {{udp}}, p, [](const std::vector<Peer>&) {});
+    SwarmStats scraped;
+    scraped.seeders = 1;
+    announcer.SetSwarm(http, scraped);
+    announcer.Start();
+    farm.Run([&]() { return announcer.Done(); });
+    SwarmStats best = announcer.BestSwarm();
+    assert(best.seeders == 3 && best.leechers == 7);
+    std::cout << "[PASS]\n";
+}
+
+// An Announcer ranked by a Scraper: of a tier listing an empty swarm first, the live one is asked
+static void TestRankedRounds(Farm& farm) {
+    std::cout << "[Test] Rounds ranked by scrape results...\n";
+    LocalTracker::Config nobody;
+    nobody.seeders = nobody.leechers = 0;
+    LocalTracker empty(nobody), live;
+    std::vector<std::string> tier = {empty.HttpUrl(), live.HttpUrl()};
+    Scraper scraper(farm, 5000);
+    scraper.Add(Hash(1), tier);
+    scraper.Start();
+    farm.Run([&]() { return scraper.Done(); });
+
+    AnnounceParams p;
+    p.info_hash = Hash(1);
+    p.peer_id = "-CPP100-000000000000";
+    Announcer announcer(farm, {tier}, p, [](const std::vector<Peer>&) {});
+    announcer.SetRanking([&](std::vector<std::string> urls) { return scraper.RankTrackers(p.info_hash, std::move(urls)); });
+    announcer.Start();
+    farm.Run([&]() { return announcer.Done(); });
+    assert(empty.Stats().http_announces == 0 && live.Stats().http_announces == 1);
+    std::cout << "[PASS]\n";
+}
+
+// One tier lists a tracker with an empty swarm (and no peers) ahead of one that has the seeder.
+// The first announce goes out at once, to the empty one, while the scrapes are still running;
+// the next round, a second later, must go to the live one first.
+static void TestDownloadRanksByScrape() {
+    std::cout << "[Test] A download's scrape sends later rounds to the live swarm...\n";
+    const std::string root = std::filesystem::absolute("test_scrape_out");
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root + "/dl");
+    Buffer payload(4 * 32768);
+    uint32_t seed = 9;
+    for (auto& c : payload) { seed = seed * 1103515245 + 12345; c = (uint8_t)(seed >> 16); }
+    {
+        std::ofstream out(root + "/payload.bin", std::ios::binary);
+        out.write((const char*)payload.data(), payload.size());
+    }
+
+    LocalTracker::Config nobody;
+    nobody.seeders = nobody.leechers = 0;
+    nobody.interval = nobody.min_interval = 1;
+    LocalTracker empty(nobody), live;
+    CreateOptions opts;
+    opts.announce = empty.HttpUrl();
+    opts.piece_length = 32768;
+    Bnode meta = Bnode::Decode(TorrentCreator::Create(root + "/payload.bin", opts));
+    BList tier;
+    tier.push_back(Bnode(BufferUtils::FromString(empty.HttpUrl())));
+    tier.push_back(Bnode(BufferUtils::FromString(live.HttpUrl())));
+    BList tiers;
+    tiers.push_back(Bnode(std::move(tier)));
+    std::get<BDict>(meta.value)["announce-list"] = Bnode(std::move(tiers));
+    Buffer encoded = Bnode::Encode(meta);
+    TorrentFile tf = TorrentFile::Parse(encoded.data(), encoded.size());
+
+    LocalSeeder seeder(tf, payload);
+    LocalTracker::Config swarm;
+    swarm.peers = {Peer("127.0.0.1", seeder.Port())};
+    swarm.seeders = 1;
+    swarm.leechers = 0;
+    live.Configure(swarm);
+
+    // A peer left over from earlier that is gone now, so the empty first reply doesn't end the download
+    uint16_t gone;
+    close(Loopback::Listen(AF_INET, SOCK_STREAM, gone));
+
+    std::string cwd = std::filesystem::current_path();
+    assert(chdir((root + "/dl").c_str()) == 0);
+    {
+        Downloader d(tf, "-CPP100-000000000000", {Peer("127.0.0.1", gone)});
+        d.Start();
+        assert(d.IsComplete());
+    }
+    assert(chdir(cwd.c_str()) == 0);
+    std::ifstream in(root + "/dl/payload.bin", std::ios::binary);
+    Buffer got((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    assert(got == payload);
+    std::filesystem::remove_all(root);
+
+    LocalTracker::Counters e = empty.Stats(), l = live.Stats();
+    assert(e.http_scrapes == 1 && e.http_announces == 1); // Only 'started': nothing waited for the scrape
+    assert(l.http_scrapes == 1 && l.http_announces >= 2); // A later round ... 'stopped'
+    std::cout << "[PASS] " << l.http_announces << " announces to the live tracker, one to the empty one\n";
+}
+
+int main() {
+    uint16_t http_port, udp_port;
+    int http_fd = Loopback::Listen(AF_INET, SOCK_STREAM, http_port);
+    int udp_fd = Loopback::Listen(AF_INET, SOCK_DGRAM, udp_port);
+    std::vector<size_t> http_sizes, udp_sizes;
+    std::thread http_tracker(HttpTracker, http_fd, 4, std::ref(http_sizes));
+    std::thread udp_tracker(UdpTracker, udp_fd, 5, std::ref(udp_sizes));
+    std::string http = "http://127.0.0.1:" + std::to_string(http_port) + "/announce";
+    std::string udp = "udp://127.0.0.1:" + std::to_string(udp_port);
+
+    Farm farm;
+    TestScrapeUrl();
+    TestSingle(farm, http, udp);
+    TestScraper(farm, http, udp);
+    TestNumWant();
+    TestAnnounceSwarm(farm, http, udp);
+    TestRankedRounds(farm);
+
+    http_tracker.join();
+    udp_tracker.join();
+    assert((http_sizes == std::vector<size_t>{3, 50, 50}));
+    assert(udp_sizes.size() == 3 && udp_sizes[0] == 3 && udp_sizes[1] + udp_sizes[2] == 100);
+    assert(std::max(udp_sizes[1], udp_sizes[2]) == Announce::MAX_UDP_SCRAPE);
+    close(http_fd);
+    close(udp_fd);
+    TestDownloadRanksByScrape();
+    std::cout << "All scrape tests passed.\n";
+    return 0;
+}
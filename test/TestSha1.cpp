@@ -0,0 +1,90 @@
+#include "parsing/Sha1.h"
+#include <openssl/sha.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstring>
+#include <cassert>
+
+using namespace BitTorrent;
+
+// Usage: ./test_sha1
+// Every backend this CPU supports must agree with the FIPS 180 vectors and with
+// libcrypto on random data, whatever way the input is split across Update() calls.
+
+static std::string Hex(const uint8_t* d) {
+    static const char* digits = "0123456789abcdef";
+    std::string s;
+    for (size_t i = 0; i < Sha1::DIGEST_SIZE; ++i) { s += digits[d[i] >> 4]; s += digits[d[i] & 15]; }
+    return s;
+}
+
+int main() {
+    const Sha1::Backend backends[] = {Sha1::SCALAR, Sha1::SSSE3, Sha1::SHANI, Sha1::OPENSSL};
+    const std::pair<std::string, const char*> vectors[] = {
+        {"", "da39a3ee5e6b4b0d3255bfef95601890afd80709"},
+        {"abc", "a9993e364706816aba3e25717850c26c9cd0d89d"},
+        {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "84983e441c3bd26ebaae4aa1f95129e5e54670f1"},
+        {std::string(1000000, 'a'), "34aa973cd4c4daa4f61eeb2bdbad27316534016f"},
+    };
+
+    std::mt19937 rng(1234);
+    std::vector<uint8_t> random(300000);
+    for (auto& b : random) b = (uint8_t)rng();
+
+    std::cout << "[Test] SHA-1 backends (best here: " << Sha1::Name(Sha1::Best()) << ")\n";
+    for (Sha1::Backend b : backends) {
+        if (!Sha1::Supported(b)) {
+            std::cout << "[SKIP] " << Sha1::Name(b) << " not supported on this CPU\n";
+            continue;
+        }
+        uint8_t out[Sha1::DIGEST_SIZE];
+        for (const auto& v : vectors) {
+            Sha1::Digest((const uint8_t*)v.first.data(), v.first.size(), out, b);
+            assert(Hex(out) == v.second);
+        }
+
+        // Lengths around the 55/56/64-byte padding edges, fed in random-sized chunks
+        Sha1 ctx(b);
+        for (size_t len : {1, 55, 56, 63, 64, 65, 119, 120, 128, 4095, 16384, 300000}) {
+            uint8_t expected[Sha1::DIGEST_SIZE];
+            SHA1(random.data(), len, expected);
+
+            size_t pos = 0;
+            while (pos < len) {
+                size_t n = std::min<size_t>(len - pos, rng() % 200);
+                ctx.Update(random.data() + pos, n);
+                pos += n;
+            }
+            ctx.Final(out); // Also resets, so the context is reused for the next length
+            assert(std::memcmp(out, expected, sizeof(out)) == 0);
+        }
+        std::cout << "[PASS] " << Sha1::Name(b) << "\n";
+    }
+
+    // Multi-buffer: eight different messages per call, lengths around the padding edges
+    std::cout << "[Test] " << Sha1::LANES << "-lane multi-buffer ("
+              << (Sha1::LanesSupported() ? "avx2" : "fallback") << ")\n";
+    for (size_t len : {0, 1, 55, 56, 64, 119, 120, 1000, 16384, 30001}) {
+        const uint8_t* data[13];
+        for (size_t i = 0; i < 13; ++i) data[i] = random.data() + 977 * i;
+        uint8_t out[13][Sha1::DIGEST_SIZE];
+
+        Sha1::DigestLanes(data, len, out);
+        Sha1::DigestMany(data, len, 13, out); // Must agree whether or not lanes are used
+        for (size_t i = 0; i < 13; ++i) {
+            uint8_t expected[Sha1::DIGEST_SIZE];
+            SHA1(data[i], len, expected);
+            assert(std::memcmp(out[i], expected, sizeof(expected)) == 0);
+        }
+        Sha1::DigestLanes(data, len, out);
+        for (size_t i = 0; i < Sha1::LANES; ++i) {
+            uint8_t expected[Sha1::DIGEST_SIZE];
+            SHA1(data[i], len, expected);
+            assert(std::memcmp(out[i], expected, sizeof(expected)) == 0);
+        }
+    }
+    std::cout << "[PASS] multi-buffer\n";
+    return 0;
+}
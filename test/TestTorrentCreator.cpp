@@ -0,0 +1,76 @@
+#include "parsing/TorrentCreator.h"
+#include "download/Recheck.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cassert>
+
+using namespace BitTorrent;
+
+// Usage: ./test_torrent_creator
+// Creates torrents from a generated directory and a single file, loads them back with the
+// regular parser and rechecks the source data against the produced piece table.
+
+static void WriteFile(const std::string& path, size_t size, uint8_t seed) {
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+    std::ofstream out(path, std::ios::binary);
+    for (size_t i = 0; i < size; ++i) out.put((char)(seed + i * 7 + (i >> 9)));
+}
+
+int main() {
+    const std::string root = "test_creator_out";
+    std::filesystem::remove_all(root);
+
+    std::cout << "[Test] Automatic piece length...\n";
+    assert(TorrentCreator::AutoPieceLength(0) == 16 * 1024);
+    assert(TorrentCreator::AutoPieceLength(4000LL * 1024 * 1024) == 2 * 1024 * 1024);
+    assert(TorrentCreator::AutoPieceLength(1LL << 50) == 16 * 1024 * 1024);
+    std::cout << "[PASS]\n";
+
+    std::cout << "[Test] Multi-file torrent round trip...\n";
+    WriteFile(root + "/data/b/second.bin", 70000, 1);
+    WriteFile(root + "/data/a.bin", 33333, 2);
+    WriteFile(root + "/data/empty", 0, 3);
+    WriteFile(root + "/data/b/c/third.bin", 1000001, 4);
+
+    CreateOptions opts;
+    opts.announce = "http://127.0.0.1:6969/announce";
+    opts.piece_length = 32 * 1024;
+    opts.threads = 3;
+    opts.is_private = true;
+    int64_t last_progress = 0;
+    opts.progress = [&](int64_t done, int64_t total) { assert(done > last_progress && done <= total); last_progress = done; };
+    Buffer meta = TorrentCreator::Create(root + "/data/", opts);
+
+    TorrentFile tf = TorrentFile::Parse(meta.data(), meta.size());
+    assert(tf.name == "data" && tf.announce == opts.announce);
+    assert(tf.length == 70000 + 33333 + 1000001 && last_progress == tf.length);
+    assert(tf.files.size() == 4);
+    assert(tf.files[0].path == "data/a.bin" && tf.files[3].path == "data/empty"); // Sorted by path
+    assert(tf.PieceCount() == (size_t)((tf.length + opts.piece_length - 1) / opts.piece_length));
+
+    auto have = Recheck::Run(tf, root);
+    assert(std::count(have.begin(), have.end(), true) == (long)have.size());
+
+    // Thread count must not change the result
+    opts.threads = 1;
+    opts.progress = nullptr;
+    Buffer single_meta = TorrentCreator::Create(root + "/data", opts);
+    TorrentFile single_thread = TorrentFile::Parse(single_meta.data(), single_meta.size());
+    assert(single_thread.piece_hashes == tf.piece_hashes);
+    std::cout << "[PASS] " << tf.PieceCount() << " pieces verified against the source files.\n";
+
+    std::cout << "[Test] Single-file torrent...\n";
+    WriteFile(root + "/single.iso", 5 * 1024 * 1024 + 17, 9);
+    std::string out_path = root + "/single.torrent";
+    TorrentCreator::CreateFile(root + "/single.iso", out_path, CreateOptions());
+    TorrentFile single = TorrentFile::Load(out_path);
+    assert(single.name == "single.iso" && single.files.size() == 1);
+    assert(single.piece_length == TorrentCreator::AutoPieceLength(single.length));
+    have = Recheck::Run(single, root);
+    assert(std::count(have.begin(), have.end(), true) == (long)have.size());
+    std::cout << "[PASS]\n";
+
+    std::filesystem::remove_all(root);
+    return 0;
+}
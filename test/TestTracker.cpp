@@ -1,9 +1,17 @@
 #include "tracker/Tracker.h"
+#include "tracker/Announce.h"
+#include "LocalTracker.h"
 #include <iostream>
 #include <random>
+#include <cassert>
 
 using namespace BitTorrent;
 
+// Usage: ./test_tracker [file.torrent]
+// With a torrent: asks its real trackers for peers and prints them.
+// Without: the same path against a LocalTracker on loopback (no network needed), then the
+// client against injected latency, packet loss and truncated replies.
+
 std::string GeneratePeerID() {
     std::string id = "-BT1000-"; // Client Prefix
     std::srand(time(0));
@@ -11,11 +19,66 @@ std::string GeneratePeerID() {
     return id;
 }
 
+static AnnounceResult AnnounceOnce(const std::string& url, int udp_retry_ms) {
+    Farm farm;
+    AnnounceParams p;
+    p.info_hash = Buffer(20, 7);
+    p.peer_id = GeneratePeerID();
+    p.timeout_ms = 5000;
+    p.udp_retry_ms = udp_retry_ms;
+    AnnounceResult result;
+    auto a = Announce::Create(farm, url, p, [&](AnnounceResult& r) { result = std::move(r); });
+    farm.Run([&]() { return a->Done(); });
+    return result;
+}
+
+static int Offline() {
+    std::cout << "[Test] Tiers against a local tracker...\n";
+    LocalTracker::Config config;
+    config.peers = LocalTracker::SyntheticPeers(30, 5);
+    LocalTracker tracker(config);
+
+    TorrentFile tf;
+    tf.info_hash = Buffer(20, 7);
+    tf.length = 1 << 20;
+    tf.announce_list = {{tracker.HttpUrl()}, {tracker.UdpUrl()}};
+    std::vector<Peer> peers = Tracker::GetPeers(tf, GeneratePeerID());
+    // HTTP hands out all 35 (IPv6 as peers6), UDP over IPv4 the same 30 IPv4 ones again
+    assert(peers.size() == 35);
+    auto stats = tracker.Stats();
+    assert(stats.http_announces == 1 && stats.udp_connects == 1 && stats.udp_announces == 1);
+    std::cout << "[PASS] " << peers.size() << " peers\n";
+
+    std::cout << "[Test] Latency, loss and truncation...\n";
+    config.latency_ms = 100;
+    tracker.Configure(config);
+    AnnounceResult slow = AnnounceOnce(tracker.HttpUrl(), 20);
+    assert(slow.ok && slow.latency_ms >= 100);
+
+    config.latency_ms = 0;
+    config.loss = 0.5;
+    tracker.Configure(config);
+    UdpAnnounce::ClearConnectionCache();
+    AnnounceResult lossy = AnnounceOnce(tracker.UdpUrl(), 20);
+    assert(lossy.ok && lossy.peers.size() == 30 && tracker.Stats().dropped > 0);
+
+    config.loss = 0;
+    config.truncate = 1;
+    tracker.Configure(config);
+    AnnounceResult cut_http = AnnounceOnce(tracker.HttpUrl(), 20);
+    assert(!cut_http.ok);
+    // Every datagram comes cut short: the connect reply is unusable, so the client retries until it gives up
+    UdpAnnounce::ClearConnectionCache();
+    AnnounceResult cut_udp = AnnounceOnce(tracker.UdpUrl(), 1);
+    assert(!cut_udp.ok);
+    std::cout << "[PASS] " << slow.latency_ms << " ms with 100 ms latency, " << tracker.Stats().dropped
+              << " datagrams dropped, truncated: " << cut_http.error << " / " << cut_udp.error << "\n";
+    std::cout << "All tracker tests passed.\n";
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cout << "Usage: ./test_tracker <file.torrent>" << std::endl;
-        return 1;
-    }
+    if (argc < 2) return Offline();
 
     try {
         // 1. Load File
@@ -31,7 +94,7 @@ int main(int argc, char* argv[]) {
         // 4. Print Results
         std::cout << "Found " << peers.size() << " peers:" << std::endl;
         for (const auto& p : peers) {
-            std::cout << " - " << p.ip << ":" << p.port << std::endl;
+            std::cout << " - " << p.ToString() << std::endl;
         }
 
     } catch (std::exception& e) {
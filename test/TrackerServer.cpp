@@ -0,0 +1,55 @@
+#include "LocalTracker.h"
+#include <iostream>
+#include <string>
+#include <csignal>
+#include <unistd.h>
+
+// Usage: ./tracker_server [-p port] [-n peers] [-6 v6_peers] [-l latency_ms] [-j jitter_ms]
+//                         [--loss share] [--truncate share] [--seed n] [--close]
+// A loopback tracker (HTTP announce/scrape and UDP on the same port) for running the client with
+// no network. Prints its URLs, then serves until interrupted, with counters on the way out.
+
+static volatile sig_atomic_t stop = 0;
+
+int main(int argc, char* argv[]) {
+    using namespace BitTorrent;
+    LocalTracker::Config config;
+    uint16_t port = 0;
+    int peers = 50, peers6 = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "-p" && has_value) port = (uint16_t)std::stoi(argv[++i]);
+        else if (arg == "-n" && has_value) peers = std::stoi(argv[++i]);
+        else if (arg == "-6" && has_value) peers6 = std::stoi(argv[++i]);
+        else if (arg == "-l" && has_value) config.latency_ms = std::stoi(argv[++i]);
+        else if (arg == "-j" && has_value) config.jitter_ms = std::stoi(argv[++i]);
+        else if (arg == "--loss" && has_value) config.loss = std::stod(argv[++i]);
+        else if (arg == "--truncate" && has_value) config.truncate = std::stod(argv[++i]);
+        else if (arg == "--seed" && has_value) config.seed = (uint32_t)std::stoul(argv[++i]);
+        else if (arg == "--close") config.keep_alive = false;
+        else {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            return 1;
+        }
+    }
+    config.peers = LocalTracker::SyntheticPeers(peers, peers6);
+
+    try {
+        LocalTracker tracker(config, port);
+        std::cout << tracker.HttpUrl() << "\n" << tracker.UdpUrl() << std::endl;
+        signal(SIGINT, [](int) { stop = 1; });
+        signal(SIGTERM, [](int) { stop = 1; });
+        while (!stop) pause();
+
+        auto s = tracker.Stats();
+        std::cout << "\nhttp: " << s.http_announces << " announces, " << s.http_scrapes << " scrapes over "
+                  << s.http_connections << " connections\n"
+                  << "udp: " << s.udp_connects << " connects, " << s.udp_announces << " announces, " << s.udp_scrapes << " scrapes\n"
+                  << "dropped " << s.dropped << ", truncated " << s.truncated << "\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
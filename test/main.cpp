@@ -1,14 +1,15 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include "parsing/TorrentFile.h"
-#include "tracker/Tracker.h"
 #include "download/Downloader.h"
+#include "download/Recheck.h"
 
 int main(int argc, char* argv[]) {
     // 1. Check Args
     if (argc < 2) {
-        std::cerr << "Usage: ./my_torrent_client <file.torrent>\n";
+        std::cerr << "Usage: ./my_torrent_client <file.torrent> [--recheck]\n";
         return 1;
     }
 
@@ -17,21 +18,20 @@ int main(int argc, char* argv[]) {
         std::cout << "Loading torrent file...\n";
         auto torrent = BitTorrent::TorrentFile::Load(argv[1]);
         
+        // Recheck mode: report what is already on disk and stop
+        if (argc > 2 && std::string(argv[2]) == "--recheck") {
+            auto have = BitTorrent::Recheck::Run(torrent);
+            size_t ok = std::count(have.begin(), have.end(), true);
+            std::cout << ok << " / " << have.size() << " pieces OK on disk.\n";
+            return 0;
+        }
+
         // 3. Generate Peer ID
         std::string my_id = "-CPP-CLIENT-0001-XYZ";
 
-        // 4. Get Peers from Tracker
-        std::cout << "Connecting to Tracker...\n";
-        auto peers = BitTorrent::Tracker::GetPeers(torrent, my_id);
-        
-        if (peers.empty()) {
-            std::cerr << "No peers found! Aborting.\n";
-            return 1;
-        }
-        std::cout << "Found " << peers.size() << " peers.\n";
-
-        // 5. Start Download
-        BitTorrent::Downloader d(torrent, my_id, peers);
+        // 4. Start Download. The tracker is asked from inside the download loop, so peers
+        //    are dialled as soon as its reply arrives.
+        BitTorrent::Downloader d(torrent, my_id, {});
         d.Start();
 
     } catch (const std::exception& e) {